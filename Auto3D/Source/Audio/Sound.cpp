@@ -150,12 +150,21 @@ bool Sound::LoadWav(Stream& source)
 bool Sound::LoadOggVorbis(Stream& source)
 {
 	unsigned dataSize = source.Size();
-	SharedArrayPtr<signed char> data(new signed char[dataSize]);
-	source.Read(data.Get(), dataSize);
+	SharedArrayPtr<signed char> data;
+
+	// The compressed data is kept for decoding during playback. If the stream's memory can be viewed, validate the data
+	// before allocating and copying it, otherwise read it first
+	const unsigned char* view = (const unsigned char*)source.ReadView(dataSize);
+	if (!view)
+	{
+		data = new signed char[dataSize];
+		source.Read(data.Get(), dataSize);
+		view = (const unsigned char*)data.Get();
+	}
 
 	// Check for validity of data
 	int error;
-	stb_vorbis* vorbis = stb_vorbis_open_memory((unsigned char*)data.Get(), dataSize, &error, nullptr);
+	stb_vorbis* vorbis = stb_vorbis_open_memory(view, dataSize, &error, nullptr);
 	if (!vorbis)
 	{
 		ErrorString("Could not read Ogg Vorbis data from " + source.Name());
@@ -169,6 +178,12 @@ bool Sound::LoadOggVorbis(Stream& source)
 	_stereo = info.channels > 1;
 	stb_vorbis_close(vorbis);
 
+	if (!data)
+	{
+		data = new signed char[dataSize];
+		memcpy(data.Get(), view, dataSize);
+	}
+
 	_data = data;
 	_dataSize = dataSize;
 	_sixteenBit = true;
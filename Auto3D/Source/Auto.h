@@ -37,11 +37,13 @@
 #include "Resource/JSONFile.h"
 #include "Resource/ResourceCache.h"
 #include "Renderer/SkyBox.h"
+#include "Scene/Prefab.h"
 #include "Scene/Scene.h"
 #include "RegisteredBox/RegisteredBox.h"
 #include "Thread/Condition.h"
 #include "Thread/Mutex.h"
 #include "Thread/Thread.h"
+#include "Thread/WorkQueue.h"
 #include "Time/Time.h"
 #include "Window/Input.h"
 #include "Window/Window.h"
@@ -1,4 +1,5 @@
 #include "../Debug/Log.h"
+#include "../IO/JSONDocument.h"
 #include "../IO/Stream.h"
 #include "../Object/ObjectResolver.h"
 #include "../Resource/JSONFile.h"
@@ -10,6 +11,27 @@
 namespace Auto3D
 {
 
+/// Create and load the child nodes from either a JSON value or a JSON document node.
+template <typename _Ty> static void LoadChildrenJSON(Node2D* node, const _Ty& source, ObjectResolver& resolver)
+{
+	const _Ty& children = source["children"];
+	if (!children.IsArray())
+		return;
+
+	for (size_t i = 0; i < children.Size(); ++i)
+	{
+		const _Ty& childJSON = children[i];
+		StringHash childType(childJSON["type"].GetString());
+		unsigned childId = (unsigned)childJSON["id"].GetNumber();
+		Node2D* child = node->CreateChild(childType);
+		if (child)
+		{
+			resolver.StoreObject(childId, child);
+			child->LoadJSON(childJSON, resolver);
+		}
+	}
+}
+
 Node2D::Node2D():
 	_flags(NF_2D_ENABLED),
 	_layer(LAYER_2D_DEFAULT),
@@ -79,23 +101,14 @@ void Node2D::LoadJSON(const JSONValue& source, ObjectResolver& resolver)
 {
 	// Type and _id has been read by the parent
 	Serializable::LoadJSON(source, resolver);
+	LoadChildrenJSON(this, source, resolver);
+}
 
-	const JSONArray& children = source["children"].GetArray();
-	if (children.Size())
-	{
-		for (auto it = children.Begin(); it != children.End(); ++it)
-		{
-			const JSONValue& childJSON = *it;
-			StringHash childType(childJSON["type"].GetString());
-			unsigned childId = (unsigned)childJSON["id"].GetNumber();
-			Node2D* child = CreateChild(childType);
-			if (child)
-			{
-				resolver.StoreObject(childId, child);
-				child->LoadJSON(childJSON, resolver);
-			}
-		}
-	}
+void Node2D::LoadJSON(const JSONNode& source, ObjectResolver& resolver)
+{
+	// Type and _id has been read by the parent
+	Serializable::LoadJSON(source, resolver);
+	LoadChildrenJSON(this, source, resolver);
 }
 
 void Node2D::SaveJSON(JSONValue& dest)
@@ -82,12 +82,12 @@ public:
         
         /// Construct from a non-const iterator.
         ConstIterator(const Iterator& rhs) :
-            HashIteratorBase(rhs.ptr)
+            HashIteratorBase(rhs._ptr)
         {
         }
         
         /// Assign from a non-const iterator.
-        ConstIterator& operator = (const Iterator& rhs) { _ptr = rhs.ptr; return *this; }
+        ConstIterator& operator = (const Iterator& rhs) { _ptr = rhs._ptr; return *this; }
         /// Preincrement the pointer.
         ConstIterator& operator ++ () { GotoNext(); return *this; }
         /// Postincrement the pointer.
@@ -98,9 +98,9 @@ public:
         ConstIterator operator -- (int) { ConstIterator it = *this; GotoPrev(); return it; }
         
         /// Point to the _key.
-        const _Ty* operator -> () const { return &(static_cast<Node*>(_ptr))->key; }
+        const _Ty* operator -> () const { return &(static_cast<Node*>(_ptr))->_key; }
         /// Dereference the _key.
-        const _Ty& operator * () const { return (static_cast<Node*>(_ptr))->key; }
+        const _Ty& operator * () const { return (static_cast<Node*>(_ptr))->_key; }
     };
     
     /// Construct empty.
@@ -202,7 +202,7 @@ public:
     /// Insert a _key by iterator. Return iterator to the value.
     Iterator Insert(const ConstIterator& it)
     {
-        return Iterator(InsertNode(*it));
+        return Insert(*it);
     }
     
     /// Erase a _key. Return true if was found.
@@ -219,9 +219,9 @@ public:
             return false;
         
         if (previous)
-            previous->down = node->down;
+            previous->_down = node->_down;
         else
-            Ptrs()[hashKey] = node->down;
+            Ptrs()[hashKey] = node->_down;
         
         EraseNode(node);
         return true;
@@ -230,13 +230,13 @@ public:
     /// Erase a _key by iterator. Return iterator to the next _key.
     Iterator Erase(const Iterator& it)
     {
-        if (!_ptrs || !it.ptr)
+        if (!_ptrs || !it._ptr)
             return End();
         
-        Node* node = static_cast<Node*>(it.ptr);
+        Node* node = static_cast<Node*>(it._ptr);
         Node* next = node->Next();
         
-        unsigned hashKey = Hash(node->key);
+        unsigned hashKey = Hash(node->_key);
         
         Node* previous = nullptr;
         Node* current = static_cast<Node*>(Ptrs()[hashKey]);
@@ -249,9 +249,9 @@ public:
         assert(current == node);
         
         if (previous)
-            previous->down = node->down;
+            previous->_down = node->_down;
         else
-            Ptrs()[hashKey] = node->down;
+            Ptrs()[hashKey] = node->_down;
         
         EraseNode(node);
         return Iterator(next);
@@ -292,14 +292,14 @@ public:
         Auto3D::Sort(RandomAccessIterator<Node*>(ptrs), RandomAccessIterator<Node*>(ptrs + numKeys), CompareNodes);
         
         SetHead(ptrs[0]);
-        ptrs[0]->prev = nullptr;
+        ptrs[0]->_prev = nullptr;
         for (size_t i = 1; i < numKeys; ++i)
         {
-            ptrs[i - 1]->next = ptrs[i];
-            ptrs[i]->prev = ptrs[i - 1];
+            ptrs[i - 1]->_next = ptrs[i];
+            ptrs[i]->_prev = ptrs[i - 1];
         }
-        ptrs[numKeys - 1]->next = Tail();
-        Tail()->prev = ptrs[numKeys - 1];
+        ptrs[numKeys - 1]->_next = Tail();
+        Tail()->_prev = ptrs[numKeys - 1];
         
         delete[] ptrs;
     }
@@ -418,7 +418,7 @@ private:
         Node* node = static_cast<Node*>(Ptrs()[hashKey]);
         while (node)
         {
-            if (node->key == key)
+            if (node->_key == key)
                 return node;
             previous = node;
             node = node->Down();
@@ -464,8 +464,8 @@ private:
         Node* prev = node->Prev();
         Node* next = node->Next();
         if (prev)
-            prev->next = next;
-        next->prev = prev;
+            prev->_next = next;
+        next->_prev = prev;
         
         // Reassign the head node if necessary
         if (node == Head())
@@ -505,7 +505,7 @@ private:
     }
     
     /// Compare two nodes.
-    static bool CompareNodes(Node*& lhs, Node*& rhs) { return lhs->key < rhs->key; }
+    static bool CompareNodes(Node*& lhs, Node*& rhs) { return lhs->_key < rhs->_key; }
 
     /// Compute a hash based on the _key and the bucket _size
     unsigned Hash(const _Ty& key) const { return MakeHash(key) & (NumBuckets() - 1); }
@@ -0,0 +1,41 @@
+#include "IdAllocator.h"
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+IdAllocator::IdAllocator(unsigned firstId) :
+    _firstId(firstId),
+    _nextId(firstId)
+{
+}
+
+unsigned IdAllocator::Allocate()
+{
+    MutexLock lock(_mutex);
+
+    if (_freeIds.IsEmpty())
+        return _nextId++;
+
+    unsigned id = _freeIds.Back();
+    _freeIds.Pop();
+    return id;
+}
+
+void IdAllocator::Free(unsigned id)
+{
+    MutexLock lock(_mutex);
+
+    if (id >= _firstId && id < _nextId)
+        _freeIds.Push(id);
+}
+
+unsigned IdAllocator::NumAllocated()
+{
+    MutexLock lock(_mutex);
+
+    return _nextId - _firstId - (unsigned)_freeIds.Size();
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../Thread/Mutex.h"
+#include "Vector.h"
+
+namespace Auto3D
+{
+
+/// Allocator of small integer IDs, for example for sort keys. Freed IDs are reused before new ones are allocated, so that the IDs stay small and do not depend on memory addresses. Thread-safe.
+class AUTO_API IdAllocator
+{
+public:
+    /// Construct. IDs are allocated starting from firstId.
+    IdAllocator(unsigned firstId = 1);
+
+    /// Allocate an ID.
+    unsigned Allocate();
+    /// Free an ID for reuse.
+    void Free(unsigned id);
+
+    /// Return number of IDs in use.
+    unsigned NumAllocated();
+
+private:
+    /// Mutex for thread-safe access.
+    Mutex _mutex;
+    /// Freed IDs.
+    Vector<unsigned> _freeIds;
+    /// First ID.
+    unsigned _firstId;
+    /// Next never allocated ID.
+    unsigned _nextId;
+};
+
+}
@@ -0,0 +1,109 @@
+#include "RadixSort.h"
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+/// Below this key count an insertion sort is faster than the radix sort passes.
+static const size_t RADIX_SORT_THRESHOLD = 64;
+
+RadixSorter::RadixSorter()
+{
+    _histograms.Resize(RADIX_SORT_MAX_PASSES * RADIX_SORT_BUCKETS);
+}
+
+void RadixSorter::Sort(Vector<unsigned long long>& keys, Vector<unsigned>& indices, unsigned keyBits)
+{
+    size_t count = keys.Size();
+    indices.Resize(count);
+    for (size_t i = 0; i < count; ++i)
+        indices[i] = (unsigned)i;
+
+    if (count < 2)
+        return;
+
+    if (count < RADIX_SORT_THRESHOLD)
+    {
+        // Stable insertion sort of the keys and indices together
+        for (size_t i = 1; i < count; ++i)
+        {
+            unsigned long long key = keys[i];
+            size_t j = i;
+            while (j > 0 && key < keys[j - 1])
+            {
+                keys[j] = keys[j - 1];
+                indices[j] = indices[j - 1];
+                --j;
+            }
+            keys[j] = key;
+            indices[j] = (unsigned)i;
+        }
+        return;
+    }
+
+    if (keyBits > 64)
+        keyBits = 64;
+    size_t numPasses = (keyBits + RADIX_SORT_DIGIT_BITS - 1) / RADIX_SORT_DIGIT_BITS;
+    const unsigned long long digitMask = RADIX_SORT_BUCKETS - 1;
+
+    // Count the digits of all passes in one read of the keys
+    unsigned* histograms = &_histograms[0];
+    for (size_t i = 0; i < numPasses * RADIX_SORT_BUCKETS; ++i)
+        histograms[i] = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        unsigned long long key = keys[i];
+        for (size_t pass = 0; pass < numPasses; ++pass)
+            ++histograms[pass * RADIX_SORT_BUCKETS + ((key >> (pass * RADIX_SORT_DIGIT_BITS)) & digitMask)];
+    }
+
+    _tempKeys.Resize(count);
+    _tempIndices.Resize(count);
+    unsigned long long* srcKeys = &keys[0];
+    unsigned* srcIndices = &indices[0];
+    unsigned long long* destKeys = &_tempKeys[0];
+    unsigned* destIndices = &_tempIndices[0];
+
+    for (size_t pass = 0; pass < numPasses; ++pass)
+    {
+        unsigned* histogram = histograms + pass * RADIX_SORT_BUCKETS;
+        unsigned shift = (unsigned)(pass * RADIX_SORT_DIGIT_BITS);
+
+        // If all keys have the same digit, the pass would not change the order
+        if (histogram[(srcKeys[0] >> shift) & digitMask] == count)
+            continue;
+
+        // Convert counts to bucket start offsets
+        unsigned offset = 0;
+        for (size_t i = 0; i < RADIX_SORT_BUCKETS; ++i)
+        {
+            unsigned bucketCount = histogram[i];
+            histogram[i] = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            unsigned long long key = srcKeys[i];
+            unsigned dest = histogram[(key >> shift) & digitMask]++;
+            destKeys[dest] = key;
+            destIndices[dest] = srcIndices[i];
+        }
+
+        Swap(srcKeys, destKeys);
+        Swap(srcIndices, destIndices);
+    }
+
+    // Copy back if the result ended up in the scratch buffers
+    if (srcKeys != &keys[0])
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            keys[i] = srcKeys[i];
+            indices[i] = srcIndices[i];
+        }
+    }
+}
+
+}
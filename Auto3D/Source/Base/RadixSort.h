@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Vector.h"
+
+namespace Auto3D
+{
+
+/// Number of key bits sorted per radix sort pass.
+static const unsigned RADIX_SORT_DIGIT_BITS = 11;
+/// Number of buckets per radix sort pass.
+static const size_t RADIX_SORT_BUCKETS = 1 << RADIX_SORT_DIGIT_BITS;
+/// Maximum number of radix sort passes for a 64-bit key.
+static const size_t RADIX_SORT_MAX_PASSES = (64 + RADIX_SORT_DIGIT_BITS - 1) / RADIX_SORT_DIGIT_BITS;
+
+/// Stable least significant digit first radix sorter for 64-bit keys. Sorts keys together with their original indices, so that the sorted objects need to be moved only once. Keeps the scratch buffers between sorts.
+class AUTO_API RadixSorter
+{
+public:
+    /// Construct.
+    RadixSorter();
+
+    /// Sort keys in ascending order and fill the indices with the original positions of the sorted keys. Only the low keyBits of the keys are sorted, fewer bits take fewer passes. Passes where all keys have the same digit are skipped.
+    void Sort(Vector<unsigned long long>& keys, Vector<unsigned>& indices, unsigned keyBits = 64);
+
+private:
+    /// Scratch keys.
+    Vector<unsigned long long> _tempKeys;
+    /// Scratch indices.
+    Vector<unsigned> _tempIndices;
+    /// Bucket counts of all passes.
+    Vector<unsigned> _histograms;
+};
+
+}
@@ -100,6 +100,15 @@ ProfilerBlock* ProfilerBlock::FindOrCreateChild(const char* name)
     return newBlock;
 }
 
+ProfilerCounter::ProfilerCounter(const char* name) :
+    _name(name),
+    _value(0),
+    _frameValue(0),
+    _intervalValue(0),
+    _totalValue(0)
+{
+}
+
 Profiler::Profiler() :
     _intervalFrames(0),
     _totalFrames(0)
@@ -153,6 +162,14 @@ void Profiler::EndFrame()
         ++_totalFrames;
         _root->EndFrame();
         _current = _root;
+
+        for (auto it = _counters.Begin(); it != _counters.End(); ++it)
+        {
+            it->_frameValue = it->_value;
+            it->_intervalValue += it->_value;
+            it->_totalValue += it->_value;
+            it->_value = 0;
+        }
     }
 }
 
@@ -160,6 +177,48 @@ void Profiler::BeginInterval()
 {
     _root->BeginInterval();
     _intervalFrames = 0;
+
+    for (auto it = _counters.Begin(); it != _counters.End(); ++it)
+        it->_intervalValue = 0;
+}
+
+void Profiler::AddToCounter(const char* name, long long value)
+{
+    if (!Thread::IsMainThread())
+        return;
+
+    // First check using string pointers only, then resort to actual strcmp
+    for (auto it = _counters.Begin(); it != _counters.End(); ++it)
+    {
+        if (it->_name == name)
+        {
+            it->_value += value;
+            return;
+        }
+    }
+
+    for (auto it = _counters.Begin(); it != _counters.End(); ++it)
+    {
+        if (!String::Compare(it->_name, name))
+        {
+            it->_value += value;
+            return;
+        }
+    }
+
+    _counters.Push(ProfilerCounter(name));
+    _counters.Back()._value = value;
+}
+
+const ProfilerCounter* Profiler::FindCounter(const char* name) const
+{
+    for (auto it = _counters.Begin(); it != _counters.End(); ++it)
+    {
+        if (it->_name == name || !String::Compare(it->_name, name))
+            return &*it;
+    }
+
+    return nullptr;
 }
 
 String Profiler::OutputResults(bool showUnused, bool showTotal, size_t maxDepth) const
@@ -179,6 +238,33 @@ String Profiler::OutputResults(bool showUnused, bool showTotal, size_t maxDepth)
 
     OutputResults(_root, output, 0, maxDepth, showUnused, showTotal);
 
+    if (_counters.Size())
+    {
+        char line[LINE_MAX_LENGTH];
+        char paddedName[LINE_MAX_LENGTH];
+        size_t currentInterval = _intervalFrames ? _intervalFrames : 1;
+
+        if (!showTotal)
+            output += String("\nCounter                          Avg/frame         Interval\n\n");
+        else
+            output += String("\nCounter                          Last frame        Total\n\n");
+
+        for (auto it = _counters.Begin(); it != _counters.End(); ++it)
+        {
+            memset(paddedName, ' ', NAME_MAX_LENGTH);
+            paddedName[0] = 0;
+            strcat(paddedName, it->_name);
+            paddedName[strlen(paddedName)] = ' ';
+            paddedName[NAME_MAX_LENGTH] = 0;
+
+            if (!showTotal)
+                sprintf(line, "%s %16lld %16lld\n", paddedName, it->_intervalValue / (long long)currentInterval, it->_intervalValue);
+            else
+                sprintf(line, "%s %16lld %16lld\n", paddedName, it->_frameValue, it->_totalValue);
+            output += String(line);
+        }
+    }
+
     return output;
 }
 
@@ -63,6 +63,24 @@ public:
     unsigned _totalCount;
 };
 
+/// Profiling counter for a value accumulated during each frame, for example uploaded bytes.
+struct AUTO_API ProfilerCounter
+{
+    /// Construct.
+    ProfilerCounter(const char* name = nullptr);
+
+    /// Counter name.
+    const char* _name;
+    /// Current frame's value.
+    long long _value;
+    /// Previous frame's value.
+    long long _frameValue;
+    /// Current interval's accumulated value.
+    long long _intervalValue;
+    /// Accumulated value since start.
+    long long _totalValue;
+};
+
 /// Hierarchical performance profiler subsystem.
 class AUTO_API Profiler : public BaseSubsystem
 {
@@ -84,6 +102,8 @@ public:
     void EndFrame();
     /// Begin a profiler interval.
     void BeginInterval();
+    /// Add to a counter's value for the current frame. The name must be persistent; string literals are recommended.
+    void AddToCounter(const char* name, long long value);
 
     /// Output results into a string.
     String OutputResults(bool showUnused = false, bool showTotal = false, size_t maxDepth = M_MAX_UNSIGNED) const;
@@ -91,6 +111,10 @@ public:
     const ProfilerBlock* CurrentBlock() const { return _current; }
     /// Return the root profiling block.
     const ProfilerBlock* RootBlock() const { return _root; }
+    /// Return a counter by name or null if not found.
+    const ProfilerCounter* FindCounter(const char* name) const;
+    /// Return all counters.
+    const Vector<ProfilerCounter>& Counters() const { return _counters; }
 
 private:
     /// Output results recursively.
@@ -100,6 +124,8 @@ private:
     ProfilerBlock* _current;
     /// Root profiling block.
     AutoPtr<ProfilerBlock> _root;
+    /// Counters.
+    Vector<ProfilerCounter> _counters;
     /// Frames in the current interval.
     size_t _intervalFrames;
     /// Total frames since start.
@@ -132,8 +158,10 @@ private:
 
 #ifdef AUTO_PROFILING
 #define PROFILE(name) AutoProfileBlock profile_ ## name (#name)
+#define PROFILE_COUNTER(name, value) { Profiler* profiler_ = Object::Subsystem<Profiler>(); if (profiler_) profiler_->AddToCounter(#name, value); }
 #else
 #define PROFILE(_name)
+#define PROFILE_COUNTER(_name, _value)
 #endif
 
 }
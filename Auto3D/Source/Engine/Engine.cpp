@@ -2,6 +2,7 @@
 
 #include "../Window/Window.h"
 #include "../Thread/Thread.h"
+#include "../Thread/WorkQueue.h"
 
 #include "../Audio/Audio.h"
 #include "../Resource/ResourceCache.h"
@@ -59,6 +60,7 @@ Engine::Engine():
 	_graphics = new Graphics();
 	_renderer = new Renderer();
 	_time = new Time();
+	_workQueue = new WorkQueue();
 	_registeredBox = new RegisteredBox();
 	_script = new Script();
 	_renderer2d = new Renderer2D();
@@ -109,6 +111,9 @@ bool Engine::Init()
 	// Init FPU state of main thread
 	InitFPU();
 
+	// Create one worker thread per logical CPU, the main thread takes the remaining one
+	_workQueue->CreateThreads(Max((int)GetNumLogicalCPUs() - 1, 0));
+
 	_frameTimer.Reset();
 
 	_initialized = true;
@@ -187,6 +192,11 @@ bool Engine::Update()
 	}
 	if(Subsystem<Audio>())
 		Subsystem<Audio>()->Update();
+	// Reload resources whose files have changed before they are used this frame
+	if (_cache->AutoReloadResources())
+		_cache->ReloadChangedResources();
+	// Finish resources loaded in the background within the frame budget
+	_cache->UpdateBackgroundLoading();
 
 	
 	return true;
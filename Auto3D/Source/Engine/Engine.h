@@ -12,6 +12,7 @@ class Input;
 class Log;
 class Profiler;
 class Time;
+class WorkQueue;
 class RegisteredBox;
 class Script;
 class Renderer2D;
@@ -75,6 +76,8 @@ public:
 private:
 	/// Actually perform the exit actions.
 	void DoExit();
+	/// Work-stealing job system for running work on all CPU cores. Declared first so that it is destroyed last, after the resource cache has stopped its background loader thread
+	UniquePtr<WorkQueue> _workQueue;
 	/// Manage the subsystem of all resource loads
 	UniquePtr<ResourceCache> _cache;
 	/// ADAPTS the low-level rendering interface as well as the form's rendering function
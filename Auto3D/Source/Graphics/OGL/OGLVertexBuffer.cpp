@@ -15,7 +15,12 @@ VertexBuffer::VertexBuffer() :
     _numVertices(0),
     _vertexSize(0),
     _elementHash(0),
-    _usage(ResourceUsage::DEFAULT)
+    _usage(ResourceUsage::DEFAULT),
+    _numRegions(0),
+    _regionVertices(0),
+    _regionIndex(0),
+    _mappedData(nullptr),
+    _persistent(false)
 {
 }
 
@@ -35,14 +40,32 @@ void VertexBuffer::Release()
         }
     }
 
+    for (auto it = _regionFences.Begin(); it != _regionFences.End(); ++it)
+    {
+        if (*it)
+        {
+            glDeleteSync((GLsync)*it);
+            *it = nullptr;
+        }
+    }
+
     if (_buffer)
     {
+        if (_mappedData && _graphics)
+        {
+            _graphics->BindVBO(_buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        _mappedData = nullptr;
+
         if (_graphics && _graphics->BoundVBO() == _buffer)
             _graphics->BindVBO(0);
 
         glDeleteBuffers(1, &_buffer);
         _buffer = 0;
     }
+
+    _persistent = false;
 }
 
 void VertexBuffer::Recreate()
@@ -51,8 +74,17 @@ void VertexBuffer::Recreate()
     {
         // Also make a copy of the current vertex elements, as they are passed by reference and manipulated by Define()
         Vector<VertexElement> srcElements = _elements;
-        Define(_usage, _numVertices, srcElements, !_shadowData.IsNull(), _shadowData.Get());
-        SetDataLost(!_shadowData.IsNull());
+        if (_numRegions)
+        {
+            // Ring buffer contents are rewritten every frame, so they do not need to be restored
+            DefineRing(_numRegions, _regionVertices, srcElements);
+            SetDataLost(false);
+        }
+        else
+        {
+            Define(_usage, _numVertices, srcElements, !_shadowData.IsNull(), _shadowData.Get());
+            SetDataLost(!_shadowData.IsNull());
+        }
     }
 }
 
@@ -75,6 +107,11 @@ bool VertexBuffer::SetData(size_t firstVertex, size_t numVertices, const void* d
         ErrorString("Can not update immutable vertex buffer");
         return false;
     }
+    if (_numRegions)
+    {
+        ErrorString("Ring vertex buffer must be updated by mapping its regions");
+        return false;
+    }
 
     if (_shadowData)
         memcpy(_shadowData.Get() + firstVertex * _vertexSize, data, numVertices * _vertexSize);
@@ -91,6 +128,112 @@ bool VertexBuffer::SetData(size_t firstVertex, size_t numVertices, const void* d
     return true;
 }
 
+bool VertexBuffer::DefineRing(size_t numRegions, size_t regionVertices, const Vector<VertexElement>& elements)
+{
+    if (!numRegions || !regionVertices)
+    {
+        ErrorString("Can not define ring vertex buffer with no regions or no vertices");
+        return false;
+    }
+
+    // Set the ring parameters first, as Create() checks them
+    _numRegions = numRegions;
+    _regionVertices = regionVertices;
+    _regionIndex = 0;
+    _regionFences.Resize(numRegions);
+    for (size_t i = 0; i < numRegions; ++i)
+        _regionFences[i] = nullptr;
+
+    if (!Define(ResourceUsage::DYNAMIC, numRegions * regionVertices, elements, false))
+    {
+        _numRegions = 0;
+        _regionVertices = 0;
+        _regionFences.Clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool VertexBuffer::NextRegion()
+{
+    if (!_numRegions)
+    {
+        ErrorString("Vertex buffer is not a ring buffer");
+        return false;
+    }
+
+    UnmapRegion();
+
+    if (!_buffer)
+        return false;
+
+    // Fence the region the GPU may still be reading, then wait for the next region to become free
+    if (_regionFences[_regionIndex])
+        glDeleteSync((GLsync)_regionFences[_regionIndex]);
+    _regionFences[_regionIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _regionIndex = (_regionIndex + 1) % _numRegions;
+
+    GLsync fence = (GLsync)_regionFences[_regionIndex];
+    if (fence)
+    {
+        PROFILE(WaitVertexBufferRegion);
+
+        for (;;)
+        {
+            GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+                break;
+        }
+
+        glDeleteSync(fence);
+        _regionFences[_regionIndex] = nullptr;
+    }
+
+    return true;
+}
+
+unsigned char* VertexBuffer::MapRegion(size_t firstVertex, size_t numVertices)
+{
+    if (!_numRegions || !_buffer)
+    {
+        ErrorString("Vertex buffer is not a ring buffer");
+        return nullptr;
+    }
+    if (firstVertex + numVertices > _regionVertices)
+    {
+        ErrorString("Out of bounds range for mapping vertex buffer region");
+        return nullptr;
+    }
+
+    size_t offset = (RegionStart() + firstVertex) * _vertexSize;
+    if (_persistent)
+        return _mappedData + offset;
+
+    UnmapRegion();
+    if (!numVertices)
+        return nullptr;
+
+    // The fences guarantee that the GPU is not reading the range, so no synchronization is needed
+    _graphics->BindVBO(_buffer);
+    _mappedData = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, offset, numVertices * _vertexSize, GL_MAP_WRITE_BIT |
+        GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!_mappedData)
+        ErrorString("Failed to map vertex buffer region");
+
+    return _mappedData;
+}
+
+void VertexBuffer::UnmapRegion()
+{
+    if (_persistent || !_mappedData)
+        return;
+
+    _graphics->BindVBO(_buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    _mappedData = nullptr;
+}
+
 bool VertexBuffer::Create(const void* data)
 {
     if (_graphics && _graphics->IsInitialized())
@@ -103,7 +246,21 @@ bool VertexBuffer::Create(const void* data)
         }
 
         _graphics->BindVBO(_buffer);
-        glBufferData(GL_ARRAY_BUFFER, _numVertices * _vertexSize, data, _usage == ResourceUsage::DYNAMIC ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+        size_t byteSize = _numVertices * _vertexSize;
+
+        // Ring buffers stay mapped for their whole lifetime if immutable buffer storage is supported (GL 4.4)
+        if (_numRegions && glBufferStorage && glMapBufferRange)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, byteSize, data, flags);
+            _mappedData = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, byteSize, flags);
+            _persistent = _mappedData != nullptr;
+            if (!_persistent)
+                ErrorString("Failed to map ring vertex buffer persistently");
+        }
+        else
+            glBufferData(GL_ARRAY_BUFFER, byteSize, data, _usage == ResourceUsage::DYNAMIC ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+
         LogStringF("Created vertex buffer numVertices %u vertexSize %u", (unsigned)_numVertices, (unsigned)_vertexSize);
     }
 
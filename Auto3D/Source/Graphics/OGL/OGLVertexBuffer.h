@@ -28,6 +28,14 @@ public:
     bool Define(ResourceUsage::Type usage, size_t numVertices, size_t numElements, const VertexElement* elements, bool useShadowData, const void* _data = nullptr);
     /// Redefine buffer data either completely or partially. Not supported for immutable buffers. Return true on success.
     bool SetData(size_t firstVertex, size_t numVertices, const void* _data);
+    /// Define a dynamic ring buffer of several equally sized regions. The CPU writes one region while the GPU may still read the others. Stays persistently mapped if buffer storage is supported. Return true on success.
+    bool DefineRing(size_t numRegions, size_t regionVertices, const Vector<VertexElement>& elements);
+    /// Move to the next ring buffer region, waiting until the GPU has finished reading it. Call after issuing the draw calls that use the current region. Return true on success.
+    bool NextRegion();
+    /// Map a vertex range of the current ring buffer region for writing. The range must not have been drawn from yet. Return pointer to the data or null on failure.
+    unsigned char* MapRegion(size_t firstVertex, size_t numVertices);
+    /// Unmap the current ring buffer region, which must be done before drawing from it. No-op when persistently mapped.
+    void UnmapRegion();
 
     /// Return CPU-side shadow data if exists.
     unsigned char* ShadowData() const { return _shadowData.Get(); }
@@ -47,6 +55,14 @@ public:
     bool IsDynamic() const { return _usage == ResourceUsage::DYNAMIC; }
     /// Return whether is immutable.
     bool IsImmutable() const { return _usage == ResourceUsage::IMMUTABLE; }
+    /// Return number of ring buffer regions, or 0 if not a ring buffer.
+    size_t NumRegions() const { return _numRegions; }
+    /// Return number of vertices in one ring buffer region.
+    size_t RegionVertices() const { return _regionVertices; }
+    /// Return first vertex of the current ring buffer region.
+    size_t RegionStart() const { return _regionIndex * _regionVertices; }
+    /// Return whether the ring buffer stays persistently mapped.
+    bool IsPersistent() const { return _persistent; }
 
     /// Return the OpenGL buffer identifier. Used internally and should not be called by portable application code.
     unsigned GetGLBuffer() const { return _buffer; }
@@ -77,6 +93,18 @@ private:
     unsigned _elementHash;
     /// Resource usage type.
     ResourceUsage::Type _usage;
+    /// Number of ring buffer regions.
+    size_t _numRegions;
+    /// Number of vertices in one ring buffer region.
+    size_t _regionVertices;
+    /// Current ring buffer region.
+    size_t _regionIndex;
+    /// OpenGL fences of the ring buffer regions, signaled when the GPU has finished reading them.
+    Vector<void*> _regionFences;
+    /// Mapped data pointer, which points to the whole buffer when persistently mapped.
+    unsigned char* _mappedData;
+    /// Persistent mapping flag.
+    bool _persistent;
 };
 
 }
\ No newline at end of file
@@ -80,6 +80,9 @@ bool Shader::ProcessIncludes(String& code, Stream& source)
             if (!includeStream)
                 return false;
 
+            // Reload the shader when the include file changes
+            cache->StoreResourceDependency(this, includeFileName);
+
             // Add the include file into the current code recursively
             if (!ProcessIncludes(code, *includeStream))
                 return false;
@@ -34,18 +34,9 @@ bool Texture::BeginLoad(Stream& source)
         _loadImages[0] = rgbaImage; // This destroys the original compressed image
     }
 
-    // Construct mip levels now if image is uncompressed
-    if (!_loadImages[0]->IsCompressed())
-    {
-        Image* mipImage = _loadImages[0];
-
-        while (mipImage->GetWidth() > 1 || mipImage->GetHeight() > 1)
-        {
-            _loadImages.Push(new Image());
-            mipImage->GenerateMipImage(*_loadImages.Back());
-            mipImage = _loadImages.Back();
-        }
-    }
+    // Construct mip levels now if image is uncompressed and does not already contain them. All levels share one allocation
+    if (!_loadImages[0]->IsCompressed() && _loadImages[0]->GetNumLevels() == 1)
+        _loadImages[0]->GenerateMipLevels();
     
     return true;
 }
@@ -64,6 +55,11 @@ bool Texture::EndLoad()
     }
 
     Image* image = _loadImages[0];
+    size_t memoryUse = 0;
+    for (size_t i = 0; i < _loadImages.Size(); ++i)
+        memoryUse += _loadImages[i]->GetMemoryUse();
+    SetMemoryUse((unsigned)memoryUse);
+
     bool success = Define(TextureType::TEX_2D, ResourceUsage::IMMUTABLE, image->GetSize(), image->GetFormat(), initialData.Size(), &initialData[0]);
     /// \todo Read a parameter file for the sampling parameters
     success &= DefineSampler(TextureFilterMode::FILTER_TRILINEAR, TextureAddressMode::WRAP, TextureAddressMode::WRAP, TextureAddressMode::WRAP);
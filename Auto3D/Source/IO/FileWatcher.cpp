@@ -0,0 +1,243 @@
+#include "../Base/Vector.h"
+#include "../Debug/Log.h"
+#include "FileSystem.h"
+#include "FileWatcher.h"
+
+#ifdef __linux__
+#	include <poll.h>
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#endif
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+#ifdef __linux__
+/// Inotify events that indicate a changed or new file.
+static const unsigned WATCH_EVENTS = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO;
+/// Inotify poll timeout in milliseconds, which determines how fast the thread reacts to being stopped.
+static const int NOTIFY_TIMEOUT = 100;
+#endif
+
+/// Sleep interval in milliseconds while waiting for the next poll.
+static const unsigned POLL_SLEEP = 50;
+
+FileWatcher::FileWatcher() :
+    _watchSubDirs(false),
+    _watchHandle(-1),
+    _delay(DEFAULT_FILE_WATCHER_DELAY)
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+    StopWatching();
+}
+
+bool FileWatcher::StartWatching(const String& pathName, bool watchSubDirs)
+{
+    StopWatching();
+
+    if (!DirExists(pathName))
+    {
+        ErrorString("Could not watch nonexistent directory " + pathName);
+        return false;
+    }
+
+    _path = AddTrailingSlash(pathName);
+    _watchSubDirs = watchSubDirs;
+
+#ifdef __linux__
+    _watchHandle = inotify_init1(IN_NONBLOCK);
+    if (_watchHandle >= 0)
+    {
+        // Inotify does not watch subdirectories, so each needs its own watch
+        AddDirWatch(String::EMPTY);
+        if (watchSubDirs)
+        {
+            Vector<String> dirNames;
+            ScanDir(dirNames, _path, "*", SCAN_DIRS, true);
+            for (auto it = dirNames.Begin(); it != dirNames.End(); ++it)
+            {
+                String dirName = FileNameAndExtension(*it);
+                if (dirName != "." && dirName != "..")
+                    AddDirWatch(*it);
+            }
+        }
+    }
+    else
+        WarningString("Could not initialize inotify, polling " + _path + " for changes");
+#endif
+
+    // When polling, take the initial modification times so that only later changes are reported
+    if (_watchHandle < 0)
+    {
+        Vector<String> fileNames;
+        ScanDir(fileNames, _path, "*", SCAN_FILES, watchSubDirs);
+        for (auto it = fileNames.Begin(); it != fileNames.End(); ++it)
+            _fileTimes[*it] = LastModifiedTime(_path + *it);
+    }
+
+    if (!Run())
+    {
+        ErrorString("Could not start file watcher thread for " + _path);
+        StopWatching();
+        return false;
+    }
+
+    InfoString("Started watching " + _path);
+    return true;
+}
+
+void FileWatcher::StopWatching()
+{
+    Stop();
+
+#ifdef __linux__
+    if (_watchHandle >= 0)
+        close(_watchHandle);
+#endif
+
+    _watchHandle = -1;
+    _dirNames.Clear();
+    _fileTimes.Clear();
+
+    MutexLock lock(_changesMutex);
+    _changes.Clear();
+}
+
+void FileWatcher::SetDelay(int delayMs)
+{
+    _delay = Max(delayMs, 0);
+}
+
+void FileWatcher::ThreadFunction()
+{
+    while (_shouldRun)
+    {
+        if (_watchHandle >= 0)
+        {
+            if (!ReadNotifications())
+                break;
+        }
+        else
+        {
+            for (unsigned time = 0; time < FILE_WATCHER_POLL_INTERVAL && _shouldRun; time += POLL_SLEEP)
+                Thread::Sleep(POLL_SLEEP);
+            if (_shouldRun)
+                PollChanges();
+        }
+    }
+}
+
+void FileWatcher::AddChange(const String& fileName)
+{
+    MutexLock lock(_changesMutex);
+    // Restart the delay on each change, so that a file being written is reported once it is finished
+    _changes[fileName] = _timer.ElapsedUSec(false);
+}
+
+bool FileWatcher::NextChange(String& dest)
+{
+    MutexLock lock(_changesMutex);
+
+    long long now = _timer.ElapsedUSec(false);
+    for (auto it = _changes.Begin(); it != _changes.End(); ++it)
+    {
+        if (now - it->_second >= _delay * 1000LL)
+        {
+            dest = it->_first;
+            _changes.Erase(it);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void FileWatcher::AddDirWatch(const String& dirName)
+{
+#ifdef __linux__
+    String dirPath = dirName.IsEmpty() ? _path : AddTrailingSlash(_path + dirName);
+    int watch = inotify_add_watch(_watchHandle, NativePath(dirPath).CString(), WATCH_EVENTS);
+    if (watch >= 0)
+        _dirNames[watch] = dirName.IsEmpty() ? dirName : AddTrailingSlash(dirName);
+    else
+        WarningString("Could not watch directory " + dirPath);
+#endif
+}
+
+bool FileWatcher::ReadNotifications()
+{
+#ifdef __linux__
+    pollfd fd;
+    fd.fd = _watchHandle;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    if (poll(&fd, 1, NOTIFY_TIMEOUT) <= 0 || !(fd.revents & POLLIN))
+        return true;
+
+    char buffer[4096] __attribute__((aligned(__alignof__(inotify_event))));
+    ssize_t length = read(_watchHandle, buffer, sizeof buffer);
+    if (length <= 0)
+        return true;
+
+    for (ssize_t offset = 0; offset < length;)
+    {
+        const inotify_event* event = (const inotify_event*)&buffer[offset];
+        offset += sizeof(inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW)
+        {
+            WarningString("File watcher event queue overflowed in " + _path + ", changes may be missed");
+            continue;
+        }
+        if (!event->len)
+            continue;
+
+        auto it = _dirNames.Find(event->wd);
+        if (it == _dirNames.End())
+            continue;
+
+        String fileName = it->_second + event->name;
+        if (event->mask & IN_ISDIR)
+        {
+            // Watch new subdirectories
+            if (_watchSubDirs && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                AddDirWatch(fileName);
+        }
+        else
+            AddChange(fileName);
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FileWatcher::PollChanges()
+{
+    Vector<String> fileNames;
+    ScanDir(fileNames, _path, "*", SCAN_FILES, _watchSubDirs);
+
+    for (auto it = fileNames.Begin(); it != fileNames.End(); ++it)
+    {
+        unsigned time = LastModifiedTime(_path + *it);
+        auto timeIt = _fileTimes.Find(*it);
+        if (timeIt == _fileTimes.End())
+        {
+            _fileTimes[*it] = time;
+            AddChange(*it);
+        }
+        else if (timeIt->_second != time)
+        {
+            timeIt->_second = time;
+            AddChange(*it);
+        }
+    }
+}
+
+}
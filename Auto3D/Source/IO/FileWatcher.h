@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../Base/HashMap.h"
+#include "../Base/String.h"
+#include "../Thread/Mutex.h"
+#include "../Thread/Thread.h"
+#include "../Time/Time.h"
+
+namespace Auto3D
+{
+
+/// Default delay in milliseconds after the last change to a file before it is reported.
+static const int DEFAULT_FILE_WATCHER_DELAY = 200;
+/// Interval in milliseconds for scanning the directory when the operating system can not notify of changes.
+static const int FILE_WATCHER_POLL_INTERVAL = 500;
+
+/// Watches a directory and its subdirectories for file changes in a background thread. Uses inotify on Linux and polls the file modification times elsewhere.
+class AUTO_API FileWatcher : public Thread
+{
+public:
+    /// Construct.
+    FileWatcher();
+    /// Destruct. Stop watching.
+    ~FileWatcher();
+
+    /// Watch for changes until stopped.
+    void ThreadFunction() override;
+
+    /// Start watching a directory. Return true on success.
+    bool StartWatching(const String& pathName, bool watchSubDirs);
+    /// Stop watching the directory.
+    void StopWatching();
+    /// Set the delay in milliseconds after the last change to a file before it is reported. Editors often write a file several times when saving.
+    void SetDelay(int delayMs);
+    /// Add a file change. Called from the watcher thread, or manually.
+    void AddChange(const String& fileName);
+    /// Return the next changed file name relative to the watched directory, if its delay has passed. Return true if found.
+    bool NextChange(String& dest);
+
+    /// Return the watched directory.
+    const String& Path() const { return _path; }
+    /// Return the delay in milliseconds.
+    int Delay() const { return _delay; }
+    /// Return whether the operating system notifies of the changes, instead of polling.
+    bool IsNotifying() const { return _watchHandle >= 0; }
+
+private:
+    /// Add an inotify watch for a directory relative to the watched directory.
+    void AddDirWatch(const String& dirName);
+    /// Read and handle inotify events. Return false if failed.
+    bool ReadNotifications();
+    /// Compare file modification times to the previous scan and add the changes.
+    void PollChanges();
+
+    /// Watched directory.
+    String _path;
+    /// Watch subdirectories flag.
+    bool _watchSubDirs;
+    /// Inotify instance, or negative if polling.
+    int _watchHandle;
+    /// Watched subdirectories by inotify watch descriptor.
+    HashMap<int, String> _dirNames;
+    /// File modification times from the previous scan when polling.
+    HashMap<String, unsigned> _fileTimes;
+    /// Mutex for the changes.
+    Mutex _changesMutex;
+    /// Changed files and the time of their last change in microseconds.
+    HashMap<String, long long> _changes;
+    /// Timer for the changes.
+    HiresTimer _timer;
+    /// Delay in milliseconds.
+    int _delay;
+};
+
+}
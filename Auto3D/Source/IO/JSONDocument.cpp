@@ -0,0 +1,368 @@
+#include "../Debug/Log.h"
+#include "../Debug/Profiler.h"
+#include "JSONDocument.h"
+#include "Stream.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+/// Minimum arena block size in bytes.
+static const size_t MIN_ARENA_BLOCK_SIZE = 16 * 1024;
+/// Alignment of arena allocations.
+static const size_t ARENA_ALIGNMENT = 8;
+
+const JSONNode JSONNode::EMPTY;
+
+/// JSON parse event handler that builds the values of a JSONDocument. Finished values are collected on a stack, and moved to the arena as one flat array when their parent array or object ends.
+class JSONDocumentBuilder : public JSONHandler
+{
+public:
+    /// Construct.
+    JSONDocumentBuilder(JSONDocument& document) :
+        _document(document),
+        _key(nullptr)
+    {
+    }
+
+    /// Handle a null value.
+    bool OnNull() override
+    {
+        PushValue();
+        return true;
+    }
+
+    /// Handle a boolean value.
+    bool OnBool(bool value) override
+    {
+        JSONNode& node = PushValue();
+        node._type = JSONType::BOOL;
+        node._data._bool = value;
+        return true;
+    }
+
+    /// Handle a number value.
+    bool OnNumber(double value) override
+    {
+        JSONNode& node = PushValue();
+        node._type = JSONType::NUMBER;
+        node._data._number = value;
+        return true;
+    }
+
+    /// Handle a vector2 value.
+    bool OnVector2(const Vector2F& value) override
+    {
+        return OnVector(JSONType::VECTOR2, value.Data(), 2);
+    }
+
+    /// Handle a vector3 value.
+    bool OnVector3(const Vector3F& value) override
+    {
+        return OnVector(JSONType::VECTOR3, value.Data(), 3);
+    }
+
+    /// Handle a vector4 value.
+    bool OnVector4(const Vector4F& value) override
+    {
+        return OnVector(JSONType::VECTOR4, value.Data(), 4);
+    }
+
+    /// Handle a string value. Parsing in place leaves the string null-terminated in the document's copy of the text.
+    bool OnString(const char* str, size_t length) override
+    {
+        JSONNode& node = PushValue();
+        node._type = JSONType::STRING;
+        node._size = (unsigned)length;
+        node._data._string = str;
+        return true;
+    }
+
+    /// Handle the start of an array.
+    bool OnStartArray() override
+    {
+        StartContainer();
+        return true;
+    }
+
+    /// Handle the end of an array.
+    bool OnEndArray(size_t numElements) override
+    {
+        size_t first = _values.Size() - numElements;
+        JSONNode* elements = numElements ? static_cast<JSONNode*>(_document.Allocate(numElements * sizeof(JSONNode))) : nullptr;
+        for (size_t i = 0; i < numElements; ++i)
+            new(elements + i) JSONNode(_values[first + i]._value);
+
+        _values.Resize(first);
+        EndContainer();
+        JSONNode& node = PushValue();
+        node._type = JSONType::ARRAY;
+        node._size = (unsigned)numElements;
+        node._data._elements = elements;
+        return true;
+    }
+
+    /// Handle the start of an object.
+    bool OnStartObject() override
+    {
+        StartContainer();
+        return true;
+    }
+
+    /// Handle the key of an object member.
+    bool OnKey(const char* str, size_t /*length*/) override
+    {
+        _keyHash = StringHash(str);
+        _key = _document.InternKey(str, _keyHash);
+        return true;
+    }
+
+    /// Handle the end of an object.
+    bool OnEndObject(size_t numMembers) override
+    {
+        size_t first = _values.Size() - numMembers;
+        JSONMember* members = numMembers ? static_cast<JSONMember*>(_document.Allocate(numMembers * sizeof(JSONMember))) : nullptr;
+        for (size_t i = 0; i < numMembers; ++i)
+            new(members + i) JSONMember(_values[first + i]);
+
+        _values.Resize(first);
+        EndContainer();
+        JSONNode& node = PushValue();
+        node._type = JSONType::OBJECT;
+        node._size = (unsigned)numMembers;
+        node._data._members = members;
+        return true;
+    }
+
+    /// Return the root value after parsing.
+    const JSONNode& Root() const { return _values.Size() ? _values[0]._value : JSONNode::EMPTY; }
+
+private:
+    /// Push a null value with the current key to the stack and return it.
+    JSONNode& PushValue()
+    {
+        _values.Resize(_values.Size() + 1);
+        JSONMember& member = _values.Back();
+        member._key = _key;
+        member._keyHash = _keyHash;
+        member._value = JSONNode();
+        _key = nullptr;
+        return member._value;
+    }
+
+    /// Handle a vector value.
+    bool OnVector(JSONType::Type type, const float* data, size_t numComponents)
+    {
+        JSONNode& node = PushValue();
+        node._type = type;
+        for (size_t i = 0; i < numComponents; ++i)
+            node._data._vector[i] = data[i];
+        return true;
+    }
+
+    /// Remember the key of an array or object while its values are parsed.
+    void StartContainer()
+    {
+        _containerKeys.Push(MakePair(_key, _keyHash));
+        _key = nullptr;
+    }
+
+    /// Restore the key of an array or object once it ends.
+    void EndContainer()
+    {
+        _key = _containerKeys.Back()._first;
+        _keyHash = _containerKeys.Back()._second;
+        _containerKeys.Pop();
+    }
+
+    /// Document.
+    JSONDocument& _document;
+    /// Finished values waiting for their parent to end.
+    Vector<JSONMember> _values;
+    /// Keys of the arrays and objects being parsed.
+    Vector<Pair<const char*, StringHash> > _containerKeys;
+    /// Key of the next value.
+    const char* _key;
+    /// Hash of the next value's key.
+    StringHash _keyHash;
+};
+
+const JSONNode& JSONNode::operator [] (const char* key) const
+{
+    const JSONMember* member = FindMember(key);
+    return member ? member->_value : EMPTY;
+}
+
+const JSONMember& JSONNode::Member(size_t index) const
+{
+    assert(_type == JSONType::OBJECT && index < _size);
+    return _data._members[index];
+}
+
+const JSONMember* JSONNode::FindMember(const char* key) const
+{
+    if (_type != JSONType::OBJECT)
+        return nullptr;
+
+    // Objects are small, so a linear search is faster than a hash table. Compare the hashes first to skip most string comparisons
+    StringHash keyHash(key);
+    for (const JSONMember* member = _data._members; member != _data._members + _size; ++member)
+    {
+        if (member->_keyHash == keyHash && (member->_key == key || !strcmp(member->_key, key)))
+            return member;
+    }
+
+    return nullptr;
+}
+
+void JSONNode::ToValue(JSONValue& dest) const
+{
+    switch (_type)
+    {
+    case JSONType::BOOL:
+        dest = _data._bool;
+        break;
+
+    case JSONType::NUMBER:
+        dest = _data._number;
+        break;
+
+    case JSONType::VECTOR2:
+        dest = GetVector2();
+        break;
+
+    case JSONType::VECTOR3:
+        dest = GetVector3();
+        break;
+
+    case JSONType::VECTOR4:
+        dest = GetVector4();
+        break;
+
+    case JSONType::STRING:
+        dest = String(_data._string, _size);
+        break;
+
+    case JSONType::ARRAY:
+        dest.SetEmptyArray();
+        dest.Resize(_size);
+        for (size_t i = 0; i < _size; ++i)
+            _data._elements[i].ToValue(dest[i]);
+        break;
+
+    case JSONType::OBJECT:
+        dest.SetEmptyObject();
+        for (size_t i = 0; i < _size; ++i)
+            _data._members[i]._value.ToValue(dest[_data._members[i]._key]);
+        break;
+
+    default:
+        dest.SetNull();
+        break;
+    }
+}
+
+JSONDocument::JSONDocument() :
+    _blockPos(nullptr),
+    _blockFree(0),
+    _memoryUse(0)
+{
+}
+
+JSONDocument::~JSONDocument()
+{
+    Clear();
+}
+
+bool JSONDocument::Parse(const char* data, size_t length)
+{
+    Clear();
+
+    // Copy the text to the arena, so that it can be parsed in place and the strings can point to it
+    char* text = static_cast<char*>(Allocate(length));
+    memcpy(text, data, length);
+
+    JSONReader reader;
+    JSONDocumentBuilder builder(*this);
+    bool success = reader.ParseInSitu(text, length, builder);
+    _root = builder.Root();
+    return success;
+}
+
+bool JSONDocument::Load(Stream& source)
+{
+    PROFILE(LoadJSONDocument);
+
+    Clear();
+
+    // Read the text directly to the arena, so that it can be parsed in place and the strings can point to it
+    size_t dataSize = source.Size() - source.Position();
+    char* text = static_cast<char*>(Allocate(dataSize));
+    if (source.Read(text, dataSize) != dataSize)
+    {
+        ErrorString("Failed to read JSON from " + source.Name());
+        return false;
+    }
+
+    JSONReader reader;
+    JSONDocumentBuilder builder(*this);
+    bool success = reader.ParseInSitu(text, dataSize, builder);
+    _root = builder.Root();
+    if (!success)
+        ErrorString("Parsing JSON from " + source.Name() + " failed on line " + String(reader.ErrorLine()) + "; data may be partial");
+
+    return success;
+}
+
+void JSONDocument::Clear()
+{
+    for (auto it = _blocks.Begin(); it != _blocks.End(); ++it)
+        delete[] *it;
+
+    _blocks.Clear();
+    _blockPos = nullptr;
+    _blockFree = 0;
+    _memoryUse = 0;
+    _keys.Clear();
+    _root = JSONNode();
+}
+
+void* JSONDocument::Allocate(size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    if (size > _blockFree)
+    {
+        // The first block holds the text and usually most of the values. Following blocks grow with the total size
+        size_t blockSize = Max(Max(size + size / 2, _memoryUse), MIN_ARENA_BLOCK_SIZE);
+        unsigned char* block = new unsigned char[blockSize];
+        _blocks.Push(block);
+        _blockPos = block;
+        _blockFree = blockSize;
+        _memoryUse += blockSize;
+    }
+
+    void* ret = _blockPos;
+    _blockPos += size;
+    _blockFree -= size;
+    return ret;
+}
+
+const char* JSONDocument::InternKey(const char* key, StringHash hash)
+{
+    auto it = _keys.Find(hash);
+    if (it == _keys.End())
+    {
+        _keys[hash] = key;
+        return key;
+    }
+
+    // On a hash collision of different keys, leave the key uninterned
+    return !strcmp(it->_second, key) ? it->_second : key;
+}
+
+}
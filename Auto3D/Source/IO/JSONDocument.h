@@ -0,0 +1,167 @@
+#pragma once
+
+#include "../Base/HashMap.h"
+#include "../Base/StringHash.h"
+#include "JSONValue.h"
+
+namespace Auto3D
+{
+
+struct JSONMember;
+
+/// Read-only JSON value stored in the memory arena of a JSONDocument. Arrays store their elements and objects their members as flat arrays in document order.
+class AUTO_API JSONNode
+{
+    friend class JSONDocument;
+    friend class JSONDocumentBuilder;
+
+public:
+    /// Construct a null value.
+    JSONNode() :
+        _type(JSONType::Null),
+        _size(0)
+    {
+        _data._number = 0.0;
+    }
+
+    /// Index as an array. Return a null value if not an array or out of range.
+    const JSONNode& operator [] (size_t index) const { return _type == JSONType::ARRAY && index < _size ? _data._elements[index] : EMPTY; }
+    /// Index as an object. Return a null value if not an object or the key does not exist.
+    const JSONNode& operator [] (const char* key) const;
+    /// Index as an object. Return a null value if not an object or the key does not exist.
+    const JSONNode& operator [] (const String& key) const { return (*this)[key.CString()]; }
+
+    /// Return type.
+    JSONType::Type Type() const { return _type; }
+    /// Return whether is null.
+    bool IsNull() const { return _type == JSONType::Null; }
+    /// Return whether is a bool.
+    bool IsBool() const { return _type == JSONType::BOOL; }
+    /// Return whether is a number.
+    bool IsNumber() const { return _type == JSONType::NUMBER; }
+    /// Return whether is a vector2.
+    bool IsVector2() const { return _type == JSONType::VECTOR2; }
+    /// Return whether is a vector3.
+    bool IsVector3() const { return _type == JSONType::VECTOR3; }
+    /// Return whether is a vector4.
+    bool IsVector4() const { return _type == JSONType::VECTOR4; }
+    /// Return whether is a string.
+    bool IsString() const { return _type == JSONType::STRING; }
+    /// Return whether is an array.
+    bool IsArray() const { return _type == JSONType::ARRAY; }
+    /// Return whether is an object.
+    bool IsObject() const { return _type == JSONType::OBJECT; }
+    /// Return value as a bool, or false on type mismatch.
+    bool GetBool() const { return _type == JSONType::BOOL ? _data._bool : false; }
+    /// Return value as a number, or zero on type mismatch.
+    double GetNumber() const { return _type == JSONType::NUMBER ? _data._number : 0.0; }
+    /// Return value as a vector2, or zero on type mismatch.
+    const Vector2F& GetVector2() const { return _type == JSONType::VECTOR2 ? *(reinterpret_cast<const Vector2F*>(_data._vector)) : Vector2F::ZERO; }
+    /// Return value as a vector3, or zero on type mismatch.
+    const Vector3F& GetVector3() const { return _type == JSONType::VECTOR3 ? *(reinterpret_cast<const Vector3F*>(_data._vector)) : Vector3F::ZERO; }
+    /// Return value as a vector4, or zero on type mismatch.
+    const Vector4F& GetVector4() const { return _type == JSONType::VECTOR4 ? *(reinterpret_cast<const Vector4F*>(_data._vector)) : Vector4F::ZERO; }
+    /// Return value as a null-terminated string, or empty string on type mismatch.
+    const char* GetString() const { return _type == JSONType::STRING ? _data._string : ""; }
+    /// Return string length, or 0 on type mismatch.
+    size_t StringLength() const { return _type == JSONType::STRING ? _size : 0; }
+    /// Return number of elements for arrays or members for objects, or 0 otherwise.
+    size_t Size() const { return _type == JSONType::ARRAY || _type == JSONType::OBJECT ? _size : 0; }
+    /// Return whether an object or array is empty. Return false if not an object or array.
+    bool IsEmpty() const { return (_type == JSONType::ARRAY || _type == JSONType::OBJECT) && !_size; }
+    /// Return an object member by index. Must be an object and the index in range.
+    const JSONMember& Member(size_t index) const;
+    /// Find an object member by key. Return null if not an object or the key does not exist.
+    const JSONMember* FindMember(const char* key) const;
+    /// Return whether has an object member.
+    bool Contains(const char* key) const { return FindMember(key) != nullptr; }
+    /// Return whether has an object member.
+    bool Contains(const String& key) const { return FindMember(key.CString()) != nullptr; }
+
+    /// Copy to a modifiable JSON value, including any nested values.
+    void ToValue(JSONValue& dest) const;
+    /// Return as a modifiable JSON value, including any nested values.
+    JSONValue ToValue() const { JSONValue ret; ToValue(ret); return ret; }
+
+    /// Empty (null) value.
+    static const JSONNode EMPTY;
+
+private:
+    /// Type.
+    JSONType::Type _type;
+    /// String length, or number of array elements or object members.
+    unsigned _size;
+    /// Value data.
+    union
+    {
+        bool _bool;
+        double _number;
+        float _vector[4];
+        const char* _string;
+        const JSONNode* _elements;
+        const JSONMember* _members;
+    } _data;
+};
+
+/// Object member of a JSONNode.
+struct AUTO_API JSONMember
+{
+    /// Null-terminated key. Equal keys within one document share the same pointer.
+    const char* _key;
+    /// Key hash.
+    StringHash _keyHash;
+    /// Value.
+    JSONNode _value;
+};
+
+/// Read-only JSON document. Parses the text in place into a copy held in a memory arena, and allocates the values there as well, so that a whole document takes only a few allocations and is freed at once.
+class AUTO_API JSONDocument
+{
+    friend class JSONDocumentBuilder;
+
+public:
+    /// Construct empty.
+    JSONDocument();
+    /// Destruct. Free the arena.
+    ~JSONDocument();
+
+    /// Prevent copy construction.
+    JSONDocument(const JSONDocument& rhs) = delete;
+    /// Prevent assignment.
+    JSONDocument& operator = (const JSONDocument& rhs) = delete;
+
+    /// Parse from JSON text. Return true on success.
+    bool Parse(const char* data, size_t length);
+    /// Parse from JSON text. Return true on success.
+    bool Parse(const String& str) { return Parse(str.CString(), str.Length()); }
+    /// Load from a stream as JSON text. Log the line of a parse error. Return true on success.
+    bool Load(Stream& source);
+    /// Free all values and the arena.
+    void Clear();
+
+    /// Return the root value.
+    const JSONNode& Root() const { return _root; }
+    /// Return the total size of the arena blocks in bytes.
+    size_t MemoryUse() const { return _memoryUse; }
+
+private:
+    /// Allocate memory from the arena, aligned for any value type.
+    void* Allocate(size_t size);
+    /// Return the interned pointer of a null-terminated key.
+    const char* InternKey(const char* key, StringHash hash);
+
+    /// Arena memory blocks.
+    Vector<unsigned char*> _blocks;
+    /// Next free byte of the current block.
+    unsigned char* _blockPos;
+    /// Free bytes left in the current block.
+    size_t _blockFree;
+    /// Total size of the arena blocks.
+    size_t _memoryUse;
+    /// First occurrence of each key, by hash.
+    HashMap<StringHash, const char*> _keys;
+    /// Root value.
+    JSONNode _root;
+};
+
+}
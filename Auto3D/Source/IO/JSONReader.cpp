@@ -0,0 +1,539 @@
+#include "../Base/AutoPtr.h"
+#include "JSONReader.h"
+#include "Stream.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+/// Maximum nesting depth of arrays and objects.
+static const unsigned MAX_JSON_DEPTH = 256;
+/// Largest mantissa that is exactly representable as a double.
+static const unsigned long long MAX_EXACT_MANTISSA = 1ULL << 53;
+
+/// Powers of ten that are exactly representable as a double.
+static const double exactPowersOfTen[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/// Parse 4 hexadecimal digits. Return true on success.
+static bool ParseHex4(unsigned& dest, const char*& pos, const char* end)
+{
+    if (end - pos < 4)
+        return false;
+
+    dest = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        char c = *pos++;
+        dest <<= 4;
+        if (c >= '0' && c <= '9')
+            dest |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            dest |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            dest |= c - 'A' + 10;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+JSONHandler::~JSONHandler()
+{
+}
+
+JSONReader::JSONReader() :
+    _start(nullptr),
+    _pos(nullptr),
+    _end(nullptr),
+    _inSitu(nullptr),
+    _errorLine(0)
+{
+}
+
+bool JSONReader::Parse(const char* data, size_t length, JSONHandler& handler)
+{
+    _start = data;
+    _pos = data;
+    _end = data + length;
+    _inSitu = nullptr;
+    return ParseRoot(handler);
+}
+
+bool JSONReader::ParseInSitu(char* data, size_t length, JSONHandler& handler)
+{
+    _start = data;
+    _pos = data;
+    _end = data + length;
+    _inSitu = data;
+    return ParseRoot(handler);
+}
+
+bool JSONReader::Parse(Stream& source, JSONHandler& handler)
+{
+    size_t dataSize = source.Size() - source.Position();
+    const char* data = (const char*)source.ReadView(dataSize);
+    if (data)
+        return Parse(data, dataSize, handler);
+
+    // The temporary buffer is owned here, so it can be parsed in place
+    AutoArrayPtr<char> buffer(new char[dataSize]);
+    if (source.Read(buffer.Get(), dataSize) != dataSize)
+    {
+        _start = _pos = _end = nullptr;
+        _errorLine = 1;
+        return false;
+    }
+
+    return ParseInSitu(buffer.Get(), dataSize, handler);
+}
+
+bool JSONReader::ParseRoot(JSONHandler& handler)
+{
+    _errorLine = 0;
+    // Anything after the root value is ignored
+    return ParseValue(handler, 0);
+}
+
+bool JSONReader::ParseValue(JSONHandler& handler, unsigned depth)
+{
+    if (!SkipWhiteSpace())
+        return Fail();
+
+    switch (*_pos)
+    {
+    case '{':
+        ++_pos;
+        return ParseObject(handler, depth + 1);
+
+    case '[':
+        ++_pos;
+        return ParseArray(handler, depth + 1);
+
+    case '\"':
+        {
+            ++_pos;
+            const char* str;
+            size_t length;
+            return (ParseString(str, length) && handler.OnString(str, length)) || Fail();
+        }
+
+    case 'n':
+        return (MatchLiteral("null") && handler.OnNull()) || Fail();
+
+    case 't':
+        return (MatchLiteral("true") && handler.OnBool(true)) || Fail();
+
+    case 'f':
+        return (MatchLiteral("false") && handler.OnBool(false)) || Fail();
+
+    case 'v':
+        if (MatchLiteral("vec2"))
+        {
+            Vector2F value;
+            return (ParseVector(&value._x, 2) && handler.OnVector2(value)) || Fail();
+        }
+        else if (MatchLiteral("vec3"))
+        {
+            Vector3F value;
+            return (ParseVector(&value._x, 3) && handler.OnVector3(value)) || Fail();
+        }
+        else if (MatchLiteral("vec4"))
+        {
+            Vector4F value;
+            return (ParseVector(&value._x, 4) && handler.OnVector4(value)) || Fail();
+        }
+        return Fail();
+
+    default:
+        if (IsDigit(*_pos) || *_pos == '-')
+        {
+            double value;
+            return (ParseNumber(value) && handler.OnNumber(value)) || Fail();
+        }
+        return Fail();
+    }
+}
+
+bool JSONReader::ParseArray(JSONHandler& handler, unsigned depth)
+{
+    if (depth > MAX_JSON_DEPTH || !handler.OnStartArray() || !SkipWhiteSpace())
+        return Fail();
+
+    size_t numElements = 0;
+    if (*_pos == ']')
+        ++_pos;
+    else
+    {
+        for (;;)
+        {
+            if (!ParseValue(handler, depth))
+                return false;
+            ++numElements;
+
+            if (!SkipWhiteSpace())
+                return Fail();
+            char c = *_pos;
+            if (c != ',' && c != ']')
+                return Fail();
+            ++_pos;
+            if (c == ']')
+                break;
+        }
+    }
+
+    return handler.OnEndArray(numElements) || Fail();
+}
+
+bool JSONReader::ParseObject(JSONHandler& handler, unsigned depth)
+{
+    if (depth > MAX_JSON_DEPTH || !handler.OnStartObject() || !SkipWhiteSpace())
+        return Fail();
+
+    size_t numMembers = 0;
+    if (*_pos == '}')
+        ++_pos;
+    else
+    {
+        for (;;)
+        {
+            if (*_pos != '\"')
+                return Fail();
+            ++_pos;
+
+            const char* key;
+            size_t keyLength;
+            if (!ParseString(key, keyLength) || !handler.OnKey(key, keyLength))
+                return Fail();
+            if (!SkipWhiteSpace() || *_pos != ':')
+                return Fail();
+            ++_pos;
+
+            if (!ParseValue(handler, depth))
+                return false;
+            ++numMembers;
+
+            if (!SkipWhiteSpace())
+                return Fail();
+            char c = *_pos;
+            if (c != ',' && c != '}')
+                return Fail();
+            ++_pos;
+            if (c == '}')
+                break;
+            if (!SkipWhiteSpace())
+                return Fail();
+        }
+    }
+
+    return handler.OnEndObject(numMembers) || Fail();
+}
+
+bool JSONReader::ParseString(const char*& str, size_t& length)
+{
+    const char* begin = _pos;
+
+    // Most strings have no escape sequences and can be returned from the source as is
+    while (_pos < _end && *_pos != '\"' && *_pos != '\\')
+        ++_pos;
+    if (_pos >= _end)
+        return false;
+
+    if (*_pos == '\"')
+    {
+        str = begin;
+        length = _pos - begin;
+        if (_inSitu)
+            _inSitu[_pos - _start] = '\0';
+        ++_pos;
+        return true;
+    }
+
+    char* decodeEnd;
+    if (_inSitu)
+    {
+        // The decoded string is never longer than the source, so it can overwrite it
+        str = begin;
+        decodeEnd = DecodeEscapes(_inSitu + (_pos - _start));
+        if (!decodeEnd)
+            return false;
+        length = decodeEnd - (_inSitu + (begin - _start));
+    }
+    else
+    {
+        // Find the closing quote first to know how much space the decoded string may need
+        const char* scan = _pos;
+        while (scan < _end && *scan != '\"')
+            scan += *scan == '\\' ? 2 : 1;
+        if (scan >= _end)
+            return false;
+
+        size_t prefixLength = _pos - begin;
+        _scratch.Resize((scan - begin) + 1);
+        memcpy(&_scratch[0], begin, prefixLength);
+        decodeEnd = DecodeEscapes(&_scratch[prefixLength]);
+        if (!decodeEnd)
+            return false;
+        str = &_scratch[0];
+        length = decodeEnd - &_scratch[0];
+    }
+
+    *decodeEnd = '\0';
+    return true;
+}
+
+char* JSONReader::DecodeEscapes(char* dest)
+{
+    while (_pos < _end)
+    {
+        char c = *_pos++;
+        if (c == '\"')
+            return dest;
+        else if (c != '\\')
+        {
+            *dest++ = c;
+            continue;
+        }
+
+        if (_pos >= _end)
+            return nullptr;
+
+        c = *_pos++;
+        switch (c)
+        {
+        case '\"':
+        case '\\':
+        case '/':
+            *dest++ = c;
+            break;
+
+        case 'b':
+            *dest++ = '\b';
+            break;
+
+        case 'f':
+            *dest++ = '\f';
+            break;
+
+        case 'n':
+            *dest++ = '\n';
+            break;
+
+        case 'r':
+            *dest++ = '\r';
+            break;
+
+        case 't':
+            *dest++ = '\t';
+            break;
+
+        case 'u':
+            {
+                unsigned code;
+                if (!ParseHex4(code, _pos, _end))
+                    return nullptr;
+
+                // Combine a UTF-16 surrogate pair
+                if (code >= 0xd800 && code < 0xdc00 && _end - _pos >= 2 && _pos[0] == '\\' && _pos[1] == 'u')
+                {
+                    _pos += 2;
+                    unsigned low;
+                    if (!ParseHex4(low, _pos, _end) || low < 0xdc00 || low >= 0xe000)
+                        return nullptr;
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+
+                String::EncodeUTF8(dest, code);
+            }
+            break;
+
+        default:
+            return nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+bool JSONReader::ParseNumber(double& dest)
+{
+    const char* begin = _pos;
+    bool negative = false;
+    if (_pos < _end && *_pos == '-')
+    {
+        negative = true;
+        ++_pos;
+    }
+
+    // Accumulate up to 19 significant digits into an integer mantissa
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    bool truncated = false;
+    bool hasDigits = false;
+
+    while (_pos < _end && IsDigit(*_pos))
+    {
+        if (mantissa < 1000000000000000000ULL)
+            mantissa = mantissa * 10 + (*_pos - '0');
+        else
+        {
+            ++exponent;
+            truncated = true;
+        }
+        hasDigits = true;
+        ++_pos;
+    }
+
+    if (_pos < _end && *_pos == '.')
+    {
+        ++_pos;
+        while (_pos < _end && IsDigit(*_pos))
+        {
+            if (mantissa < 1000000000000000000ULL)
+            {
+                mantissa = mantissa * 10 + (*_pos - '0');
+                --exponent;
+            }
+            else
+                truncated = true;
+            hasDigits = true;
+            ++_pos;
+        }
+    }
+
+    if (!hasDigits)
+        return false;
+
+    if (_pos < _end && (*_pos == 'e' || *_pos == 'E'))
+    {
+        ++_pos;
+        bool negativeExponent = false;
+        if (_pos < _end && (*_pos == '-' || *_pos == '+'))
+        {
+            negativeExponent = *_pos == '-';
+            ++_pos;
+        }
+        if (_pos >= _end || !IsDigit(*_pos))
+            return false;
+
+        int explicitExponent = 0;
+        while (_pos < _end && IsDigit(*_pos))
+        {
+            if (explicitExponent < 10000)
+                explicitExponent = explicitExponent * 10 + (*_pos - '0');
+            ++_pos;
+        }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    // When both the mantissa and the power of ten are exact, one multiplication or division gives the correctly rounded result
+    if (!truncated && mantissa <= MAX_EXACT_MANTISSA && exponent >= -22 && exponent <= 22)
+    {
+        double value = (double)mantissa;
+        value = exponent >= 0 ? value * exactPowersOfTen[exponent] : value / exactPowersOfTen[-exponent];
+        dest = negative ? -value : value;
+        return true;
+    }
+
+    // Otherwise let the C library round the number. The source may not be null-terminated, so copy it first
+    String number(begin, _pos - begin);
+    dest = strtod(number.CString(), nullptr);
+    return true;
+}
+
+bool JSONReader::ParseVector(float* dest, size_t numComponents)
+{
+    if (!SkipWhiteSpace() || *_pos != '(')
+        return false;
+    ++_pos;
+
+    for (size_t i = 0; i < numComponents; ++i)
+    {
+        double value;
+        if (!SkipWhiteSpace() || !ParseNumber(value) || !SkipWhiteSpace())
+            return false;
+        dest[i] = (float)value;
+
+        if (*_pos != (i < numComponents - 1 ? ',' : ')'))
+            return false;
+        ++_pos;
+    }
+
+    return true;
+}
+
+bool JSONReader::SkipWhiteSpace()
+{
+    for (;;)
+    {
+        while (_pos < _end && (unsigned char)*_pos <= 0x20)
+            ++_pos;
+        if (_pos >= _end)
+            return false;
+        if (*_pos != '/')
+            return true;
+
+        if (_end - _pos < 2)
+            return false;
+        if (_pos[1] == '/')
+        {
+            // Skip until end of line
+            _pos += 2;
+            while (_pos < _end && *_pos != '\n')
+                ++_pos;
+        }
+        else if (_pos[1] == '*')
+        {
+            // Skip until end of comment
+            _pos += 2;
+            while (_pos < _end - 1 && (_pos[0] != '*' || _pos[1] != '/'))
+                ++_pos;
+            if (_pos >= _end - 1)
+                return false;
+            _pos += 2;
+        }
+        else
+            return false;
+    }
+}
+
+bool JSONReader::MatchLiteral(const char* str)
+{
+    const char* pos = _pos;
+    while (*str)
+    {
+        if (pos >= _end || *pos != *str)
+            return false;
+        ++pos;
+        ++str;
+    }
+
+    _pos = pos;
+    return true;
+}
+
+bool JSONReader::Fail()
+{
+    if (!_errorLine)
+    {
+        const char* errorPos = _pos < _end ? _pos : _end;
+        _errorLine = 1;
+        for (const char* pos = _start; pos < errorPos; ++pos)
+        {
+            if (*pos == '\n')
+                ++_errorLine;
+        }
+    }
+
+    return false;
+}
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../Base/String.h"
+#include "../Base/Vector.h"
+#include "../Math/Vector4.h"
+
+namespace Auto3D
+{
+
+class Stream;
+
+/// Receiver of events from JSONReader. Strings are passed as a pointer and length; how long the pointer stays valid depends on the parse mode. Return false from any event to stop parsing.
+class AUTO_API JSONHandler
+{
+public:
+    /// Destruct.
+    virtual ~JSONHandler();
+
+    /// Handle a null value.
+    virtual bool OnNull() = 0;
+    /// Handle a boolean value.
+    virtual bool OnBool(bool value) = 0;
+    /// Handle a number value.
+    virtual bool OnNumber(double value) = 0;
+    /// Handle a vec2(x, y) value.
+    virtual bool OnVector2(const Vector2F& value) = 0;
+    /// Handle a vec3(x, y, z) value.
+    virtual bool OnVector3(const Vector3F& value) = 0;
+    /// Handle a vec4(x, y, z, w) value.
+    virtual bool OnVector4(const Vector4F& value) = 0;
+    /// Handle a string value.
+    virtual bool OnString(const char* str, size_t length) = 0;
+    /// Handle the start of an array.
+    virtual bool OnStartArray() = 0;
+    /// Handle the end of an array with its number of elements.
+    virtual bool OnEndArray(size_t numElements) = 0;
+    /// Handle the start of an object.
+    virtual bool OnStartObject() = 0;
+    /// Handle the key of an object member. The member's value follows.
+    virtual bool OnKey(const char* str, size_t length) = 0;
+    /// Handle the end of an object with its number of members.
+    virtual bool OnEndObject(size_t numMembers) = 0;
+};
+
+/// SAX-style JSON parser. Sends the values to a handler as they are read instead of building a tree, and does not allocate memory for strings without escape sequences. Supports comments and the vec2/vec3/vec4 value extension.
+class AUTO_API JSONReader
+{
+public:
+    /// Construct.
+    JSONReader();
+
+    /// Parse read-only JSON text. Strings point to the source data, or to a temporary buffer if they contain escape sequences, and are valid only during the event. Return true on success.
+    bool Parse(const char* data, size_t length, JSONHandler& handler);
+    /// Parse JSON text in place. Escape sequences are decoded into the source data and every string is null-terminated there, so strings stay valid as long as the data. Return true on success.
+    bool ParseInSitu(char* data, size_t length, JSONHandler& handler);
+    /// Parse JSON text from the current position to the end of a stream. Parses the stream's memory directly if it can be viewed, otherwise reads it to a temporary buffer first. Strings are valid only during the event. Return true on success.
+    bool Parse(Stream& source, JSONHandler& handler);
+
+    /// Return the number of bytes consumed by the last parse.
+    size_t Position() const { return _pos - _start; }
+    /// Return the line number on which the last parse failed, or 0 if it succeeded.
+    unsigned ErrorLine() const { return _errorLine; }
+
+private:
+    /// Parse the root value from the current position.
+    bool ParseRoot(JSONHandler& handler);
+    /// Parse a value. Return true on success.
+    bool ParseValue(JSONHandler& handler, unsigned depth);
+    /// Parse an array after the opening bracket. Return true on success.
+    bool ParseArray(JSONHandler& handler, unsigned depth);
+    /// Parse an object after the opening brace. Return true on success.
+    bool ParseObject(JSONHandler& handler, unsigned depth);
+    /// Parse a string after the opening quote. Return true on success.
+    bool ParseString(const char*& str, size_t& length);
+    /// Decode the escape sequences of a string starting from the first backslash into the destination. Return the end of the decoded string, or null on failure.
+    char* DecodeEscapes(char* dest);
+    /// Parse a number. Return true on success.
+    bool ParseNumber(double& dest);
+    /// Parse the parenthesized components of a vector value. Return true on success.
+    bool ParseVector(float* dest, size_t numComponents);
+    /// Skip whitespace and comments. Return false if the data ended or a comment was malformed.
+    bool SkipWhiteSpace();
+    /// Match a literal at the current position and advance past it. Return true on match.
+    bool MatchLiteral(const char* str);
+    /// Mark the parse as failed at the current position and return false.
+    bool Fail();
+
+    /// Start of the data.
+    const char* _start;
+    /// Current position.
+    const char* _pos;
+    /// End of the data.
+    const char* _end;
+    /// Writable data when parsing in place, null otherwise.
+    char* _inSitu;
+    /// Buffer for decoding escaped strings of read-only data.
+    Vector<char> _scratch;
+    /// Line number of the parse error, or 0 if none.
+    unsigned _errorLine;
+};
+
+}
@@ -301,16 +301,16 @@ bool JSONValue::operator == (const JSONValue& rhs) const
 
 bool JSONValue::FromString(const String& str)
 {
-    const char* pos = str.CString();
-    const char* end = pos + str.Length();
-    return Parse(pos, end);
+    JSONReader reader;
+    JSONValueBuilder builder(*this);
+    return reader.Parse(str.CString(), str.Length(), builder);
 }
 
 bool JSONValue::FromString(const char* str)
 {
-    const char* pos = str;
-    const char* end = pos + String::CStringLength(str);
-    return Parse(pos, end);
+    JSONReader reader;
+    JSONValueBuilder builder(*this);
+    return reader.Parse(str, String::CStringLength(str), builder);
 }
 
 void JSONValue::FromBinary(Stream& source)
@@ -580,155 +580,6 @@ bool JSONValue::Contains(const String& key) const
         return false;
 }
 
-bool JSONValue::Parse(const char*& pos, const char*& end)
-{
-    char c;
-
-    // Handle comments
-    for (;;)
-    {
-        if (!NextChar(c, pos, end, true))
-            return false;
-
-        if (c == '/')
-        {
-            if (!NextChar(c, pos, end, false))
-                return false;
-            if (c == '/')
-            {
-                // Skip until end of line
-                if (!MatchChar('\n', pos, end))
-                    return false;
-            }
-            else if (c == '*')
-            {
-                // Skip until end of comment
-                if (!MatchChar('*', pos, end))
-                    return false;
-                if (!MatchChar('/', pos, end))
-                    return false;
-            }
-            else
-                return false;
-        }
-        else
-            break;
-    }
-
-    if (c == '}' || c == ']')
-        return false;
-	else if (c == 'v')	//vec3
-	{
-		if (MatchString("ec", pos, end))
-		{
-			if (MatchString("2", pos, end))
-			{
-				SetType(JSONType::VECTOR2);
-				return ReadJSONVector2(*(reinterpret_cast<Vector2F*>(&_data)), pos, end);
-			}
-			else if (MatchString("3", pos, end))
-			{
-				SetType(JSONType::VECTOR3);
-				return ReadJSONVector3(*(reinterpret_cast<Vector3F*>(&_data)), pos, end);
-			}	
-			else if (MatchString("4", pos, end))
-			{
-				SetType(JSONType::VECTOR4);
-				return ReadJSONVector4(*(reinterpret_cast<Vector4F*>(&_data)), pos, end);
-			}
-		}	
-		else
-			return false;
-	}
-    else if (c == 'n')	//null
-    {
-        SetNull();
-        return MatchString("ull", pos, end);
-    }
-    else if (c == 'f')	//false
-    {
-        *this = false;
-        return MatchString("alse", pos, end);
-    }
-    else if (c == 't')	//true
-    {
-        *this = true;
-        return MatchString("rue", pos, end);
-    }
-    else if (IsDigit(c) || c == '-')	//digit
-    {
-        --pos;
-        *this = strtod(pos, const_cast<char**>(&pos));
-        return true;
-    }
-    else if (c == '\"')
-    {
-        SetType(JSONType::STRING);
-        return ReadJSONString(*(reinterpret_cast<String*>(&_data)), pos, end, true);
-    }
-    else if (c == '[')
-    {
-        SetEmptyArray();
-        // Check for empty first
-        if (!NextChar(c, pos, end, true))
-            return false;
-        if (c == ']')
-            return true;
-        else
-            --pos;
-        
-        for (;;)
-        {
-            JSONValue arrayValue;
-            if (!arrayValue.Parse(pos, end))
-                return false;
-            Push(arrayValue);
-            if (!NextChar(c, pos, end, true))
-                return false;
-            if (c == ']')
-                break;
-            else if (c != ',')
-                return false;
-        }
-        return true;
-    }
-    else if (c == '{')
-    {
-        SetEmptyObject();
-        if (!NextChar(c, pos, end, true))
-            return false;
-        if (c == '}')
-            return true;
-        else
-            --pos;
-        
-        for (;;)
-        {
-            String key;
-            if (!ReadJSONString(key, pos, end, false))
-                return false;
-            if (!NextChar(c, pos, end, true))
-                return false;
-            if (c != ':')
-                return false;
-            
-            JSONValue objectValue;
-            if (!objectValue.Parse(pos, end))
-                return false;
-            (*this)[key] = objectValue;
-            if (!NextChar(c, pos, end, true))
-                return false;
-            if (c == '}')
-                break;
-            else if (c != ',')
-                return false;
-        }
-        return true;
-    }
-    
-    return false;
-}
-
 void JSONValue::SetType(JSONType::Type newType)
 {
     if (_type == newType)
@@ -805,7 +656,7 @@ void JSONValue::WriteJSONString(String& dest, const String& str)
     {
         char c = *it;
         
-        if (c >= 0x20 && c != '\"' && c != '\\')
+        if ((unsigned char)c >= 0x20 && c != '\"' && c != '\\')
             dest += c;
         else
         {
@@ -841,7 +692,7 @@ void JSONValue::WriteJSONString(String& dest, const String& str)
             default:
                 {
                     char buffer[6];
-                    sprintf(buffer, "u%04x", c);
+                    sprintf(buffer, "u%04x", (unsigned char)c);
                     dest += buffer;
                 }
                 break;
@@ -860,241 +711,107 @@ void JSONValue::WriteIndent(String& dest, int indent)
         dest[oldLength + i] = ' ';
 }
 
-bool JSONValue::ReadJSONVector2(Vector2F& dest, const char*& pos, const char*& end)
-{
-	char c;
-	if (!NextChar(c, pos, end, true))
-		return false;
-	if (c == '(')
-	{
-		if (!NextChar(c, pos, end, true))
-			return false;
-		// JSON value vector2 x
-		if (IsDigit(c) || c == '-')
-		{
-			--pos;
-			dest._x = strtod(pos, const_cast<char**>(&pos));
-		}
-		else
-			return false;
-
-		if (!NextChar(c, pos, end, true) || c != ',' || !NextChar(c, pos, end, true))
-			return false;
-		// JSON value vector2 y
-		if (IsDigit(c) || c == '-')
-		{
-			--pos;
-			dest._y = strtod(pos, const_cast<char**>(&pos));
-		}
-		else
-			return false;
-
-		if (!NextChar(c, pos, end, true) || c != ')')
-			return false;
-		return true;
-	}
-	return false;
-}
-
-bool JSONValue::ReadJSONVector3(Vector3F& dest, const char*& pos, const char*& end)
-{
-	char c;
-	if (!NextChar(c, pos, end, true))
-		return false;
-	if (c == '(')
-	{
-		if (!NextChar(c, pos, end, true))
-			return false;
-		// JSON value vector2 x
-		if (IsDigit(c) || c == '-')
-		{
-			--pos;
-			dest._x = strtod(pos, const_cast<char**>(&pos));
-		}
-		else
-			return false;
-
-		if (!NextChar(c, pos, end, true) || c != ',' || !NextChar(c, pos, end, true))
-			return false;
-		// JSON value vector2 y
-		if (IsDigit(c) || c == '-')
-		{
-			--pos;
-			dest._y = strtod(pos, const_cast<char**>(&pos));
-		}
-		else
-			return false;
-		if (!NextChar(c, pos, end, true) || c != ',' || !NextChar(c, pos, end, true))
-			return false;
-		// JSON value vector4 z
-		if (IsDigit(c) || c == '-')
-		{
-			--pos;
-			dest._z = strtod(pos, const_cast<char**>(&pos));
-		}
-		else
-			return false;
-
-		if (!NextChar(c, pos, end, true) || c != ')')
-			return false;
-		return true;
-	}
-	return false;
-}
-
-bool JSONValue::ReadJSONVector4(Vector4F& dest, const char*& pos, const char*& end)
-{
-	char c;
-	if (!NextChar(c, pos, end, true))
-		return false;
-	if (c == '(')
-	{
-		if (!NextChar(c, pos, end, true))
-			return false;
-		// JSON value vector4 x
-		if (IsDigit(c) || c == '-')
-		{
-			--pos;
-			dest._x = strtod(pos, const_cast<char**>(&pos));
-		}
-		else
-			return false;
-
-		if (!NextChar(c, pos, end, true) || c != ',' || !NextChar(c, pos, end, true))
-			return false;
-		// JSON value vector4 y
-		if (IsDigit(c) || c == '-')
-		{
-			--pos;
-			dest._y = strtod(pos, const_cast<char**>(&pos));
-		}
-		else
-			return false;
-
-		if (!NextChar(c, pos, end, true) || c != ',' || !NextChar(c, pos, end, true))
-			return false;
-		// JSON value vector4 z
-		if (IsDigit(c) || c == '-')
-		{
-			--pos;
-			dest._z = strtod(pos, const_cast<char**>(&pos));
-		}
-		else
-			return false;
-
-		if (!NextChar(c, pos, end, true) || c != ',' || !NextChar(c, pos, end, true))
-			return false;
-		// JSON value vector4 w
-		if (IsDigit(c) || c == '-')
-		{
-			--pos;
-			dest._w = strtod(pos, const_cast<char**>(&pos));
-		}
-		else
-			return false;
-
-		if (!NextChar(c, pos, end, true) || c != ')')
-			return false;
-		return true;
-	}
-	return false;
-}
-
-bool JSONValue::ReadJSONString(String& dest, const char*& pos, const char*& end, bool inQuote)
-{
-    char c;
-    
-    if (!inQuote)
-    {
-        if (!NextChar(c, pos, end, true) || c != '\"')
-            return false;
-    }
-    
-    dest.Clear();
-    for (;;)
-    {
-        if (!NextChar(c, pos, end, false))
-            return false;
-        if (c == '\"')
-            break;
-        else if (c != '\\')
-            dest += c;
-        else
-        {
-            if (!NextChar(c, pos, end, false))
-                return false;
-            switch (c)
-            {
-            case '\\':
-                dest += '\\';
-                break;
-                
-            case '\"':
-                dest += '\"';
-                break;
-                
-            case 'b':
-                dest += '\b';
-                break;
-                
-            case 'f':
-                dest += '\f';
-                break;
-                
-            case 'n':
-                dest += '\n';
-                break;
-            
-            case 'r':
-                dest += '\r';
-                break;
-                
-            case 't':
-                dest += '\t';
-                break;
-                
-            case 'u':
-                {
-                    /// \todo Doesn't _handle unicode surrogate pairs
-                    unsigned code;
-                    sscanf(pos, "%x", &code);
-                    pos += 4;
-                    dest.AppendUTF8(code);
-                }
-                break;
-            }
-        }
-    }
-    
+JSONValueBuilder::JSONValueBuilder(JSONValue& root) :
+    _root(root)
+{
+    _root.SetNull();
+}
+
+bool JSONValueBuilder::OnNull()
+{
+    NextValue().SetNull();
     return true;
 }
 
-bool JSONValue::MatchString(const char* str, const char*& pos, const char*& end)
+bool JSONValueBuilder::OnBool(bool value)
 {
-    while (*str)
-    {
-        if (pos >= end || *pos != *str)
-            return false;
-        else
-        {
-            ++pos;
-            ++str;
-        }
-    }
-    
+    NextValue() = value;
+    return true;
+}
+
+bool JSONValueBuilder::OnNumber(double value)
+{
+    NextValue() = value;
     return true;
 }
 
-bool JSONValue::MatchChar(char c, const char*& pos, const char*& end)
+bool JSONValueBuilder::OnVector2(const Vector2F& value)
 {
-    char next;
+    NextValue() = value;
+    return true;
+}
 
-    while (NextChar(next, pos, end, false))
+bool JSONValueBuilder::OnVector3(const Vector3F& value)
+{
+    NextValue() = value;
+    return true;
+}
+
+bool JSONValueBuilder::OnVector4(const Vector4F& value)
+{
+    NextValue() = value;
+    return true;
+}
+
+bool JSONValueBuilder::OnString(const char* str, size_t length)
+{
+    JSONValue& value = NextValue();
+    value.SetType(JSONType::STRING);
+    reinterpret_cast<String*>(&value._data)->Append(str, length);
+    return true;
+}
+
+bool JSONValueBuilder::OnStartArray()
+{
+    JSONValue& value = NextValue();
+    value.SetEmptyArray();
+    _stack.Push(&value);
+    return true;
+}
+
+bool JSONValueBuilder::OnEndArray(size_t /*numElements*/)
+{
+    _stack.Pop();
+    return true;
+}
+
+bool JSONValueBuilder::OnStartObject()
+{
+    JSONValue& value = NextValue();
+    value.SetEmptyObject();
+    _stack.Push(&value);
+    return true;
+}
+
+bool JSONValueBuilder::OnKey(const char* str, size_t length)
+{
+    _key.Clear();
+    _key.Append(str, length);
+    return true;
+}
+
+bool JSONValueBuilder::OnEndObject(size_t /*numMembers*/)
+{
+    _stack.Pop();
+    return true;
+}
+
+JSONValue& JSONValueBuilder::NextValue()
+{
+    if (_stack.IsEmpty())
+        return _root;
+
+    // Values are constructed directly into their parent instead of being copied there after parsing.
+    // The parent can not reallocate while a child array or object is on the stack, as its next value is added only after the child ends
+    JSONValue& parent = *_stack.Back();
+    if (parent.IsArray())
     {
-        if (next == c)
-            return true;
+        JSONArray& array = *reinterpret_cast<JSONArray*>(&parent._data);
+        array.Resize(array.Size() + 1);
+        return array.Back();
     }
-    return false;
+    else
+        return parent[_key];
 }
 
 }
@@ -5,7 +5,7 @@
 #include "../Base/Vector.h"
 #include "../Base/Ptr.h"
 #include "../Math/Vector4.h"
-
+#include "JSONReader.h"
 
 namespace Auto3D
 {
@@ -51,8 +51,8 @@ struct JSONData
 /// JSON value. Stores a boolean, string or number, or either an array or dictionary-like collection of nested values.
 class AUTO_API JSONValue
 {
-    friend class JSONFile;
-    
+    friend class JSONValueBuilder;
+
 public:
     /// Construct a null value.
     JSONValue();
@@ -212,8 +212,6 @@ public:
     static const JSONObject emptyJSONObject;
     
 private:
-    /// Parse from a char buffer. Return true on success.
-    bool Parse(const char*&pos, const char*& end);
     /// Assign a new type and perform the necessary dynamic allocation / deletion.
     void SetType(JSONType::Type newType);
     
@@ -221,37 +219,55 @@ private:
     static void WriteJSONString(String& dest, const String& str);
     /// Append indent spaces to the destination.
     static void WriteIndent(String& dest, int indent);
-	/// Read a vector2 in JSON format from a stream. Return true on success.
-	static bool ReadJSONVector2(Vector2F& dest, const char*& pos, const char*& end);
-	/// Read a vector3 in JSON format from a stream. Return true on success.
-	static bool ReadJSONVector3(Vector3F& dest, const char*& pos, const char*& end);
-	/// Read a vector4 in JSON format from a stream. Return true on success.
-	static bool ReadJSONVector4(Vector4F& dest, const char*& pos, const char*& end);
-    /// Read a string in JSON format from a stream. Return true on success.
-    static bool ReadJSONString(String& dest, const char*& pos, const char*& end, bool inQuote);
-    /// Match until the end of a string. Return true if successfully matched.
-    static bool MatchString(const char* str, const char*& pos, const char*& end);
-    /// Scan until a character is found. Return true if successfully matched.
-    static bool MatchChar(char c, const char*& pos, const char*& end);
 
-    /// Get the next char from a stream. Return true on success or false if the stream ended.
-    static bool NextChar(char& dest, const char*& pos, const char*& end, bool skipWhiteSpace)
-    {
-        while (pos < end)
-        {
-            dest = *pos;
-            ++pos;
-            if (!skipWhiteSpace || dest > 0x20)
-                return true;
-        }
-        
-        return false;
-    }
-    
     /// Type.
     JSONType::Type _type;
     /// Value data.
     JSONData _data;
 };
 
+/// JSON parse event handler that builds a JSONValue tree in place.
+class AUTO_API JSONValueBuilder : public JSONHandler
+{
+public:
+    /// Construct with the root value to build into.
+    JSONValueBuilder(JSONValue& root);
+
+    /// Handle a null value.
+    bool OnNull() override;
+    /// Handle a boolean value.
+    bool OnBool(bool value) override;
+    /// Handle a number value.
+    bool OnNumber(double value) override;
+    /// Handle a vector2 value.
+    bool OnVector2(const Vector2F& value) override;
+    /// Handle a vector3 value.
+    bool OnVector3(const Vector3F& value) override;
+    /// Handle a vector4 value.
+    bool OnVector4(const Vector4F& value) override;
+    /// Handle a string value.
+    bool OnString(const char* str, size_t length) override;
+    /// Handle the start of an array.
+    bool OnStartArray() override;
+    /// Handle the end of an array.
+    bool OnEndArray(size_t numElements) override;
+    /// Handle the start of an object.
+    bool OnStartObject() override;
+    /// Handle the key of an object member.
+    bool OnKey(const char* str, size_t length) override;
+    /// Handle the end of an object.
+    bool OnEndObject(size_t numMembers) override;
+
+private:
+    /// Return the value to assign next: the root, a new array element or the member of the current key.
+    JSONValue& NextValue();
+
+    /// Root value.
+    JSONValue& _root;
+    /// Arrays and objects being filled.
+    Vector<JSONValue*> _stack;
+    /// Key of the next object member.
+    String _key;
+};
+
 }
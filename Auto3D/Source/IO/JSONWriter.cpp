@@ -0,0 +1,693 @@
+#include "../Math/Math.h"
+#include "JSONValue.h"
+#include "JSONWriter.h"
+#include "Stream.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+/// Largest magnitude below which every integral double is exact and fits a long long.
+static const double MAX_EXACT_INTEGER = 9007199254740992.0;
+/// Spaces copied for indentation.
+static const char indentSpaces[] = "                                ";
+/// Hexadecimal digits for escape sequences.
+static const char hexDigits[] = "0123456789abcdef";
+
+/// Significands of the cached powers of ten 10^-348, 10^-340, ..., 10^340 for Grisu2, normalized to 64 bits.
+static const unsigned long long cachedPowerSignificands[] =
+{
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+/// Binary exponents of the cached powers of ten.
+static const short cachedPowerExponents[] =
+{
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+/// Powers of ten that fit 32 bits.
+static const unsigned powersOfTen[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+/// Floating point number with a 64-bit significand and a binary exponent, used by Grisu2.
+struct DiyFp
+{
+    /// Construct.
+    DiyFp(unsigned long long f, int e) :
+        _f(f),
+        _e(e)
+    {
+    }
+
+    /// Subtract a number with the same exponent.
+    DiyFp operator - (const DiyFp& rhs) const { return DiyFp(_f - rhs._f, _e); }
+
+    /// Multiply, keeping the rounded upper 64 bits of the product.
+    DiyFp operator * (const DiyFp& rhs) const
+    {
+        unsigned long long a = _f >> 32;
+        unsigned long long b = _f & 0xffffffffULL;
+        unsigned long long c = rhs._f >> 32;
+        unsigned long long d = rhs._f & 0xffffffffULL;
+        unsigned long long ac = a * c;
+        unsigned long long bc = b * c;
+        unsigned long long ad = a * d;
+        unsigned long long bd = b * d;
+        unsigned long long middle = (bd >> 32) + (ad & 0xffffffffULL) + (bc & 0xffffffffULL) + (1ULL << 31);
+        return DiyFp(ac + (ad >> 32) + (bc >> 32) + (middle >> 32), _e + rhs._e + 64);
+    }
+
+    /// Return with the significand shifted so that its highest bit is set.
+    DiyFp Normalize() const
+    {
+        DiyFp ret = *this;
+        while (!(ret._f & (1ULL << 63)))
+        {
+            ret._f <<= 1;
+            --ret._e;
+        }
+        return ret;
+    }
+
+    /// Significand.
+    unsigned long long _f;
+    /// Binary exponent.
+    int _e;
+};
+
+/// Return the number of decimal digits in a number below 10^9.
+static int CountDecimalDigits(unsigned value)
+{
+    int count = 1;
+    while (count < 9 && value >= powersOfTen[count])
+        ++count;
+    return count;
+}
+
+/// Round the last generated digit towards the exact value while it stays within the rounding interval.
+static void GrisuRound(char* digits, int length, unsigned long long delta, unsigned long long rest, unsigned long long tenKappa, unsigned long long distance)
+{
+    while (rest < distance && delta - rest >= tenKappa && (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance))
+    {
+        --digits[length - 1];
+        rest += tenKappa;
+    }
+}
+
+/// Generate the shortest digits within the rounding interval of a number scaled by a cached power of ten. Add the decimal exponent of the last digit to K. Return the number of digits.
+static int GrisuDigits(const DiyFp& w, const DiyFp& upper, unsigned long long delta, char* digits, int& K)
+{
+    DiyFp one(1ULL << -upper._e, upper._e);
+    unsigned long long distance = (upper - w)._f;
+    unsigned integral = (unsigned)(upper._f >> -one._e);
+    unsigned long long fraction = upper._f & (one._f - 1);
+    int kappa = CountDecimalDigits(integral);
+    int length = 0;
+
+    while (kappa > 0)
+    {
+        unsigned divisor = powersOfTen[kappa - 1];
+        unsigned digit = integral / divisor;
+        integral %= divisor;
+        if (digit || length)
+            digits[length++] = (char)('0' + digit);
+        --kappa;
+
+        unsigned long long rest = ((unsigned long long)integral << -one._e) + fraction;
+        if (rest <= delta)
+        {
+            K += kappa;
+            GrisuRound(digits, length, delta, rest, (unsigned long long)powersOfTen[kappa] << -one._e, distance);
+            return length;
+        }
+    }
+
+    for (;;)
+    {
+        fraction *= 10;
+        delta *= 10;
+        char digit = (char)(fraction >> -one._e);
+        if (digit || length)
+            digits[length++] = (char)('0' + digit);
+        fraction &= one._f - 1;
+        --kappa;
+
+        if (fraction < delta)
+        {
+            K += kappa;
+            GrisuRound(digits, length, delta, fraction, one._f, -kappa < 9 ? distance * powersOfTen[-kappa] : 0);
+            return length;
+        }
+    }
+}
+
+/// Write the shortest digits that read back to a positive number, given its significand, binary exponent and the precision of its type in bits, using Grisu2. Return the number of digits, and the decimal exponent of the last digit in K.
+static int Grisu2(unsigned long long significand, int exponent, int precision, char* digits, int& K)
+{
+    // The rounding interval extends halfway to the neighbouring values. The lower neighbour is closer at powers of two
+    DiyFp value(significand, exponent);
+    DiyFp upper = DiyFp((significand << 1) + 1, exponent - 1).Normalize();
+    DiyFp lower = significand == (1ULL << (precision - 1)) ? DiyFp((significand << 2) - 1, exponent - 2) :
+        DiyFp((significand << 1) - 1, exponent - 1);
+    lower._f <<= lower._e - upper._e;
+    lower._e = upper._e;
+
+    // Scale by a cached power of ten so that the binary exponent falls within [-60, -32]
+    double dk = (-61 - upper._e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if (dk - k > 0.0)
+        ++k;
+    unsigned index = (unsigned)((k >> 3) + 1);
+    K = 348 - (int)(index << 3);
+    DiyFp cachedPower(cachedPowerSignificands[index], cachedPowerExponents[index]);
+
+    DiyFp w = value.Normalize() * cachedPower;
+    DiyFp scaledUpper = upper * cachedPower;
+    DiyFp scaledLower = lower * cachedPower;
+    ++scaledLower._f;
+    --scaledUpper._f;
+    return GrisuDigits(w, scaledUpper, scaledUpper._f - scaledLower._f, digits, K);
+}
+
+/// Format digits with the decimal exponent K of the last digit as a JSON number, in plain notation for moderate exponents and scientific notation otherwise. Return the number of characters written, excluding the null terminator.
+static size_t FormatDigits(char* dest, bool negative, const char* digits, int length, int K)
+{
+    char* pos = dest;
+    if (negative)
+        *pos++ = '-';
+
+    // Position of the decimal point relative to the first digit
+    int point = length + K;
+
+    if (K >= 0 && point <= 21)
+    {
+        // 1234e7 -> 12340000000
+        memcpy(pos, digits, length);
+        pos += length;
+        for (int i = 0; i < K; ++i)
+            *pos++ = '0';
+    }
+    else if (point > 0 && point <= 21)
+    {
+        // 1234e-2 -> 12.34
+        memcpy(pos, digits, point);
+        pos += point;
+        *pos++ = '.';
+        memcpy(pos, digits + point, length - point);
+        pos += length - point;
+    }
+    else if (point > -6 && point <= 0)
+    {
+        // 1234e-6 -> 0.001234
+        *pos++ = '0';
+        *pos++ = '.';
+        for (int i = point; i < 0; ++i)
+            *pos++ = '0';
+        memcpy(pos, digits, length);
+        pos += length;
+    }
+    else
+    {
+        // 1234e30 -> 1.234e33
+        *pos++ = digits[0];
+        if (length > 1)
+        {
+            *pos++ = '.';
+            memcpy(pos, digits + 1, length - 1);
+            pos += length - 1;
+        }
+        *pos++ = 'e';
+        int exponent = point - 1;
+        if (exponent < 0)
+        {
+            *pos++ = '-';
+            exponent = -exponent;
+        }
+        if (exponent >= 100)
+            *pos++ = (char)('0' + exponent / 100);
+        if (exponent >= 10)
+            *pos++ = (char)('0' + exponent / 10 % 10);
+        *pos++ = (char)('0' + exponent % 10);
+    }
+
+    *pos = 0;
+    return pos - dest;
+}
+
+JSONWriter::JSONWriter(Stream& dest, int spacing) :
+    _dest(dest),
+    _spacing(spacing),
+    _depth(0),
+    _first(true),
+    _afterKey(false),
+    _failed(false),
+    _used(0)
+{
+}
+
+JSONWriter::~JSONWriter()
+{
+    Flush();
+}
+
+void JSONWriter::StartObject()
+{
+    BeginValue();
+    Put('{');
+    ++_depth;
+    _first = true;
+}
+
+void JSONWriter::EndObject()
+{
+    EndContainer();
+    Put('}');
+}
+
+void JSONWriter::StartArray()
+{
+    BeginValue();
+    Put('[');
+    ++_depth;
+    _first = true;
+}
+
+void JSONWriter::EndArray()
+{
+    EndContainer();
+    Put(']');
+}
+
+void JSONWriter::WriteKey(const char* str, size_t length)
+{
+    BeginValue();
+    PutString(str, length);
+    if (_spacing)
+        Put(": ", 2);
+    else
+        Put(':');
+    _afterKey = true;
+}
+
+void JSONWriter::WriteKey(const char* str)
+{
+    WriteKey(str, strlen(str));
+}
+
+void JSONWriter::WriteNull()
+{
+    BeginValue();
+    Put("null", 4);
+}
+
+void JSONWriter::WriteBool(bool value)
+{
+    BeginValue();
+    if (value)
+        Put("true", 4);
+    else
+        Put("false", 5);
+}
+
+void JSONWriter::WriteNumber(double value)
+{
+    if (!std::isfinite(value))
+    {
+        WriteNull();
+        return;
+    }
+
+    BeginValue();
+    char buffer[JSON_NUMBER_BUFFER_SIZE];
+    Put(buffer, FormatNumber(buffer, value));
+}
+
+void JSONWriter::WriteNumber(float value)
+{
+    if (!std::isfinite(value))
+    {
+        WriteNull();
+        return;
+    }
+
+    BeginValue();
+    char buffer[JSON_NUMBER_BUFFER_SIZE];
+    Put(buffer, FormatNumber(buffer, value));
+}
+
+void JSONWriter::WriteNumber(int value)
+{
+    BeginValue();
+    char buffer[JSON_NUMBER_BUFFER_SIZE];
+    Put(buffer, FormatNumber(buffer, (long long)value));
+}
+
+void JSONWriter::WriteNumber(unsigned value)
+{
+    BeginValue();
+    char buffer[JSON_NUMBER_BUFFER_SIZE];
+    Put(buffer, FormatNumber(buffer, (long long)value));
+}
+
+void JSONWriter::WriteString(const char* str, size_t length)
+{
+    BeginValue();
+    PutString(str, length);
+}
+
+void JSONWriter::WriteString(const char* str)
+{
+    WriteString(str, strlen(str));
+}
+
+void JSONWriter::WriteNumberString(const float* values, size_t count)
+{
+    BeginValue();
+    Put('\"');
+    char buffer[JSON_NUMBER_BUFFER_SIZE];
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i)
+            Put(' ');
+        Put(buffer, FormatNumber(buffer, values[i]));
+    }
+    Put('\"');
+}
+
+void JSONWriter::WriteNumberString(const int* values, size_t count)
+{
+    BeginValue();
+    Put('\"');
+    char buffer[JSON_NUMBER_BUFFER_SIZE];
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i)
+            Put(' ');
+        Put(buffer, FormatNumber(buffer, (long long)values[i]));
+    }
+    Put('\"');
+}
+
+void JSONWriter::WriteValue(const JSONValue& value)
+{
+    switch (value.Type())
+    {
+    case JSONType::BOOL:
+        WriteBool(value.GetBool());
+        break;
+
+    case JSONType::NUMBER:
+        WriteNumber(value.GetNumber());
+        break;
+
+    case JSONType::VECTOR2:
+    case JSONType::VECTOR3:
+    case JSONType::VECTOR4:
+        {
+            // Use the vector extension of the JSON dialect so that the value reads back with the same type
+            size_t numComponents = value.Type() - JSONType::VECTOR2 + 2;
+            const float* components = value.IsVector2() ? value.GetVector2().Data() : value.IsVector3() ? value.GetVector3().Data() :
+                value.GetVector4().Data();
+
+            BeginValue();
+            char buffer[JSON_NUMBER_BUFFER_SIZE];
+            Put("vec", 3);
+            Put((char)('0' + numComponents));
+            Put('(');
+            for (size_t i = 0; i < numComponents; ++i)
+            {
+                if (i)
+                    Put(", ", 2);
+                Put(buffer, FormatNumber(buffer, components[i]));
+            }
+            Put(')');
+        }
+        break;
+
+    case JSONType::STRING:
+        WriteString(value.GetString());
+        break;
+
+    case JSONType::ARRAY:
+        {
+            const JSONArray& array = value.GetArray();
+            StartArray();
+            for (auto it = array.Begin(); it != array.End(); ++it)
+                WriteValue(*it);
+            EndArray();
+        }
+        break;
+
+    case JSONType::OBJECT:
+        {
+            const JSONObject& object = value.GetObject();
+            StartObject();
+            for (auto it = object.Begin(); it != object.End(); ++it)
+            {
+                WriteKey(it->_first);
+                WriteValue(it->_second);
+            }
+            EndObject();
+        }
+        break;
+
+    default:
+        WriteNull();
+        break;
+    }
+}
+
+bool JSONWriter::Flush()
+{
+    FlushBuffer();
+    return !_failed;
+}
+
+size_t JSONWriter::FormatNumber(char* dest, double value)
+{
+    if (!std::isfinite(value))
+        value = 0.0;
+
+    // Integral values are common and exact, so write their digits directly
+    if (std::fabs(value) < MAX_EXACT_INTEGER && value == (double)(long long)value)
+        return FormatNumber(dest, (long long)value);
+
+    // Otherwise write the shortest digits that read back to the same value. Denormals have no hidden bit
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof bits);
+    int biasedExponent = (int)((bits >> 52) & 0x7ff);
+    unsigned long long significand = bits & 0xfffffffffffffULL;
+    if (biasedExponent)
+        significand |= 1ULL << 52;
+    int exponent = biasedExponent ? biasedExponent - 1075 : -1074;
+
+    char digits[JSON_NUMBER_BUFFER_SIZE];
+    int K;
+    int length = Grisu2(significand, exponent, 53, digits, K);
+    return FormatDigits(dest, value < 0.0, digits, length, K);
+}
+
+size_t JSONWriter::FormatNumber(char* dest, float value)
+{
+    if (!std::isfinite(value))
+        value = 0.0f;
+
+    if (std::fabs(value) < 16777216.0f && value == (float)(int)value)
+        return FormatNumber(dest, (long long)value);
+
+    // Use the rounding interval of the float, so that the digits are the shortest that read back to the same float
+    unsigned bits;
+    memcpy(&bits, &value, sizeof bits);
+    int biasedExponent = (int)((bits >> 23) & 0xff);
+    unsigned long long significand = bits & 0x7fffff;
+    if (biasedExponent)
+        significand |= 1ULL << 23;
+    int exponent = biasedExponent ? biasedExponent - 150 : -149;
+
+    char digits[JSON_NUMBER_BUFFER_SIZE];
+    int K;
+    int length = Grisu2(significand, exponent, 24, digits, K);
+    return FormatDigits(dest, value < 0.0f, digits, length, K);
+}
+
+size_t JSONWriter::FormatNumber(char* dest, long long value)
+{
+    // Write the digits backwards to a temporary buffer, then copy in order
+    char digits[JSON_NUMBER_BUFFER_SIZE];
+    char* pos = digits + JSON_NUMBER_BUFFER_SIZE;
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    do
+    {
+        *--pos = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0)
+        *--pos = '-';
+
+    size_t length = digits + JSON_NUMBER_BUFFER_SIZE - pos;
+    memcpy(dest, pos, length);
+    dest[length] = 0;
+    return length;
+}
+
+void JSONWriter::BeginValue()
+{
+    if (_afterKey)
+    {
+        _afterKey = false;
+        return;
+    }
+
+    if (_depth)
+    {
+        if (!_first)
+            Put(',');
+        if (_spacing)
+        {
+            Put('\n');
+            PutIndent();
+        }
+    }
+
+    _first = false;
+}
+
+void JSONWriter::EndContainer()
+{
+    assert(_depth > 0 && !_afterKey);
+
+    --_depth;
+    // Empty arrays and objects are closed on the same line
+    if (!_first && _spacing)
+    {
+        Put('\n');
+        PutIndent();
+    }
+    // The parent now has at least this value
+    _first = false;
+}
+
+void JSONWriter::PutString(const char* str, size_t length)
+{
+    Put('\"');
+
+    const char* end = str + length;
+    while (str < end)
+    {
+        // Copy runs of characters that need no escaping at once. Bytes of multibyte UTF-8 sequences are copied as is
+        const char* run = str;
+        while (str < end && (unsigned char)*str >= 0x20 && *str != '\"' && *str != '\\')
+            ++str;
+        if (str > run)
+            Put(run, str - run);
+        if (str == end)
+            break;
+
+        char c = *str++;
+        Put('\\');
+        switch (c)
+        {
+        case '\"':
+        case '\\':
+            Put(c);
+            break;
+
+        case '\b':
+            Put('b');
+            break;
+
+        case '\f':
+            Put('f');
+            break;
+
+        case '\n':
+            Put('n');
+            break;
+
+        case '\r':
+            Put('r');
+            break;
+
+        case '\t':
+            Put('t');
+            break;
+
+        default:
+            {
+                char escape[5] = { 'u', '0', '0', hexDigits[(unsigned char)c >> 4], hexDigits[c & 0xf] };
+                Put(escape, 5);
+            }
+            break;
+        }
+    }
+
+    Put('\"');
+}
+
+void JSONWriter::PutIndent()
+{
+    size_t indent = (size_t)(_depth * _spacing);
+    while (indent)
+    {
+        size_t count = Min(indent, sizeof indentSpaces - 1);
+        Put(indentSpaces, count);
+        indent -= count;
+    }
+}
+
+void JSONWriter::Put(const char* data, size_t length)
+{
+    if (_used + length > JSON_WRITE_BUFFER_SIZE)
+    {
+        FlushBuffer();
+        // Write data larger than the buffer directly
+        if (length > JSON_WRITE_BUFFER_SIZE)
+        {
+            if (_dest.Write(data, length) != length)
+                _failed = true;
+            return;
+        }
+    }
+
+    memcpy(_buffer + _used, data, length);
+    _used += length;
+}
+
+void JSONWriter::FlushBuffer()
+{
+    if (_used && _dest.Write(_buffer, _used) != _used)
+        _failed = true;
+    _used = 0;
+}
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "../Base/String.h"
+
+namespace Auto3D
+{
+
+class JSONValue;
+class Stream;
+
+/// Size of the JSON writer's output buffer in bytes.
+static const size_t JSON_WRITE_BUFFER_SIZE = 16 * 1024;
+/// Minimum buffer size for formatting a number.
+static const size_t JSON_NUMBER_BUFFER_SIZE = 32;
+
+/// Streaming JSON writer. Writes values to a stream through a fixed-size buffer as they are given, without building a tree first. The caller is responsible for well-formed nesting: inside objects each value must be preceded by a key.
+class AUTO_API JSONWriter
+{
+public:
+    /// Construct with the destination stream and the number of spaces per indentation level. Zero spacing writes compact JSON without line breaks.
+    JSONWriter(Stream& dest, int spacing = 2);
+    /// Destruct. Flush any buffered output.
+    ~JSONWriter();
+
+    /// Prevent copy construction.
+    JSONWriter(const JSONWriter& rhs) = delete;
+    /// Prevent assignment.
+    JSONWriter& operator = (const JSONWriter& rhs) = delete;
+
+    /// Start an object.
+    void StartObject();
+    /// End the current object.
+    void EndObject();
+    /// Start an array.
+    void StartArray();
+    /// End the current array.
+    void EndArray();
+    /// Write the key of an object member. The member's value must follow.
+    void WriteKey(const char* str, size_t length);
+    /// Write the key of an object member. The member's value must follow.
+    void WriteKey(const char* str);
+    /// Write the key of an object member. The member's value must follow.
+    void WriteKey(const String& str) { WriteKey(str.CString(), str.Length()); }
+    /// Write a null value.
+    void WriteNull();
+    /// Write a boolean value.
+    void WriteBool(bool value);
+    /// Write a double-precision number using the shortest form that reads back to the same value. Non-finite numbers are written as null.
+    void WriteNumber(double value);
+    /// Write a single-precision number using the shortest form that reads back to the same float. Non-finite numbers are written as null.
+    void WriteNumber(float value);
+    /// Write an integer number.
+    void WriteNumber(int value);
+    /// Write an unsigned integer number.
+    void WriteNumber(unsigned value);
+    /// Write a string value.
+    void WriteString(const char* str, size_t length);
+    /// Write a string value.
+    void WriteString(const char* str);
+    /// Write a string value.
+    void WriteString(const String& str) { WriteString(str.CString(), str.Length()); }
+    /// Write numbers as a space-separated string value, the format the math classes read with FromString().
+    void WriteNumberString(const float* values, size_t count);
+    /// Write numbers as a space-separated string value, the format the math classes read with FromString().
+    void WriteNumberString(const int* values, size_t count);
+    /// Write a JSON value including any nested values.
+    void WriteValue(const JSONValue& value);
+    /// Write buffered output to the stream. Return true if all output so far was written successfully.
+    bool Flush();
+
+    /// Format a double-precision number to a buffer of at least JSON_NUMBER_BUFFER_SIZE bytes with the Grisu2 algorithm, which writes digits that read back to the same value and are nearly always the shortest. Non-finite numbers are formatted as zero. Return the number of characters written, excluding the null terminator.
+    static size_t FormatNumber(char* dest, double value);
+    /// Format a single-precision number to a buffer of at least JSON_NUMBER_BUFFER_SIZE bytes with the Grisu2 algorithm, which writes digits that read back to the same float and are nearly always the shortest. Non-finite numbers are formatted as zero. Return the number of characters written, excluding the null terminator.
+    static size_t FormatNumber(char* dest, float value);
+    /// Format an integer to a buffer of at least JSON_NUMBER_BUFFER_SIZE bytes. Return the number of characters written, excluding the null terminator.
+    static size_t FormatNumber(char* dest, long long value);
+
+private:
+    /// Write the separator, line break and indentation needed before a value or key.
+    void BeginValue();
+    /// Write the line break and indentation before closing an array or object.
+    void EndContainer();
+    /// Write a string with quotes and escape sequences.
+    void PutString(const char* str, size_t length);
+    /// Write the indentation of the current depth.
+    void PutIndent();
+    /// Write characters to the buffer.
+    void Put(const char* data, size_t length);
+    /// Write a character to the buffer.
+    void Put(char c)
+    {
+        if (_used == JSON_WRITE_BUFFER_SIZE)
+            FlushBuffer();
+        _buffer[_used++] = c;
+    }
+    /// Write the buffer to the stream and empty it.
+    void FlushBuffer();
+
+    /// Destination stream.
+    Stream& _dest;
+    /// Spaces per indentation level, or 0 for compact output.
+    int _spacing;
+    /// Current nesting depth.
+    int _depth;
+    /// Whether no values have been written in the current array or object.
+    bool _first;
+    /// Whether a key was written and its value is next.
+    bool _afterKey;
+    /// Whether writing to the stream has failed.
+    bool _failed;
+    /// Bytes used in the buffer.
+    size_t _used;
+    /// Output buffer.
+    char _buffer[JSON_WRITE_BUFFER_SIZE];
+};
+
+}
@@ -0,0 +1,167 @@
+#include "FileSystem.h"
+#include "MappedFile.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+MappedFile::MappedFile() :
+    _data(nullptr),
+    _mappingHandle(nullptr)
+{
+}
+
+MappedFile::MappedFile(const String& fileName) :
+    _data(nullptr),
+    _mappingHandle(nullptr)
+{
+    Open(fileName);
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const String& fileName)
+{
+    Close();
+
+    if (fileName.IsEmpty())
+        return false;
+
+    size_t fileSize = 0;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(WideNativePath(fileName).CString(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || !size.QuadPart)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    // The mapping keeps the file open, so the file handle can be closed right away
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    _mappingHandle = mapping;
+    fileSize = (size_t)size.QuadPart;
+#else
+    int file = open(NativePath(fileName).CString(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(file, &st) || !st.st_size)
+    {
+        close(file);
+        return false;
+    }
+
+    // The mapping stays valid after closing the descriptor
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+        return false;
+
+    fileSize = (size_t)st.st_size;
+#endif
+
+    _data = (const unsigned char*)data;
+    _name = fileName;
+    _size = fileSize;
+    _position = 0;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (!_data)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(_data);
+    CloseHandle((HANDLE)_mappingHandle);
+#else
+    munmap((void*)_data, _size);
+#endif
+
+    _data = nullptr;
+    _mappingHandle = nullptr;
+    _position = 0;
+    _size = 0;
+}
+
+size_t MappedFile::Read(void* dest, size_t numBytes)
+{
+    if (numBytes + _position > _size)
+        numBytes = _size - _position;
+    if (!numBytes)
+        return 0;
+
+    memcpy(dest, _data + _position, numBytes);
+    _position += numBytes;
+    return numBytes;
+}
+
+size_t MappedFile::Seek(size_t newPosition)
+{
+    if (newPosition > _size)
+        newPosition = _size;
+
+    _position = newPosition;
+    return _position;
+}
+
+size_t MappedFile::Write(const void*, size_t)
+{
+    return 0;
+}
+
+const void* MappedFile::ReadView(size_t numBytes)
+{
+    if (!_data || numBytes > _size - _position)
+        return nullptr;
+
+    const void* ret = _data + _position;
+    _position += numBytes;
+    return ret;
+}
+
+bool MappedFile::IsReadable() const
+{
+    return _data != nullptr;
+}
+
+bool MappedFile::IsWritable() const
+{
+    return false;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Stream.h"
+
+namespace Auto3D
+{
+
+/// Read-only file mapped into memory. Reads return views into the mapping without copying. If the file is truncated by another process while mapped, accessing the removed part faults, and on Windows the file can not be overwritten while mapped, so keep mappings of files that may be edited short-lived.
+class AUTO_API MappedFile : public Stream
+{
+public:
+    /// Construct.
+    MappedFile();
+    /// Construct and open a file.
+    MappedFile(const String& fileName);
+    /// Destruct. Unmap the file. Views into the file become invalid.
+    ~MappedFile();
+
+    /// Read bytes from the file. Return number of bytes actually read.
+    size_t Read(void* dest, size_t numBytes) override;
+    /// Set position in bytes from the beginning of the file.
+    size_t Seek(size_t newPosition) override;
+    /// Write bytes to the file. Not supported, always returns zero.
+    size_t Write(const void* data, size_t numBytes) override;
+    /// Return a pointer to the next bytes in the mapping and advance the position, or null if not enough data. Valid until the file is closed.
+    const void* ReadView(size_t numBytes) override;
+    /// Return whether read operations are allowed.
+    bool IsReadable() const override;
+    /// Return whether write operations are allowed.
+    bool IsWritable() const override;
+
+    /// Open and map a file. Empty files can not be mapped. Return true on success.
+    bool Open(const String& fileName);
+    /// Unmap and close the file.
+    void Close();
+
+    /// Return whether is open.
+    bool IsOpen() const { return _data != nullptr; }
+    /// Return the mapped file data.
+    const void* Data() const { return _data; }
+
+    using Stream::Read;
+    using Stream::Write;
+
+private:
+    /// Mapped file data.
+    const unsigned char* _data;
+    /// Operating system file mapping handle.
+    void* _mappingHandle;
+};
+
+}
@@ -109,6 +109,16 @@ size_t MemoryBuffer::Write(const void* _data, size_t numBytes)
     return numBytes;
 }
 
+const void* MemoryBuffer::ReadView(size_t numBytes)
+{
+    if (!_buffer || numBytes > _size - _position)
+        return nullptr;
+
+    const void* ret = _buffer + _position;
+    _position += numBytes;
+    return ret;
+}
+
 bool MemoryBuffer::IsReadable() const
 {
     return _buffer != nullptr;
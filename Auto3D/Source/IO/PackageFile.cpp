@@ -0,0 +1,207 @@
+#include "../Debug/Log.h"
+#include "../Debug/Profiler.h"
+#include "MemoryBuffer.h"
+#include "PackageFile.h"
+#include "VectorBuffer.h"
+
+#include <atomic>
+#include <lz4.h>
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+/// Memory-mapped package file, shared by the package and its uncompressed entry streams. Streams are opened and destroyed in the background loader thread while the package may be removed in the main thread, so the reference count is atomic instead of using RefCounted.
+struct PackageMapping
+{
+    /// Construct with one reference.
+    PackageMapping() :
+        _refs(1)
+    {
+    }
+
+    /// Add a reference.
+    void AddRef()
+    {
+        ++_refs;
+    }
+
+    /// Remove a reference and unmap the file when no references remain.
+    void ReleaseRef()
+    {
+        if (--_refs == 0)
+            delete this;
+    }
+
+    /// Mapped file.
+    MappedFile _file;
+    /// Number of references.
+    std::atomic<unsigned> _refs;
+};
+
+/// Stream reading an uncompressed package entry in place. Keeps the package file mapped while the stream exists.
+class PackageEntryBuffer : public MemoryBuffer
+{
+public:
+    /// Construct with the mapping and the entry's data.
+    PackageEntryBuffer(PackageMapping* mapping, const void* data, size_t numBytes) :
+        MemoryBuffer(data, numBytes),
+        _mapping(mapping)
+    {
+        _mapping->AddRef();
+    }
+
+    /// Destruct. Release the mapping.
+    ~PackageEntryBuffer()
+    {
+        _mapping->ReleaseRef();
+    }
+
+private:
+    /// Package file mapping.
+    PackageMapping* _mapping;
+};
+
+PackageFile::PackageFile() :
+    _mapping(nullptr)
+{
+}
+
+PackageFile::PackageFile(const String& fileName) :
+    _mapping(nullptr)
+{
+    Open(fileName);
+}
+
+PackageFile::~PackageFile()
+{
+    Close();
+}
+
+bool PackageFile::Open(const String& fileName)
+{
+    PROFILE(OpenPackageFile);
+
+    Close();
+
+    _mapping = new PackageMapping();
+    if (!_mapping->_file.Open(fileName))
+    {
+        ErrorString("Could not open package file " + fileName);
+        Close();
+        return false;
+    }
+
+    // Access the mapping only through its data pointer, as the file's read position would not be thread-safe
+    size_t fileSize = _mapping->_file.Size();
+    MemoryBuffer source(_mapping->_file.Data(), fileSize);
+    if (source.ReadFileID() != PACKAGE_FILE_ID)
+    {
+        ErrorString(fileName + " is not a valid package file");
+        Close();
+        return false;
+    }
+
+    unsigned version = source.Read<unsigned>();
+    if (version != PACKAGE_FILE_VERSION)
+    {
+        ErrorStringF("Unsupported package file version %d in %s", version, fileName.CString());
+        Close();
+        return false;
+    }
+
+    unsigned numEntries = source.Read<unsigned>();
+    unsigned long long directoryOffset = source.Read<unsigned long long>();
+    if (directoryOffset > fileSize)
+    {
+        ErrorString("Corrupt directory in package file " + fileName);
+        Close();
+        return false;
+    }
+
+    source.Seek((size_t)directoryOffset);
+    for (unsigned i = 0; i < numEntries; ++i)
+    {
+        PackageEntry entry;
+        entry._name = source.Read<String>();
+        entry._offset = source.Read<unsigned long long>();
+        entry._size = source.Read<unsigned>();
+        entry._packedSize = source.Read<unsigned>();
+
+        size_t storedSize = entry._packedSize ? entry._packedSize : entry._size;
+        if (entry._name.IsEmpty() || storedSize > fileSize || entry._offset > fileSize - storedSize)
+        {
+            ErrorString("Corrupt directory in package file " + fileName);
+            Close();
+            return false;
+        }
+
+        // Lookups compare the name, so an entry whose name hash collides with another entry could never be found
+        StringHash nameHash(entry._name);
+        auto it = _entries.Find(nameHash);
+        if (it != _entries.End() && it->_second._name != entry._name)
+        {
+            ErrorString("Name hash of " + entry._name + " collides with " + it->_second._name + " in package file " + fileName);
+            Close();
+            return false;
+        }
+
+        _entries[nameHash] = entry;
+    }
+
+    _name = fileName;
+    LogStringF("Opened package file %s with %d entries", fileName.CString(), (int)_entries.Size());
+    return true;
+}
+
+void PackageFile::Close()
+{
+    if (_mapping)
+    {
+        _mapping->ReleaseRef();
+        _mapping = nullptr;
+    }
+
+    _entries.Clear();
+    _name.Clear();
+}
+
+AutoPtr<Stream> PackageFile::OpenEntry(const String& name) const
+{
+    AutoPtr<Stream> ret;
+
+    const PackageEntry* entry = FindEntry(name);
+    if (!entry)
+        return ret;
+
+    const unsigned char* src = (const unsigned char*)_mapping->_file.Data() + entry->_offset;
+
+    if (!entry->_packedSize)
+        ret = new PackageEntryBuffer(_mapping, src, entry->_size);
+    else
+    {
+        VectorBuffer* buffer = new VectorBuffer();
+        ret = buffer;
+        buffer->Resize(entry->_size);
+        int decompressed = LZ4_decompress_safe((const char*)src, (char*)buffer->ModifiableData(), (int)entry->_packedSize,
+            (int)entry->_size);
+        if (decompressed != (int)entry->_size)
+        {
+            ErrorString("Failed to decompress " + name + " from package file " + _name);
+            ret.Reset();
+            return ret;
+        }
+    }
+
+    ret->SetName(entry->_name);
+    return ret;
+}
+
+const PackageEntry* PackageFile::FindEntry(const String& name) const
+{
+    auto it = _entries.Find(StringHash(name));
+    return (it != _entries.End() && it->_second._name == name) ? &it->_second : nullptr;
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../Base/AutoPtr.h"
+#include "../Base/HashMap.h"
+#include "../Base/StringHash.h"
+#include "MappedFile.h"
+
+namespace Auto3D
+{
+
+struct PackageMapping;
+
+/// Package file identifier.
+static const char* PACKAGE_FILE_ID = "APAK";
+/// Package file format version.
+static const unsigned PACKAGE_FILE_VERSION = 1;
+/// Alignment of entry data within the package file.
+static const size_t PACKAGE_ENTRY_ALIGNMENT = 16;
+
+/// %File entry within a package file.
+struct AUTO_API PackageEntry
+{
+    /// Resource name.
+    String _name;
+    /// Offset of the data from the beginning of the package file.
+    unsigned long long _offset;
+    /// Uncompressed size.
+    unsigned _size;
+    /// LZ4 compressed size, or zero if stored uncompressed.
+    unsigned _packedSize;
+};
+
+/// Read-only archive of resource files, memory-mapped for reading. The layout is a header (file ID, version, number of entries and directory offset), the entry data aligned to PACKAGE_ENTRY_ALIGNMENT, and a directory of entries at the end.
+class AUTO_API PackageFile : public RefCounted
+{
+public:
+    /// Construct.
+    PackageFile();
+    /// Construct and open.
+    PackageFile(const String& fileName);
+    /// Destruct. Close the package if open.
+    ~PackageFile();
+
+    /// Open and map a package file. Return true on success.
+    bool Open(const String& fileName);
+    /// Close the package. Streams already opened from it stay readable.
+    void Close();
+    /// Open an entry for reading. Uncompressed entries are read directly from the mapped file, which the stream keeps mapped until it is destroyed; compressed entries are decompressed to memory. Return null if not found or failed. Can be called from the background loader thread while no other thread modifies the package.
+    AutoPtr<Stream> OpenEntry(const String& name) const;
+
+    /// Return the entry for a resource name, or null if not found. The name is compared in addition to its hash.
+    const PackageEntry* FindEntry(const String& name) const;
+    /// Return whether the package contains a resource.
+    bool Exists(const String& name) const { return FindEntry(name) != nullptr; }
+    /// Return the package file name.
+    const String& Name() const { return _name; }
+    /// Return the entries.
+    const HashMap<StringHash, PackageEntry>& Entries() const { return _entries; }
+    /// Return number of entries.
+    size_t NumEntries() const { return _entries.Size(); }
+    /// Return whether is open.
+    bool IsOpen() const { return _mapping != nullptr; }
+
+private:
+    /// Package file name.
+    String _name;
+    /// Entries by resource name hash.
+    HashMap<StringHash, PackageEntry> _entries;
+    /// Mapped package file, shared with the uncompressed entry streams.
+    PackageMapping* _mapping;
+};
+
+}
@@ -25,6 +25,11 @@ Stream::~Stream()
 {
 }
 
+const void* Stream::ReadView(size_t)
+{
+    return nullptr;
+}
+
 void Stream::SetName(const String& newName)
 {
     _name = newName;
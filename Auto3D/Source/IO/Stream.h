@@ -30,6 +30,8 @@ public:
     virtual size_t Seek(size_t position) = 0;
     /// Write bytes to the stream. Return number of bytes actually written.
     virtual size_t Write(const void* _data, size_t _size) = 0;
+    /// Return a pointer to the next bytes without copying them and advance the position, or null if the stream does not support views or has not enough data. The view stays valid as long as the stream.
+    virtual const void* ReadView(size_t numBytes);
     /// Return whether read operations are allowed.
     virtual bool IsReadable() const = 0;
     /// Return whether write operations are allowed.
@@ -106,6 +106,16 @@ size_t VectorBuffer::Write(const void* _data, size_t numBytes)
     return numBytes;
 }
 
+const void* VectorBuffer::ReadView(size_t numBytes)
+{
+    if (numBytes > _size - _position)
+        return nullptr;
+
+    const void* ret = _buffer.Begin()._ptr + _position;
+    _position += numBytes;
+    return ret;
+}
+
 bool VectorBuffer::IsReadable() const
 {
     return true;
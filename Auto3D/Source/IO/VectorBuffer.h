@@ -25,6 +25,8 @@ public:
     size_t Seek(size_t newPosition) override;
     /// Write bytes to the buffer. Return number of bytes actually written.
     size_t Write(const void* _data, size_t _size) override;
+    /// Return a pointer to the next bytes in the buffer and advance the position, or null if not enough data. Valid until the buffer is resized.
+    const void* ReadView(size_t numBytes) override;
     /// Return whether read operations are allowed.
     bool IsReadable() const override;
     /// Return whether write operations are allowed.
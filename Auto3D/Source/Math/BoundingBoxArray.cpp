@@ -0,0 +1,235 @@
+#include "BoundingBoxArray.h"
+
+#include <cassert>
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+BoundingBoxArray::BoundingBoxArray() :
+    _size(0)
+{
+}
+
+void BoundingBoxArray::Push(const BoundingBoxF& box)
+{
+    size_t index = _size++;
+    size_t paddedSize = (_size + SIMD_FLOAT_PADDING - 1) & ~(SIMD_FLOAT_PADDING - 1);
+    if (_centers[0].Size() < paddedSize)
+    {
+        for (size_t i = 0; i < 3; ++i)
+        {
+            _centers[i].Resize(paddedSize);
+            _halfSizes[i].Resize(paddedSize);
+        }
+    }
+
+    Set(index, box);
+}
+
+void BoundingBoxArray::Set(size_t index, const BoundingBoxF& box)
+{
+    assert(index < _size);
+
+    // Calculate the same way as Frustum::IsInsideFast() so that the results are identical
+    Vector3F center = box.Center();
+    Vector3F halfSize = center - box._min;
+    _centers[0][index] = center._x;
+    _centers[1][index] = center._y;
+    _centers[2][index] = center._z;
+    _halfSizes[0][index] = halfSize._x;
+    _halfSizes[1][index] = halfSize._y;
+    _halfSizes[2][index] = halfSize._z;
+}
+
+void BoundingBoxArray::EraseSwap(size_t index)
+{
+    assert(index < _size);
+
+    size_t last = --_size;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        _centers[i][index] = _centers[i][last];
+        _halfSizes[i][index] = _halfSizes[i][last];
+        _centers[i][last] = 0.0f;
+        _halfSizes[i][last] = 0.0f;
+    }
+}
+
+void BoundingBoxArray::Clear()
+{
+    for (size_t i = 0; i < 3; ++i)
+    {
+        _centers[i].Clear();
+        _halfSizes[i].Clear();
+    }
+    _size = 0;
+}
+
+BoundingBoxF BoundingBoxArray::Get(size_t index) const
+{
+    assert(index < _size);
+
+    Vector3F center(_centers[0][index], _centers[1][index], _centers[2][index]);
+    Vector3F halfSize(_halfSizes[0][index], _halfSizes[1][index], _halfSizes[2][index]);
+    return BoundingBoxF(center - halfSize, center + halfSize);
+}
+
+FrustumPlaneArray::FrustumPlaneArray()
+{
+    for (size_t i = 0; i < NUM_FRUSTUM_PLANES; ++i)
+    {
+        _normalX[i] = _normalY[i] = _normalZ[i] = 0.0f;
+        _absNormalX[i] = _absNormalY[i] = _absNormalZ[i] = 0.0f;
+        _d[i] = 0.0f;
+    }
+}
+
+FrustumPlaneArray::FrustumPlaneArray(const Frustum& frustum)
+{
+    Define(frustum);
+}
+
+void FrustumPlaneArray::Define(const Frustum& frustum)
+{
+    for (size_t i = 0; i < NUM_FRUSTUM_PLANES; ++i)
+    {
+        const Plane& plane = frustum._planes[i];
+        _normalX[i] = plane._normal._x;
+        _normalY[i] = plane._normal._y;
+        _normalZ[i] = plane._normal._z;
+        _absNormalX[i] = plane._absNormal._x;
+        _absNormalY[i] = plane._absNormal._y;
+        _absNormalZ[i] = plane._absNormal._z;
+        _d[i] = plane._d;
+    }
+}
+
+size_t FrustumPlaneArray::CullBoxes(const BoundingBoxArray& boxes, size_t start, size_t count, unsigned* dest) const
+{
+    assert((start & (SIMD_FLOAT_PADDING - 1)) == 0);
+    assert(start + count <= boxes.Size());
+
+    const float* centerX = boxes.Centers(0) + start;
+    const float* centerY = boxes.Centers(1) + start;
+    const float* centerZ = boxes.Centers(2) + start;
+    const float* halfSizeX = boxes.HalfSizes(0) + start;
+    const float* halfSizeY = boxes.HalfSizes(1) + start;
+    const float* halfSizeZ = boxes.HalfSizes(2) + start;
+    size_t numVisible = 0;
+
+    // The component arrays are padded, so whole groups can always be loaded. The padding results are masked out
+    // A box is outside if it is on the negative side of any plane: dot(normal, center) + d < -dot(absNormal, halfSize)
+#if defined(AUTO_AVX)
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(centerX + i);
+        __m256 cy = _mm256_loadu_ps(centerY + i);
+        __m256 cz = _mm256_loadu_ps(centerZ + i);
+        __m256 hx = _mm256_loadu_ps(halfSizeX + i);
+        __m256 hy = _mm256_loadu_ps(halfSizeY + i);
+        __m256 hz = _mm256_loadu_ps(halfSizeZ + i);
+        __m256 outside = _mm256_setzero_ps();
+
+        for (size_t j = 0; j < NUM_FRUSTUM_PLANES; ++j)
+        {
+            __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(_normalX[j])),
+                _mm256_mul_ps(cy, _mm256_set1_ps(_normalY[j]))), _mm256_mul_ps(cz, _mm256_set1_ps(_normalZ[j])));
+            dist = _mm256_add_ps(dist, _mm256_set1_ps(_d[j]));
+            __m256 absDist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(hx, _mm256_set1_ps(_absNormalX[j])),
+                _mm256_mul_ps(hy, _mm256_set1_ps(_absNormalY[j]))), _mm256_mul_ps(hz, _mm256_set1_ps(_absNormalZ[j])));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, _mm256_sub_ps(_mm256_setzero_ps(), absDist), _CMP_LT_OQ));
+        }
+
+        unsigned visibleMask = ~(unsigned)_mm256_movemask_ps(outside) & 0xff;
+        if (count - i < 8)
+            visibleMask &= (1u << (count - i)) - 1;
+        for (unsigned j = 0; visibleMask; ++j, visibleMask >>= 1)
+        {
+            if (visibleMask & 1)
+                dest[numVisible++] = (unsigned)(start + i + j);
+        }
+    }
+#elif defined(AUTO_SSE)
+    for (size_t i = 0; i < count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(centerX + i);
+        __m128 cy = _mm_loadu_ps(centerY + i);
+        __m128 cz = _mm_loadu_ps(centerZ + i);
+        __m128 hx = _mm_loadu_ps(halfSizeX + i);
+        __m128 hy = _mm_loadu_ps(halfSizeY + i);
+        __m128 hz = _mm_loadu_ps(halfSizeZ + i);
+        __m128 outside = _mm_setzero_ps();
+
+        for (size_t j = 0; j < NUM_FRUSTUM_PLANES; ++j)
+        {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(_normalX[j])), _mm_mul_ps(cy, _mm_set1_ps(_normalY[j]))),
+                _mm_mul_ps(cz, _mm_set1_ps(_normalZ[j])));
+            dist = _mm_add_ps(dist, _mm_set1_ps(_d[j]));
+            __m128 absDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, _mm_set1_ps(_absNormalX[j])), _mm_mul_ps(hy, _mm_set1_ps(_absNormalY[j]))),
+                _mm_mul_ps(hz, _mm_set1_ps(_absNormalZ[j])));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_sub_ps(_mm_setzero_ps(), absDist)));
+        }
+
+        unsigned visibleMask = ~(unsigned)_mm_movemask_ps(outside) & 0xf;
+        if (count - i < 4)
+            visibleMask &= (1u << (count - i)) - 1;
+        for (unsigned j = 0; visibleMask; ++j, visibleMask >>= 1)
+        {
+            if (visibleMask & 1)
+                dest[numVisible++] = (unsigned)(start + i + j);
+        }
+    }
+#elif defined(AUTO_NEON)
+    for (size_t i = 0; i < count; i += 4)
+    {
+        float32x4_t cx = vld1q_f32(centerX + i);
+        float32x4_t cy = vld1q_f32(centerY + i);
+        float32x4_t cz = vld1q_f32(centerZ + i);
+        float32x4_t hx = vld1q_f32(halfSizeX + i);
+        float32x4_t hy = vld1q_f32(halfSizeY + i);
+        float32x4_t hz = vld1q_f32(halfSizeZ + i);
+        uint32x4_t outside = vdupq_n_u32(0);
+
+        for (size_t j = 0; j < NUM_FRUSTUM_PLANES; ++j)
+        {
+            // Multiply and add separately instead of fused multiply-add, so that the results match the scalar test
+            float32x4_t dist = vaddq_f32(vaddq_f32(vmulq_n_f32(cx, _normalX[j]), vmulq_n_f32(cy, _normalY[j])),
+                vmulq_n_f32(cz, _normalZ[j]));
+            dist = vaddq_f32(dist, vdupq_n_f32(_d[j]));
+            float32x4_t absDist = vaddq_f32(vaddq_f32(vmulq_n_f32(hx, _absNormalX[j]), vmulq_n_f32(hy, _absNormalY[j])),
+                vmulq_n_f32(hz, _absNormalZ[j]));
+            outside = vorrq_u32(outside, vcltq_f32(dist, vnegq_f32(absDist)));
+        }
+
+        unsigned visibleMask = (vgetq_lane_u32(outside, 0) ? 0 : 1) | (vgetq_lane_u32(outside, 1) ? 0 : 2) |
+            (vgetq_lane_u32(outside, 2) ? 0 : 4) | (vgetq_lane_u32(outside, 3) ? 0 : 8);
+        if (count - i < 4)
+            visibleMask &= (1u << (count - i)) - 1;
+        for (unsigned j = 0; visibleMask; ++j, visibleMask >>= 1)
+        {
+            if (visibleMask & 1)
+                dest[numVisible++] = (unsigned)(start + i + j);
+        }
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        bool outside = false;
+        for (size_t j = 0; j < NUM_FRUSTUM_PLANES && !outside; ++j)
+        {
+            float dist = _normalX[j] * centerX[i] + _normalY[j] * centerY[i] + _normalZ[j] * centerZ[i] + _d[j];
+            float absDist = _absNormalX[j] * halfSizeX[i] + _absNormalY[j] * halfSizeY[i] + _absNormalZ[j] * halfSizeZ[i];
+            outside = dist < -absDist;
+        }
+
+        if (!outside)
+            dest[numVisible++] = (unsigned)(start + i);
+    }
+#endif
+
+    return numVisible;
+}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../Base/Vector.h"
+#include "Frustum.h"
+#include "SIMD.h"
+
+namespace Auto3D
+{
+
+/// Bounding boxes stored as separate center and half size component arrays for testing several boxes at once with SIMD. The arrays are zero-padded to a multiple of SIMD_FLOAT_PADDING.
+class AUTO_API BoundingBoxArray
+{
+public:
+    /// Construct empty.
+    BoundingBoxArray();
+
+    /// Add a box to the end.
+    void Push(const BoundingBoxF& box);
+    /// Replace a box.
+    void Set(size_t index, const BoundingBoxF& box);
+    /// Remove a box by moving the last box in its place.
+    void EraseSwap(size_t index);
+    /// Remove all boxes.
+    void Clear();
+
+    /// Return a box.
+    BoundingBoxF Get(size_t index) const;
+    /// Return number of boxes.
+    size_t Size() const { return _size; }
+    /// Return whether has no boxes.
+    bool IsEmpty() const { return _size == 0; }
+    /// Return center component array: 0 = X, 1 = Y, 2 = Z.
+    const float* Centers(size_t axis) const { return _centers[axis].Begin()._ptr; }
+    /// Return half size component array: 0 = X, 1 = Y, 2 = Z.
+    const float* HalfSizes(size_t axis) const { return _halfSizes[axis].Begin()._ptr; }
+
+private:
+    /// Center component arrays.
+    Vector<float> _centers[3];
+    /// Half size component arrays.
+    Vector<float> _halfSizes[3];
+    /// Number of boxes.
+    size_t _size;
+};
+
+/// %Frustum planes stored as separate component arrays for testing several bounding boxes at once with SIMD.
+class AUTO_API FrustumPlaneArray
+{
+public:
+    /// Construct undefined.
+    FrustumPlaneArray();
+    /// Construct from a frustum.
+    FrustumPlaneArray(const Frustum& frustum);
+
+    /// Define from a frustum.
+    void Define(const Frustum& frustum);
+    /// Test a range of boxes, starting at a multiple of SIMD_FLOAT_PADDING. Write the indices of boxes that are inside or intersect to the destination, which must have room for count indices, and return their number. Matches Frustum::IsInsideFast().
+    size_t CullBoxes(const BoundingBoxArray& boxes, size_t start, size_t count, unsigned* dest) const;
+
+    /// Plane normal X components.
+    float _normalX[NUM_FRUSTUM_PLANES];
+    /// Plane normal Y components.
+    float _normalY[NUM_FRUSTUM_PLANES];
+    /// Plane normal Z components.
+    float _normalZ[NUM_FRUSTUM_PLANES];
+    /// Absolute plane normal X components.
+    float _absNormalX[NUM_FRUSTUM_PLANES];
+    /// Absolute plane normal Y components.
+    float _absNormalY[NUM_FRUSTUM_PLANES];
+    /// Absolute plane normal Z components.
+    float _absNormalZ[NUM_FRUSTUM_PLANES];
+    /// Plane constants.
+    float _d[NUM_FRUSTUM_PLANES];
+};
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../AutoConfig.h"
+
+#include <cstddef>
+
+// Detect the SIMD instruction sets available at compile time. Code using them must also provide a scalar fallback.
+#if defined(__AVX__)
+#   define AUTO_AVX
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define AUTO_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   define AUTO_NEON
+#endif
+
+#ifdef AUTO_AVX
+#   include <immintrin.h>
+#endif
+#ifdef AUTO_SSE
+#   include <emmintrin.h>
+#endif
+#ifdef AUTO_NEON
+#   include <arm_neon.h>
+#endif
+
+namespace Auto3D
+{
+
+/// Padding granularity of float arrays processed with SIMD, so that the widest instruction set can process whole groups.
+static const size_t SIMD_FLOAT_PADDING = 8;
+
+}
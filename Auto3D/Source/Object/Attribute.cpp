@@ -1,4 +1,7 @@
+#include "../Debug/Log.h"
+#include "../IO/JSONDocument.h"
 #include "../IO/JSONValue.h"
+#include "../IO/JSONWriter.h"
 #include "../IO/ObjectRef.h"
 #include "../IO/ResourceRef.h"
 #include "../Math/BoundingBox.h"
@@ -126,6 +129,32 @@ void Attribute::Skip(AttributeType::Type type, Stream& source)
     }
 }
 
+void Attribute::SkipColumn(AttributeType::Type type, size_t count, Stream& source)
+{
+    if (byteSizes[type])
+    {
+        source.Seek(source.Position() + count * byteSizes[type]);
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+        Skip(type, source);
+}
+
+bool Attribute::CheckColumnSize(AttributeType::Type type, size_t count, Stream& source)
+{
+    // Variable-sized values take at least one byte each
+    size_t minSize = byteSizes[type] ? byteSizes[type] : 1;
+    size_t remaining = source.Position() < source.Size() ? source.Size() - source.Position() : 0;
+    if (count > remaining / minSize)
+    {
+        ErrorStringF("Column of %u %s attribute values exceeds the remaining data of %s", (unsigned)count, typeNames[type].CString(),
+            source.Name().CString());
+        return false;
+    }
+    return true;
+}
+
 const String& Attribute::TypeName() const
 {
     return typeNames[Type()];
@@ -136,7 +165,20 @@ size_t Attribute::ByteSize() const
     return byteSizes[Type()];
 }
 
-void Attribute::FromJSON(AttributeType::Type type, void* dest, const JSONValue& source)
+/// Copy a JSON value as a JSON value attribute.
+static void CopyJSONValue(JSONValue& dest, const JSONValue& source)
+{
+    dest = source;
+}
+
+/// Copy a JSON document node as a JSON value attribute.
+static void CopyJSONValue(JSONValue& dest, const JSONNode& source)
+{
+    source.ToValue(dest);
+}
+
+/// Deserialize attribute value from either a JSON value or a JSON document node, which share the same accessors.
+template <typename _Ty> static void AttributeFromJSON(AttributeType::Type type, void* dest, const _Ty& source)
 {
     switch (type)
     {
@@ -225,7 +267,7 @@ void Attribute::FromJSON(AttributeType::Type type, void* dest, const JSONValue&
         break;
 
     case AttributeType::JSONVALUE:
-        *(reinterpret_cast<JSONValue*>(dest)) = source;
+        CopyJSONValue(*(reinterpret_cast<JSONValue*>(dest)), source);
         break;
 
     default:
@@ -233,6 +275,16 @@ void Attribute::FromJSON(AttributeType::Type type, void* dest, const JSONValue&
     }
 }
 
+void Attribute::FromJSON(AttributeType::Type type, void* dest, const JSONValue& source)
+{
+    AttributeFromJSON(type, dest, source);
+}
+
+void Attribute::FromJSON(AttributeType::Type type, void* dest, const JSONNode& source)
+{
+    AttributeFromJSON(type, dest, source);
+}
+
 void Attribute::ToJSON(AttributeType::Type type, JSONValue& dest, const void* source)
 {
     switch (type)
@@ -330,6 +382,117 @@ void Attribute::ToJSON(AttributeType::Type type, JSONValue& dest, const void* so
     }
 }
 
+void Attribute::ToJSON(AttributeType::Type type, JSONWriter& dest, const void* source)
+{
+    // Math types are written in the same space-separated format as their ToString(), but with full float precision
+    switch (type)
+    {
+    case AttributeType::BOOL:
+        dest.WriteBool(*(reinterpret_cast<const bool*>(source)));
+        break;
+
+    case AttributeType::BYTE:
+        dest.WriteNumber((unsigned)*(reinterpret_cast<const unsigned char*>(source)));
+        break;
+
+    case AttributeType::UNSIGNED:
+        dest.WriteNumber(*(reinterpret_cast<const unsigned*>(source)));
+        break;
+
+    case AttributeType::INT:
+        dest.WriteNumber(*(reinterpret_cast<const int*>(source)));
+        break;
+
+    case AttributeType::INTVECTOR2:
+        dest.WriteNumberString(reinterpret_cast<const Vector2I*>(source)->Data(), 2);
+        break;
+
+    case AttributeType::INTRECT:
+        {
+            const RectI& rect = *reinterpret_cast<const RectI*>(source);
+            int values[] = { rect._min._x, rect._min._y, rect._max._x, rect._max._y };
+            dest.WriteNumberString(values, 4);
+        }
+        break;
+
+    case AttributeType::FLOAT:
+        dest.WriteNumber(*(reinterpret_cast<const float*>(source)));
+        break;
+
+    case AttributeType::VECTOR2:
+        dest.WriteNumberString(reinterpret_cast<const Vector2F*>(source)->Data(), 2);
+        break;
+
+    case AttributeType::VECTOR3:
+        dest.WriteNumberString(reinterpret_cast<const Vector3F*>(source)->Data(), 3);
+        break;
+
+    case AttributeType::VECTOR4:
+        dest.WriteNumberString(reinterpret_cast<const Vector4F*>(source)->Data(), 4);
+        break;
+
+    case AttributeType::QUATERNION:
+        dest.WriteNumberString(reinterpret_cast<const Quaternion*>(source)->Data(), 4);
+        break;
+
+    case AttributeType::COLOR:
+        dest.WriteNumberString(reinterpret_cast<const Color*>(source)->Data(), 4);
+        break;
+
+    case AttributeType::RECT:
+        {
+            const RectF& rect = *reinterpret_cast<const RectF*>(source);
+            float values[] = { rect._min._x, rect._min._y, rect._max._x, rect._max._y };
+            dest.WriteNumberString(values, 4);
+        }
+        break;
+
+    case AttributeType::BOUNDINGBOX:
+        {
+            const BoundingBoxF& box = *reinterpret_cast<const BoundingBoxF*>(source);
+            float values[] = { box._min._x, box._min._y, box._min._z, box._max._x, box._max._y, box._max._z };
+            dest.WriteNumberString(values, 6);
+        }
+        break;
+
+    case AttributeType::MATRIX3:
+        dest.WriteNumberString(reinterpret_cast<const Matrix3x3F*>(source)->Data(), 9);
+        break;
+
+    case AttributeType::MATRIX3X4:
+        dest.WriteNumberString(reinterpret_cast<const Matrix3x4F*>(source)->Data(), 12);
+        break;
+
+    case AttributeType::MATRIX4:
+        dest.WriteNumberString(reinterpret_cast<const Matrix4x4F*>(source)->Data(), 16);
+        break;
+
+    case AttributeType::STRING:
+        dest.WriteString(*(reinterpret_cast<const String*>(source)));
+        break;
+
+    case AttributeType::RESOURCEREF:
+        dest.WriteString(reinterpret_cast<const ResourceRef*>(source)->ToString());
+        break;
+
+    case AttributeType::RESOURCEREFLIST:
+        dest.WriteString(reinterpret_cast<const ResourceRefList*>(source)->ToString());
+        break;
+
+    case AttributeType::OBJECTREF:
+        dest.WriteNumber(reinterpret_cast<const ObjectRef*>(source)->_id);
+        break;
+
+    case AttributeType::JSONVALUE:
+        dest.WriteValue(*(reinterpret_cast<const JSONValue*>(source)));
+        break;
+
+    default:
+        dest.WriteNull();
+        break;
+    }
+}
+
 AttributeType::Type Attribute::TypeFromName(const String& name)
 {
     return (AttributeType::Type)String::ListIndex(name, &typeNames[0], AttributeType::Count);
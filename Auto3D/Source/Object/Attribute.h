@@ -6,7 +6,9 @@
 namespace Auto3D
 {
 
+class JSONNode;
 class JSONValue;
+class JSONWriter;
 class Serializable;
 class Stream;
 
@@ -54,6 +56,10 @@ public:
     virtual void Get(const Serializable* instance, void* dest) = 0;
     /// Set new value for the variable.
     virtual void Set(Serializable* instance, const void* source) = 0;
+    /// Get the current values of the variable from several instances to a contiguous array.
+    virtual void GetColumn(Serializable* const* instances, size_t count, void* dest) = 0;
+    /// Set new values for the variable from a contiguous array to several instances. Null instances are skipped.
+    virtual void SetColumn(Serializable* const* instances, size_t count, const void* source) = 0;
 };
 
 /// Description of an automatically serializable variable.
@@ -71,10 +77,20 @@ public:
     virtual void FromBinary(Serializable* instance, Stream& source) = 0;
     /// Serialize to a binary stream.
     virtual void ToBinary(Serializable* instance, Stream& dest) = 0;
+    /// Deserialize a column of values, one for each instance, from a binary stream. Null instances are skipped but their values are still read.
+    virtual void FromBinaryColumn(Serializable* const* instances, size_t count, Stream& source) = 0;
+    /// Serialize a column of values, one for each instance, to a binary stream.
+    virtual void ToBinaryColumn(Serializable* const* instances, size_t count, Stream& dest) = 0;
     /// Deserialize from JSON.
     virtual void FromJSON(Serializable* instance, const JSONValue& source) = 0;
+    /// Deserialize from a JSON document node.
+    virtual void FromJSON(Serializable* instance, const JSONNode& source) = 0;
     /// Serialize to JSON.
     virtual void ToJSON(Serializable* instance, JSONValue& dest) = 0;
+    /// Serialize to a JSON writer.
+    virtual void ToJSON(Serializable* instance, JSONWriter& dest) = 0;
+    /// Copy the value from another instance of the same class.
+    virtual void CopyValue(Serializable* dest, Serializable* source) = 0;
     /// Return type.
     virtual AttributeType::Type Type() const = 0;
     /// Return whether is default value.
@@ -96,10 +112,18 @@ public:
     
     /// Skip binary data of an attribute.
     static void Skip(AttributeType::Type type, Stream& source);
+    /// Skip binary data of a column of attribute values.
+    static void SkipColumn(AttributeType::Type type, size_t count, Stream& source);
+    /// Return whether a column of attribute values can fit in the rest of a binary stream. Log an error if not.
+    static bool CheckColumnSize(AttributeType::Type type, size_t count, Stream& source);
     /// Serialize attribute value to JSON.
     static void ToJSON(AttributeType::Type type, JSONValue& dest, const void* source);
+    /// Serialize attribute value to a JSON writer.
+    static void ToJSON(AttributeType::Type type, JSONWriter& dest, const void* source);
     /// Deserialize attribute value from JSON.
     static void FromJSON(AttributeType::Type type, void* dest, const JSONValue& source);
+    /// Deserialize attribute value from a JSON document node.
+    static void FromJSON(AttributeType::Type type, void* dest, const JSONNode& source);
     /// Return attribute type from type name.
     static AttributeType::Type TypeFromName(const String& name);
     /// Return attribute type from type name.
@@ -145,9 +169,53 @@ public:
         _accessor->Get(instance, &value);
         dest.Write<_Ty>(value);
     }
+
+    /// Deserialize a column of values, one for each instance, from a binary stream. Null instances are skipped but their values are still read.
+    void FromBinaryColumn(Serializable* const* instances, size_t count, Stream& source) override
+    {
+        if (!count || !CheckColumnSize(Type(), count, source))
+            return;
+
+        AutoArrayPtr<_Ty> values(new _Ty[count]);
+        // Fixed-size values are stored in their memory layout and can be read at once. Bools are read one by one to validate them
+        if (byteSizes[Type()] == sizeof(_Ty) && Type() != AttributeType::BOOL)
+            source.Read(values.Get(), count * sizeof(_Ty));
+        else
+        {
+            for (size_t i = 0; i < count; ++i)
+                values[i] = source.Read<_Ty>();
+        }
+
+        _accessor->SetColumn(instances, count, values.Get());
+    }
+
+    /// Serialize a column of values, one for each instance, to a binary stream.
+    void ToBinaryColumn(Serializable* const* instances, size_t count, Stream& dest) override
+    {
+        if (!count)
+            return;
+
+        AutoArrayPtr<_Ty> values(new _Ty[count]);
+        _accessor->GetColumn(instances, count, values.Get());
+        if (byteSizes[Type()] == sizeof(_Ty) && Type() != AttributeType::BOOL)
+            dest.Write(values.Get(), count * sizeof(_Ty));
+        else
+        {
+            for (size_t i = 0; i < count; ++i)
+                dest.Write<_Ty>(values[i]);
+        }
+    }
     
     /// Return whether is default value.
     bool IsDefault(Serializable* instance) override { return Value(instance) == _defaultValue; }
+
+    /// Copy the value from another instance of the same class.
+    void CopyValue(Serializable* dest, Serializable* source) override
+    {
+        _Ty value;
+        _accessor->Get(source, &value);
+        _accessor->Set(dest, &value);
+    }
     
     /// Deserialize from JSON.
     void FromJSON(Serializable* instance, const JSONValue& source) override
@@ -157,6 +225,14 @@ public:
         _accessor->Set(instance, &value);
     }
 
+    /// Deserialize from a JSON document node.
+    void FromJSON(Serializable* instance, const JSONNode& source) override
+    {
+        _Ty value;
+        Attribute::FromJSON(Type(), &value, source);
+        _accessor->Set(instance, &value);
+    }
+
     /// Serialize to JSON.
     void ToJSON(Serializable* instance, JSONValue& dest) override
     {
@@ -165,6 +241,14 @@ public:
         Attribute::ToJSON(Type(), dest, &value);
     }
 
+    /// Serialize to a JSON writer.
+    void ToJSON(Serializable* instance, JSONWriter& dest) override
+    {
+        _Ty value;
+        _accessor->Get(instance, &value);
+        Attribute::ToJSON(Type(), dest, &value);
+    }
+
     /// Return type.
     AttributeType::Type Type() const override;
     
@@ -225,6 +309,25 @@ public:
         (classInstance->*_set)(value);
     }
 
+    /// Get the current values of the variable from several instances to a contiguous array.
+    void GetColumn(Serializable* const* instances, size_t count, void* dest) override
+    {
+        U* values = reinterpret_cast<U*>(dest);
+        for (size_t i = 0; i < count; ++i)
+            values[i] = (static_cast<const _Ty*>(instances[i])->*_get)();
+    }
+
+    /// Set new values for the variable from a contiguous array to several instances. Null instances are skipped.
+    void SetColumn(Serializable* const* instances, size_t count, const void* source) override
+    {
+        const U* values = reinterpret_cast<const U*>(source);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (instances[i])
+                (static_cast<_Ty*>(instances[i])->*_set)(values[i]);
+        }
+    }
+
 private:
     /// Getter function pointer.
     GetFunctionPtr _get;
@@ -268,6 +371,25 @@ public:
         (classPtr->*_set)(value);
     }
 
+    /// Get the current values of the variable from several instances to a contiguous array.
+    void GetColumn(Serializable* const* instances, size_t count, void* dest) override
+    {
+        U* values = reinterpret_cast<U*>(dest);
+        for (size_t i = 0; i < count; ++i)
+            values[i] = (static_cast<const _Ty*>(instances[i])->*_get)();
+    }
+
+    /// Set new values for the variable from a contiguous array to several instances. Null instances are skipped.
+    void SetColumn(Serializable* const* instances, size_t count, const void* source) override
+    {
+        const U* values = reinterpret_cast<const U*>(source);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (instances[i])
+                (static_cast<_Ty*>(instances[i])->*_set)(values[i]);
+        }
+    }
+
 private:
     /// Getter function pointer.
     GetFunctionPtr _get;
@@ -311,6 +433,25 @@ public:
         (classPtr->*_set)(value);
     }
 
+    /// Get the current values of the variable from several instances to a contiguous array.
+    void GetColumn(Serializable* const* instances, size_t count, void* dest) override
+    {
+        U* values = reinterpret_cast<U*>(dest);
+        for (size_t i = 0; i < count; ++i)
+            values[i] = (static_cast<const _Ty*>(instances[i])->*_get)();
+    }
+
+    /// Set new values for the variable from a contiguous array to several instances. Null instances are skipped.
+    void SetColumn(Serializable* const* instances, size_t count, const void* source) override
+    {
+        const U* values = reinterpret_cast<const U*>(source);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (instances[i])
+                (static_cast<_Ty*>(instances[i])->*_set)(values[i]);
+        }
+    }
+
 private:
     /// Getter function pointer.
     GetFunctionPtr _get;
@@ -1,4 +1,7 @@
+#include "../Debug/Log.h"
+#include "../IO/JSONDocument.h"
 #include "../IO/JSONValue.h"
+#include "../IO/JSONWriter.h"
 #include "../IO/ObjectRef.h"
 #include "../IO/Stream.h"
 #include "ObjectResolver.h"
@@ -11,6 +14,42 @@ namespace Auto3D
 
 HashMap<StringHash, Vector<SharedPtr<Attribute> > > Serializable::_classAttributes;
 
+/// Return a member of a JSON object value, or null if not found.
+static const JSONValue* FindJSONMember(const JSONValue& source, const String& name)
+{
+    const JSONObject& object = source.GetObject();
+    auto it = object.Find(name);
+    return it != object.End() ? &it->_second : nullptr;
+}
+
+/// Return a member of a JSON document object node, or null if not found.
+static const JSONNode* FindJSONMember(const JSONNode& source, const String& name)
+{
+    const JSONMember* member = source.FindMember(name.CString());
+    return member ? &member->_value : nullptr;
+}
+
+/// Load attributes from either a JSON value or a JSON document node. Store object ref attributes to the resolver instead of immediately setting.
+template <typename _Ty> static void LoadAttributesJSON(Serializable* instance, const _Ty& source, ObjectResolver& resolver)
+{
+    const Vector<SharedPtr<Attribute> >* attributes = instance->Attributes();
+    if (!attributes || !source.IsObject() || !source.Size())
+        return;
+    
+    for (auto it = attributes->Begin(); it != attributes->End(); ++it)
+    {
+        Attribute* attr = *it;
+        const _Ty* value = FindJSONMember(source, attr->Name());
+        if (value)
+        {
+            if (attr->Type() != AttributeType::OBJECTREF)
+                attr->FromJSON(instance, *value);
+            else
+                resolver.StoreObjectRef(instance, attr, ObjectRef((unsigned)value->GetNumber()));
+        }
+    }
+}
+
 void Serializable::Load(Stream& source, ObjectResolver& resolver)
 {
     const Vector<SharedPtr<Attribute> >* attributes = Attributes();
@@ -60,29 +99,38 @@ void Serializable::Save(Stream& dest)
 }
 
 void Serializable::LoadJSON(const JSONValue& source, ObjectResolver& resolver)
+{
+    LoadAttributesJSON(this, source, resolver);
+}
+
+void Serializable::LoadJSON(const JSONNode& source, ObjectResolver& resolver)
+{
+    LoadAttributesJSON(this, source, resolver);
+}
+
+void Serializable::SaveJSON(JSONValue& dest)
 {
     const Vector<SharedPtr<Attribute> >* attributes = Attributes();
-    if (!attributes || !source.IsObject() || !source.Size())
+    if (!attributes)
         return;
     
-    const JSONObject& object = source.GetObject();
-    
-    for (auto it = attributes->Begin(); it != attributes->End(); ++it)
+    for (size_t i = 0; i < attributes->Size(); ++i)
     {
-        Attribute* attr = *it;
-        auto jsonIt = object.Find(attr->Name());
-        if (jsonIt != object.End())
-        {
-            // Store object refs to the resolver instead of immediately setting
-            if (attr->Type() != AttributeType::OBJECTREF)
-                attr->FromJSON(this, jsonIt->_second);
-            else
-                resolver.StoreObjectRef(this, attr, ObjectRef((unsigned)jsonIt->_second.GetNumber()));
-        }
+        Attribute* attr = attributes->At(i);
+        // For better readability, do not save default-valued attributes to JSON
+        if (!attr->IsDefault(this))
+            attr->ToJSON(this, dest[attr->Name()]);
     }
 }
 
-void Serializable::SaveJSON(JSONValue& dest)
+void Serializable::SaveJSON(JSONWriter& dest)
+{
+    dest.StartObject();
+    SaveAttributesJSON(dest);
+    dest.EndObject();
+}
+
+void Serializable::SaveAttributesJSON(JSONWriter& dest)
 {
     const Vector<SharedPtr<Attribute> >* attributes = Attributes();
     if (!attributes)
@@ -93,10 +141,31 @@ void Serializable::SaveJSON(JSONValue& dest)
         Attribute* attr = attributes->At(i);
         // For better readability, do not save default-valued attributes to JSON
         if (!attr->IsDefault(this))
-            attr->ToJSON(this, dest[attr->Name()]);
+        {
+            dest.WriteKey(attr->Name());
+            attr->ToJSON(this, dest);
+        }
     }
 }
 
+void Serializable::CopyAttributes(Serializable* source)
+{
+    if (!source || source == this)
+        return;
+    if (source->GetType() != GetType())
+    {
+        ErrorString("Can not copy attributes from " + source->GetTypeName() + " to " + GetTypeName());
+        return;
+    }
+
+    const Vector<SharedPtr<Attribute> >* attributes = Attributes();
+    if (!attributes)
+        return;
+
+    for (auto it = attributes->Begin(); it != attributes->End(); ++it)
+        (*it)->CopyValue(this, source);
+}
+
 void Serializable::SetAttributeValue(Attribute* attr, const void* source)
 {
     if (attr)
@@ -18,11 +18,17 @@ public:
     virtual void Save(Stream& dest);
     /// Load from JSON data. Optionally store object ref attributes to be resolved later.
     virtual void LoadJSON(const JSONValue& source, ObjectResolver& resolver);
+    /// Load from a JSON document node. Optionally store object ref attributes to be resolved later.
+    virtual void LoadJSON(const JSONNode& source, ObjectResolver& resolver);
     /// Save as JSON data.
     virtual void SaveJSON(JSONValue& dest);
+    /// Save as a JSON object to a writer.
+    virtual void SaveJSON(JSONWriter& dest);
     /// Return _id for referring to the object in serialization.
     virtual unsigned Id() const { return 0; }
 
+    /// Copy all attribute values from another object of the same type. Object refs are copied as is.
+    void CopyAttributes(Serializable* source);
     /// Set attribute value from memory.
     void SetAttributeValue(Attribute* attr, const void* source);
     /// Copy attribute value to memory.
@@ -61,6 +67,9 @@ public:
         return typedAttr ? typedAttr->Value(this) : _Ty();
     }
     
+    /// Save non-default attributes as members of the JSON object being written.
+    void SaveAttributesJSON(JSONWriter& dest);
+
     /// Return the attribute descriptions. Default implementation uses per-class registration.
     virtual const Vector<SharedPtr<Attribute> >* Attributes() const;
     /// Return an attribute description by name, or null if does not exist.
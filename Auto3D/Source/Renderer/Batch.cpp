@@ -2,24 +2,51 @@
 #include "../Graphics/Texture.h"
 #include "Batch.h"
 
+#include <cassert>
+#include <cstring>
+
 #include "../Debug/DebugNew.h"
 
 namespace Auto3D
 {
 
-inline bool CompareBatchState(Batch& lhs, Batch& rhs)
-{
-    return lhs._sortKey < rhs._sortKey;
-}
-
-inline bool CompareBatchDistanceFrontToBack(Batch& lhs, Batch& rhs)
+/// Number of sort key bits used for front to back distance. Dropping the low mantissa bits saves one radix sort pass.
+static const unsigned FRONT_TO_BACK_KEY_BITS = 22;
+/// Largest shader ID that fits in the state sort key, along with the geometry type.
+static const unsigned MAX_SORT_SHADER_ID = 0x3fff;
+/// Largest material ID that fits in the state sort key.
+static const unsigned MAX_SORT_MATERIAL_ID = 0xffff;
+/// Largest light pass ID that fits in the state sort key.
+static const unsigned MAX_SORT_LIGHT_PASS_ID = 0xfff;
+/// Largest geometry ID that fits in the state sort key.
+static const unsigned MAX_SORT_GEOMETRY_ID = 0xffff;
+
+/// Convert a float to an unsigned integer that sorts in the same order.
+inline unsigned FloatToSortKey(float value)
 {
-    return lhs._distance < rhs._distance;
+    unsigned bits;
+    memcpy(&bits, &value, sizeof bits);
+    return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
 }
 
-inline bool CompareBatchDistanceBackToFront(Batch& lhs, Batch& rhs)
+void Batch::CalculateSortKey(unsigned depthBucket)
 {
-    return lhs._distance > rhs._distance;
+    // Key layout from most significant bits:
+    // 63-48 shader ID and geometry type, 47-32 material ID, 31-20 light pass ID, 19-4 geometry ID, 3-0 depth bucket
+    // The IDs are small recycled integers, so the fields only overflow if there are more objects alive than fit in them. Then
+    // distinct states would share keys and be interleaved
+    unsigned shaderId = _pass->GetShaderId();
+    unsigned materialId = _pass->Parent()->GetSortId();
+    unsigned lightPassId = _lights ? _lights->_sortId : 0;
+    unsigned geometryId = _geometry->GetSortId();
+    assert(shaderId <= MAX_SORT_SHADER_ID && materialId <= MAX_SORT_MATERIAL_ID && lightPassId <= MAX_SORT_LIGHT_PASS_ID &&
+        geometryId <= MAX_SORT_GEOMETRY_ID);
+
+    _sortKey = ((unsigned long long)((shaderId & MAX_SORT_SHADER_ID) << 2 | _type) << 48) |
+        ((unsigned long long)(materialId & MAX_SORT_MATERIAL_ID) << 32) |
+        ((unsigned long long)(lightPassId & MAX_SORT_LIGHT_PASS_ID) << 20) |
+        ((unsigned long long)(geometryId & MAX_SORT_GEOMETRY_ID) << 4) |
+        (depthBucket & (SORT_KEY_DEPTH_BUCKETS - 1));
 }
 
 void RenderQueue::Clear()
@@ -28,24 +55,24 @@ void RenderQueue::Clear()
     _additiveBatches.Clear();
 }
 
-void RenderQueue::Sort(Vector<Matrix3x4F>& instanceTransforms)
+void RenderQueue::Sort(InstanceData& instances)
 {
     switch (_sort)
     {
     case RenderCommandSortMode::STATE:
-        Auto3D::Sort(_batches.Begin(), _batches.End(), CompareBatchState);
-        Auto3D::Sort(_additiveBatches.Begin(), _additiveBatches.End(), CompareBatchState);
+        SortBatches(_batches, RenderCommandSortMode::STATE);
+        SortBatches(_additiveBatches, RenderCommandSortMode::STATE);
         break;
 
     case RenderCommandSortMode::FRONT_TO_BACK:
-        Auto3D::Sort(_batches.Begin(), _batches.End(), CompareBatchDistanceFrontToBack);
+        SortBatches(_batches, RenderCommandSortMode::FRONT_TO_BACK);
         // After drawing the base batches, the Z buffer has been prepared. Additive batches can be sorted per state now
-        Auto3D::Sort(_additiveBatches.Begin(), _additiveBatches.End(), CompareBatchState);
+        SortBatches(_additiveBatches, RenderCommandSortMode::STATE);
         break;
 
     case RenderCommandSortMode::BACK_TO_FRONT:
-        Auto3D::Sort(_batches.Begin(), _batches.End(), CompareBatchDistanceBackToFront);
-        Auto3D::Sort(_additiveBatches.Begin(), _additiveBatches.End(), CompareBatchDistanceBackToFront);
+        SortBatches(_batches, RenderCommandSortMode::BACK_TO_FRONT);
+        SortBatches(_additiveBatches, RenderCommandSortMode::BACK_TO_FRONT);
         break;
 
     default:
@@ -53,13 +80,57 @@ void RenderQueue::Sort(Vector<Matrix3x4F>& instanceTransforms)
     }
 
     // Build instances where adjacent batches have same state
-    BuildInstances(_batches, instanceTransforms);
-    BuildInstances(_additiveBatches, instanceTransforms);
+    BuildInstances(_batches, instances);
+    BuildInstances(_additiveBatches, instances);
+}
+
+void RenderQueue::SortBatches(Vector<Batch>& batches, RenderCommandSortMode::Type sort)
+{
+    size_t numBatches = batches.Size();
+    if (numBatches < 2)
+        return;
+
+    _sortKeys.Resize(numBatches);
+    unsigned keyBits;
+
+    switch (sort)
+    {
+    case RenderCommandSortMode::STATE:
+        for (size_t i = 0; i < numBatches; ++i)
+            _sortKeys[i] = batches[i]._sortKey;
+        keyBits = 64;
+        break;
+
+    case RenderCommandSortMode::FRONT_TO_BACK:
+        for (size_t i = 0; i < numBatches; ++i)
+            _sortKeys[i] = FloatToSortKey(batches[i]._distance) >> (32 - FRONT_TO_BACK_KEY_BITS);
+        keyBits = FRONT_TO_BACK_KEY_BITS;
+        break;
+
+    case RenderCommandSortMode::BACK_TO_FRONT:
+        for (size_t i = 0; i < numBatches; ++i)
+            _sortKeys[i] = ~FloatToSortKey(batches[i]._distance);
+        keyBits = 32;
+        break;
+
+    default:
+        return;
+    }
+
+    _sorter.Sort(_sortKeys, _sortIndices, keyBits);
+
+    // Move the batches to their sorted positions once
+    _sortedBatches.Resize(numBatches);
+    for (size_t i = 0; i < numBatches; ++i)
+        _sortedBatches[i] = batches[_sortIndices[i]];
+    batches.Swap(_sortedBatches);
 }
 
-void RenderQueue::BuildInstances(Vector<Batch>& batches, Vector<Matrix3x4F>& instanceTransforms)
+void RenderQueue::BuildInstances(Vector<Batch>& batches, InstanceData& instances)
 {
     Batch* start = nullptr;
+    // Whether the start batch's transform was already counted as overflow
+    bool startOverflow = false;
 
     for (auto it = batches.Begin(), end = batches.End(); it != end; ++it)
     {
@@ -70,22 +141,39 @@ void RenderQueue::BuildInstances(Vector<Batch>& batches, Vector<Matrix3x4F>& ins
         {
             if (start->_type == GeometryType::INSTANCED)
             {
-                instanceTransforms.Push(*current->_worldMatrix);
-                ++start->_instanceCount;
+                if (instances._count < instances._capacity)
+                {
+                    instances._transforms[instances._count++] = *current->_worldMatrix;
+                    ++start->_instanceCount;
+                    continue;
+                }
+                ++instances._overflow;
             }
             else
             {
-                // Begin new instanced batch
-                start->_type = GeometryType::INSTANCED;
-                size_t instanceStart = instanceTransforms.Size();
-                instanceTransforms.Push(*start->_worldMatrix);
-                instanceTransforms.Push(*current->_worldMatrix);
-                start->_instanceStart = instanceStart; // Overwrites non-instance world matrix
-                start->_instanceCount = 2; // Overwrites sort _key / distance
+                if (instances._count + 2 <= instances._capacity)
+                {
+                    // Begin new instanced batch
+                    start->_type = GeometryType::INSTANCED;
+                    size_t instanceStart = instances._start + instances._count;
+                    instances._transforms[instances._count++] = *start->_worldMatrix;
+                    instances._transforms[instances._count++] = *current->_worldMatrix;
+                    start->_instanceStart = instanceStart; // Overwrites non-instance world matrix
+                    start->_instanceCount = 2; // Overwrites sort _key / distance
+                    continue;
+                }
+                instances._overflow += startOverflow ? 1 : 2;
             }
+
+            // Out of room: render the current batch non-instanced
+            start = current;
+            startOverflow = true;
         }
         else
+        {
             start = (current->_type == GeometryType::STATIC) ? current : nullptr;
+            startOverflow = false;
+        }
     }
 }
 
@@ -1,4 +1,5 @@
 #pragma once
+#include "../Base/RadixSort.h"
 #include "../Math/AreaAllocator.h"
 #include "Camera.h"
 #include "GeometryNode.h"
@@ -15,17 +16,14 @@ struct LightPass;
 static const size_t MAX_LIGHTS_PER_PASS = 4;
 
 
+/// Number of depth buckets in the state sort key.
+static const unsigned SORT_KEY_DEPTH_BUCKETS = 16;
+
 /// Description of a draw call.
 struct AUTO_API Batch
 {
-    /// Calculate sort _key for state sorting.
-    void CalculateSortKey()
-    {
-        _sortKey = ((((unsigned long long)_pass->GetShaderHash() * _type) & 0xffff) << 48) |
-            ((((unsigned long long)_lights) & 0xffff) << 32) |
-            ((((unsigned long long)_pass->Parent()) & 0xffff) << 16) |
-            (((unsigned long long)_geometry) & 0xffff);
-    }
+    /// Calculate sort key for state sorting. The depth bucket orders batches with otherwise same state front to back.
+    void CalculateSortKey(unsigned depthBucket = 0);
 
     /// Geometry.
     Geometry* _geometry;
@@ -55,16 +53,45 @@ struct AUTO_API Batch
     };
 };
 
+/// Destination for instance transforms while building instances, normally a mapped range of the instance vertex buffer.
+struct AUTO_API InstanceData
+{
+    /// Construct with no room.
+    InstanceData() :
+        _transforms(nullptr),
+        _start(0),
+        _count(0),
+        _capacity(0),
+        _overflow(0)
+    {
+    }
+
+    /// Transforms to write.
+    Matrix3x4F* _transforms;
+    /// Instance vertex buffer index of the first transform.
+    size_t _start;
+    /// Number of transforms written.
+    size_t _count;
+    /// Maximum number of transforms.
+    size_t _capacity;
+    /// Number of transforms that did not fit. The batches are left non-instanced in that case.
+    size_t _overflow;
+};
+
 /// Per-pass batch queue structure.
 struct AUTO_API RenderQueue
 {
     /// Clear structures.
     void Clear();
     /// Sort batches and build instances.
-    void Sort(Vector<Matrix3x4F>& instanceTransforms);
+    void Sort(InstanceData& instances);
+    /// Return the maximum number of instance transforms that sorting may write.
+    size_t MaxInstances() const { return _batches.Size() + _additiveBatches.Size(); }
 
     /// Build instances from adjacent batches with same state.
-    static void BuildInstances(Vector<Batch>& batches, Vector<Matrix3x4F>& instanceTransforms);
+    static void BuildInstances(Vector<Batch>& batches, InstanceData& instances);
+    /// Sort batches by radix sorting their keys and moving each batch once.
+    void SortBatches(Vector<Batch>& batches, RenderCommandSortMode::Type sort);
 
     /// Batches, which may be instanced or non-instanced.
     Vector<Batch> _batches;
@@ -74,10 +101,20 @@ struct AUTO_API RenderQueue
 	RenderCommandSortMode::Type _sort;
     /// Lighting flag.
     bool _lit;
+    /// Clustered lighting flag. Lit batches use the light clusters instead of light passes and there are no additive batches.
+    bool _clustered;
     /// Base pass index.
     unsigned char _baseIndex;
     /// Additive pass index (if needed.)
     unsigned char _additiveIndex;
+    /// Radix sorter with its scratch buffers, kept between frames.
+    RadixSorter _sorter;
+    /// Sort keys of the batches being sorted.
+    Vector<unsigned long long> _sortKeys;
+    /// Sorted batch indices.
+    Vector<unsigned> _sortIndices;
+    /// Scratch vector for the sorted batches.
+    Vector<Batch> _sortedBatches;
 };
 
 /// %List of lights for a geometry node.
@@ -117,9 +154,21 @@ struct AUTO_API LightPass
     /// Shadow maps.
     Texture* _shadowMaps[MAX_LIGHTS_PER_PASS];
     /// Vertex shader variation bits.
-    unsigned short _vsBits;
+    unsigned _vsBits;
     /// Pixel shader variation bits.
-    unsigned short _psBits;
+    unsigned _psBits;
+    /// ID for state sorting, assigned when the light pass is created. The ambient only light pass uses 0.
+    unsigned _sortId;
+    /// Lights the constant data was built from.
+    Light* _lights[MAX_LIGHTS_PER_PASS];
+    /// Parameter versions of the lights when the constant data was built.
+    unsigned _lightVersions[MAX_LIGHTS_PER_PASS];
+    /// Number of lights.
+    size_t _numLights;
+    /// Whether any of the lights is shadowed. Shadow constants depend on the camera and the shadow map allocation, so they are rebuilt every frame.
+    bool _shadowed;
+    /// Frame number on which the light pass was last used.
+    unsigned _lastFrameNumber;
 };
 
 /// Shadow rendering view data structure.
@@ -1,3 +1,4 @@
+#include "../Base/IdAllocator.h"
 #include "../Debug/Log.h"
 #include "../Graphics/ConstantBuffer.h"
 #include "../Graphics/Graphics.h"
@@ -14,16 +15,25 @@
 namespace Auto3D
 {
 
+/// Return the geometry sort ID allocator. Allocated on first use and never destroyed, so that geometries destroyed during static destruction can still free their IDs.
+static IdAllocator& GetGeometryIds()
+{
+    static IdAllocator* ids = new IdAllocator();
+    return *ids;
+}
+
 Geometry::Geometry() : 
     _primitiveType(PrimitiveType::TRIANGLE_LIST),
     _drawStart(0),
     _drawCount(0),
-    _lodDistance(0.0f)
+    _lodDistance(0.0f),
+    _sortId(GetGeometryIds().Allocate())
 {
 }
 
 Geometry::~Geometry()
 {
+    GetGeometryIds().Free(_sortId);
 }
 
 void Geometry::Draw(Graphics* graphics)
@@ -50,7 +60,8 @@ void Geometry::DrawInstanced(Graphics* graphics, size_t start, size_t count)
         graphics->DrawInstanced(_primitiveType, _drawStart, _drawCount, start, count);
 }
 
-SourceBatch::SourceBatch()
+SourceBatch::SourceBatch() :
+    _lodGeometry(nullptr)
 {
 }
 
@@ -110,7 +121,10 @@ void GeometryNode::SetGeometry(size_t index, Geometry* geometry)
     }
 
     if (index < _batches.Size())
+    {
         _batches[index]._geometry = geometry;
+        _batches[index]._lodGeometry = geometry;
+    }
     else
         ErrorStringF("Out of bounds batch index %d for setting geometry", (int)index);
 }
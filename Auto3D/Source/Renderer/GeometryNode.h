@@ -34,8 +34,10 @@ struct AUTO_API VertexBufferDesc
 	Vector<VertexElement> _vertexElements;
 	/// Number of vertices.
 	size_t _numVertices;
-	/// Vertex data.
+	/// Vertex data, if copied from the source stream.
 	SharedArrayPtr<unsigned char> _vertexData;
+	/// Vertex data to upload. Points either to the copied data or into the source stream.
+	const unsigned char* _vertexDataView;
 };
 
 /// Load-time description of an index buffer, to be uploaded on the GPU later.
@@ -45,8 +47,10 @@ struct AUTO_API IndexBufferDesc
 	size_t _indexSize;
 	/// Number of indices.
 	size_t _numIndices;
-	/// Index data.
+	/// Index data, if copied from the source stream.
 	SharedArrayPtr<unsigned char> _indexData;
+	/// Index data to upload. Points either to the copied data or into the source stream.
+	const unsigned char* _indexDataView;
 };
 
 /// Load-time description of a geometry.
@@ -80,6 +84,9 @@ public:
     /// Draw an instance range. A separate instance data vertex buffer must be bound.
     void DrawInstanced(Graphics* graphics, size_t start, size_t count);
 
+    /// Return ID for state sorting.
+    unsigned GetSortId() const { return _sortId; }
+
     /// %Geometry vertex buffer.
     SharedPtr<VertexBuffer> _vertexBuffer;
     /// %Geometry index buffer.
@@ -94,6 +101,10 @@ public:
     size_t _drawCount;
     /// LOD transition distance.
     float _lodDistance;
+
+private:
+    /// ID for state sorting.
+    unsigned _sortId;
 };
 
 /// Draw call source data.
@@ -104,8 +115,10 @@ struct AUTO_API SourceBatch
     /// Destruct.
     ~SourceBatch();
 
-    /// The geometry to render. Must be non-null.
+    /// The geometry assigned to this batch. Must be non-null.
     SharedPtr<Geometry> _geometry;
+    /// The geometry of the current LOD level, which is used for rendering. Not reference counted, so that it can be switched from worker threads; it is owned either by _geometry or by the node's model.
+    Geometry* _lodGeometry;
     /// The material to use for rendering. Must be non-null.
     SharedPtr<Material> _material;
 };
@@ -124,7 +137,7 @@ public:
     /// Register factory and attributes.
     static void RegisterObject();
 
-    /// Prepare object for rendering. Reset framenumber and light list and calculate distance from camera. Called by Renderer.
+    /// Prepare object for rendering. Reset framenumber and light list and calculate distance from camera. Called by Renderer, possibly from a worker thread, so must only modify the node itself.
     void OnPrepareRender(unsigned frameNumber, Camera* camera) override;
 
     /// Set geometry type, which is shared by all geometries.
@@ -19,6 +19,9 @@ static const float DEFAULT_FADE_START = 0.9f;
 static const int DEFAULT_DEPTH_BIAS = 5;
 static const float DEFAULT_SLOPE_SCALED_DEPTH_BIAS = 0.5f;
 
+/// Next light parameters version. Versions are unique among all lights, so that a new light allocated at the address of a destroyed one does not match its cached light passes.
+static unsigned nextVersion = 1;
+
 static const char* lightTypeNames[] =
 {
     "directional",
@@ -28,6 +31,8 @@ static const char* lightTypeNames[] =
 };
 
 Light::Light() :
+    _litGeometriesVersion(0),
+    _litGeometriesDirty(true),
     _lightType(DEFAULT_LIGHTTYPE),
     _color(DEFAULT_COLOR),
     _range(DEFAULT_RANGE),
@@ -38,7 +43,8 @@ Light::Light() :
     _shadowFadeStart(DEFAULT_FADE_START),
     _depthBias(DEFAULT_DEPTH_BIAS),
     _slopeScaledDepthBias(DEFAULT_SLOPE_SCALED_DEPTH_BIAS),
-    _shadowMap(nullptr)
+    _shadowMap(nullptr),
+    _version(nextVersion++)
 {
     SetFlag(NF_LIGHT, true);
 }
@@ -123,13 +129,14 @@ void Light::SetLightType(LightType::Type type)
     {
         _lightType = type;
         // Bounding box will change
-        OctreeNode::OnTransformChanged();
+        OnTransformChanged();
     }
 }
 
 void Light::SetColor(const Color& color)
 {
     _color = color;
+    _version = nextVersion++;
 }
 
 void Light::SetRange(float range)
@@ -139,7 +146,7 @@ void Light::SetRange(float range)
     {
         _range = range;
         // Bounding box will change
-        OctreeNode::OnTransformChanged();
+        OnTransformChanged();
     }
 }
 
@@ -150,13 +157,17 @@ void Light::SetFov(float fov)
     {
         _fov = fov;
         // Bounding box will change
-        OctreeNode::OnTransformChanged();
+        OnTransformChanged();
     }
 }
 
 void Light::SetLightMask(unsigned lightMask)
 {
-    _lightMask = lightMask;
+    if (lightMask != _lightMask)
+    {
+        _lightMask = lightMask;
+        _litGeometriesDirty = true;
+    }
 }
 
 void Light::SetShadowMapSize(int _size)
@@ -468,6 +479,12 @@ void Light::SetupShadowViews(Camera* mainCamera, Vector<AutoPtr<ShadowView> >& s
     useIndex += numViews;
 }
 
+void Light::OnTransformChanged()
+{
+    OctreeNode::OnTransformChanged();
+    _version = nextVersion++;
+}
+
 void Light::OnWorldBoundingBoxUpdate() const
 {
     switch (_lightType)
@@ -10,6 +10,7 @@
 namespace Auto3D
 {
 
+class GeometryNode;
 class Texture;
 struct ShadowView;
 
@@ -116,8 +117,19 @@ public:
     const Vector4F& GetShadowParameters() const { return _shadowParameters; }
     /// Return point light shadow extra parameters.
     const Vector4F& GetPointShadowParameters() const { return _pointShadowParameters; }
+    /// Return version of the parameters used for light pass constants. Changes when the type, color, range, fov or transform changes, and is unique among all lights.
+    unsigned GetVersion() const { return _version; }
+
+    /// Cached geometries inside the point or spot light volume, whether visible or not. Filled by Renderer.
+    Vector<GeometryNode*> _litGeometries;
+    /// Octree light interaction version at the time the lit geometries were cached. Filled by Renderer.
+    unsigned _litGeometriesVersion;
+    /// Cached lit geometries dirty flag. Set by Octree when the light or geometries near it change.
+    bool _litGeometriesDirty;
 
 protected:
+    /// Handle the transform matrix changing.
+    void OnTransformChanged() override;
     /// Recalculate the world space bounding box.
     virtual void OnWorldBoundingBoxUpdate() const override;
 
@@ -157,6 +169,8 @@ private:
     Vector4F _shadowParameters;
     /// Shadow mapping extra parameters for point lights.
     Vector4F _pointShadowParameters;
+    /// Light pass parameters version.
+    unsigned _version;
 };
 
 }
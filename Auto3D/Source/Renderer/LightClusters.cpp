@@ -0,0 +1,278 @@
+#include "../Debug/Profiler.h"
+#include "../Thread/WorkQueue.h"
+#include "Camera.h"
+#include "Light.h"
+#include "LightClusters.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+/// Minimum number of point and spot lights before assigning the depth slices in worker threads.
+static const size_t MIN_THREADED_CLUSTER_LIGHTS = 16;
+
+LightClusters::LightClusters() :
+    _depthSliceParameters(Vector2F::ZERO),
+    _nearClip(0.0f),
+    _farClip(0.0f),
+    _numLights(0),
+    _numDirLights(0),
+    _numLightIndices(0),
+    _numOverflowIndices(0)
+{
+    memset(_clusterGrid, 0, sizeof _clusterGrid);
+}
+
+void LightClusters::Build(Camera* camera, const Vector<Light*>& lights, WorkQueue* workQueue)
+{
+    PROFILE(BuildLightClusters);
+
+    _projection = camera->GetProjectionMatrix();
+    _nearClip = camera->GetNearClip();
+    _farClip = camera->GetFarClip();
+    // Exponential slices keep the clusters roughly cubical. Orthographic cameras use a single slice
+    if (!camera->IsOrthographic() && _nearClip > 0.0f && _farClip > _nearClip)
+        _depthSliceParameters = Vector2F((float)NUM_CLUSTERS_Z / logf(_farClip / _nearClip), (float)NUM_CLUSTERS_Z);
+    else
+        _depthSliceParameters = Vector2F::ZERO;
+
+    _numLights = 0;
+    _numDirLights = 0;
+    _lightBounds.Clear();
+
+    // Directional lights go first, as the shader loops through them for every cluster
+    for (auto it = lights.Begin(); it != lights.End() && _numLights < MAX_CLUSTER_LIGHTS; ++it)
+    {
+        Light* light = *it;
+        if (light->GetLightType() == LightType::DIRECTIONAL)
+        {
+            SetLightData(_numLights++, light);
+            ++_numDirLights;
+        }
+    }
+
+    const Matrix3x4F& viewMatrix = camera->GetViewMatrix();
+
+    for (auto it = lights.Begin(); it != lights.End() && _numLights < MAX_CLUSTER_LIGHTS; ++it)
+    {
+        Light* light = *it;
+        if (light->GetLightType() == LightType::DIRECTIONAL)
+            continue;
+
+        float range = light->GetRange();
+        Vector3F center = light->GetWorldPosition();
+        float radius = range;
+
+        if (light->GetLightType() == LightType::SPOT)
+        {
+            // Use the bounding sphere of the cone instead of the whole range
+            float halfAngle = light->GetFov() * 0.5f * M_DEGTORAD;
+            Vector3F direction = light->GetWorldDirection();
+            if (halfAngle > M_PI * 0.25f)
+            {
+                center += direction * (range * cosf(halfAngle));
+                radius = range * sinf(halfAngle);
+            }
+            else
+            {
+                radius = range / (2.0f * cosf(halfAngle));
+                center += direction * radius;
+            }
+        }
+
+        ClusterLightBounds bounds;
+        bounds._center = viewMatrix * center;
+        bounds._radius = radius;
+        float minZ = Max(bounds._center._z - radius, _nearClip);
+        float maxZ = Min(bounds._center._z + radius, _farClip);
+        if (minZ > maxZ)
+            continue;
+
+        bounds._firstSlice = DepthSlice(minZ);
+        bounds._lastSlice = DepthSlice(maxZ);
+        bounds._index = (unsigned char)_numLights;
+        _lightBounds.Push(bounds);
+        SetLightData(_numLights++, light);
+    }
+
+    if (workQueue && workQueue->NumThreads() && _lightBounds.Size() >= MIN_THREADED_CLUSTER_LIGHTS)
+    {
+        workQueue->ParallelFor(NUM_CLUSTERS_Z, 1, [this](size_t begin, size_t end, unsigned)
+        {
+            for (size_t i = begin; i < end; ++i)
+                BuildSlice(i);
+        });
+    }
+    else
+    {
+        for (size_t i = 0; i < NUM_CLUSTERS_Z; ++i)
+            BuildSlice(i);
+    }
+
+    // Concatenate the slices' light indices. The cluster offsets were relative to their slice; make them relative to the
+    // whole list and drop the indices that do not fit
+    _numLightIndices = 0;
+    _numOverflowIndices = 0;
+
+    for (size_t i = 0; i < NUM_CLUSTERS_Z; ++i)
+    {
+        const Vector<unsigned char>& sliceIndices = _sliceIndices[i];
+        unsigned* clusters = &_clusterGrid[i * CLUSTERS_PER_SLICE];
+        size_t base = _numLightIndices;
+
+        for (size_t j = 0; j < CLUSTERS_PER_SLICE; ++j)
+        {
+            size_t offset = base + (clusters[j] >> 8);
+            size_t count = clusters[j] & 0xff;
+            size_t room = offset < MAX_CLUSTER_LIGHT_INDICES ? MAX_CLUSTER_LIGHT_INDICES - offset : 0;
+            if (count > room)
+            {
+                _numOverflowIndices += count - room;
+                count = room;
+            }
+            clusters[j] = count ? (unsigned)((offset << 8) | count) : 0;
+        }
+
+        size_t numIndices = Min(sliceIndices.Size(), MAX_CLUSTER_LIGHT_INDICES - base);
+        if (numIndices)
+            memcpy(&_lightIndices[base], sliceIndices.Begin()._ptr, numIndices);
+        _numLightIndices += numIndices;
+    }
+
+    PROFILE_COUNTER(ClusterLightIndices, (long long)_numLightIndices);
+}
+
+unsigned LightClusters::DepthSlice(float depth) const
+{
+    if (_depthSliceParameters._x == 0.0f)
+        return 0;
+
+    // Same calculation as in the shader, which has the depth normalized by the far clip distance
+    float slice = logf(Max(depth / _farClip, M_EPSILON)) * _depthSliceParameters._x + _depthSliceParameters._y;
+    return (unsigned)Clamp(slice, 0.0f, (float)(NUM_CLUSTERS_Z - 1));
+}
+
+float LightClusters::SliceDepth(size_t slice) const
+{
+    if (_depthSliceParameters._x == 0.0f)
+        return slice ? _farClip : _nearClip;
+    else
+        return _nearClip * powf(_farClip / _nearClip, (float)slice / (float)NUM_CLUSTERS_Z);
+}
+
+void LightClusters::SetLightData(size_t index, Light* light)
+{
+    float invRange = 1.0f / Max(light->GetRange(), M_EPSILON);
+
+    _lightData._lightPositions[index] = Vector4F(light->GetWorldPosition(), 1.0f);
+    _lightData._lightDirections[index] = Vector4F(-light->GetWorldDirection(), 0.0f);
+    _lightData._lightColors[index] = light->GetColor();
+
+    if (light->GetLightType() == LightType::SPOT)
+    {
+        float cutoff = cosf(light->GetFov() * 0.5f * M_DEGTORAD);
+        _lightData._lightAttenuations[index] = Vector4F(invRange, cutoff, 1.0f / (1.0f - cutoff), 0.0f);
+    }
+    else
+    {
+        // Point lights share the spot light calculation in the shader with a cutoff that never attenuates
+        _lightData._lightAttenuations[index] = Vector4F(invRange, -2.0f, 1.0f, 0.0f);
+    }
+}
+
+void LightClusters::BuildSlice(size_t slice)
+{
+    unsigned* clusters = &_clusterGrid[slice * CLUSTERS_PER_SLICE];
+    Vector<ClusterLightRect>& sliceLights = _sliceLights[slice];
+    Vector<unsigned char>& sliceIndices = _sliceIndices[slice];
+    float sliceNear = SliceDepth(slice);
+    float sliceFar = SliceDepth(slice + 1);
+    unsigned offsets[CLUSTERS_PER_SLICE];
+
+    for (size_t i = 0; i < CLUSTERS_PER_SLICE; ++i)
+        offsets[i] = 0;
+    sliceLights.Clear();
+
+    // Find the lights in the slice and count them per cluster
+    for (auto it = _lightBounds.Begin(); it != _lightBounds.End(); ++it)
+    {
+        if (slice < it->_firstSlice || slice > it->_lastSlice)
+            continue;
+
+        // The slice range came from DepthSlice(), so do not reject lights that only touch the slice boundary due to
+        // floating point differences
+        ClusterLightRect rect;
+        float minZ = Max(it->_center._z - it->_radius, sliceNear);
+        float maxZ = Min(it->_center._z + it->_radius, sliceFar);
+        if (!CalculateRect(*it, Min(minZ, maxZ), Max(minZ, maxZ), rect))
+            continue;
+
+        for (size_t y = rect._minY; y <= rect._maxY; ++y)
+        {
+            for (size_t x = rect._minX; x <= rect._maxX; ++x)
+                ++offsets[y * NUM_CLUSTERS_X + x];
+        }
+        sliceLights.Push(rect);
+    }
+
+    // Convert the counts to offsets, then write the indices
+    unsigned numIndices = 0;
+    for (size_t i = 0; i < CLUSTERS_PER_SLICE; ++i)
+    {
+        unsigned count = offsets[i];
+        clusters[i] = (numIndices << 8) | count;
+        offsets[i] = numIndices;
+        numIndices += count;
+    }
+
+    sliceIndices.Resize(numIndices);
+    for (auto it = sliceLights.Begin(); it != sliceLights.End(); ++it)
+    {
+        for (size_t y = it->_minY; y <= it->_maxY; ++y)
+        {
+            for (size_t x = it->_minX; x <= it->_maxX; ++x)
+                sliceIndices[offsets[y * NUM_CLUSTERS_X + x]++] = it->_index;
+        }
+    }
+}
+
+bool LightClusters::CalculateRect(const ClusterLightBounds& bounds, float minZ, float maxZ, ClusterLightRect& rect) const
+{
+    const Vector3F& center = bounds._center;
+    float radius = bounds._radius;
+    Vector2F minNdc(M_INFINITY, M_INFINITY);
+    Vector2F maxNdc(-M_INFINITY, -M_INFINITY);
+    float depths[2] = { minZ, maxZ };
+
+    // The projected X coordinate depends only on view space X and Z, and Y only on Y and Z, so the extremes of the box
+    // between the two depths are found at its corners
+    for (size_t i = 0; i < 2; ++i)
+    {
+        float z = depths[i];
+        float invW = 1.0f / Max(_projection._m32 * z + _projection._m33, M_EPSILON);
+        float x1 = (_projection._m00 * (center._x - radius) + _projection._m02 * z + _projection._m03) * invW;
+        float x2 = (_projection._m00 * (center._x + radius) + _projection._m02 * z + _projection._m03) * invW;
+        float y1 = (_projection._m11 * (center._y - radius) + _projection._m12 * z + _projection._m13) * invW;
+        float y2 = (_projection._m11 * (center._y + radius) + _projection._m12 * z + _projection._m13) * invW;
+        minNdc._x = Min(minNdc._x, Min(x1, x2));
+        maxNdc._x = Max(maxNdc._x, Max(x1, x2));
+        minNdc._y = Min(minNdc._y, Min(y1, y2));
+        maxNdc._y = Max(maxNdc._y, Max(y1, y2));
+    }
+
+    if (maxNdc._x < -1.0f || minNdc._x > 1.0f || maxNdc._y < -1.0f || minNdc._y > 1.0f)
+        return false;
+
+    rect._index = bounds._index;
+    rect._minX = (unsigned char)Clamp((minNdc._x * 0.5f + 0.5f) * NUM_CLUSTERS_X, 0.0f, (float)(NUM_CLUSTERS_X - 1));
+    rect._maxX = (unsigned char)Clamp((maxNdc._x * 0.5f + 0.5f) * NUM_CLUSTERS_X, 0.0f, (float)(NUM_CLUSTERS_X - 1));
+    rect._minY = (unsigned char)Clamp((minNdc._y * 0.5f + 0.5f) * NUM_CLUSTERS_Y, 0.0f, (float)(NUM_CLUSTERS_Y - 1));
+    rect._maxY = (unsigned char)Clamp((maxNdc._y * 0.5f + 0.5f) * NUM_CLUSTERS_Y, 0.0f, (float)(NUM_CLUSTERS_Y - 1));
+    return true;
+}
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "../Base/Vector.h"
+#include "../Math/Color.h"
+#include "../Math/Matrix4x4.h"
+#include "../Math/Vector2.h"
+#include "../Math/Vector3.h"
+#include "../Math/Vector4.h"
+
+namespace Auto3D
+{
+
+class Camera;
+class Light;
+class WorkQueue;
+
+/// Number of light cluster columns.
+static const size_t NUM_CLUSTERS_X = 16;
+/// Number of light cluster rows.
+static const size_t NUM_CLUSTERS_Y = 8;
+/// Number of light cluster depth slices.
+static const size_t NUM_CLUSTERS_Z = 16;
+/// Number of light clusters in one depth slice.
+static const size_t CLUSTERS_PER_SLICE = NUM_CLUSTERS_X * NUM_CLUSTERS_Y;
+/// Total number of light clusters.
+static const size_t NUM_CLUSTERS = CLUSTERS_PER_SLICE * NUM_CLUSTERS_Z;
+/// Maximum number of lights in clustered lighting. Light indices are stored as bytes and the light data must fit in a 16KB constant buffer.
+static const size_t MAX_CLUSTER_LIGHTS = 255;
+/// Maximum total number of light indices in the clusters, stored as bytes in a 16KB constant buffer.
+static const size_t MAX_CLUSTER_LIGHT_INDICES = 16384;
+
+/// Light constant data for clustered lighting, in the same layout as the shader constant buffer.
+struct AUTO_API ClusterLightData
+{
+    /// Light positions.
+    Vector4F _lightPositions[MAX_CLUSTER_LIGHTS];
+    /// Light directions.
+    Vector4F _lightDirections[MAX_CLUSTER_LIGHTS];
+    /// Light attenuation parameters.
+    Vector4F _lightAttenuations[MAX_CLUSTER_LIGHTS];
+    /// Light colors.
+    Color _lightColors[MAX_CLUSTER_LIGHTS];
+};
+
+/// View space bounding sphere and depth slice range of a point or spot light.
+struct AUTO_API ClusterLightBounds
+{
+    /// View space center.
+    Vector3F _center;
+    /// Radius.
+    float _radius;
+    /// First depth slice.
+    unsigned _firstSlice;
+    /// Last depth slice.
+    unsigned _lastSlice;
+    /// Light index.
+    unsigned char _index;
+};
+
+/// Cluster columns and rows covered by a light within one depth slice.
+struct AUTO_API ClusterLightRect
+{
+    /// Light index.
+    unsigned char _index;
+    /// First column.
+    unsigned char _minX;
+    /// First row.
+    unsigned char _minY;
+    /// Last column.
+    unsigned char _maxX;
+    /// Last row.
+    unsigned char _maxY;
+};
+
+/// Assigns the visible lights to a 3D grid of view space clusters for clustered forward lighting. Columns and rows divide the viewport evenly, with row 0 at the bottom, and depth slices are distributed exponentially between the near and far clip distances. Does not need the Graphics subsystem.
+class AUTO_API LightClusters
+{
+public:
+    /// Construct.
+    LightClusters();
+
+    /// Assign lights to clusters from a camera's point of view. Directional lights are stored first and affect all clusters. Lights beyond MAX_CLUSTER_LIGHTS are ignored, so the lights should be sorted by importance. Depth slices are processed in worker threads if a work queue is given.
+    void Build(Camera* camera, const Vector<Light*>& lights, WorkQueue* workQueue = nullptr);
+
+    /// Return light constant data.
+    const ClusterLightData& LightData() const { return _lightData; }
+    /// Return the cluster grid, ordered by depth slice, row and column. Each cluster has the offset to the light index list in the high 24 bits and the light count in the low 8 bits.
+    const unsigned* ClusterGrid() const { return _clusterGrid; }
+    /// Return the light index list.
+    const unsigned char* LightIndices() const { return _lightIndices; }
+    /// Return the offset of a cluster's lights in the light index list.
+    size_t ClusterLightOffset(size_t cluster) const { return _clusterGrid[cluster] >> 8; }
+    /// Return the number of lights in a cluster.
+    size_t ClusterLightCount(size_t cluster) const { return _clusterGrid[cluster] & 0xff; }
+    /// Return number of lights, including directional lights.
+    size_t NumLights() const { return _numLights; }
+    /// Return number of directional lights.
+    size_t NumDirLights() const { return _numDirLights; }
+    /// Return number of used light indices.
+    size_t NumLightIndices() const { return _numLightIndices; }
+    /// Return number of light indices that did not fit in the light index list.
+    size_t NumOverflowIndices() const { return _numOverflowIndices; }
+    /// Return the shader parameters for calculating the depth slice from depth normalized by the far clip distance: log(depth) * x + y. Zero for orthographic cameras, which use a single slice.
+    const Vector2F& DepthSliceParameters() const { return _depthSliceParameters; }
+    /// Return the depth slice for a view space depth.
+    unsigned DepthSlice(float depth) const;
+    /// Return the view space depth where a depth slice begins.
+    float SliceDepth(size_t slice) const;
+
+    /// Return a cluster index from column, row and depth slice.
+    static size_t ClusterIndex(size_t x, size_t y, size_t z) { return (z * NUM_CLUSTERS_Y + y) * NUM_CLUSTERS_X + x; }
+
+private:
+    /// Write a light's constant data.
+    void SetLightData(size_t index, Light* light);
+    /// Assign lights to the clusters of one depth slice. Called also from worker threads.
+    void BuildSlice(size_t slice);
+    /// Calculate the cluster columns and rows covered by a light within a depth range. Return false if outside the view.
+    bool CalculateRect(const ClusterLightBounds& bounds, float minZ, float maxZ, ClusterLightRect& rect) const;
+
+    /// Light constant data.
+    ClusterLightData _lightData;
+    /// Cluster grid.
+    unsigned _clusterGrid[NUM_CLUSTERS];
+    /// Light index list.
+    unsigned char _lightIndices[MAX_CLUSTER_LIGHT_INDICES];
+    /// Point and spot light bounds.
+    Vector<ClusterLightBounds> _lightBounds;
+    /// Lights covering each depth slice.
+    Vector<ClusterLightRect> _sliceLights[NUM_CLUSTERS_Z];
+    /// Light indices of each depth slice before concatenation.
+    Vector<unsigned char> _sliceIndices[NUM_CLUSTERS_Z];
+    /// Camera projection matrix.
+    Matrix4x4F _projection;
+    /// Depth slice shader parameters.
+    Vector2F _depthSliceParameters;
+    /// Camera near clip distance.
+    float _nearClip;
+    /// Camera far clip distance.
+    float _farClip;
+    /// Number of lights.
+    size_t _numLights;
+    /// Number of directional lights.
+    size_t _numDirLights;
+    /// Number of used light indices.
+    size_t _numLightIndices;
+    /// Number of light indices that did not fit.
+    size_t _numOverflowIndices;
+};
+
+}
@@ -1,10 +1,13 @@
+#include "../Base/IdAllocator.h"
 #include "../Debug/Profiler.h"
 #include "../Graphics/ConstantBuffer.h"
 #include "../Graphics/ShaderVariation.h"
 #include "../Graphics/Shader.h"
 #include "../Graphics/Texture.h"
+#include "../IO/JSONDocument.h"
 #include "../Resource/JSONFile.h"
 #include "../Resource/ResourceCache.h"
+#include "../Thread/Thread.h"
 #include "Material.h"
 
 #include "../Debug/DebugNew.h"
@@ -12,6 +15,58 @@
 namespace Auto3D
 {
 
+/// Sort and shader IDs shared by all materials.
+struct MaterialIds
+{
+    /// Material sort IDs.
+    IdAllocator _materialIds;
+    /// Shader IDs.
+    IdAllocator _shaderIds;
+    /// Mutex for the shader IDs.
+    Mutex _shaderIdMutex;
+    /// Shader ID and use count by shader hash.
+    HashMap<unsigned, Pair<unsigned, unsigned> > _shaderIdMap;
+};
+
+/// Return the material IDs. Allocated on first use and never destroyed, so that materials destroyed during static destruction can still free their IDs.
+static MaterialIds& GetMaterialIds()
+{
+    static MaterialIds* ids = new MaterialIds();
+    return *ids;
+}
+
+/// Return the shared ID of a shader hash and increment its use count.
+static unsigned AcquireShaderId(unsigned shaderHash)
+{
+    MaterialIds& ids = GetMaterialIds();
+    MutexLock lock(ids._shaderIdMutex);
+
+    auto it = ids._shaderIdMap.Find(shaderHash);
+    if (it != ids._shaderIdMap.End())
+    {
+        ++it->_second._second;
+        return it->_second._first;
+    }
+
+    unsigned id = ids._shaderIds.Allocate();
+    ids._shaderIdMap[shaderHash] = MakePair(id, 1u);
+    return id;
+}
+
+/// Decrement the use count of a shader hash and free its ID when no longer used.
+static void ReleaseShaderId(unsigned shaderHash)
+{
+    MaterialIds& ids = GetMaterialIds();
+    MutexLock lock(ids._shaderIdMutex);
+
+    auto it = ids._shaderIdMap.Find(shaderHash);
+    if (it != ids._shaderIdMap.End() && --it->_second._second == 0)
+    {
+        ids._shaderIds.Free(it->_second._first);
+        ids._shaderIdMap.Erase(it);
+    }
+}
+
 SharedPtr<Material> Material::_defaultMaterial;
 HashMap<String, unsigned char> Material::_passIndices;
 Vector<String> Material::_passNames;
@@ -21,6 +76,7 @@ Pass::Pass(Material* parent_, const String& name_) :
     _parent(parent_),
     _name(name_),
     _shaderHash(0),
+    _shaderId(0),
     _shadersLoaded(false)
 {
     Reset();
@@ -28,6 +84,8 @@ Pass::Pass(Material* parent_, const String& name_) :
 
 Pass::~Pass()
 {
+    if (_shaderId)
+        ReleaseShaderId(_shaderHash);
 }
 
 bool Pass::LoadJSON(const JSONValue& source)
@@ -180,16 +238,27 @@ void Pass::OnShadersChanged()
             _combinedShaderDefines[i] = _shaderDefines[i].Trimmed();
     }
 
-    _shaderHash = StringHash(_shaderNames[ShaderStage::VS] + _shaderNames[ShaderStage::PS] + _combinedShaderDefines[ShaderStage::VS] +
+    unsigned newShaderHash = StringHash(_shaderNames[ShaderStage::VS] + _shaderNames[ShaderStage::PS] + _combinedShaderDefines[ShaderStage::VS] +
         _combinedShaderDefines[ShaderStage::PS]).Value();
+    if (!_shaderId || newShaderHash != _shaderHash)
+    {
+        // Acquire first so that an unchanged ID is not freed and reallocated
+        unsigned newShaderId = AcquireShaderId(newShaderHash);
+        if (_shaderId)
+            ReleaseShaderId(_shaderHash);
+        _shaderHash = newShaderHash;
+        _shaderId = newShaderId;
+    }
 }
 
-Material::Material()
+Material::Material() :
+    _sortId(GetMaterialIds()._materialIds.Allocate())
 {
 }
 
 Material::~Material()
 {
+    GetMaterialIds()._materialIds.Free(_sortId);
 }
 
 void Material::RegisterObject()
@@ -201,11 +270,11 @@ bool Material::BeginLoad(Stream& source)
 {
     PROFILE(BeginLoadMaterial);
 
-    _loadJSON = new JSONFile();
+    _loadJSON = new JSONDocument();
     if (!_loadJSON->Load(source))
         return false;
 
-    const JSONValue& root = _loadJSON->Root();
+    const JSONNode& root = _loadJSON->Root();
 
     _shaderDefines[ShaderStage::VS].Clear();
     _shaderDefines[ShaderStage::PS].Clear();
@@ -214,6 +283,24 @@ bool Material::BeginLoad(Stream& source)
     if (root.Contains("psDefines"))
         _shaderDefines[ShaderStage::PS] = root["psDefines"].GetString();
 
+    // When loading in the background, queue the textures so that they load in parallel and are ready before EndLoad()
+    if (!Thread::IsMainThread())
+    {
+        ResourceCache* cache = Subsystem<ResourceCache>();
+        const JSONNode& jsonTextures = root["textures"];
+        if (jsonTextures.IsObject())
+        {
+            for (size_t i = 0; i < jsonTextures.Size(); ++i)
+                cache->BackgroundLoadResource<Texture>(jsonTextures.Member(i)._value.GetString(), false, this);
+        }
+        const JSONNode& jsonTexturesMap = root["texturesMap"];
+        if (jsonTexturesMap.IsObject())
+        {
+            for (size_t i = 0; i < jsonTexturesMap.Size(); ++i)
+                cache->BackgroundLoadResource<Image>(jsonTexturesMap.Member(i)._value.GetString(), false, this);
+        }
+    }
+
     return true;
 }
 
@@ -221,16 +308,18 @@ bool Material::EndLoad()
 {
     PROFILE(EndLoadMaterial);
 
-    const JSONValue& root = _loadJSON->Root();
+    const JSONNode& root = _loadJSON->Root();
 
+    // Passes and constant buffers are small, so convert them to JSON values for their loaders
     _passes.Clear();
-    if (root.Contains("passes"))
+    const JSONNode& jsonPasses = root["passes"];
+    if (jsonPasses.IsObject())
     {
-        const JSONObject& jsonPasses = root["passes"].GetObject();
-        for (auto it = jsonPasses.Begin(); it != jsonPasses.End(); ++it)
+        for (size_t i = 0; i < jsonPasses.Size(); ++i)
         {
-            Pass* newPass = CreatePass(it->_first);
-            newPass->LoadJSON(it->_second);
+            const JSONMember& jsonPass = jsonPasses.Member(i);
+            Pass* newPass = CreatePass(jsonPass._key);
+            newPass->LoadJSON(jsonPass._value.ToValue());
         }
     }
 
@@ -238,34 +327,37 @@ bool Material::EndLoad()
     if (root.Contains("vsConstantBuffer"))
     {
         _constantBuffers[ShaderStage::VS] = new ConstantBuffer();
-        _constantBuffers[ShaderStage::VS]->LoadJSON(root["vsConstantBuffer"].GetObject());
+        _constantBuffers[ShaderStage::VS]->LoadJSON(root["vsConstantBuffer"].ToValue());
     }
 
     _constantBuffers[ShaderStage::PS].Reset();
     if (root.Contains("psConstantBuffer"))
     {
         _constantBuffers[ShaderStage::PS] = new ConstantBuffer();
-        _constantBuffers[ShaderStage::PS]->LoadJSON(root["psConstantBuffer"].GetObject());
+        _constantBuffers[ShaderStage::PS]->LoadJSON(root["psConstantBuffer"].ToValue());
     }
-    
-    /// \todo Queue texture loads during BeginLoad()
+
+    // Textures queued in BeginLoad() have already been finished, so these only return the loaded resources
     ResetTextures();
-    if (root.Contains("textures"))
+    if (root["textures"].IsObject())
     {
         ResourceCache* cache = Subsystem<ResourceCache>();
-        const JSONObject& jsonTextures = root["textures"].GetObject();
-        for (auto it = jsonTextures.Begin(); it != jsonTextures.End(); ++it)
-            SetTexture(it->_first.ToInt(), cache->LoadResource<Texture>(it->_second.GetString()));
+        const JSONNode& jsonTextures = root["textures"];
+        for (size_t i = 0; i < jsonTextures.Size(); ++i)
+        {
+            const JSONMember& jsonTexture = jsonTextures.Member(i);
+            SetTexture(String::ToInt(jsonTexture._key), cache->LoadResource<Texture>(jsonTexture._value.GetString()));
+        }
     }
-	if (root.Contains("texturesMap"))
+	if (root["texturesMap"].IsObject())
 	{
 		ResourceCache* cache = Subsystem<ResourceCache>();
-		const JSONObject& jsonTextures = root["texturesMap"].GetObject();
+		const JSONNode& jsonTextures = root["texturesMap"];
 		Vector<Image*> imageData;
 		Vector<ImageLevel> faces;
 
-		for (auto it = jsonTextures.Begin(); it != jsonTextures.End(); ++it)
-			imageData.Push(cache->LoadResource<Image>(it->_second.GetString()));
+		for (size_t i = 0; i < jsonTextures.Size(); ++i)
+			imageData.Push(cache->LoadResource<Image>(jsonTextures.Member(i)._value.GetString()));
 
 		
 		for (int i = 0; i < MAX_CUBE_FACES; ++i)
@@ -277,7 +369,7 @@ bool Material::EndLoad()
 		textureCube->Define(TextureType::TEX_CUBE, ResourceUsage::DEFAULT, imageData[0]->GetLevel(0)._size, imageData[0]->GetFormat(), 1, &faces[0]);
 		textureCube->DefineSampler(TextureFilterMode::COMPARE_TRILINEAR, TextureAddressMode::CLAMP, TextureAddressMode::CLAMP, TextureAddressMode::CLAMP);
 		textureCube->SetDataLost(false);
-		SetTexture(jsonTextures.Begin()->_first.ToInt(), textureCube);
+		SetTexture(String::ToInt(jsonTextures.Member(0)._key), textureCube);
 		
 	}
     _loadJSON.Reset();
@@ -8,7 +8,7 @@ namespace Auto3D
 {
 
 class ConstantBuffer;
-class JSONFile;
+class JSONDocument;
 class JSONValue;
 class Material;
 class Shader;
@@ -47,6 +47,8 @@ public:
     const String& GetCombinedShaderDefines(ShaderStage::Type stage) const { return _combinedShaderDefines[stage]; }
     /// Return shader hash value for state sorting.
     unsigned GetShaderHash() const { return _shaderHash; }
+    /// Return shader ID for state sorting. Passes with the same shaders and defines share the ID.
+    unsigned GetShaderId() const { return _shaderId; }
 
     /// Refresh the combined shader defines and shader hash and clear any cached shader variations. Called internally.
     void OnShadersChanged();
@@ -70,7 +72,7 @@ public:
     /// Shader resources. Filled by Renderer.
     SharedPtr<Shader> _shaders[ShaderStage::Count];
     /// Cached shader variations. Filled by Renderer.
-    HashMap<unsigned short, WeakPtr<ShaderVariation> > _shaderVariations[ShaderStage::Count];
+    HashMap<unsigned, WeakPtr<ShaderVariation> > _shaderVariations[ShaderStage::Count];
     /// Shader load attempted flag. Filled by Renderer.
     bool _shadersLoaded;
 
@@ -87,6 +89,8 @@ private:
     String _combinedShaderDefines[ShaderStage::Count];
     /// Shader hash calculated from names and defines.
     unsigned _shaderHash;
+    /// Shader ID for state sorting.
+    unsigned _shaderId;
 };
 
 /// %Material resource, which describes how to render 3D geometry and refers to textures. A material can contain several passes (for example normal rendering, and depth only.)
@@ -133,6 +137,8 @@ public:
     ConstantBuffer* GetConstantBuffer(ShaderStage::Type stage) const;
     /// Return shader defines by stage.
     const String& ShaderDefines(ShaderStage::Type stage) const;
+    /// Return ID for state sorting.
+    unsigned GetSortId() const { return _sortId; }
 
     /// Return pass index from name. By default reserve a new index if the name was not known.
     static unsigned char PassIndex(const String& name, bool createNew = true);
@@ -152,7 +158,9 @@ protected:
     /// Global shader defines.
     String _shaderDefines[ShaderStage::Count];
     /// JSON data used for loading.
-    AutoPtr<JSONFile> _loadJSON;
+    AutoPtr<JSONDocument> _loadJSON;
+    /// ID for state sorting.
+    unsigned _sortId;
 
     /// Default material.
     static SharedPtr<Material> _defaultMaterial;
@@ -6,6 +6,7 @@
 #include "GeometryNode.h"
 #include "Material.h"
 #include "Model.h"
+#include "ModelFormat.h"
 
 #include "../Debug/DebugNew.h"
 
@@ -28,7 +29,29 @@ Bone::~Bone()
 {
 }
 
-Model::Model()
+/// Return an offset rounded up to the binary model data alignment.
+static size_t AlignModelOffset(size_t offset)
+{
+    return (offset + MODEL_DATA_ALIGNMENT - 1) & ~(MODEL_DATA_ALIGNMENT - 1);
+}
+
+/// Write zero padding up to the binary model data alignment.
+static void WriteModelPadding(Stream& dest)
+{
+    static const unsigned char padding[MODEL_DATA_ALIGNMENT] = { 0 };
+    size_t misalignment = dest.Position() % MODEL_DATA_ALIGNMENT;
+    if (misalignment)
+        dest.Write(padding, MODEL_DATA_ALIGNMENT - misalignment);
+}
+
+/// Return whether a table of count elements at offset fits in the data.
+static bool IsInsideModelData(size_t offset, size_t count, size_t elementSize, size_t dataSize)
+{
+    return offset <= dataSize && count <= (dataSize - offset) / elementSize;
+}
+
+Model::Model() :
+    _rootBoneIndex(0)
 {
 }
 
@@ -43,16 +66,28 @@ void Model::RegisterObject()
 
 bool Model::BeginLoad(Stream& source)
 {
-    /// \todo Develop own format for Auto3D
-    if (source.ReadFileID() != "UMDL")
+    String fileID = source.ReadFileID();
+
+    _vbDescs.Clear();
+    _ibDescs.Clear();
+    _geomDescs.Clear();
+    _loadData.Reset();
+
+    if (fileID == MODEL_FILE_ID)
+        return LoadBinary(source);
+    else if (fileID == "UMDL")
+        return LoadLegacy(source);
+    else
     {
         ErrorString(source.Name() + " is not a valid model file");
         return false;
     }
+}
 
-    _vbDescs.Clear();
-    _ibDescs.Clear();
-    _geomDescs.Clear();
+bool Model::LoadLegacy(Stream& source)
+{
+    // Count the vertex and index data, which are kept in shadow buffers after upload
+    size_t memoryUse = 0;
 
     size_t numVertexBuffers = source.Read<unsigned>();
     _vbDescs.Resize(numVertexBuffers);
@@ -117,8 +152,16 @@ bool Model::BeginLoad(Stream& source)
             vertexSize += 4;
         }
 
-        vbDesc._vertexData = new unsigned char[vbDesc._numVertices * vertexSize];
-        source.Read(&vbDesc._vertexData[0], vbDesc._numVertices * vertexSize);
+        // Use the data in place if the stream supports it, as the stream stays alive until EndLoad()
+        size_t vertexDataSize = vbDesc._numVertices * vertexSize;
+        memoryUse += vertexDataSize;
+        vbDesc._vertexDataView = (const unsigned char*)source.ReadView(vertexDataSize);
+        if (!vbDesc._vertexDataView)
+        {
+            vbDesc._vertexData = new unsigned char[vertexDataSize];
+            source.Read(&vbDesc._vertexData[0], vertexDataSize);
+            vbDesc._vertexDataView = vbDesc._vertexData.Get();
+        }
     }
 
     size_t numIndexBuffers = source.Read<unsigned>();
@@ -129,22 +172,34 @@ bool Model::BeginLoad(Stream& source)
     
         ibDesc._numIndices = source.Read<unsigned>();
         ibDesc._indexSize = source.Read<unsigned>();
-        ibDesc._indexData = new unsigned char[ibDesc._numIndices * ibDesc._indexSize];
-        source.Read(&ibDesc._indexData[0], ibDesc._numIndices * ibDesc._indexSize);
+        size_t indexDataSize = ibDesc._numIndices * ibDesc._indexSize;
+        memoryUse += indexDataSize;
+        ibDesc._indexDataView = (const unsigned char*)source.ReadView(indexDataSize);
+        if (!ibDesc._indexDataView)
+        {
+            ibDesc._indexData = new unsigned char[indexDataSize];
+            source.Read(&ibDesc._indexData[0], indexDataSize);
+            ibDesc._indexDataView = ibDesc._indexData.Get();
+        }
     }
 
+    SetMemoryUse((unsigned)memoryUse);
+
     size_t numGeometries = source.Read<unsigned>();
 
     _geomDescs.Resize(numGeometries);
     _boneMappings.Resize(numGeometries);
+    Vector<unsigned> boneMappings;
     for (size_t i = 0; i < numGeometries; ++i)
     {
-        // Read bone mappings
+        // Read bone mappings as a batch
         size_t boneMappingCount = source.Read<unsigned>();
+        boneMappings.Resize(boneMappingCount);
+        if (boneMappingCount)
+            source.Read(&boneMappings[0], boneMappingCount * sizeof(unsigned));
         _boneMappings[i].Resize(boneMappingCount);
-        /// \todo Should read as a batch
         for (size_t j = 0; j < boneMappingCount; ++j)
-            _boneMappings[i][j] = source.Read<unsigned>();
+            _boneMappings[i][j] = boneMappings[j];
 
         size_t numLodLevels = source.Read<unsigned>();
         _geomDescs[i].Resize(numLodLevels);
@@ -200,6 +255,217 @@ bool Model::BeginLoad(Stream& source)
     return true;
 }
 
+bool Model::LoadBinary(Stream& source)
+{
+    // Get the whole file with one view or read, so that the buffer data can be used in place
+    size_t dataSize = source.Size();
+    if (dataSize < sizeof(ModelFileHeader))
+    {
+        ErrorString(source.Name() + " is truncated");
+        return false;
+    }
+
+    source.Seek(0);
+    const unsigned char* data = (const unsigned char*)source.ReadView(dataSize);
+    if (!data)
+    {
+        _loadData = new unsigned char[dataSize];
+        if (source.Read(_loadData.Get(), dataSize) != dataSize)
+        {
+            ErrorString("Failed to read " + source.Name());
+            return false;
+        }
+        data = _loadData.Get();
+    }
+
+    const ModelFileHeader& header = *reinterpret_cast<const ModelFileHeader*>(data);
+    if (header._version != MODEL_FILE_VERSION)
+    {
+        ErrorStringF("%s has unsupported model format version %u", source.Name().CString(), header._version);
+        return false;
+    }
+
+    if (!IsInsideModelData(header._vertexBuffersOffset, header._numVertexBuffers, sizeof(ModelVertexBufferEntry), dataSize) ||
+        !IsInsideModelData(header._vertexElementsOffset, header._numVertexElements, sizeof(ModelVertexElementEntry), dataSize) ||
+        !IsInsideModelData(header._indexBuffersOffset, header._numIndexBuffers, sizeof(ModelIndexBufferEntry), dataSize) ||
+        !IsInsideModelData(header._geometriesOffset, header._numGeometries, sizeof(ModelGeometryEntry), dataSize) ||
+        !IsInsideModelData(header._lodLevelsOffset, header._numLodLevels, sizeof(ModelLodLevelEntry), dataSize) ||
+        !IsInsideModelData(header._boneMappingsOffset, header._numBoneMappings, sizeof(unsigned), dataSize) ||
+        !IsInsideModelData(header._bonesOffset, header._numBones, sizeof(ModelBoneEntry), dataSize) ||
+        !IsInsideModelData(header._namesOffset, header._namesSize, 1, dataSize))
+    {
+        ErrorString(source.Name() + " has out of range model tables");
+        return false;
+    }
+
+    const ModelVertexBufferEntry* vbEntries = reinterpret_cast<const ModelVertexBufferEntry*>(data + header._vertexBuffersOffset);
+    const ModelVertexElementEntry* elementEntries = reinterpret_cast<const ModelVertexElementEntry*>(data + header._vertexElementsOffset);
+    const ModelIndexBufferEntry* ibEntries = reinterpret_cast<const ModelIndexBufferEntry*>(data + header._indexBuffersOffset);
+    const ModelGeometryEntry* geomEntries = reinterpret_cast<const ModelGeometryEntry*>(data + header._geometriesOffset);
+    const ModelLodLevelEntry* lodEntries = reinterpret_cast<const ModelLodLevelEntry*>(data + header._lodLevelsOffset);
+    const unsigned* boneMappings = reinterpret_cast<const unsigned*>(data + header._boneMappingsOffset);
+    const ModelBoneEntry* boneEntries = reinterpret_cast<const ModelBoneEntry*>(data + header._bonesOffset);
+    const char* names = reinterpret_cast<const char*>(data + header._namesOffset);
+
+    size_t memoryUse = 0;
+
+    _vbDescs.Resize(header._numVertexBuffers);
+    for (size_t i = 0; i < header._numVertexBuffers; ++i)
+    {
+        const ModelVertexBufferEntry& entry = vbEntries[i];
+        VertexBufferDesc& vbDesc = _vbDescs[i];
+
+        if (entry._firstElement > header._numVertexElements || entry._numElements > header._numVertexElements - entry._firstElement)
+        {
+            ErrorString(source.Name() + " has out of range vertex elements");
+            return false;
+        }
+
+        size_t vertexSize = 0;
+        vbDesc._vertexElements.Resize(entry._numElements);
+        for (size_t j = 0; j < entry._numElements; ++j)
+        {
+            const ModelVertexElementEntry& elementEntry = elementEntries[entry._firstElement + j];
+            if (elementEntry._type >= ElementType::Count || elementEntry._semantic >= ElementSemantic::Count)
+            {
+                ErrorString(source.Name() + " has an invalid vertex element");
+                return false;
+            }
+
+            vbDesc._vertexElements[j] = VertexElement((ElementType::Type)elementEntry._type,
+                (ElementSemantic::Type)elementEntry._semantic, elementEntry._index);
+            vertexSize += elementSizes[elementEntry._type];
+        }
+
+        if (vertexSize != entry._vertexSize || (size_t)entry._numVertices * vertexSize != entry._dataSize ||
+            !IsInsideModelData(entry._dataOffset, entry._dataSize, 1, dataSize))
+        {
+            ErrorString(source.Name() + " has invalid vertex buffer data");
+            return false;
+        }
+
+        vbDesc._numVertices = entry._numVertices;
+        vbDesc._vertexDataView = data + entry._dataOffset;
+        memoryUse += entry._dataSize;
+    }
+
+    _ibDescs.Resize(header._numIndexBuffers);
+    for (size_t i = 0; i < header._numIndexBuffers; ++i)
+    {
+        const ModelIndexBufferEntry& entry = ibEntries[i];
+        IndexBufferDesc& ibDesc = _ibDescs[i];
+
+        if ((entry._indexSize != sizeof(unsigned short) && entry._indexSize != sizeof(unsigned)) ||
+            (size_t)entry._numIndices * entry._indexSize != entry._dataSize ||
+            !IsInsideModelData(entry._dataOffset, entry._dataSize, 1, dataSize))
+        {
+            ErrorString(source.Name() + " has invalid index buffer data");
+            return false;
+        }
+
+        ibDesc._numIndices = entry._numIndices;
+        ibDesc._indexSize = entry._indexSize;
+        ibDesc._indexDataView = data + entry._dataOffset;
+        memoryUse += entry._dataSize;
+    }
+
+    SetMemoryUse((unsigned)memoryUse);
+
+    _geomDescs.Resize(header._numGeometries);
+    _boneMappings.Resize(header._numGeometries);
+    for (size_t i = 0; i < header._numGeometries; ++i)
+    {
+        const ModelGeometryEntry& entry = geomEntries[i];
+        if (entry._firstLodLevel > header._numLodLevels || entry._numLodLevels > header._numLodLevels - entry._firstLodLevel ||
+            entry._firstBoneMapping > header._numBoneMappings || entry._numBoneMappings > header._numBoneMappings - entry._firstBoneMapping)
+        {
+            ErrorString(source.Name() + " has out of range geometry data");
+            return false;
+        }
+
+        const unsigned* geomBoneMappings = boneMappings + entry._firstBoneMapping;
+        _boneMappings[i].Resize(entry._numBoneMappings);
+        for (size_t j = 0; j < entry._numBoneMappings; ++j)
+            _boneMappings[i][j] = geomBoneMappings[j];
+
+        _geomDescs[i].Resize(entry._numLodLevels);
+        for (size_t j = 0; j < entry._numLodLevels; ++j)
+        {
+            const ModelLodLevelEntry& lodEntry = lodEntries[entry._firstLodLevel + j];
+            GeometryDesc& geomDesc = _geomDescs[i][j];
+
+            if (lodEntry._primitiveType < PrimitiveType::POINT_LIST || lodEntry._primitiveType >= PrimitiveType::Count)
+            {
+                ErrorString(source.Name() + " has an invalid primitive type");
+                return false;
+            }
+
+            // The draw range must be within the index buffer, or the vertex buffer if not indexed
+            bool indexed = lodEntry._ibRef != M_MAX_UNSIGNED;
+            if (lodEntry._vbRef >= header._numVertexBuffers || (indexed && lodEntry._ibRef >= header._numIndexBuffers))
+            {
+                ErrorString(source.Name() + " has an out of range buffer reference");
+                return false;
+            }
+
+            unsigned long long drawEnd = (unsigned long long)lodEntry._drawStart + lodEntry._drawCount;
+            if (drawEnd > (indexed ? ibEntries[lodEntry._ibRef]._numIndices : vbEntries[lodEntry._vbRef]._numVertices))
+            {
+                ErrorString(source.Name() + " has a draw range outside its buffer");
+                return false;
+            }
+
+            geomDesc._lodDistance = lodEntry._lodDistance;
+            geomDesc._primitiveType = (PrimitiveType::Type)lodEntry._primitiveType;
+            geomDesc._vbRef = lodEntry._vbRef;
+            geomDesc._ibRef = lodEntry._ibRef;
+            geomDesc._drawStart = lodEntry._drawStart;
+            geomDesc._drawCount = lodEntry._drawCount;
+        }
+    }
+
+    if (header._numBones && header._rootBoneIndex >= header._numBones)
+    {
+        ErrorString(source.Name() + " has an out of range root bone index");
+        return false;
+    }
+
+    _bones.Resize(header._numBones);
+    for (size_t i = 0; i < header._numBones; ++i)
+    {
+        const ModelBoneEntry& entry = boneEntries[i];
+        Bone& bone = _bones[i];
+
+        if (entry._nameOffset > header._namesSize || entry._nameLength > header._namesSize - entry._nameOffset)
+        {
+            ErrorString(source.Name() + " has an out of range bone name");
+            return false;
+        }
+
+        // The root bone is its own parent, so every parent index must refer to a bone of the model
+        if (entry._parentIndex >= header._numBones)
+        {
+            ErrorString(source.Name() + " has an out of range bone parent index");
+            return false;
+        }
+
+        bone._name = String(names + entry._nameOffset, entry._nameLength);
+        bone._parentIndex = entry._parentIndex;
+        bone._initialPosition = entry._initialPosition;
+        bone._initialRotation = entry._initialRotation;
+        bone._initialScale = entry._initialScale;
+        bone._offsetMatrix = entry._offsetMatrix;
+        bone._radius = entry._radius;
+        bone._boundingBox = entry._boundingBox;
+        bone._animated = entry._animated != 0;
+    }
+
+    _rootBoneIndex = header._rootBoneIndex;
+    _boundingBox = header._boundingBox;
+
+    return true;
+}
+
 bool Model::EndLoad()
 {
     Vector<SharedPtr<VertexBuffer> > vbs;
@@ -208,7 +474,7 @@ bool Model::EndLoad()
         const VertexBufferDesc& vbDesc = _vbDescs[i];
         SharedPtr<VertexBuffer> vb(new VertexBuffer());
 
-        vb->Define(ResourceUsage::IMMUTABLE, vbDesc._numVertices, vbDesc._vertexElements, true, vbDesc._vertexData.Get());
+        vb->Define(ResourceUsage::IMMUTABLE, vbDesc._numVertices, vbDesc._vertexElements, true, vbDesc._vertexDataView);
         vbs.Push(vb);
     }
 
@@ -218,7 +484,7 @@ bool Model::EndLoad()
         const IndexBufferDesc& ibDesc = _ibDescs[i];
         SharedPtr<IndexBuffer> ib(new IndexBuffer());
 
-        ib->Define(ResourceUsage::IMMUTABLE, ibDesc._numIndices, ibDesc._indexSize, true, ibDesc._indexData.Get());
+        ib->Define(ResourceUsage::IMMUTABLE, ibDesc._numIndices, ibDesc._indexSize, true, ibDesc._indexDataView);
         ibs.Push(ib);
     }
 
@@ -244,7 +510,7 @@ bool Model::EndLoad()
 
             if (geomDesc._ibRef < ibs.Size())
                 geom->_indexBuffer = ibs[geomDesc._ibRef];
-            else
+            else if (geomDesc._ibRef != M_MAX_UNSIGNED)
                 ErrorString("Out of range index buffer reference in " + Name());
             
             _geometries[i][j] = geom;
@@ -254,6 +520,208 @@ bool Model::EndLoad()
     _vbDescs.Clear();
     _ibDescs.Clear();
     _geomDescs.Clear();
+    _loadData.Reset();
+
+    SendEvent(loadedEvent);
+    return true;
+}
+
+bool Model::Save(Stream& dest)
+{
+    PROFILE(SaveModel);
+
+    // Collect the unique buffers referenced by the geometries
+    Vector<VertexBuffer*> vbs;
+    Vector<IndexBuffer*> ibs;
+    Vector<ModelLodLevelEntry> lodEntries;
+    Vector<ModelGeometryEntry> geomEntries(_geometries.Size());
+    Vector<unsigned> boneMappings;
+
+    for (size_t i = 0; i < _geometries.Size(); ++i)
+    {
+        ModelGeometryEntry& geomEntry = geomEntries[i];
+        geomEntry._firstLodLevel = (unsigned)lodEntries.Size();
+        geomEntry._numLodLevels = (unsigned)_geometries[i].Size();
+        geomEntry._firstBoneMapping = (unsigned)boneMappings.Size();
+        geomEntry._numBoneMappings = i < _boneMappings.Size() ? (unsigned)_boneMappings[i].Size() : 0;
+
+        for (size_t j = 0; j < geomEntry._numBoneMappings; ++j)
+            boneMappings.Push((unsigned)_boneMappings[i][j]);
+
+        for (size_t j = 0; j < _geometries[i].Size(); ++j)
+        {
+            Geometry* geom = _geometries[i][j];
+            VertexBuffer* vb = geom->_vertexBuffer;
+            IndexBuffer* ib = geom->_indexBuffer;
+            if (!vb || !vb->ShadowData() || (ib && !ib->ShadowData()))
+            {
+                ErrorString("Can not save model " + Name() + " without vertex and index buffer shadow data");
+                return false;
+            }
+
+            auto vbIt = vbs.Find(vb);
+            if (vbIt == vbs.End())
+            {
+                vbs.Push(vb);
+                vbIt = vbs.End() - 1;
+            }
+
+            ModelLodLevelEntry lodEntry;
+            lodEntry._lodDistance = geom->_lodDistance;
+            lodEntry._primitiveType = geom->_primitiveType;
+            lodEntry._vbRef = (unsigned)(vbIt - vbs.Begin());
+            lodEntry._ibRef = M_MAX_UNSIGNED;
+            lodEntry._drawStart = (unsigned)geom->_drawStart;
+            lodEntry._drawCount = (unsigned)geom->_drawCount;
+
+            if (ib)
+            {
+                auto ibIt = ibs.Find(ib);
+                if (ibIt == ibs.End())
+                {
+                    ibs.Push(ib);
+                    ibIt = ibs.End() - 1;
+                }
+                lodEntry._ibRef = (unsigned)(ibIt - ibs.Begin());
+            }
+
+            lodEntries.Push(lodEntry);
+        }
+    }
+
+    Vector<ModelBoneEntry> boneEntries(_bones.Size());
+    String names;
+    for (size_t i = 0; i < _bones.Size(); ++i)
+    {
+        const Bone& bone = _bones[i];
+        ModelBoneEntry& entry = boneEntries[i];
+
+        entry._nameOffset = (unsigned)names.Length();
+        entry._nameLength = (unsigned)bone._name.Length();
+        entry._parentIndex = (unsigned)bone._parentIndex;
+        entry._animated = bone._animated ? 1 : 0;
+        entry._initialPosition = bone._initialPosition;
+        entry._initialRotation = bone._initialRotation;
+        entry._initialScale = bone._initialScale;
+        entry._offsetMatrix = bone._offsetMatrix;
+        entry._radius = bone._radius;
+        entry._boundingBox = bone._boundingBox;
+        names += bone._name;
+    }
+
+    // Lay out the tables first and the buffer data last, everything aligned so that the loader can use it in place
+    ModelFileHeader header;
+    memcpy(header._fileID, MODEL_FILE_ID, sizeof header._fileID);
+    header._version = MODEL_FILE_VERSION;
+    header._numVertexBuffers = (unsigned)vbs.Size();
+    header._numIndexBuffers = (unsigned)ibs.Size();
+    header._numGeometries = (unsigned)geomEntries.Size();
+    header._numLodLevels = (unsigned)lodEntries.Size();
+    header._numBoneMappings = (unsigned)boneMappings.Size();
+    header._numBones = (unsigned)boneEntries.Size();
+    header._rootBoneIndex = (unsigned)_rootBoneIndex;
+    header._boundingBox = _boundingBox;
+
+    header._numVertexElements = 0;
+    for (auto it = vbs.Begin(); it != vbs.End(); ++it)
+        header._numVertexElements += (unsigned)(*it)->GetNumElements();
+
+    size_t offset = AlignModelOffset(sizeof(ModelFileHeader));
+    header._vertexBuffersOffset = (unsigned)offset;
+    offset = AlignModelOffset(offset + header._numVertexBuffers * sizeof(ModelVertexBufferEntry));
+    header._vertexElementsOffset = (unsigned)offset;
+    offset = AlignModelOffset(offset + header._numVertexElements * sizeof(ModelVertexElementEntry));
+    header._indexBuffersOffset = (unsigned)offset;
+    offset = AlignModelOffset(offset + header._numIndexBuffers * sizeof(ModelIndexBufferEntry));
+    header._geometriesOffset = (unsigned)offset;
+    offset = AlignModelOffset(offset + header._numGeometries * sizeof(ModelGeometryEntry));
+    header._lodLevelsOffset = (unsigned)offset;
+    offset = AlignModelOffset(offset + header._numLodLevels * sizeof(ModelLodLevelEntry));
+    header._boneMappingsOffset = (unsigned)offset;
+    offset = AlignModelOffset(offset + header._numBoneMappings * sizeof(unsigned));
+    header._bonesOffset = (unsigned)offset;
+    offset = AlignModelOffset(offset + header._numBones * sizeof(ModelBoneEntry));
+    header._namesOffset = (unsigned)offset;
+    header._namesSize = (unsigned)names.Length();
+    offset = AlignModelOffset(offset + header._namesSize);
+
+    Vector<ModelVertexBufferEntry> vbEntries(vbs.Size());
+    Vector<ModelVertexElementEntry> elementEntries;
+    for (size_t i = 0; i < vbs.Size(); ++i)
+    {
+        VertexBuffer* vb = vbs[i];
+        ModelVertexBufferEntry& entry = vbEntries[i];
+
+        entry._numVertices = (unsigned)vb->GetNumVertices();
+        entry._vertexSize = (unsigned)vb->GetVertexSize();
+        entry._firstElement = (unsigned)elementEntries.Size();
+        entry._numElements = (unsigned)vb->GetNumElements();
+        entry._dataOffset = (unsigned)offset;
+        entry._dataSize = entry._numVertices * entry._vertexSize;
+        offset = AlignModelOffset(offset + entry._dataSize);
+
+        const Vector<VertexElement>& elements = vb->GetElements();
+        for (auto it = elements.Begin(); it != elements.End(); ++it)
+        {
+            ModelVertexElementEntry elementEntry;
+            elementEntry._type = (unsigned char)it->_type;
+            elementEntry._semantic = (unsigned char)it->_semantic;
+            elementEntry._index = it->_index;
+            elementEntry._padding = 0;
+            elementEntries.Push(elementEntry);
+        }
+    }
+
+    Vector<ModelIndexBufferEntry> ibEntries(ibs.Size());
+    for (size_t i = 0; i < ibs.Size(); ++i)
+    {
+        IndexBuffer* ib = ibs[i];
+        ModelIndexBufferEntry& entry = ibEntries[i];
+
+        entry._numIndices = (unsigned)ib->NumIndices();
+        entry._indexSize = (unsigned)ib->IndexSize();
+        entry._dataOffset = (unsigned)offset;
+        entry._dataSize = entry._numIndices * entry._indexSize;
+        offset = AlignModelOffset(offset + entry._dataSize);
+    }
+
+    dest.Write(&header, sizeof header);
+    WriteModelPadding(dest);
+    if (vbEntries.Size())
+        dest.Write(&vbEntries[0], vbEntries.Size() * sizeof(ModelVertexBufferEntry));
+    WriteModelPadding(dest);
+    if (elementEntries.Size())
+        dest.Write(&elementEntries[0], elementEntries.Size() * sizeof(ModelVertexElementEntry));
+    WriteModelPadding(dest);
+    if (ibEntries.Size())
+        dest.Write(&ibEntries[0], ibEntries.Size() * sizeof(ModelIndexBufferEntry));
+    WriteModelPadding(dest);
+    if (geomEntries.Size())
+        dest.Write(&geomEntries[0], geomEntries.Size() * sizeof(ModelGeometryEntry));
+    WriteModelPadding(dest);
+    if (lodEntries.Size())
+        dest.Write(&lodEntries[0], lodEntries.Size() * sizeof(ModelLodLevelEntry));
+    WriteModelPadding(dest);
+    if (boneMappings.Size())
+        dest.Write(&boneMappings[0], boneMappings.Size() * sizeof(unsigned));
+    WriteModelPadding(dest);
+    if (boneEntries.Size())
+        dest.Write(&boneEntries[0], boneEntries.Size() * sizeof(ModelBoneEntry));
+    WriteModelPadding(dest);
+    if (names.Length())
+        dest.Write(names.CString(), names.Length());
+    WriteModelPadding(dest);
+
+    for (size_t i = 0; i < vbs.Size(); ++i)
+    {
+        dest.Write(vbs[i]->ShadowData(), vbEntries[i]._dataSize);
+        WriteModelPadding(dest);
+    }
+    for (size_t i = 0; i < ibs.Size(); ++i)
+    {
+        dest.Write(ibs[i]->ShadowData(), ibEntries[i]._dataSize);
+        WriteModelPadding(dest);
+    }
 
     return true;
 }
@@ -312,4 +780,10 @@ Geometry* Model::GetGeometry(size_t index, size_t lodLevel) const
     return (index < _geometries.Size() && lodLevel < _geometries[index].Size()) ? _geometries[index][lodLevel].Get() : nullptr;
 }
 
+const Vector<SharedPtr<Geometry> >& Model::GetLodGeometries(size_t index) const
+{
+    static const Vector<SharedPtr<Geometry> > noGeometries;
+    return index < _geometries.Size() ? _geometries[index] : noGeometries;
+}
+
 }
@@ -61,6 +61,8 @@ public:
     bool BeginLoad(Stream& source) override;
     /// Finalize model loading in the main thread. Return true on success.
     bool EndLoad() override;
+    /// Save the model in the binary model format. The vertex and index buffers must have shadow data. Return true on success.
+    bool Save(Stream& dest) override;
 
     /// Set number of geometries.
     void SetNumGeometries(size_t num);
@@ -79,8 +81,8 @@ public:
     size_t GetNumLodLevels(size_t index) const;
     /// Return the geometry at batch index and LOD level.
     Geometry* GetGeometry(size_t index, size_t lodLevel) const;
-    /// Return the LOD geometries at batch index.
-    const Vector<SharedPtr<Geometry> >& GetLodGeometries(size_t index) const { return _geometries[index]; }
+    /// Return the LOD geometries at batch index, or an empty vector if out of range.
+    const Vector<SharedPtr<Geometry> >& GetLodGeometries(size_t index) const;
     /// Return the local space bounding box.
     const BoundingBoxF& GetLocalBoundingBox() const { return _boundingBox; }
     /// Return the model's bones.
@@ -90,7 +92,15 @@ public:
     /// Return per-geometry bone mapping.
     const Vector<Vector<size_t> > GetBoneMappings() const { return _boneMappings; }
 
+    /// Load finished event, sent from EndLoad(). The geometries are recreated on each load, so nodes using the model subscribe to this to take the new geometries when the model is reloaded.
+    Event loadedEvent;
+
 private:
+    /// Load the legacy UMDL format after the file ID. Return true on success.
+    bool LoadLegacy(Stream& source);
+    /// Load the binary model format. The data is read with one view or read operation and the buffer data is used in place. Return true on success.
+    bool LoadBinary(Stream& source);
+
     /// Geometry LOD levels.
     Vector<Vector<SharedPtr<Geometry> > > _geometries;
     /// Local space bounding box.
@@ -107,6 +117,8 @@ private:
     Vector<IndexBufferDesc> _ibDescs;
     /// Geometry descriptions for loading.
     Vector<Vector<GeometryDesc> > _geomDescs;
+    /// Binary model file data for loading, if the source stream does not support views.
+    SharedArrayPtr<unsigned char> _loadData;
 };
 
 }
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "../Math/BoundingBox.h"
+#include "../Math/Matrix3x4.h"
+#include "../Math/Quaternion.h"
+
+namespace Auto3D
+{
+
+/// Binary model file identifier.
+static const char* MODEL_FILE_ID = "AMDL";
+/// Binary model file format version.
+static const unsigned MODEL_FILE_VERSION = 1;
+/// Alignment of the tables and buffer data within a binary model file.
+static const size_t MODEL_DATA_ALIGNMENT = 16;
+
+/// Binary model file header. All offsets are in bytes from the beginning of the file and aligned to MODEL_DATA_ALIGNMENT, so that the file can be mapped and the tables and buffer data used in place.
+struct ModelFileHeader
+{
+    /// File identifier.
+    char _fileID[4];
+    /// Format version.
+    unsigned _version;
+    /// Number of vertex buffers.
+    unsigned _numVertexBuffers;
+    /// Number of vertex elements in all vertex buffers.
+    unsigned _numVertexElements;
+    /// Number of index buffers.
+    unsigned _numIndexBuffers;
+    /// Number of geometries.
+    unsigned _numGeometries;
+    /// Number of LOD levels in all geometries.
+    unsigned _numLodLevels;
+    /// Number of bone mapping entries in all geometries.
+    unsigned _numBoneMappings;
+    /// Number of bones.
+    unsigned _numBones;
+    /// Root bone index.
+    unsigned _rootBoneIndex;
+    /// Offset of the vertex buffer table.
+    unsigned _vertexBuffersOffset;
+    /// Offset of the vertex element table.
+    unsigned _vertexElementsOffset;
+    /// Offset of the index buffer table.
+    unsigned _indexBuffersOffset;
+    /// Offset of the geometry table.
+    unsigned _geometriesOffset;
+    /// Offset of the LOD level table.
+    unsigned _lodLevelsOffset;
+    /// Offset of the bone mapping table.
+    unsigned _boneMappingsOffset;
+    /// Offset of the bone table.
+    unsigned _bonesOffset;
+    /// Offset of the bone name string data.
+    unsigned _namesOffset;
+    /// Size of the bone name string data.
+    unsigned _namesSize;
+    /// Local space bounding box.
+    BoundingBoxF _boundingBox;
+};
+
+/// Vertex buffer entry in a binary model file.
+struct ModelVertexBufferEntry
+{
+    /// Number of vertices.
+    unsigned _numVertices;
+    /// Vertex size in bytes.
+    unsigned _vertexSize;
+    /// Index of the first vertex element in the vertex element table.
+    unsigned _firstElement;
+    /// Number of vertex elements.
+    unsigned _numElements;
+    /// Offset of the vertex data.
+    unsigned _dataOffset;
+    /// Size of the vertex data in bytes.
+    unsigned _dataSize;
+};
+
+/// Vertex element entry in a binary model file.
+struct ModelVertexElementEntry
+{
+    /// Element type.
+    unsigned char _type;
+    /// Element semantic.
+    unsigned char _semantic;
+    /// Semantic index.
+    unsigned char _index;
+    /// Padding.
+    unsigned char _padding;
+};
+
+/// Index buffer entry in a binary model file.
+struct ModelIndexBufferEntry
+{
+    /// Number of indices.
+    unsigned _numIndices;
+    /// Index size in bytes.
+    unsigned _indexSize;
+    /// Offset of the index data.
+    unsigned _dataOffset;
+    /// Size of the index data in bytes.
+    unsigned _dataSize;
+};
+
+/// Geometry entry in a binary model file.
+struct ModelGeometryEntry
+{
+    /// Index of the first LOD level in the LOD level table.
+    unsigned _firstLodLevel;
+    /// Number of LOD levels.
+    unsigned _numLodLevels;
+    /// Index of the first bone mapping entry in the bone mapping table.
+    unsigned _firstBoneMapping;
+    /// Number of bone mapping entries.
+    unsigned _numBoneMappings;
+};
+
+/// LOD level entry in a binary model file.
+struct ModelLodLevelEntry
+{
+    /// LOD distance.
+    float _lodDistance;
+    /// Primitive type.
+    unsigned _primitiveType;
+    /// Vertex buffer index.
+    unsigned _vbRef;
+    /// Index buffer index, or M_MAX_UNSIGNED if not indexed.
+    unsigned _ibRef;
+    /// Draw range start.
+    unsigned _drawStart;
+    /// Draw range element count.
+    unsigned _drawCount;
+};
+
+/// Bone entry in a binary model file.
+struct ModelBoneEntry
+{
+    /// Offset of the name within the bone name string data.
+    unsigned _nameOffset;
+    /// Name length in bytes. Names are not zero-terminated.
+    unsigned _nameLength;
+    /// Parent bone index.
+    unsigned _parentIndex;
+    /// Animated flag.
+    unsigned _animated;
+    /// Reset position.
+    Vector3F _initialPosition;
+    /// Reset rotation.
+    Quaternion _initialRotation;
+    /// Reset scale.
+    Vector3F _initialScale;
+    /// Offset matrix for skinning.
+    Matrix3x4F _offsetMatrix;
+    /// Collision radius.
+    float _radius;
+    /// Collision bounding box.
+    BoundingBoxF _boundingBox;
+};
+
+}
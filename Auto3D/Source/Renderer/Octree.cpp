@@ -1,5 +1,7 @@
 #include "../Debug/Log.h"
 #include "../Math/Ray.h"
+#include "../Thread/WorkQueue.h"
+#include "Light.h"
 #include "Octree.h"
 
 #include <cassert>
@@ -11,7 +13,9 @@ namespace Auto3D
 
 static const float DEFAULT_OCTREE_SIZE = 1000.0f;
 static const int DEFAULT_OCTREE_LEVELS = 8;
-static const int MAX_OCTREE_LEVELS = 256;
+static const size_t CULL_BATCH_SIZE = 64;
+static const size_t MIN_PARALLEL_UPDATE_NODES = 256;
+static const size_t MIN_UPDATE_GRAIN_SIZE = 64;
 
 bool CompareRaycastResults(const RaycastResult& lhs, const RaycastResult& rhs)
 {
@@ -41,6 +45,29 @@ void Octant::Initialize(Octant* parent, const BoundingBoxF& boundingBox, int lev
     _parent = parent;
 }
 
+BoundingBoxF Octant::ChildBoundingBox(size_t index) const
+{
+    Vector3F newMin = _worldBoundingBox._min;
+    Vector3F newMax = _worldBoundingBox._max;
+
+    if (index & 1)
+        newMin._x = _center._x;
+    else
+        newMax._x = _center._x;
+
+    if (index & 2)
+        newMin._y = _center._y;
+    else
+        newMax._y = _center._y;
+
+    if (index & 4)
+        newMin._z = _center._z;
+    else
+        newMax._z = _center._z;
+
+    return BoundingBoxF(newMin, newMax);
+}
+
 bool Octant::FitBoundingBox(const BoundingBoxF& box, const Vector3F& boxSize) const
 {
     // If max split level, _size always OK, otherwise check that box is at least half _size of octant
@@ -59,7 +86,12 @@ bool Octant::FitBoundingBox(const BoundingBoxF& box, const Vector3F& boxSize) co
     return false;
 }
 
-Octree::Octree()
+Octree::Octree() :
+    _linearOctantsDirty(true),
+    _numMovedNodes(0),
+    _numSkippedNodes(0),
+    _numLights(0),
+    _lightInteractionVersion(0)
 {
     _root.Initialize(nullptr, BoundingBoxF(-DEFAULT_OCTREE_SIZE, DEFAULT_OCTREE_SIZE), DEFAULT_OCTREE_LEVELS);
 }
@@ -81,62 +113,152 @@ void Octree::Update()
 {
     PROFILE(UpdateOctree);
 
-    for (auto it = _updateQueue.Begin(); it != _updateQueue.End(); ++it)
+    _numMovedNodes = 0;
+    _numSkippedNodes = 0;
+    if (_updateQueue.IsEmpty())
     {
-        OctreeNode* node = *it;
-        // If node was removed before update could happen, a null pointer will be in its place
-        if (node)
+        if (_linearOctantsDirty)
+            BuildLinearOctants();
+        return;
+    }
+
+    size_t numQueued = _updateQueue.Size();
+    _updateDepths.Resize(numQueued);
+    _oldBounds.Resize(numQueued);
+
+    // Phase 1: calculate the world bounding boxes and find out which nodes need to move. Octants are not modified, so
+    // this can run in worker threads when there are enough nodes
+    {
+        PROFILE(CalculateOctreeUpdates);
+
+        WorkQueue* workQueue = Subsystem<WorkQueue>();
+        if (workQueue && workQueue->NumThreads() && numQueued >= MIN_PARALLEL_UPDATE_NODES)
         {
-            node->SetFlag(NF_OCTREE_UPDATE_QUEUED, false);
+            // Nodes evaluate their parent's world transform lazily. Evaluate the parents here so that the worker threads
+            // only modify the node they are processing
+            for (auto it = _updateQueue.Begin(); it != _updateQueue.End(); ++it)
+            {
+                OctreeNode* node = *it;
+                if (node && node->TestFlag(NF_SPATIAL_PARENT))
+                    static_cast<SpatialNode*>(node->Parent())->GetWorldTransform();
+            }
+
+            size_t grainSize = workQueue->GrainSize(numQueued, MIN_UPDATE_GRAIN_SIZE);
+            workQueue->ParallelFor(numQueued, grainSize, [this](size_t begin, size_t end, unsigned)
+            {
+                CalculateUpdates(begin, end);
+            });
+        }
+        else
+            CalculateUpdates(0, numQueued);
+    }
 
-            // Do nothing if still fits the current octant
-            const BoundingBoxF& box = node->WorldBoundingBox();
-            Vector3F boxSize = box.Size();
-            Octant* oldOctant = node->_octant;
+    // Phase 2: move the nodes. Resolve the target octants first, then remove all moving nodes from their old octants
+    // and insert them into the new ones, and finally erase octants that were left empty
+    {
+        PROFILE(MoveOctreeNodes);
 
-		
-            if (oldOctant && oldOctant->_cullingBox.IsInside(box) == INSIDE && oldOctant->FitBoundingBox(box, boxSize))
+        _moves.Clear();
+        for (size_t i = 0; i < numQueued; ++i)
+        {
+            OctreeNode* node = _updateQueue[i];
+            int depth = _updateDepths[i];
+            if (!node)
+                continue;
+            if (depth < 0)
+            {
+                ++_numSkippedNodes;
                 continue;
+            }
 
-            // Begin reinsert process. Start from root and check what level child needs to be used
             Octant* newOctant = &_root;
-            Vector3F boxCenter = box.Center();
+            Vector3F boxCenter = node->WorldBoundingBox().Center();
+            for (int j = 0; j < depth; ++j)
+                newOctant = CreateChildOctant(newOctant, newOctant->ChildIndex(boxCenter));
+
+            if (newOctant != node->_octant)
+                _moves.Push(MakePair(node, newOctant));
+            else
+            {
+                RefreshNode(node);
+                ++_numSkippedNodes;
+            }
+        }
+
+        bool octantsEmptied = false;
+        for (auto it = _moves.Begin(); it != _moves.End(); ++it)
+        {
+            OctreeNode* node = it->_first;
+            if (node->_octant)
+                octantsEmptied |= DetachNode(node->_octant, node->_octantIndex);
+        }
+
+        for (auto it = _moves.Begin(); it != _moves.End(); ++it)
+            AddNode(it->_first, it->_second);
+
+        if (octantsEmptied)
+            DeleteEmptyChildOctants(&_root);
+
+        _numMovedNodes = _moves.Size();
+    }
+
+    // Phase 3: invalidate the lights' cached lit geometries. If there are at least as many changed geometries as lights,
+    // a query per geometry would cost more than the lights querying again, so invalidate all lights instead
+    {
+        PROFILE(InvalidateLightInteractions);
+
+        size_t numGeometries = 0;
+        for (auto it = _updateQueue.Begin(); it != _updateQueue.End(); ++it)
+        {
+            OctreeNode* node = *it;
+            if (!node)
+                continue;
+            if (node->TestFlag(NF_LIGHT))
+                static_cast<Light*>(node)->_litGeometriesDirty = true;
+            else if (node->TestFlag(NF_GEOMETRY))
+                ++numGeometries;
+        }
 
-            for (;;)
+        if (numGeometries && _numLights)
+        {
+            if (numGeometries >= _numLights)
+                ++_lightInteractionVersion;
+            else
             {
-                bool insertHere;
-                // If node does not fit fully inside root octant, must remain in it
-                if (newOctant == &_root)
-                    insertHere = newOctant->_cullingBox.IsInside(box) != INSIDE || newOctant->FitBoundingBox(box, boxSize);
-                else
-                    insertHere = newOctant->FitBoundingBox(box, boxSize);
-
-                if (insertHere)
+                for (size_t i = 0; i < numQueued; ++i)
                 {
-                    if (newOctant != oldOctant)
+                    OctreeNode* node = _updateQueue[i];
+                    if (node && node->TestFlag(NF_GEOMETRY))
                     {
-                        // Add first, then remove, because node count going to zero deletes the octree branch in question
-                        AddNode(node, newOctant);
-                        if (oldOctant)
-                            RemoveNode(node, oldOctant);
+                        BoundingBoxF box = _oldBounds[i];
+                        box.Merge(node->WorldBoundingBox());
+                        InvalidateLightInteractions(box);
                     }
-                    break;
                 }
-                else
-                    newOctant = CreateChildOctant(newOctant, newOctant->ChildIndex(boxCenter));
             }
         }
     }
 
     _updateQueue.Clear();
+
+    if (_linearOctantsDirty)
+        BuildLinearOctants();
 }
 
 void Octree::Resize(const BoundingBoxF& boundingBox, int numLevels)
 {
     PROFILE(ResizeOctree);
 
-    // Collect nodes to the root and delete all child octants
-    _updateQueue.Clear();
+    // Collect nodes to the root and delete all child octants. Keep queued nodes that have not been inserted yet, as they
+    // are not found from the octants, and are queued only once
+    size_t numKept = 0;
+    for (size_t i = 0; i < _updateQueue.Size(); ++i)
+    {
+        OctreeNode* node = _updateQueue[i];
+        if (node && !node->_octant)
+            _updateQueue[numKept++] = node;
+    }
+    _updateQueue.Resize(numKept);
     CollectNodes(_updateQueue, &_root);
     DeleteChildOctants(&_root, false);
     _allocator.Reset();
@@ -149,7 +271,13 @@ void Octree::Resize(const BoundingBoxF& boundingBox, int numLevels)
 void Octree::RemoveNode(OctreeNode* node)
 {
     assert(node);
-    RemoveNode(node, node->_octant);
+    if (node->_octant)
+    {
+        BoundingBoxF box = node->_octant->_nodeBounds.Get(node->_octantIndex);
+        RemoveNode(node->_octant, node->_octantIndex);
+        if (node->TestFlag(NF_GEOMETRY))
+            InvalidateLightInteractions(box);
+    }
     if (node->TestFlag(NF_OCTREE_UPDATE_QUEUED))
         CancelUpdate(node);
     node->_octant = nullptr;
@@ -158,6 +286,9 @@ void Octree::RemoveNode(OctreeNode* node)
 void Octree::QueueUpdate(OctreeNode* node)
 {
     assert(node);
+    // Queue only once, as the update may process the queue in several threads
+    if (node->TestFlag(NF_OCTREE_UPDATE_QUEUED))
+        return;
     _updateQueue.Push(node);
     node->SetFlag(NF_OCTREE_UPDATE_QUEUED, true);
 }
@@ -171,12 +302,41 @@ void Octree::CancelUpdate(OctreeNode* node)
     node->SetFlag(NF_OCTREE_UPDATE_QUEUED, false);
 }
 
+void Octree::UpdateNodeFlags(OctreeNode* node)
+{
+    assert(node);
+    Octant* octant = node->_octant;
+    if (octant)
+    {
+        octant->_nodeFlags[node->_octantIndex] = node->Flags();
+        octant->_nodeLayerMasks[node->_octantIndex] = node->GetLayerMask();
+        if (node->TestFlag(NF_GEOMETRY))
+            InvalidateLightInteractions(octant->_nodeBounds.Get(node->_octantIndex));
+    }
+}
+
 void Octree::Raycast(Vector<RaycastResult>& result, const Ray& ray, unsigned short nodeFlags, float maxDistance, unsigned layerMask)
 {
     PROFILE(OctreeRaycast);
 
+    // The cached node bounds are refreshed only on update. Raycasts are typically done by game logic after moving nodes, so update now
+    if (_updateQueue.Size())
+        Update();
+
     result.Clear();
-    CollectNodes(result, &_root, ray, nodeFlags, maxDistance, layerMask);
+    if (_linearOctantsDirty)
+        CollectNodes(result, &_root, ray, nodeFlags, maxDistance, layerMask);
+    else
+    {
+        VisitLinearOctants(ray, maxDistance, [&](const Octant* octant)
+        {
+            for (size_t i = 0; i < octant->_nodes.Size(); ++i)
+            {
+                if ((octant->_nodeFlags[i] & nodeFlags) == nodeFlags && (octant->_nodeLayerMasks[i] & layerMask))
+                    octant->_nodes[i]->OnRaycast(result, ray, maxDistance);
+            }
+        });
+    }
     Sort(result.Begin(), result.End(), CompareRaycastResults);
 }
 
@@ -184,9 +344,28 @@ RaycastResult Octree::RaycastSingle(const Ray& ray, unsigned short nodeFlags, fl
 {
     PROFILE(OctreeRaycastSingle);
 
+    if (_updateQueue.Size())
+        Update();
+
     // Get first the potential hits
     _initialRes.Clear();
-    CollectNodes(_initialRes, &_root, ray, nodeFlags, maxDistance, layerMask);
+    if (_linearOctantsDirty)
+        CollectNodes(_initialRes, &_root, ray, nodeFlags, maxDistance, layerMask);
+    else
+    {
+        VisitLinearOctants(ray, maxDistance, [&](const Octant* octant)
+        {
+            for (size_t i = 0; i < octant->_nodes.Size(); ++i)
+            {
+                if ((octant->_nodeFlags[i] & nodeFlags) == nodeFlags && (octant->_nodeLayerMasks[i] & layerMask))
+                {
+                    float distance = ray.HitDistance(octant->_nodeBounds.Get(i));
+                    if (distance < maxDistance)
+                        _initialRes.Push(MakePair(octant->_nodes[i], distance));
+                }
+            }
+        });
+    }
     Sort(_initialRes.Begin(), _initialRes.End(), CompareNodeDistances);
 
     // Then perform actual per-node ray tests and early-out when possible
@@ -221,6 +400,37 @@ RaycastResult Octree::RaycastSingle(const Ray& ray, unsigned short nodeFlags, fl
     }
 }
 
+void Octree::FindNodes(Vector<OctreeNode*>& result, const Frustum& frustum, unsigned short nodeFlags, unsigned layerMask) const
+{
+    PROFILE(QueryOctree);
+
+    FrustumPlaneArray planes(frustum);
+    if (_linearOctantsDirty)
+    {
+        CollectNodes(result, &_root, frustum, planes, nodeFlags, layerMask);
+        return;
+    }
+
+    VisitLinearOctants(frustum, [&](const Octant* octant, bool inside)
+    {
+        if (inside)
+            CollectOctantNodes(result, octant, nodeFlags, layerMask);
+        else
+            CollectOctantNodes(result, octant, planes, nodeFlags, layerMask);
+    });
+}
+
+void Octree::InvalidateLightInteractions(const BoundingBoxF& box)
+{
+    if (!_numLights)
+        return;
+
+    _invalidatedLights.Clear();
+    FindNodes(_invalidatedLights, box, NF_LIGHT);
+    for (auto it = _invalidatedLights.Begin(); it != _invalidatedLights.End(); ++it)
+        static_cast<Light*>(*it)->_litGeometriesDirty = true;
+}
+
 void Octree::SetBoundingBoxAttr(const BoundingBoxF& boundingBox)
 {
     _root._worldBoundingBox = boundingBox;
@@ -244,8 +454,14 @@ int Octree::NumLevelsAttr() const
 
 void Octree::AddNode(OctreeNode* node, Octant* octant)
 {
+    node->_octantIndex = octant->_nodes.Size();
     octant->_nodes.Push(node);
+    octant->_nodeBounds.Push(node->WorldBoundingBox());
+    octant->_nodeFlags.Push(node->Flags());
+    octant->_nodeLayerMasks.Push(node->GetLayerMask());
     node->_octant = octant;
+    if (node->TestFlag(NF_LIGHT))
+        ++_numLights;
 
     // Increment the node count in the whole parent branch
     while (octant)
@@ -255,49 +471,123 @@ void Octree::AddNode(OctreeNode* node, Octant* octant)
     }
 }
 
-void Octree::RemoveNode(OctreeNode* node, Octant* octant)
+void Octree::RemoveNode(Octant* octant, size_t index)
 {
-    // Do not set the node's octant pointer to zero, as the node may already be added into another octant
-    octant->_nodes.Remove(node);
-    
-    // Decrement the node count in the whole parent branch and erase empty octants as necessary
-    while (octant)
+    DetachNode(octant, index);
+
+    // Erase empty octants from the parent branch
+    while (!octant->_numNodes && octant->_parent)
     {
-        --octant->_numNodes;
         Octant* next = octant->_parent;
-        if (!octant->_numNodes && next)
-            DeleteChildOctant(next, next->ChildIndex(octant->_center));
+        DeleteChildOctant(next, next->ChildIndex(octant->_center));
         octant = next;
     }
 }
 
-Octant* Octree::CreateChildOctant(Octant* octant, size_t index)
+bool Octree::DetachNode(Octant* octant, size_t index)
 {
-    if (octant->_children[index])
-        return octant->_children[index];
+    // Move the last node in place of the removed to keep the node bounds indices valid. Do not set the node's octant
+    // pointer to zero, as the node may already be added into another octant
+    Vector<OctreeNode*>& octantNodes = octant->_nodes;
+    assert(index < octantNodes.Size());
+    if (octantNodes[index]->TestFlag(NF_LIGHT))
+        --_numLights;
+    if (index + 1 < octantNodes.Size())
+    {
+        octantNodes[index] = octantNodes.Back();
+        octantNodes[index]->_octantIndex = index;
+        octant->_nodeFlags[index] = octant->_nodeFlags.Back();
+        octant->_nodeLayerMasks[index] = octant->_nodeLayerMasks.Back();
+    }
+    octantNodes.Pop();
+    octant->_nodeBounds.EraseSwap(index);
+    octant->_nodeFlags.Pop();
+    octant->_nodeLayerMasks.Pop();
 
-    Vector3F newMin = octant->_worldBoundingBox._min;
-    Vector3F newMax = octant->_worldBoundingBox._max;
-    const Vector3F& oldCenter = octant->_center;
+    // Decrement the node count in the whole parent branch
+    bool emptied = false;
+    while (octant)
+    {
+        if (!--octant->_numNodes && octant->_parent)
+            emptied = true;
+        octant = octant->_parent;
+    }
 
-    if (index & 1)
-        newMin._x = oldCenter._x;
-    else
-        newMax._x = oldCenter._x;
+    return emptied;
+}
 
-    if (index & 2)
-        newMin._y = oldCenter._y;
-    else
-        newMax._y = oldCenter._y;
+void Octree::RefreshNode(OctreeNode* node)
+{
+    Octant* octant = node->_octant;
+    size_t index = node->_octantIndex;
+    octant->_nodeBounds.Set(index, node->WorldBoundingBox());
+    octant->_nodeFlags[index] = node->Flags();
+    octant->_nodeLayerMasks[index] = node->GetLayerMask();
+}
 
-    if (index & 4)
-        newMin._z = oldCenter._z;
-    else
-        newMax._z = oldCenter._z;
+void Octree::CalculateUpdates(size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        OctreeNode* node = _updateQueue[i];
+        // If node was removed before update could happen, a null pointer will be in its place
+        if (!node)
+            continue;
+
+        node->SetFlag(NF_OCTREE_UPDATE_QUEUED, false);
+
+        Octant* oldOctant = node->_octant;
+        if (oldOctant)
+            _oldBounds[i] = oldOctant->_nodeBounds.Get(node->_octantIndex);
+
+        const BoundingBoxF& box = node->WorldBoundingBox();
+        Vector3F boxSize = box.Size();
+        if (!oldOctant)
+            _oldBounds[i] = box;
+
+        // If still fits the current octant, only refresh the cached bounds. Each node has its own slot in the octant's
+        // arrays, so this is safe to do in worker threads
+        if (oldOctant && oldOctant->_cullingBox.IsInside(box) == INSIDE && oldOctant->FitBoundingBox(box, boxSize))
+        {
+            RefreshNode(node);
+            _updateDepths[i] = -1;
+        }
+        else
+            _updateDepths[i] = InsertionDepth(box, boxSize);
+    }
+}
+
+int Octree::InsertionDepth(const BoundingBoxF& box, const Vector3F& boxSize) const
+{
+    // If node does not fit fully inside root octant, must remain in it
+    if (_root._cullingBox.IsInside(box) != INSIDE || _root.FitBoundingBox(box, boxSize))
+        return 0;
+
+    // Descend through temporary octants that have the same bounds as the actual child octants would, so that no octants
+    // need to be created yet
+    Vector3F boxCenter = box.Center();
+    Octant octant;
+    octant.Initialize(nullptr, _root.ChildBoundingBox(_root.ChildIndex(boxCenter)), _root._level - 1);
+    int depth = 1;
+
+    while (!octant.FitBoundingBox(box, boxSize))
+    {
+        octant.Initialize(nullptr, octant.ChildBoundingBox(octant.ChildIndex(boxCenter)), octant._level - 1);
+        ++depth;
+    }
+
+    return depth;
+}
+
+Octant* Octree::CreateChildOctant(Octant* octant, size_t index)
+{
+    if (octant->_children[index])
+        return octant->_children[index];
 
     Octant* child = _allocator.Allocate();
-    child->Initialize(octant, BoundingBoxF(newMin, newMax), octant->_level - 1);
+    child->Initialize(octant, octant->ChildBoundingBox(index), octant->_level - 1);
     octant->_children[index] = child;
+    _linearOctantsDirty = true;
 
     return child;
 }
@@ -306,6 +596,7 @@ void Octree::DeleteChildOctant(Octant* octant, size_t index)
 {
     _allocator.Free(octant->_children[index]);
     octant->_children[index] = nullptr;
+    _linearOctantsDirty = true;
 }
 
 void Octree::DeleteChildOctants(Octant* octant, bool deletingOctree)
@@ -315,10 +606,15 @@ void Octree::DeleteChildOctants(Octant* octant, bool deletingOctree)
         OctreeNode* node = *it;
         node->_octant = nullptr;
         node->SetFlag(NF_OCTREE_UPDATE_QUEUED, false);
+        if (node->TestFlag(NF_LIGHT))
+            --_numLights;
         if (deletingOctree)
             node->_octree = nullptr;
     }
     octant->_nodes.Clear();
+    octant->_nodeBounds.Clear();
+    octant->_nodeFlags.Clear();
+    octant->_nodeLayerMasks.Clear();
     octant->_numNodes = 0;
 
     for (size_t i = 0; i < NUM_OCTANTS; ++i)
@@ -332,6 +628,81 @@ void Octree::DeleteChildOctants(Octant* octant, bool deletingOctree)
 
     if (octant != &_root)
         _allocator.Free(octant);
+    _linearOctantsDirty = true;
+}
+
+void Octree::DeleteEmptyChildOctants(Octant* octant)
+{
+    for (size_t i = 0; i < NUM_OCTANTS; ++i)
+    {
+        Octant* child = octant->_children[i];
+        if (child)
+        {
+            if (!child->_numNodes)
+            {
+                DeleteChildOctants(child, false);
+                octant->_children[i] = nullptr;
+            }
+            else
+                DeleteEmptyChildOctants(child);
+        }
+    }
+}
+
+void Octree::BuildLinearOctants()
+{
+    PROFILE(BuildLinearOctree);
+
+    _linearOctants.Clear();
+
+    LinearOctant rootOctant;
+    rootOctant._cullingBox = _root._cullingBox;
+    rootOctant._octant = &_root;
+    _linearOctants.Push(rootOctant);
+
+    // The array doubles as the breadth-first queue: the children of each octant are appended consecutively
+    for (size_t i = 0; i < _linearOctants.Size(); ++i)
+    {
+        const Octant* octant = _linearOctants[i]._octant;
+        unsigned firstChild = (unsigned)_linearOctants.Size();
+
+        for (size_t j = 0; j < NUM_OCTANTS; ++j)
+        {
+            const Octant* child = octant->_children[j];
+            if (child && child->_numNodes)
+            {
+                LinearOctant childOctant;
+                childOctant._cullingBox = child->_cullingBox;
+                childOctant._octant = child;
+                _linearOctants.Push(childOctant);
+            }
+        }
+
+        _linearOctants[i]._firstChild = firstChild;
+        _linearOctants[i]._numChildren = (unsigned)_linearOctants.Size() - firstChild;
+    }
+
+    _linearOctantsDirty = false;
+}
+
+template <typename _Visitor> void Octree::VisitLinearOctants(const Ray& ray, float maxDistance, const _Visitor& visitor) const
+{
+    unsigned stack[OCTREE_QUERY_STACK_SIZE];
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize)
+    {
+        const LinearOctant& linearOctant = _linearOctants[stack[--stackSize]];
+        if (ray.HitDistance(linearOctant._cullingBox) >= maxDistance)
+            continue;
+
+        visitor(linearOctant._octant);
+
+        // Push the children in reverse so that they are visited in index order
+        for (unsigned i = linearOctant._numChildren; i > 0; --i)
+            stack[stackSize++] = linearOctant._firstChild + i - 1;
+    }
 }
 
 void Octree::CollectNodes(Vector<OctreeNode*>& result, const Octant* octant) const
@@ -345,15 +716,36 @@ void Octree::CollectNodes(Vector<OctreeNode*>& result, const Octant* octant) con
     }
 }
 
-void Octree::CollectNodes(Vector<OctreeNode*>& result, const Octant* octant, unsigned short nodeFlags, unsigned layerMask) const
+void Octree::CollectOctantNodes(Vector<OctreeNode*>& result, const Octant* octant, unsigned short nodeFlags, unsigned layerMask) const
+{
+    for (size_t i = 0; i < octant->_nodes.Size(); ++i)
+    {
+        if ((octant->_nodeFlags[i] & nodeFlags) == nodeFlags && (octant->_nodeLayerMasks[i] & layerMask))
+            result.Push(octant->_nodes[i]);
+    }
+}
+
+void Octree::CollectOctantNodes(Vector<OctreeNode*>& result, const Octant* octant, const FrustumPlaneArray& planes, unsigned short nodeFlags,
+    unsigned layerMask) const
 {
     const Vector<OctreeNode*>& octantNodes = octant->_nodes;
-    for (auto it = octantNodes.Begin(); it != octantNodes.End(); ++it)
+    unsigned visibleIndices[CULL_BATCH_SIZE];
+
+    for (size_t start = 0; start < octantNodes.Size(); start += CULL_BATCH_SIZE)
     {
-        OctreeNode* node = *it;
-        if ((node->Flags() & nodeFlags) == nodeFlags && (node->GetLayerMask() & layerMask))
-            result.Push(node);
+        size_t numVisible = planes.CullBoxes(octant->_nodeBounds, start, Min(octantNodes.Size() - start, CULL_BATCH_SIZE), visibleIndices);
+        for (size_t i = 0; i < numVisible; ++i)
+        {
+            unsigned index = visibleIndices[i];
+            if ((octant->_nodeFlags[index] & nodeFlags) == nodeFlags && (octant->_nodeLayerMasks[index] & layerMask))
+                result.Push(octantNodes[index]);
+        }
     }
+}
+
+void Octree::CollectNodes(Vector<OctreeNode*>& result, const Octant* octant, unsigned short nodeFlags, unsigned layerMask) const
+{
+    CollectOctantNodes(result, octant, nodeFlags, layerMask);
 
     for (size_t i = 0; i < NUM_OCTANTS; ++i)
     {
@@ -362,6 +754,28 @@ void Octree::CollectNodes(Vector<OctreeNode*>& result, const Octant* octant, uns
     }
 }
 
+void Octree::CollectNodes(Vector<OctreeNode*>& result, const Octant* octant, const Frustum& frustum, const FrustumPlaneArray& planes,
+    unsigned short nodeFlags, unsigned layerMask) const
+{
+    Intersection res = frustum.IsInside(octant->_cullingBox);
+    if (res == OUTSIDE)
+        return;
+
+    // If this octant is completely inside the frustum, can include all contained octants and their nodes without further tests
+    if (res == INSIDE)
+        CollectNodes(result, octant, nodeFlags, layerMask);
+    else
+    {
+        CollectOctantNodes(result, octant, planes, nodeFlags, layerMask);
+
+        for (size_t i = 0; i < NUM_OCTANTS; ++i)
+        {
+            if (octant->_children[i])
+                CollectNodes(result, octant->_children[i], frustum, planes, nodeFlags, layerMask);
+        }
+    }
+}
+
 void Octree::CollectNodes(Vector<RaycastResult>& result, const Octant* octant, const Ray& ray, unsigned short nodeFlags, 
     float maxDistance, unsigned layerMask) const
 {
@@ -3,12 +3,18 @@
 #include "../Base/Allocator.h"
 #include "../Debug/Profiler.h"
 #include "../Math/BoundingBox.h"
+#include "../Math/BoundingBoxArray.h"
 #include "OctreeNode.h"
 
 namespace Auto3D
 {
 
 static const size_t NUM_OCTANTS = 8;
+static const int MAX_OCTREE_LEVELS = 256;
+/// Maximum number of pending octants in a depth-first query of the linearized octree.
+static const size_t OCTREE_QUERY_STACK_SIZE = (NUM_OCTANTS - 1) * MAX_OCTREE_LEVELS + 1;
+/// Flag in a query stack entry telling that the octant is completely inside the query volume.
+static const unsigned LINEAR_OCTANT_INSIDE = 0x80000000;
 
 class Octree;
 class OctreeNode;
@@ -37,6 +43,8 @@ struct AUTO_API Octant
    
     /// Initialize parent and bounds.
     void Initialize(Octant* parent, const BoundingBoxF& boundingBox, int level);
+    /// Return bounding box of a child octant by index.
+    BoundingBoxF ChildBoundingBox(size_t index) const;
     /// Test if a node should be inserted in this octant or if a smaller child octant should be created.
     bool FitBoundingBox(const BoundingBoxF& box, const Vector3F& boxSize) const;
     /// Return child octant index based on _position.
@@ -54,6 +62,12 @@ struct AUTO_API Octant
     int _level;
     /// Nodes contained in the octant.
     Vector<OctreeNode*> _nodes;
+    /// World bounding boxes of the nodes, in the same order. Refreshed when the octree is updated.
+    BoundingBoxArray _nodeBounds;
+    /// Flags of the nodes, in the same order.
+    Vector<unsigned short> _nodeFlags;
+    /// Layer masks of the nodes, in the same order.
+    Vector<unsigned> _nodeLayerMasks;
     /// Child octants.
     Octant* _children[NUM_OCTANTS];
     /// Parent octant.
@@ -62,6 +76,19 @@ struct AUTO_API Octant
     size_t _numNodes;
 };
 
+/// %Octree cell in the linearized octree used for queries. Stored in breadth-first order, so that the children of each cell are consecutive.
+struct AUTO_API LinearOctant
+{
+    /// Expanded (loose) bounding box of the octant.
+    BoundingBoxF _cullingBox;
+    /// Octant, which holds the node arrays.
+    const Octant* _octant;
+    /// Index of the first child.
+    unsigned _firstChild;
+    /// Number of children that contain nodes.
+    unsigned _numChildren;
+};
+
 /// Acceleration structure for rendering. Should be created as a child of the scene root.
 class AUTO_API Octree : public Node
 {
@@ -76,7 +103,7 @@ public:
     /// Register factory and attributes.
     static void RegisterObject();
     
-    /// Process the queue of nodes to be reinserted.
+    /// Process the queue of nodes to be reinserted. The bounding boxes and target octants are calculated in worker threads when there are many nodes, after which the nodes are moved in one pass.
     void Update();
     /// Resize octree.
     void Resize(const BoundingBoxF& boundingBox, int numLevels);
@@ -86,18 +113,43 @@ public:
     void QueueUpdate(OctreeNode* node);
     /// Cancel a pending reinsertion.
     void CancelUpdate(OctreeNode* node);
-    /// Query for nodes with a raycast and return all results.
+    /// Refresh the cached flags and layer mask of a node. Called by the node when they change.
+    void UpdateNodeFlags(OctreeNode* node);
+    /// Query for nodes with a raycast and return all results. Processes pending reinsertions first, so that nodes moved since the last Update() are tested at their current bounds.
     void Raycast(Vector<RaycastResult>& result, const Ray& ray, unsigned short nodeFlags, float maxDistance = M_INFINITY, unsigned layerMask = LAYERMASK_ALL);
-    /// Query for nodes with a raycast and return the closest result.
+    /// Query for nodes with a raycast and return the closest result. Processes pending reinsertions first, so that nodes moved since the last Update() are tested at their current bounds.
     RaycastResult RaycastSingle(const Ray& ray, unsigned short nodeFlags, float maxDistance = M_INFINITY, unsigned layerMask = LAYERMASK_ALL);
 
-    /// Query for nodes using a volume such as frustum or sphere.
+    /// Query for nodes using a volume such as frustum or sphere. Nodes moved since the last Update() are tested at their bounds from that update.
     template <typename _Ty> void FindNodes(Vector<OctreeNode*>& result, const _Ty& volume, unsigned short nodeFlags, unsigned layerMask = LAYERMASK_ALL) const
     {
         PROFILE(QueryOctree);
-        CollectNodes(result, &_root, volume, nodeFlags, layerMask);
+
+        if (_linearOctantsDirty)
+        {
+            CollectNodes(result, &_root, volume, nodeFlags, layerMask);
+            return;
+        }
+
+        VisitLinearOctants(volume, [&](const Octant* octant, bool inside)
+        {
+            if (inside)
+                CollectOctantNodes(result, octant, nodeFlags, layerMask);
+            else
+            {
+                for (size_t i = 0; i < octant->_nodes.Size(); ++i)
+                {
+                    if ((octant->_nodeFlags[i] & nodeFlags) == nodeFlags && (octant->_nodeLayerMasks[i] & layerMask) &&
+                        volume.IsInsideFast(octant->_nodeBounds.Get(i)) != OUTSIDE)
+                        result.Push(octant->_nodes[i]);
+                }
+            }
+        });
     }
 
+    /// Query for nodes using a frustum. Tests the node bounds of each octant in batches with SIMD. Nodes moved since the last Update() are tested at their bounds from that update.
+    void FindNodes(Vector<OctreeNode*>& result, const Frustum& frustum, unsigned short nodeFlags, unsigned layerMask = LAYERMASK_ALL) const;
+
     /// Query for nodes using a volume such as frustum or sphere. Invoke a function for each octant.
     template <typename _Ty> void FindNodes(const _Ty& volume, void(*callback)(Vector<OctreeNode*>::ConstIterator, Vector<OctreeNode*>::ConstIterator, bool)) const
     {
@@ -112,7 +164,38 @@ public:
         CollectNodesMemberCallback(&_root, volume, object, callback);
     }
 
+    /// Query for octants that contain nodes using a volume such as frustum or sphere. Octants are returned in the same order as the callback versions of FindNodes() visit them, paired with a flag telling whether the octant is completely inside the volume.
+    template <typename _Ty> void FindOctants(Vector<Pair<const Octant*, bool> >& result, const _Ty& volume) const
+    {
+        PROFILE(QueryOctants);
+
+        if (_linearOctantsDirty)
+        {
+            CollectOctants(result, &_root, volume);
+            return;
+        }
+
+        VisitLinearOctants(volume, [&result](const Octant* octant, bool inside)
+        {
+            if (octant->_nodes.Size())
+                result.Push(MakePair(octant, inside));
+        });
+    }
+
+    /// Return whether the linearized octree is up to date. It is rebuilt by Update() after octants have been created or deleted, and queries use the octant hierarchy meanwhile.
+    bool IsLinearized() const { return !_linearOctantsDirty; }
+    /// Return the linearized octants in breadth-first order.
+    const Vector<LinearOctant>& LinearOctants() const { return _linearOctants; }
+    /// Return number of nodes moved to another octant in the last update.
+    size_t NumMovedNodes() const { return _numMovedNodes; }
+    /// Return number of queued nodes that stayed in their octant in the last update.
+    size_t NumSkippedNodes() const { return _numSkippedNodes; }
+    /// Return light interaction version. Changes when too many geometries changed to invalidate the lights' cached lit geometries individually.
+    unsigned LightInteractionVersion() const { return _lightInteractionVersion; }
+
 private:
+    /// Mark the cached lit geometries of lights whose bounds intersect a changed geometry node's bounds dirty.
+    void InvalidateLightInteractions(const BoundingBoxF& box);
     /// Set bounding box. Used in serialization.
     void SetBoundingBoxAttr(const BoundingBoxF& boundingBox);
     /// Return bounding box. Used in serialization.
@@ -123,23 +206,75 @@ private:
     int NumLevelsAttr() const;
     /// Add node to a specific octant.
     void AddNode(OctreeNode* node, Octant* octant);
-    /// Remove node from an octant.
-    void RemoveNode(OctreeNode* node, Octant* octant);
+    /// Remove node from an octant by its index in the octant. Erase octants left empty.
+    void RemoveNode(Octant* octant, size_t index);
+    /// Remove node from an octant by its index in the octant without erasing octants. Return true if an octant other than the root was left empty.
+    bool DetachNode(Octant* octant, size_t index);
+    /// Refresh the cached bounds, flags and layer mask of a node in its current octant.
+    void RefreshNode(OctreeNode* node);
+    /// Calculate world bounding boxes and target octant depths for a range of the update queue. Called also from worker threads.
+    void CalculateUpdates(size_t begin, size_t end);
+    /// Return how many levels below the root a bounding box should be inserted.
+    int InsertionDepth(const BoundingBoxF& box, const Vector3F& boxSize) const;
     /// Create a new child octant.
     Octant* CreateChildOctant(Octant* octant, size_t index);
     /// Delete one child octant.
     void DeleteChildOctant(Octant* octant, size_t index);
     /// Delete a child octant hierarchy. If not deleting the octree for good, moves any nodes back to the root octant.
     void DeleteChildOctants(Octant* octant, bool deletingOctree);
+    /// Delete child octants that contain no nodes, recursively.
+    void DeleteEmptyChildOctants(Octant* octant);
+    /// Rebuild the linearized octants from the octant hierarchy.
+    void BuildLinearOctants();
+    /// Get the nodes matching flags from one octant, using the cached node flags and layer masks.
+    void CollectOctantNodes(Vector<OctreeNode*>& result, const Octant* octant, unsigned short nodeFlags, unsigned layerMask) const;
+    /// Get the nodes matching flags from one octant that are inside a frustum, using the cached node bounds, flags and layer masks.
+    void CollectOctantNodes(Vector<OctreeNode*>& result, const Octant* octant, const FrustumPlaneArray& planes, unsigned short nodeFlags, unsigned layerMask) const;
     /// Get all nodes from an octant recursively.
     void CollectNodes(Vector<OctreeNode*>& result, const Octant* octant) const;
     /// Get all visible nodes matching flags from an octant recursively.
     void CollectNodes(Vector<OctreeNode*>& result, const Octant* octant, unsigned short nodeFlags, unsigned layerMask) const;
+    /// Get all visible nodes matching flags using a frustum.
+    void CollectNodes(Vector<OctreeNode*>& result, const Octant* octant, const Frustum& frustum, const FrustumPlaneArray& planes, unsigned short nodeFlags, unsigned layerMask) const;
     /// Get all visible nodes matching flags along a ray.
     void CollectNodes(Vector<RaycastResult>& result, const Octant* octant, const Ray& ray, unsigned short nodeFlags, float maxDistance, unsigned layerMask) const;
     /// Get all visible nodes matching flags that could be potential raycast hits.
     void CollectNodes(Vector<Pair<OctreeNode*, float> >& result, const Octant* octant, const Ray& ray, unsigned short nodeFlags, float maxDistance, unsigned layerMask) const;
 
+    /// Visit the linearized octants that intersect a volume depth-first with an explicit stack, in the same order as the recursive queries. The visitor receives the octant and whether it is completely inside the volume.
+    template <typename _Ty, typename _Visitor> void VisitLinearOctants(const _Ty& volume, const _Visitor& visitor) const
+    {
+        unsigned stack[OCTREE_QUERY_STACK_SIZE];
+        size_t stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while (stackSize)
+        {
+            unsigned entry = stack[--stackSize];
+            unsigned inside = entry & LINEAR_OCTANT_INSIDE;
+            const LinearOctant& linearOctant = _linearOctants[entry & ~LINEAR_OCTANT_INSIDE];
+
+            // Once an octant is completely inside the volume, its children need no further tests
+            if (!inside)
+            {
+                Intersection res = volume.IsInside(linearOctant._cullingBox);
+                if (res == OUTSIDE)
+                    continue;
+                if (res == INSIDE)
+                    inside = LINEAR_OCTANT_INSIDE;
+            }
+
+            visitor(linearOctant._octant, inside != 0);
+
+            // Push the children in reverse so that they are visited in index order
+            for (unsigned i = linearOctant._numChildren; i > 0; --i)
+                stack[stackSize++] = (linearOctant._firstChild + i - 1) | inside;
+        }
+    }
+
+    /// Visit the linearized octants that a ray hits within the maximum distance, in the same order as the recursive queries.
+    template <typename _Visitor> void VisitLinearOctants(const Ray& ray, float maxDistance, const _Visitor& visitor) const;
+
     /// Collect nodes matching flags using a volume such as frustum or sphere.
     template <typename _Ty> void CollectNodes(Vector<OctreeNode*>& result, const Octant* octant, const _Ty& volume, unsigned short nodeFlags, unsigned layerMask) const
     {
@@ -169,6 +304,47 @@ private:
         }
     }
     
+    /// Collect octants containing nodes from octant and child octants. All are inside the query volume.
+    void CollectOctants(Vector<Pair<const Octant*, bool> >& result, const Octant* octant) const
+    {
+        if (!octant->_numNodes)
+            return;
+        if (octant->_nodes.Size())
+            result.Push(MakePair(octant, true));
+
+        for (size_t i = 0; i < NUM_OCTANTS; ++i)
+        {
+            if (octant->_children[i])
+                CollectOctants(result, octant->_children[i]);
+        }
+    }
+
+    /// Collect octants containing nodes using a volume such as frustum or sphere.
+    template <typename _Ty> void CollectOctants(Vector<Pair<const Octant*, bool> >& result, const Octant* octant, const _Ty& volume) const
+    {
+        if (!octant->_numNodes)
+            return;
+
+        Intersection res = volume.IsInside(octant->_cullingBox);
+        if (res == OUTSIDE)
+            return;
+
+        // If this octant is completely inside the volume, can include all contained octants without further tests
+        if (res == INSIDE)
+            CollectOctants(result, octant);
+        else
+        {
+            if (octant->_nodes.Size())
+                result.Push(MakePair(octant, false));
+
+            for (size_t i = 0; i < NUM_OCTANTS; ++i)
+            {
+                if (octant->_children[i])
+                    CollectOctants(result, octant->_children[i], volume);
+            }
+        }
+    }
+
     /// Collect nodes from octant and child octants. Invoke a function for each octant.
     void CollectNodesCallback(const Octant* octant, void(*callback)(Vector<OctreeNode*>::ConstIterator, Vector<OctreeNode*>::ConstIterator, bool)) const
     {
@@ -243,6 +419,14 @@ private:
 
     /// Queue of nodes to be reinserted.
     Vector<OctreeNode*> _updateQueue;
+    /// Target octant depths of the queued nodes, or negative if staying in the current octant.
+    Vector<int> _updateDepths;
+    /// World bounding boxes of the queued nodes before the update.
+    Vector<BoundingBoxF> _oldBounds;
+    /// Lights found when invalidating light interactions.
+    Vector<OctreeNode*> _invalidatedLights;
+    /// Nodes moving to another octant during update.
+    Vector<Pair<OctreeNode*, Octant*> > _moves;
     /// RaycastSingle initial coarse result.
     Vector<Pair<OctreeNode*, float> > _initialRes;
     /// RaycastSingle final result.
@@ -251,6 +435,18 @@ private:
     Allocator<Octant> _allocator;
     /// Root octant.
     Octant _root;
+    /// Linearized octants for queries, in breadth-first order.
+    Vector<LinearOctant> _linearOctants;
+    /// Linearized octants dirty flag. Set when octants are created or deleted.
+    bool _linearOctantsDirty;
+    /// Number of nodes moved to another octant in the last update.
+    size_t _numMovedNodes;
+    /// Number of queued nodes that stayed in their octant in the last update.
+    size_t _numSkippedNodes;
+    /// Number of lights in the octree.
+    size_t _numLights;
+    /// Light interaction version.
+    unsigned _lightInteractionVersion;
 };
 
 }
\ No newline at end of file
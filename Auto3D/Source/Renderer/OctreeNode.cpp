@@ -9,6 +9,7 @@ namespace Auto3D
 OctreeNode::OctreeNode() :
     _octree(nullptr),
     _octant(nullptr),
+    _octantIndex(0),
     _lastFrameNumber(0),
     _distance(0.0f)
 {
@@ -29,6 +30,8 @@ void OctreeNode::RegisterObject()
 void OctreeNode::SetCastShadows(bool enable)
 {
     SetFlag(NF_CASTSHADOWS, enable);
+    if (_octree)
+        _octree->UpdateNodeFlags(this);
 }
 
 void OctreeNode::OnPrepareRender(unsigned frameNumber, Camera* camera)
@@ -76,6 +79,21 @@ void OctreeNode::OnTransformChanged()
         _octree->QueueUpdate(this);
 }
 
+void OctreeNode::OnSetEnabled(bool newEnabled)
+{
+    SpatialNode::OnSetEnabled(newEnabled);
+    // The octree caches the flags for queries
+    if (_octree)
+        _octree->UpdateNodeFlags(this);
+}
+
+void OctreeNode::OnSetLayer(unsigned char newLayer)
+{
+    SpatialNode::OnSetLayer(newLayer);
+    if (_octree)
+        _octree->UpdateNodeFlags(this);
+}
+
 void OctreeNode::OnWorldBoundingBoxUpdate() const
 {
     // The OctreeNode base class does not have a defined _size, so represent as a point
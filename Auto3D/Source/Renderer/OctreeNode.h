@@ -28,7 +28,7 @@ public:
     /// Register attributes.
     static void RegisterObject();
 
-    /// Prepare object for rendering. Reset framenumber and calculate distance from camera. Called by Renderer.
+    /// Prepare object for rendering. Reset framenumber and calculate distance from camera. Called by Renderer, possibly from a worker thread, so must only modify the node itself.
     virtual void OnPrepareRender(unsigned frameNumber, Camera* camera);
     /// Perform ray test on self and add possible hit to the result vector.
     virtual void OnRaycast(Vector<RaycastResult>& dest, const Ray& ray, float maxDistance);
@@ -54,6 +54,10 @@ protected:
     void OnSceneSet(Scene* newScene, Scene* oldScene) override;
     /// Handle the transform matrix changing.
     void OnTransformChanged() override;
+    /// Handle the enabled status changing.
+    void OnSetEnabled(bool newEnabled) override;
+    /// Handle the layer changing.
+    void OnSetLayer(unsigned char newLayer) override;
     /// Recalculate the world space bounding box.
     virtual void OnWorldBoundingBoxUpdate() const;
 
@@ -72,6 +76,8 @@ private:
     Octree* _octree;
     /// Current octree octant.
     Octant* _octant;
+    /// Index in the current octant's node and node bounds arrays.
+    size_t _octantIndex;
 };
 
 }
@@ -5,6 +5,7 @@
 #include "../Graphics/ShaderVariation.h"
 #include "../Graphics/Shader.h"
 #include "../Graphics/Texture.h"
+#include "../IO/JSONDocument.h"
 #include "../Resource/JSONFile.h"
 #include "../Resource/ResourceCache.h"
 
@@ -29,16 +30,17 @@ bool PBRMaterial::EndLoad()
 {
 	PROFILE(EndLoadMaterial);
 
-	const JSONValue& root = _loadJSON->Root();
+	const JSONNode& root = _loadJSON->Root();
 
 	_passes.Clear();
-	if (root.Contains("passes"))
+	const JSONNode& jsonPasses = root["passes"];
+	if (jsonPasses.IsObject())
 	{
-		const JSONObject& jsonPasses = root["passes"].GetObject();
-		for (auto it = jsonPasses.Begin(); it != jsonPasses.End(); ++it)
+		for (size_t i = 0; i < jsonPasses.Size(); ++i)
 		{
-			Pass* newPass = CreatePass(it->_first);
-			newPass->LoadJSON(it->_second);
+			const JSONMember& jsonPass = jsonPasses.Member(i);
+			Pass* newPass = CreatePass(jsonPass._key);
+			newPass->LoadJSON(jsonPass._value.ToValue());
 		}
 	}
 
@@ -46,34 +48,37 @@ bool PBRMaterial::EndLoad()
 	if (root.Contains("vsConstantBuffer"))
 	{
 		_constantBuffers[ShaderStage::VS] = new ConstantBuffer();
-		_constantBuffers[ShaderStage::VS]->LoadJSON(root["vsConstantBuffer"].GetObject());
+		_constantBuffers[ShaderStage::VS]->LoadJSON(root["vsConstantBuffer"].ToValue());
 	}
 
 	_constantBuffers[ShaderStage::PS].Reset();
 	if (root.Contains("psConstantBuffer"))
 	{
 		_constantBuffers[ShaderStage::PS] = new ConstantBuffer();
-		_constantBuffers[ShaderStage::PS]->LoadJSON(root["psConstantBuffer"].GetObject());
+		_constantBuffers[ShaderStage::PS]->LoadJSON(root["psConstantBuffer"].ToValue());
 	}
 
 	/// \todo Queue texture loads during BeginLoad()
 	ResetTextures();
-	if (root.Contains("textures"))
+	if (root["textures"].IsObject())
 	{
 		ResourceCache* cache = Subsystem<ResourceCache>();
-		const JSONObject& jsonTextures = root["textures"].GetObject();
-		for (auto it = jsonTextures.Begin(); it != jsonTextures.End(); ++it)
-			SetTexture(it->_first.ToInt(), cache->LoadResource<Texture>(it->_second.GetString()));
+		const JSONNode& jsonTextures = root["textures"];
+		for (size_t i = 0; i < jsonTextures.Size(); ++i)
+		{
+			const JSONMember& jsonTexture = jsonTextures.Member(i);
+			SetTexture(String::ToInt(jsonTexture._key), cache->LoadResource<Texture>(jsonTexture._value.GetString()));
+		}
 	}
-	if (root.Contains("texturesMap"))
+	if (root["texturesMap"].IsObject())
 	{
 		ResourceCache* cache = Subsystem<ResourceCache>();
-		const JSONObject& jsonTextures = root["texturesMap"].GetObject();
+		const JSONNode& jsonTextures = root["texturesMap"];
 		Vector<Image*> imageData;
 		Vector<ImageLevel> faces;
 
-		for (auto it = jsonTextures.Begin(); it != jsonTextures.End(); ++it)
-			imageData.Push(cache->LoadResource<Image>(it->_second.GetString()));
+		for (size_t i = 0; i < jsonTextures.Size(); ++i)
+			imageData.Push(cache->LoadResource<Image>(jsonTextures.Member(i)._value.GetString()));
 
 
 		for (int i = 0; i < MAX_CUBE_FACES; ++i)
@@ -85,7 +90,7 @@ bool PBRMaterial::EndLoad()
 		textureCube->Define(TextureType::TEX_CUBE, ResourceUsage::DEFAULT, imageData[0]->GetLevel(0)._size, imageData[0]->GetFormat(), 1, &faces[0]);
 		textureCube->DefineSampler(TextureFilterMode::COMPARE_TRILINEAR, TextureAddressMode::CLAMP, TextureAddressMode::CLAMP, TextureAddressMode::CLAMP);
 		textureCube->SetDataLost(false);
-		SetTexture(jsonTextures.Begin()->_first.ToInt(), textureCube);
+		SetTexture(String::ToInt(jsonTextures.Member(0)._key), textureCube);
 
 	}
 
@@ -40,10 +40,11 @@ struct AUTO_API RenderPassDesc
 	}
 
 	/// Construct with parameters.
-	RenderPassDesc(const String& name, RenderCommandSortMode::Type sort = RenderCommandSortMode::STATE, bool lit = true) :
+	RenderPassDesc(const String& name, RenderCommandSortMode::Type sort = RenderCommandSortMode::STATE, bool lit = true, bool clustered = false) :
 		_name(name),
 		_sort(sort),
-		_lit(lit)
+		_lit(lit),
+		_clustered(clustered)
 	{
 	}
 
@@ -53,6 +54,8 @@ struct AUTO_API RenderPassDesc
 	RenderCommandSortMode::Type _sort;
 	/// Lighting flag.
 	bool _lit;
+	/// Clustered lighting flag. When set, lit geometries are drawn once with all lights of their view space clusters instead of one additive pass per 4 lights. Shadows are not supported.
+	bool _clustered;
 };
 
 }
\ No newline at end of file
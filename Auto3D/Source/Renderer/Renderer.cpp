@@ -8,6 +8,7 @@
 #include "../Graphics/VertexBuffer.h"
 #include "../Resource/ResourceCache.h"
 #include "../Scene/Scene.h"
+#include "../Thread/WorkQueue.h"
 #include "../Math/Matrix4x4.h"
 #include "../Math/Matrix3x4.h"
 
@@ -35,6 +36,18 @@ static const unsigned LPS_LIGHT0 = (0x10 | 0x20 | 0x40);
 static const unsigned LPS_LIGHT1 = (0x80 | 0x100 | 0x200);
 static const unsigned LPS_LIGHT2 = (0x400 | 0x800 | 0x1000);
 static const unsigned LPS_LIGHT3 = (0x2000 | 0x4000 | 0x8000);
+static const unsigned LPS_CLUSTERED = 0x10000;
+
+/// Target number of culling work items per thread, including the main thread.
+static const size_t CULL_ITEMS_PER_THREAD = 4;
+/// Minimum number of octree nodes in a culling work item.
+static const size_t MIN_CULL_ITEM_NODES = 64;
+/// Number of node bounding boxes to frustum test per SIMD culling call.
+static const size_t CULL_BATCH_SIZE = 64;
+/// Number of instance vertex buffer regions, so that the CPU can write one while the GPU reads the previous frames' regions.
+static const size_t NUM_INSTANCE_BUFFER_REGIONS = 3;
+/// Initial number of instance transforms per instance vertex buffer region.
+static const size_t INITIAL_INSTANCE_BUFFER_SIZE = 1024;
 
 static const CullMode::Type cullModeFlip[] =
 {
@@ -57,7 +70,8 @@ const String lightDefines[] =
     "DIRLIGHT",
     "POINTLIGHT",
     "SPOTLIGHT",
-    "SHADOW"
+    "SHADOW",
+    "CLUSTERED"
 };
 
 inline bool CompareLights(Light* lhs, Light* rhs)
@@ -66,8 +80,11 @@ inline bool CompareLights(Light* lhs, Light* rhs)
 }
 
 Renderer::Renderer() :
+    _lightClustersBuilt(false),
     _frameNumber(0),
-    _instanceTransformsDirty(false)
+    _depthBucketScale(0.0f),
+    _numInstances(0),
+    _instanceDemand(0)
 {
 	RegisterSubsystem(this);
 }
@@ -130,14 +147,16 @@ bool Renderer::CollectObjects(Scene* scene, Camera* camera)
     // Acquire Graphics subsystem now, which needs to be initialized with a screen mode
     _geometries.Clear();
     _lights.Clear();
-    _instanceTransforms.Clear();
-    _lightLists.Clear();
-    _lightPasses.Clear();
+    BeginInstances();
+    // Light lists and light passes are kept across frames. The ones left unused are removed after collecting light interactions
+    for (auto it = _lightLists.Begin(); it != _lightLists.End(); ++it)
+        it->_second._useCount = 0;
     for (auto it = _batchQueues.Begin(); it != _batchQueues.End(); ++it)
         it->_second.Clear();
     for (auto it = _shadowMaps.Begin(); it != _shadowMaps.End(); ++it)
         it->Clear();
     _usedShadowViews = 0;
+    _lightClustersBuilt = false;
 
     _scenes = scene;
     _camera = camera;
@@ -154,8 +173,20 @@ bool Renderer::CollectObjects(Scene* scene, Camera* camera)
     _octree->Update();
 
     _frustum = _camera->GetWorldFrustum();
+    _frustumPlanes.Define(_frustum);
     _viewMask = _camera->GetViewMask();
-    _octree->FindNodes(_frustum, this, &Renderer::CollectGeometriesAndLights);
+    _depthBucketScale = (float)SORT_KEY_DEPTH_BUCKETS / Max(_camera->GetFarClip(), M_EPSILON);
+
+    WorkQueue* workQueue = Subsystem<WorkQueue>();
+    if (workQueue && workQueue->NumThreads())
+        CollectGeometriesAndLightsThreaded(workQueue);
+    else
+    {
+        _visibleOctants.Clear();
+        _octree->FindOctants(_visibleOctants, _frustum);
+        for (auto it = _visibleOctants.Begin(); it != _visibleOctants.End(); ++it)
+            CollectGeometriesAndLights(it->_first, it->_second, _geometries, _lights);
+    }
 
     return true;
 }
@@ -182,9 +213,11 @@ void Renderer::CollectLightInteractions()
         // Create a light list that contains only this light. It will be used for nodes that have no light interactions so far
         unsigned long long key = (unsigned long long)light;
         LightList* lightList = &_lightLists[key];
-        lightList->_lights.Push(light);
-        lightList->_key = key;
-        lightList->_useCount = 0;
+        if (lightList->_lights.IsEmpty())
+        {
+            lightList->_lights.Push(light);
+            lightList->_key = key;
+        }
         
         switch (light->GetLightType())
         {
@@ -201,9 +234,15 @@ void Renderer::CollectLightInteractions()
             break;
 
         case LightType::POINT:
-            _octree->FindNodes(reinterpret_cast<Vector<OctreeNode*>&>(_litGeometries), light->GetWorldSphere(), NF_ENABLED |
-                NF_GEOMETRY, lightMask);
-            for (auto gIt = _litGeometries.Begin(), gEnd = _litGeometries.End(); gIt != gEnd; ++gIt)
+            if (light->_litGeometriesDirty || light->_litGeometriesVersion != _octree->LightInteractionVersion())
+            {
+                light->_litGeometries.Clear();
+                _octree->FindNodes(reinterpret_cast<Vector<OctreeNode*>&>(light->_litGeometries), light->GetWorldSphere(),
+                    NF_ENABLED | NF_GEOMETRY, lightMask);
+                light->_litGeometriesVersion = _octree->LightInteractionVersion();
+                light->_litGeometriesDirty = false;
+            }
+            for (auto gIt = light->_litGeometries.Begin(), gEnd = light->_litGeometries.End(); gIt != gEnd; ++gIt)
             {
                 GeometryNode* node = *gIt;
                 // Add light only to nodes which are actually inside the frustum this frame
@@ -216,9 +255,15 @@ void Renderer::CollectLightInteractions()
             break;
 
         case LightType::SPOT:
-            _octree->FindNodes(reinterpret_cast<Vector<OctreeNode*>&>(_litGeometries), light->GetWorldFrustum(), NF_ENABLED |
-                NF_GEOMETRY, lightMask);
-            for (auto gIt = _litGeometries.Begin(), gEnd = _litGeometries.End(); gIt != gEnd; ++gIt)
+            if (light->_litGeometriesDirty || light->_litGeometriesVersion != _octree->LightInteractionVersion())
+            {
+                light->_litGeometries.Clear();
+                _octree->FindNodes(reinterpret_cast<Vector<OctreeNode*>&>(light->_litGeometries), light->GetWorldFrustum(),
+                    NF_ENABLED | NF_GEOMETRY, lightMask);
+                light->_litGeometriesVersion = _octree->LightInteractionVersion();
+                light->_litGeometriesDirty = false;
+            }
+            for (auto gIt = light->_litGeometries.Begin(), gEnd = light->_litGeometries.End(); gIt != gEnd; ++gIt)
             {
                 GeometryNode* node = *gIt;
                 if (node->LastFrameNumber() == _frameNumber)
@@ -283,6 +328,7 @@ void Renderer::CollectLightInteractions()
             RenderQueue& shadowQueue = view->_shadowQueue;
             shadowQueue._sort = RenderCommandSortMode::STATE;
             shadowQueue._lit = false;
+            shadowQueue._clustered = false;
             shadowQueue._baseIndex = Material::PassIndex("shadow");
             shadowQueue._additiveIndex = 0;
 
@@ -302,16 +348,16 @@ void Renderer::CollectLightInteractions()
                 // shadow frustum is inside the view at all
                 /// \todo Could use a frustum-frustum test for more accuracy
                 if (_frustum.IsInsideFast(BoundingBoxF(shadowFrustum)))
-                    CollectShadowBatches(_litGeometries, shadowQueue, shadowFrustum, true, true);
+                    CollectShadowBatches(light->_litGeometries, shadowQueue, shadowFrustum, true, true);
                 break;
 
             case LightType::SPOT:
                 // For spot light only need to check which lit geometries are shadow casters
-                CollectShadowBatches(_litGeometries, shadowQueue, shadowFrustum, true, false);
+                CollectShadowBatches(light->_litGeometries, shadowQueue, shadowFrustum, true, false);
                 break;
             }
 
-            shadowQueue.Sort(_instanceTransforms);
+            SortBatchQueue(shadowQueue);
 
             // Mark shadow map for rendering only if it has a view with some batches
             if (shadowQueue._batches.Size())
@@ -339,6 +385,23 @@ void Renderer::CollectLightInteractions()
             if (!list._useCount)
                 continue;
 
+            // A light list kept from earlier frames has the same lights. Reuse its light passes if their constant data is still valid
+            if (list._lightPasses.Size())
+            {
+                bool valid = true;
+                for (auto lpIt = list._lightPasses.Begin(); lpIt != list._lightPasses.End() && valid; ++lpIt)
+                    valid = IsLightPassValid(**lpIt);
+
+                if (valid)
+                {
+                    for (auto lpIt = list._lightPasses.Begin(); lpIt != list._lightPasses.End(); ++lpIt)
+                        (*lpIt)->_lastFrameNumber = _frameNumber;
+                    continue;
+                }
+
+                list._lightPasses.Clear();
+            }
+
             // Sort lights according to the light pointer to prevent camera angle from changing the light list order and
             // causing extra shader variations to be compiled
             Sort(list._lights.Begin(), list._lights.End());
@@ -381,63 +444,51 @@ void Renderer::CollectLightInteractions()
                 unsigned long long passKey = 0;
                 for (size_t i = 0; i < currentPass.Size(); ++i)
                     passKey += (unsigned long long)currentPass[i] << (i * 16);
-                if (list._lightPasses.IsEmpty())
+                bool ambient = list._lightPasses.IsEmpty();
+                if (ambient)
                     ++passKey; // First pass includes ambient light
 
                 HashMap<unsigned long long, LightPass>::Iterator lpIt = _lightPasses.Find(passKey);
+                LightPass* lightPass;
                 if (lpIt != _lightPasses.End())
-                    list._lightPasses.Push(&lpIt->_second);
+                {
+                    lightPass = &lpIt->_second;
+                    if (!IsLightPassValid(*lightPass))
+                        SetupLightPass(lightPass, currentPass, ambient);
+                }
                 else
                 {
-                    LightPass* newLightPass = &_lightPasses[passKey];
-                    newLightPass->_vsBits = 0;
-                    newLightPass->_psBits = list._lightPasses.IsEmpty() ? LPS_AMBIENT : 0;
-                    for (size_t i = 0; i < MAX_LIGHTS_PER_PASS; ++i)
-                        newLightPass->_shadowMaps[i] = nullptr;
-
-                    size_t numShadowCoords = 0;
-                    for (size_t i = 0; i < currentPass.Size(); ++i)
-                    {
-                        Light* light = currentPass[i];
-                        newLightPass->_psBits |= (light->GetLightType() + 1) << (i * 3 + 4);
+                    lightPass = &_lightPasses[passKey];
+                    lightPass->_sortId = _lightPassIds.Allocate();
+                    SetupLightPass(lightPass, currentPass, ambient);
+                }
 
-                        float cutoff = cosf(light->GetFov() * 0.5f * M_DEGTORAD);
-                        newLightPass->_lightPositions[i] = Vector4F(light->GetWorldPosition(), 1.0f);
-                        newLightPass->_lightDirections[i] = Vector4F(-light->GetWorldDirection(), 0.0f);
-                        newLightPass->_lightAttenuations[i] = Vector4F(1.0f / Max(light->GetRange(), M_EPSILON), cutoff, 1.0f /
-                            (1.0f - cutoff), 0.0f);
-                        newLightPass->_lightColors[i] = light->GetColor();
+                lightPass->_lastFrameNumber = _frameNumber;
+                list._lightPasses.Push(lightPass);
+            }
+        }
+    }
 
-                        if (light->GetShadowMap())
-                        {
-                            // Enable shadowed shader variation, setup shadow parameters
-                            newLightPass->_psBits |= 4 << (i * 3 + 4);
-                            newLightPass->_shadowMaps[i] = light->GetShadowMap();
-
-                            const Vector<Matrix4x4F>& shadowMatrices = light->GetShadowMatrices();
-                            for (size_t j = 0; j < shadowMatrices.Size() && numShadowCoords < MAX_LIGHTS_PER_PASS; ++j)
-                                newLightPass->_shadowMatrices[numShadowCoords++] = shadowMatrices[j];
-
-                            newLightPass->_shadowParameters[i] = light->GetShadowParameters();
-
-                            if (light->GetLightType() == LightType::DIRECTIONAL)
-                            {
-                                float fadeStart = light->GetShadowFadeStart() * light->GetMaxShadowDistance() / _camera->GetFarClip();
-                                float fadeRange = light->GetMaxShadowDistance() / _camera->GetFarClip() - fadeStart;
-                                newLightPass->_dirShadowSplits = light->GetShadowSplits() / _camera->GetFarClip();
-                                newLightPass->_dirShadowFade = Vector4F(fadeStart / fadeRange, 1.0f / fadeRange, 0.0f, 0.0f);
-                            }
-                            else if (light->GetLightType() == LightType::POINT)
-                                newLightPass->_pointShadowParameters[i] = light->GetPointShadowParameters();
-                        }
+    {
+        PROFILE(RemoveUnusedLightPasses);
 
-                        newLightPass->_vsBits |= numShadowCoords << 2;
-                        newLightPass->_psBits |= numShadowCoords << 1;
-                    }
+        for (auto it = _lightLists.Begin(); it != _lightLists.End();)
+        {
+            if (!it->_second._useCount)
+                it = _lightLists.Erase(it);
+            else
+                ++it;
+        }
 
-                    list._lightPasses.Push(newLightPass);
-                }
+        for (auto it = _lightPasses.Begin(); it != _lightPasses.End();)
+        {
+            if (it->_second._lastFrameNumber != _frameNumber)
+            {
+                _lightPassIds.Free(it->_second._sortId);
+                it = _lightPasses.Erase(it);
             }
+            else
+                ++it;
         }
     }
 }
@@ -457,8 +508,12 @@ void Renderer::CollectBatches(const Vector<RenderPassDesc>& passes)
         currentQueues[i] = batchQueue;
         batchQueue->_sort = srcPass._sort;
         batchQueue->_lit = srcPass._lit;
+        batchQueue->_clustered = srcPass._lit && srcPass._clustered;
         batchQueue->_baseIndex = baseIndex;
-        batchQueue->_additiveIndex = srcPass._lit ? Material::PassIndex(srcPass._name + "add") : 0;
+        batchQueue->_additiveIndex = srcPass._lit && !srcPass._clustered ? Material::PassIndex(srcPass._name + "add") : 0;
+
+        if (batchQueue->_clustered)
+            BuildLightClusters();
     }
 
     // Loop through geometry nodes
@@ -474,7 +529,7 @@ void Renderer::CollectBatches(const Vector<RenderPassDesc>& passes)
         // Loop through node's geometries
         for (auto bIt = node->GetBatches().Begin(), bEnd = node->GetBatches().End(); bIt != bEnd; ++bIt)
         {
-            newBatch._geometry = bIt->_geometry.Get();
+            newBatch._geometry = bIt->_lodGeometry;
             Material* material = bIt->_material.Get();
             assert(material);
 
@@ -487,14 +542,21 @@ void Renderer::CollectBatches(const Vector<RenderPassDesc>& passes)
                 if (!newBatch._pass)
                     continue;
 
-                newBatch._lights = batchQueue._lit ? lightList ? lightList->_lightPasses[0] : &_ambientLightPass : nullptr;
+                if (batchQueue._clustered)
+                    newBatch._lights = &_clusteredLightPass;
+                else
+                    newBatch._lights = batchQueue._lit ? lightList ? lightList->_lightPasses[0] : &_ambientLightPass : nullptr;
                 if (batchQueue._sort < RenderCommandSortMode::BACK_TO_FRONT)
-                    newBatch.CalculateSortKey();
+                    newBatch.CalculateSortKey(DepthBucket(node->Distance()));
                 else
                     newBatch._distance = node->Distance();
 
                 batchQueue._batches.Push(newBatch);
 
+                // Clustered lighting draws all lights at once
+                if (batchQueue._clustered)
+                    continue;
+
                 // Create additive light batches if necessary
                 if (batchQueue._lit && lightList && lightList->_lightPasses.Size() > 1)
                 {
@@ -507,7 +569,7 @@ void Renderer::CollectBatches(const Vector<RenderPassDesc>& passes)
                         newBatch._lights = lightList->_lightPasses[i];
                         if (batchQueue._sort != RenderCommandSortMode::BACK_TO_FRONT)
                         {
-                            newBatch.CalculateSortKey();
+                            newBatch.CalculateSortKey(DepthBucket(node->Distance()));
                             batchQueue._additiveBatches.Push(newBatch);
                         }
                         else
@@ -523,17 +585,8 @@ void Renderer::CollectBatches(const Vector<RenderPassDesc>& passes)
         }
     }
 
-    size_t oldSize = _instanceTransforms.Size();
-
     for (auto qIt = currentQueues.Begin(); qIt != currentQueues.End(); ++qIt)
-    {
-        RenderQueue& batchQueue = **qIt;
-        batchQueue.Sort(_instanceTransforms);
-    }
-
-    // Check if more instances where added
-    if (_instanceTransforms.Size() != oldSize)
-        _instanceTransformsDirty = true;
+        SortBatchQueue(**qIt);
 }
 
 void Renderer::CollectBatches(const RenderPassDesc& pass)
@@ -609,6 +662,8 @@ void Renderer::Initialize()
     _psFrameConstantBuffer = new ConstantBuffer();
     constants.Clear();
     constants.Push(Constant(ElementType::VECTOR4, "ambientColor"));
+    constants.Push(Constant(ElementType::VECTOR4, "clusterParameters"));
+    constants.Push(Constant(ElementType::VECTOR4, "clusterDepthParameters"));
     _psFrameConstantBuffer->Define(ResourceUsage::DEFAULT, constants);
 
     _vsObjectConstantBuffer = new ConstantBuffer();
@@ -633,6 +688,25 @@ void Renderer::Initialize()
     constants.Push(Constant(ElementType::VECTOR4, "dirShadowFade"));
     _psLightConstantBuffer->Define(ResourceUsage::DEFAULT, constants);
 
+    _psClusterLightConstantBuffer = new ConstantBuffer();
+    constants.Clear();
+    constants.Push(Constant(ElementType::VECTOR4, "clusterLightPositions", MAX_CLUSTER_LIGHTS));
+    constants.Push(Constant(ElementType::VECTOR4, "clusterLightDirections", MAX_CLUSTER_LIGHTS));
+    constants.Push(Constant(ElementType::VECTOR4, "clusterLightAttenuations", MAX_CLUSTER_LIGHTS));
+    constants.Push(Constant(ElementType::VECTOR4, "clusterLightColors", MAX_CLUSTER_LIGHTS));
+    _psClusterLightConstantBuffer->Define(ResourceUsage::DEFAULT, constants);
+
+    // The cluster grid and light index list are raw unsigned data, declared as vectors to match the std140 array layout
+    _psClusterGridConstantBuffer = new ConstantBuffer();
+    constants.Clear();
+    constants.Push(Constant(ElementType::VECTOR4, "clusterGrid", NUM_CLUSTERS / 4));
+    _psClusterGridConstantBuffer->Define(ResourceUsage::DEFAULT, constants);
+
+    _psClusterLightIndexConstantBuffer = new ConstantBuffer();
+    constants.Clear();
+    constants.Push(Constant(ElementType::VECTOR4, "clusterLightIndices", MAX_CLUSTER_LIGHT_INDICES / 16));
+    _psClusterLightIndexConstantBuffer->Define(ResourceUsage::DEFAULT, constants);
+
     // Instance vertex buffer contains texcoords 4-6 which define the instances' world matrices
     _instanceVertexBuffer = new VertexBuffer();
     _instanceVertexElements.Push(VertexElement(ElementType::VECTOR4, ElementSemantic::TEXCOORD, INSTANCE_TEXCOORD, true));
@@ -642,6 +716,12 @@ void Renderer::Initialize()
     // Setup ambient light only -pass
     _ambientLightPass._vsBits = 0;
     _ambientLightPass._psBits = LPS_AMBIENT;
+    _ambientLightPass._sortId = 0;
+
+    // Setup clustered lighting pass. It is the only light pass used in clustered queues, so it can share the sort ID
+    _clusteredLightPass._vsBits = 0;
+    _clusteredLightPass._psBits = LPS_AMBIENT | LPS_CLUSTERED;
+    _clusteredLightPass._sortId = 0;
 
     // Setup point light face selection textures
     _faceSelectionTexture1 = new Texture();
@@ -692,54 +772,113 @@ void Renderer::DefineFaceSelectionTextures()
     _faceSelectionTexture2->SetDataLost(false);
 }
 
-void Renderer::CollectGeometriesAndLights(Vector<OctreeNode*>::ConstIterator begin, Vector<OctreeNode*>::ConstIterator end,
-    bool inside)
+void Renderer::CollectGeometriesAndLights(const Octant* octant, bool inside, Vector<GeometryNode*>& geometries,
+    Vector<Light*>& lights) const
 {
+    const Vector<OctreeNode*>& octantNodes = octant->_nodes;
+
     if (inside)
     {
-        for (auto it = begin; it != end; ++it)
+        for (size_t i = 0; i < octantNodes.Size(); ++i)
+            CollectGeometryOrLight(octant, i, geometries, lights);
+    }
+    else
+    {
+        // Test the octant's cached node bounds in batches before touching the nodes themselves
+        unsigned visibleIndices[CULL_BATCH_SIZE];
+        for (size_t start = 0; start < octantNodes.Size(); start += CULL_BATCH_SIZE)
         {
-            OctreeNode* node = *it;
-            unsigned short flags = node->Flags();
-            if ((flags & NF_ENABLED) && (flags & (NF_GEOMETRY | NF_LIGHT)) && (node->GetLayerMask() & _viewMask))
-            {
-                if (flags & NF_GEOMETRY)
-                {
-                    GeometryNode* geometry = static_cast<GeometryNode*>(node);
-                    geometry->OnPrepareRender(_frameNumber, _camera);
-                    _geometries.Push(geometry);
-                }
-                else
-                {
-                    Light* light = static_cast<Light*>(node);
-                    light->OnPrepareRender(_frameNumber, _camera);
-                    _lights.Push(light);
-                }
-            }
+            size_t numVisible = _frustumPlanes.CullBoxes(octant->_nodeBounds, start, Min(octantNodes.Size() - start, CULL_BATCH_SIZE),
+                visibleIndices);
+            for (size_t i = 0; i < numVisible; ++i)
+                CollectGeometryOrLight(octant, visibleIndices[i], geometries, lights);
         }
     }
-    else
+}
+
+void Renderer::CollectGeometryOrLight(const Octant* octant, size_t index, Vector<GeometryNode*>& geometries, Vector<Light*>& lights) const
+{
+    // Check the flags and layer mask cached in the octant before touching the node
+    unsigned short flags = octant->_nodeFlags[index];
+    if ((flags & NF_ENABLED) && (flags & (NF_GEOMETRY | NF_LIGHT)) && (octant->_nodeLayerMasks[index] & _viewMask))
     {
-        for (auto it = begin; it != end; ++it)
+        OctreeNode* node = octant->_nodes[index];
+        if (flags & NF_GEOMETRY)
         {
-            OctreeNode* node = *it;
-            unsigned short flags = node->Flags();
-            if ((flags & NF_ENABLED) && (flags & (NF_GEOMETRY | NF_LIGHT)) && (node->GetLayerMask() & _viewMask) &&
-                _frustum.IsInsideFast(node->WorldBoundingBox()))
+            GeometryNode* geometry = static_cast<GeometryNode*>(node);
+            geometry->OnPrepareRender(_frameNumber, _camera);
+            geometries.Push(geometry);
+        }
+        else
+        {
+            Light* light = static_cast<Light*>(node);
+            light->OnPrepareRender(_frameNumber, _camera);
+            lights.Push(light);
+        }
+    }
+}
+
+void Renderer::CollectGeometriesAndLightsThreaded(WorkQueue* workQueue)
+{
+    _visibleOctants.Clear();
+    _octree->FindOctants(_visibleOctants, _frustum);
+
+    size_t totalNodes = 0;
+    for (auto it = _visibleOctants.Begin(); it != _visibleOctants.End(); ++it)
+        totalNodes += it->_first->_nodes.Size();
+    if (!totalNodes)
+        return;
+
+    // Split the octants into work items of roughly equal node count. Results are stored per work item and merged in
+    // order, so that the result is identical to a single-threaded query regardless of which thread executed which item
+    size_t itemNodes = Max(totalNodes / ((workQueue->NumThreads() + 1) * CULL_ITEMS_PER_THREAD), MIN_CULL_ITEM_NODES);
+    size_t currentNodes = itemNodes;
+    _cullItemStarts.Clear();
+    for (size_t i = 0; i < _visibleOctants.Size(); ++i)
+    {
+        if (currentNodes >= itemNodes)
+        {
+            _cullItemStarts.Push(i);
+            currentNodes = 0;
+        }
+        currentNodes += _visibleOctants[i]._first->_nodes.Size();
+    }
+    _cullItemStarts.Push(_visibleOctants.Size());
+
+    size_t numItems = _cullItemStarts.Size() - 1;
+    if (_cullResults.Size() < numItems)
+        _cullResults.Resize(numItems);
+
+    // The octree update has refreshed the node transforms and bounding boxes; also refresh the camera's lazily evaluated
+    // view matrix so that the worker threads only read shared data
+    _camera->GetViewMatrix();
+
+    {
+        PROFILE(CullAndPrepareNodes);
+
+        workQueue->ParallelFor(numItems, 1, [this](size_t begin, size_t end, unsigned)
+        {
+            for (size_t i = begin; i < end; ++i)
             {
-                if (flags & NF_GEOMETRY)
-                {
-                    GeometryNode* geometry = static_cast<GeometryNode*>(node);
-                    geometry->OnPrepareRender(_frameNumber, _camera);
-                    _geometries.Push(geometry);
-                }
-                else
+                CullResult& result = _cullResults[i];
+                result._geometries.Clear();
+                result._lights.Clear();
+
+                for (size_t j = _cullItemStarts[i]; j < _cullItemStarts[i + 1]; ++j)
                 {
-                    Light* light = static_cast<Light*>(node);
-                    light->OnPrepareRender(_frameNumber, _camera);
-                    _lights.Push(light);
+                    CollectGeometriesAndLights(_visibleOctants[j]._first, _visibleOctants[j]._second, result._geometries, result._lights);
                 }
             }
+        });
+    }
+
+    {
+        PROFILE(MergeCullResults);
+
+        for (size_t i = 0; i < numItems; ++i)
+        {
+            _geometries.Push(_cullResults[i]._geometries);
+            _lights.Push(_cullResults[i]._lights);
         }
     }
 }
@@ -779,6 +918,133 @@ void Renderer::AddLightToNode(GeometryNode* node, Light* light, LightList* light
     }
 }
 
+void Renderer::SetupLightPass(LightPass* lightPass, const Vector<Light*>& lights, bool ambient)
+{
+    lightPass->_vsBits = 0;
+    lightPass->_psBits = ambient ? LPS_AMBIENT : 0;
+    lightPass->_numLights = lights.Size();
+    lightPass->_shadowed = false;
+    for (size_t i = 0; i < MAX_LIGHTS_PER_PASS; ++i)
+        lightPass->_shadowMaps[i] = nullptr;
+
+    size_t numShadowCoords = 0;
+    for (size_t i = 0; i < lights.Size(); ++i)
+    {
+        Light* light = lights[i];
+        lightPass->_lights[i] = light;
+        lightPass->_lightVersions[i] = light->GetVersion();
+        lightPass->_psBits |= (light->GetLightType() + 1) << (i * 3 + 4);
+
+        float cutoff = cosf(light->GetFov() * 0.5f * M_DEGTORAD);
+        lightPass->_lightPositions[i] = Vector4F(light->GetWorldPosition(), 1.0f);
+        lightPass->_lightDirections[i] = Vector4F(-light->GetWorldDirection(), 0.0f);
+        lightPass->_lightAttenuations[i] = Vector4F(1.0f / Max(light->GetRange(), M_EPSILON), cutoff, 1.0f /
+            (1.0f - cutoff), 0.0f);
+        lightPass->_lightColors[i] = light->GetColor();
+
+        if (light->GetShadowMap())
+        {
+            // Enable shadowed shader variation, setup shadow parameters
+            lightPass->_shadowed = true;
+            lightPass->_psBits |= 4 << (i * 3 + 4);
+            lightPass->_shadowMaps[i] = light->GetShadowMap();
+
+            const Vector<Matrix4x4F>& shadowMatrices = light->GetShadowMatrices();
+            for (size_t j = 0; j < shadowMatrices.Size() && numShadowCoords < MAX_LIGHTS_PER_PASS; ++j)
+                lightPass->_shadowMatrices[numShadowCoords++] = shadowMatrices[j];
+
+            lightPass->_shadowParameters[i] = light->GetShadowParameters();
+
+            if (light->GetLightType() == LightType::DIRECTIONAL)
+            {
+                float fadeStart = light->GetShadowFadeStart() * light->GetMaxShadowDistance() / _camera->GetFarClip();
+                float fadeRange = light->GetMaxShadowDistance() / _camera->GetFarClip() - fadeStart;
+                lightPass->_dirShadowSplits = light->GetShadowSplits() / _camera->GetFarClip();
+                lightPass->_dirShadowFade = Vector4F(fadeStart / fadeRange, 1.0f / fadeRange, 0.0f, 0.0f);
+            }
+            else if (light->GetLightType() == LightType::POINT)
+                lightPass->_pointShadowParameters[i] = light->GetPointShadowParameters();
+        }
+
+        lightPass->_vsBits |= numShadowCoords << 2;
+        lightPass->_psBits |= numShadowCoords << 1;
+    }
+}
+
+bool Renderer::IsLightPassValid(const LightPass& lightPass) const
+{
+    // Already built or checked on this frame
+    if (lightPass._lastFrameNumber == _frameNumber)
+        return true;
+    if (lightPass._shadowed)
+        return false;
+
+    for (size_t i = 0; i < lightPass._numLights; ++i)
+    {
+        const Light* light = lightPass._lights[i];
+        // A light that became shadowed needs shadow constants, and may also need to move to another pass
+        if (light->GetVersion() != lightPass._lightVersions[i] || light->GetShadowMap())
+            return false;
+    }
+
+    return true;
+}
+
+void Renderer::BuildLightClusters()
+{
+    if (_lightClustersBuilt)
+        return;
+
+    // The lights have been sorted by distance, so the nearest ones are kept if there are too many
+    WorkQueue* workQueue = Subsystem<WorkQueue>();
+    _lightClusters.Build(_camera, _lights, workQueue);
+    _lightClustersBuilt = true;
+
+    _psClusterLightConstantBuffer->SetData(&_lightClusters.LightData());
+    _psClusterGridConstantBuffer->SetData(_lightClusters.ClusterGrid());
+    _psClusterLightIndexConstantBuffer->SetData(_lightClusters.LightIndices());
+}
+
+void Renderer::BeginInstances()
+{
+    _numInstances = 0;
+    if (!_instanceVertexBuffer)
+        return;
+
+    size_t regionSize = _instanceVertexBuffer->NumRegions() ? _instanceVertexBuffer->RegionVertices() : INITIAL_INSTANCE_BUFFER_SIZE;
+    if (_instanceDemand > regionSize)
+        regionSize = NextPowerOfTwo(_instanceDemand);
+    _instanceDemand = 0;
+
+    if (!_instanceVertexBuffer->NumRegions() || _instanceVertexBuffer->RegionVertices() != regionSize)
+        _instanceVertexBuffer->DefineRing(NUM_INSTANCE_BUFFER_REGIONS, regionSize, _instanceVertexElements);
+    else
+        _instanceVertexBuffer->NextRegion();
+}
+
+void Renderer::SortBatchQueue(RenderQueue& batchQueue)
+{
+    InstanceData instances;
+
+    // Map only as much of the region as the queue can possibly use
+    size_t room = _instanceVertexBuffer && _instanceVertexBuffer->NumRegions() ? _instanceVertexBuffer->RegionVertices() - _numInstances : 0;
+    size_t maxInstances = Min(batchQueue.MaxInstances(), room);
+    if (maxInstances > 1)
+    {
+        instances._transforms = reinterpret_cast<Matrix3x4F*>(_instanceVertexBuffer->MapRegion(_numInstances, maxInstances));
+        instances._start = _instanceVertexBuffer->RegionStart() + _numInstances;
+        instances._capacity = instances._transforms ? maxInstances : 0;
+    }
+
+    batchQueue.Sort(instances);
+    if (instances._transforms)
+        _instanceVertexBuffer->UnmapRegion();
+
+    _numInstances += instances._count;
+    _instanceDemand += instances._count + instances._overflow;
+    PROFILE_COUNTER(InstanceBytesUploaded, (long long)(instances._count * sizeof(Matrix3x4F)));
+}
+
 void Renderer::CollectShadowBatches(const Vector<GeometryNode*>& nodes, RenderQueue& batchQueue, const Frustum& frustum,
     bool checkShadowCaster, bool checkFrustum)
 {
@@ -803,7 +1069,7 @@ void Renderer::CollectShadowBatches(const Vector<GeometryNode*>& nodes, RenderQu
         // Loop through node's geometries
         for (auto bIt = node->GetBatches().Begin(), bEnd = node->GetBatches().End(); bIt != bEnd; ++bIt)
         {
-            newBatch._geometry = bIt->_geometry.Get();
+            newBatch._geometry = bIt->_lodGeometry;
             Material* material = bIt->_material.Get();
             assert(material);
 
@@ -862,22 +1128,36 @@ void Renderer::RenderBatches(const Vector<Batch>& batches, Camera* camera, bool
         _vsFrameConstantBuffer->SetConstant(VS_FRAME_DEPTH_PARAMETERS, depthParameters);
         _vsFrameConstantBuffer->Apply();
 
+        // Map fragment coordinates to cluster columns and rows. When rendering to a texture on OpenGL the camera is
+        // flipped vertically, which reverses the rows compared to the light cluster assignment
+        const RectI& viewport = _graphics->GetViewport();
+        float clusterScaleX = (float)NUM_CLUSTERS_X / viewport.Width();
+        float clusterScaleY = (float)NUM_CLUSTERS_Y / viewport.Height();
+        Vector4F clusterParameters(clusterScaleX, clusterScaleY, -viewport.Left() * clusterScaleX, 0.0f);
+        if (_graphics->RenderTarget(0) || _graphics->DepthStencil())
+        {
+            clusterParameters._y = -clusterScaleY;
+            clusterParameters._w = NUM_CLUSTERS_Y + viewport.Top() * clusterScaleY;
+        }
+        else
+            clusterParameters._w = -(_graphics->GetRenderTargetHeight() - viewport.Bottom()) * clusterScaleY;
+
+        const Vector2F& depthSliceParameters = _lightClusters.DepthSliceParameters();
+        Vector4F clusterDepthParameters(depthSliceParameters._x, depthSliceParameters._y, (float)_lightClusters.NumDirLights(), 0.0f);
+
         /// \todo Add also fog settings
         _psFrameConstantBuffer->SetConstant(PS_FRAME_AMBIENT_COLOR, camera->GetAmbientColor());
+        _psFrameConstantBuffer->SetConstant(PS_FRAME_CLUSTER_PARAMETERS, clusterParameters);
+        _psFrameConstantBuffer->SetConstant(PS_FRAME_CLUSTER_DEPTH_PARAMETERS, clusterDepthParameters);
         _psFrameConstantBuffer->Apply();
 
         _graphics->SetConstantBuffer(ShaderStage::VS, RendererConstantBuffer::FRAME, _vsFrameConstantBuffer);
         _graphics->SetConstantBuffer(ShaderStage::PS, RendererConstantBuffer::FRAME, _psFrameConstantBuffer);
     }
 
-    if (_instanceTransformsDirty && _instanceTransforms.Size())
-    {
-        if (_instanceVertexBuffer->GetNumVertices() < _instanceTransforms.Size())
-            _instanceVertexBuffer->Define(ResourceUsage::DYNAMIC, NextPowerOfTwo(_instanceTransforms.Size()), _instanceVertexElements, false);
-        _instanceVertexBuffer->SetData(0, _instanceTransforms.Size(), &_instanceTransforms[0]);
+    // The instance transforms have already been written to the current instance vertex buffer region
+    if (_numInstances)
         _graphics->SetVertexBuffer(1, _instanceVertexBuffer);
-        _instanceTransformsDirty = false;
-    }
     
     {
         Pass* lastPass = nullptr;
@@ -900,7 +1180,7 @@ void Renderer::RenderBatches(const Vector<Batch>& batches, Camera* camera, bool
                 // Get the shader variations
                 LightPass* lights = batch._lights;
 				
-                ShaderVariation* vs = FindShaderVariation(ShaderStage::VS, pass, (unsigned short)batch._type | (lights ? lights->_vsBits : 0));
+                ShaderVariation* vs = FindShaderVariation(ShaderStage::VS, pass, (unsigned)batch._type | (lights ? lights->_vsBits : 0));
                 ShaderVariation* ps = FindShaderVariation(ShaderStage::PS, pass, lights ? lights->_psBits : 0);
 
 				// Test Shader for this lot
@@ -959,8 +1239,16 @@ void Renderer::RenderBatches(const Vector<Batch>& batches, Camera* camera, bool
                 // Apply light constant buffers and shadow maps
                 if (lights && lights != lastLights)
                 {
-                    // If light queue is ambient only, no need to update the constants
-                    if (lights->_psBits > LPS_AMBIENT)
+                    // Clustered lighting uses the per-frame cluster buffers. If light queue is ambient only, no need to
+                    // update the constants
+                    if (lights->_psBits & LPS_CLUSTERED)
+                    {
+                        _graphics->SetConstantBuffer(ShaderStage::PS, RendererConstantBuffer::CLUSTER_LIGHTS, _psClusterLightConstantBuffer.Get());
+                        _graphics->SetConstantBuffer(ShaderStage::PS, RendererConstantBuffer::CLUSTER_GRID, _psClusterGridConstantBuffer.Get());
+                        _graphics->SetConstantBuffer(ShaderStage::PS, RendererConstantBuffer::CLUSTER_LIGHT_INDICES,
+                            _psClusterLightIndexConstantBuffer.Get());
+                    }
+                    else if (lights->_psBits > LPS_AMBIENT)
                     {
                         if (lights->_vsBits & LVS_NUMSHADOWCOORDS)
                         {
@@ -1013,11 +1301,11 @@ void Renderer::LoadPassShaders(Pass* pass)
     pass->_shadersLoaded = true;
 }
 
-ShaderVariation* Renderer::FindShaderVariation(ShaderStage::Type stage, Pass* pass, unsigned short bits)
+ShaderVariation* Renderer::FindShaderVariation(ShaderStage::Type stage, Pass* pass, unsigned bits)
 {
     /// \todo Evaluate whether the hash lookup is worth the memory save vs using just straightforward vectors
-    HashMap<unsigned short, WeakPtr<ShaderVariation> >& variations = pass->_shaderVariations[stage];
-    HashMap<unsigned short, WeakPtr<ShaderVariation> >::Iterator it = variations.Find(bits);
+    HashMap<unsigned, WeakPtr<ShaderVariation> >& variations = pass->_shaderVariations[stage];
+    HashMap<unsigned, WeakPtr<ShaderVariation> >::Iterator it = variations.Find(bits);
 
     if (it != variations.End())
         return it->_second.Get();
@@ -1042,12 +1330,14 @@ ShaderVariation* Renderer::FindShaderVariation(ShaderStage::Type stage, Pass* pa
 
             for (size_t i = 0; i < MAX_LIGHTS_PER_PASS; ++i)
             {
-                unsigned short lightBits = (bits >> (i * 3 + 4)) & 7;
+                unsigned lightBits = (bits >> (i * 3 + 4)) & 7;
                 if (lightBits)
                     psString += " " + lightDefines[(lightBits & 3) + 1] + String((int)i);
                 if (lightBits & 4)
                     psString += " " + lightDefines[5] + String((int)i);
             }
+            if (bits & LPS_CLUSTERED)
+                psString += " " + lightDefines[6];
 
             it = variations.Insert(MakePair(bits, WeakPtr<ShaderVariation>(pass->_shaders[stage]->CreateVariation(psString.Trimmed()))));
             return it->_second.Get();
@@ -1,13 +1,16 @@
 #pragma once
 
 #include "../Base/AutoPtr.h"
+#include "../Base/IdAllocator.h"
 #include "../Graphics/Texture.h"
 #include "../Math/Color.h"
+#include "../Math/BoundingBoxArray.h"
 #include "../Math/Frustum.h"
 #include "../Resource/Image.h"
 
 #include "RenderPath.h"
 #include "Batch.h"
+#include "LightClusters.h"
 
 namespace Auto3D
 {
@@ -17,6 +20,8 @@ class GeometryNode;
 class Octree;
 class Scene;
 class VertexBuffer;
+class WorkQueue;
+struct Octant;
 
 /// Shader constant buffers used by high-level rendering.
 namespace RendererConstantBuffer
@@ -26,7 +31,10 @@ namespace RendererConstantBuffer
 		FRAME = 0,
 		OBJECT,
 		MATERIAL,
-		LIGHTS
+		LIGHTS,
+		CLUSTER_LIGHTS,
+		CLUSTER_GRID,
+		CLUSTER_LIGHT_INDICES
 	};
 };
 
@@ -39,6 +47,8 @@ static const size_t VS_FRAME_DEPTH_PARAMETERS = 3;
 static const size_t VS_OBJECT_WORLD_MATRIX = 0;
 static const size_t VS_LIGHT_SHADOW_MATRICES = 0;
 static const size_t PS_FRAME_AMBIENT_COLOR = 0;
+static const size_t PS_FRAME_CLUSTER_PARAMETERS = 1;
+static const size_t PS_FRAME_CLUSTER_DEPTH_PARAMETERS = 2;
 static const size_t PS_LIGHT_POSITIONS = 0;
 static const size_t PS_LIGHT_DIRECTIONS = 1;
 static const size_t PS_LIGHT_ATTENUATIONS = 2;
@@ -52,6 +62,15 @@ static const size_t PS_LIGHT_POINT_SHADOW_PARAMETERS = 7;
 static const size_t INSTANCE_TEXCOORD = 4;
 
 
+/// Visible geometries and lights found by one view culling work item.
+struct AUTO_API CullResult
+{
+    /// Geometries in frustum.
+    Vector<GeometryNode*> _geometries;
+    /// Lights in frustum.
+    Vector<Light*> _lights;
+};
+
 /// High-level rendering subsystem. Performs rendering of 3D scenes.
 class AUTO_API Renderer : public BaseSubsystem
 {
@@ -82,6 +101,8 @@ public:
     void RenderBatches(const Vector<RenderPassDesc>& passes);
     /// Render a pass to the currently set rendertarget and viewport. Convenience function for one pass only.
     void RenderBatches(const String& pass);
+    /// Return the light clusters of the current view. Built by CollectBatches() when a clustered pass is requested.
+    const LightClusters& GetLightClusters() const { return _lightClusters; }
 
     /// Per-frame vertex shader constant buffer.
     SharedPtr<ConstantBuffer> _vsFrameConstantBuffer;
@@ -93,15 +114,37 @@ public:
     SharedPtr<ConstantBuffer> _vsLightConstantBuffer;
     /// Lights pixel shader constant buffer.
     SharedPtr<ConstantBuffer> _psLightConstantBuffer;
+    /// Clustered lighting light data pixel shader constant buffer.
+    SharedPtr<ConstantBuffer> _psClusterLightConstantBuffer;
+    /// Clustered lighting cluster grid pixel shader constant buffer.
+    SharedPtr<ConstantBuffer> _psClusterGridConstantBuffer;
+    /// Clustered lighting light index list pixel shader constant buffer.
+    SharedPtr<ConstantBuffer> _psClusterLightIndexConstantBuffer;
 private:
     /// Initialize. Needs the Graphics subsystem and rendering context to exist.
     void Initialize();
     /// (Re)define face selection textures.
     void DefineFaceSelectionTextures();
-    /// Octree callback for collecting lights and geometries.
-    void CollectGeometriesAndLights(Vector<OctreeNode*>::ConstIterator begin, Vector<OctreeNode*>::ConstIterator end, bool inside);
+    /// Collect visible lights and geometries from an octant into result vectors. Called also from worker threads.
+    void CollectGeometriesAndLights(const Octant* octant, bool inside, Vector<GeometryNode*>& geometries, Vector<Light*>& lights) const;
+    /// Prepare and add an octant's node in frustum to the result vectors if it is an enabled geometry or light in the view mask.
+    void CollectGeometryOrLight(const Octant* octant, size_t index, Vector<GeometryNode*>& geometries, Vector<Light*>& lights) const;
+    /// Collect visible lights and geometries by splitting the visible octants into work items that are executed in worker threads.
+    void CollectGeometriesAndLightsThreaded(WorkQueue* workQueue);
     /// Assign a light list to a node. Creates new light lists as necessary to _handle multiple lights.
     void AddLightToNode(GeometryNode* node, Light* light, LightList* lightList);
+    /// Fill the constant data of a light pass from its lights.
+    void SetupLightPass(LightPass* lightPass, const Vector<Light*>& lights, bool ambient);
+    /// Return whether the constant data of a light pass is up to date for the current frame.
+    bool IsLightPassValid(const LightPass& lightPass) const;
+    /// Assign the visible lights to clusters and upload the cluster constant buffers, if not done yet this frame.
+    void BuildLightClusters();
+    /// Return the state sort key depth bucket for a view distance.
+    unsigned DepthBucket(float distance) const { return Min((unsigned)(Max(distance, 0.0f) * _depthBucketScale), SORT_KEY_DEPTH_BUCKETS - 1); }
+    /// Move to the next instance vertex buffer region at the start of a frame, growing the buffer if the previous frame did not fit.
+    void BeginInstances();
+    /// Sort a batch queue and write its instance transforms to the instance vertex buffer.
+    void SortBatchQueue(RenderQueue& batchQueue);
     /// Collect shadow caster batches.
     void CollectShadowBatches(const Vector<GeometryNode*>& nodes, RenderQueue& batchQueue, const Frustum& frustum, bool checkShadowCaster, bool checkFrustum);
     /// Render batches from a specific queue and camera.
@@ -109,7 +152,7 @@ private:
     /// Load shaders for a pass.
     void LoadPassShaders(Pass* pass);
     /// Return or create a shader variation for a pass. Vertex shader variations _handle different geometry types and pixel shader variations _handle different light combinations.
-    ShaderVariation* FindShaderVariation(ShaderStage::Type stage, Pass* pass, unsigned short bits);
+    ShaderVariation* FindShaderVariation(ShaderStage::Type stage, Pass* pass, unsigned bits);
     
     /// Graphics subsystem pointer.
     WeakPtr<Graphics> _graphics;
@@ -121,35 +164,53 @@ private:
     Octree* _octree;
     /// Camera's view frustum.
     Frustum _frustum;
+    /// Camera's view frustum planes for batch culling.
+    FrustumPlaneArray _frustumPlanes;
     /// Camera's view mask.
     unsigned _viewMask;
     /// Geometries in frustum.
     Vector<GeometryNode*> _geometries;
     /// Lights in frustum.
     Vector<Light*> _lights;
+    /// Octants in frustum, with flag for being completely inside.
+    Vector<Pair<const Octant*, bool> > _visibleOctants;
+    /// First visible octant index of each culling work item, followed by the total octant count.
+    Vector<size_t> _cullItemStarts;
+    /// Results of the culling work items.
+    Vector<CullResult> _cullResults;
     /// Batch queues per pass.
     HashMap<unsigned char, RenderQueue> _batchQueues;
-    /// Instance transforms for uploading to the instance vertex buffer.
-    Vector<Matrix3x4F> _instanceTransforms;
     /// Lit geometries query result.
     Vector<GeometryNode*> _litGeometries;
-    /// %Light lists.
+    /// %Light lists. Kept across frames and removed after a frame they were not used on.
     HashMap<unsigned long long, LightList> _lightLists;
-    /// %Light passes.
+    /// %Light passes. Kept across frames and removed after a frame they were not used on.
     HashMap<unsigned long long, LightPass> _lightPasses;
+    /// Allocator for light pass sort IDs.
+    IdAllocator _lightPassIds;
     /// Ambient only light pass.
     LightPass _ambientLightPass;
+    /// Light pass for clustered lighting, which has no per-pass light data.
+    LightPass _clusteredLightPass;
+    /// Light clusters.
+    LightClusters _lightClusters;
+    /// Whether the light clusters have been built this frame.
+    bool _lightClustersBuilt;
+    /// Depth bucket scale for state sort keys, calculated from the camera far clip distance.
+    float _depthBucketScale;
     /// Current frame number.
     unsigned _frameNumber;
-    /// Instance vertex buffer dirty flag.
-    bool _instanceTransformsDirty;
+    /// Instance transforms written to the current instance vertex buffer region.
+    size_t _numInstances;
+    /// Instance transforms requested during the current frame, including those that did not fit.
+    size_t _instanceDemand;
     /// Shadow maps.
     Vector<ShadowMap> _shadowMaps;
     /// Shadow views.
     Vector<AutoPtr<ShadowView> > _shadowViews;
     /// Used shadow views so far.
     size_t _usedShadowViews;
-    /// Instance transform vertex buffer.
+    /// Instance transform ring vertex buffer. Instance transforms are written directly to its mapped regions while building instances.
     AutoPtr<VertexBuffer> _instanceVertexBuffer;
     /// Vertex elements for the instance vertex buffer.
     Vector<VertexElement> _instanceVertexElements;
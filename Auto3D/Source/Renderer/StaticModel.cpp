@@ -57,7 +57,7 @@ void StaticModel::OnPrepareRender(unsigned frameNumber, Camera* camera)
                     if (lodDistance <= lodGeometries[j]->_lodDistance)
                         break;
                 }
-                _batches[i]._geometry = lodGeometries[j - 1];
+                _batches[i]._lodGeometry = lodGeometries[j - 1].Get();
             }
         }
     }
@@ -65,7 +65,16 @@ void StaticModel::OnPrepareRender(unsigned frameNumber, Camera* camera)
 
 void StaticModel::SetModel(Model* model)
 {
-    _model = model;
+    // The subscription is left as is when called from the load event handler, as resubscribing would destroy the handler being invoked
+    if (_model != model)
+    {
+        if (_model)
+            UnsubscribeFromEvent(_model->loadedEvent);
+        _model = model;
+        if (_model)
+            SubscribeToEvent(_model->loadedEvent, &StaticModel::HandleModelLoaded);
+    }
+
     _hasLodLevels = false;
 
     if (!_model)
@@ -108,4 +117,9 @@ ResourceRef StaticModel::ModelAttr() const
     return ResourceRef(Model::GetTypeStatic(), ResourceName(_model.Get()));
 }
 
+void StaticModel::HandleModelLoaded(Event&)
+{
+    SetModel(_model);
+}
+
 }
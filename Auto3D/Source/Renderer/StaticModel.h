@@ -37,6 +37,8 @@ private:
     void SetModelAttr(const ResourceRef& model);
     /// Return model attribute. Used in serialization.
     ResourceRef ModelAttr() const;
+    /// Take the model's new geometries and bounding box after it has been reloaded.
+    void HandleModelLoaded(Event& event);
 
     /// Current model resource.
     SharedPtr<Model> _model;
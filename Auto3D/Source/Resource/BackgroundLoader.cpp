@@ -0,0 +1,309 @@
+#include "../Debug/Log.h"
+#include "../Debug/Profiler.h"
+#include "../IO/Stream.h"
+#include "../Time/Time.h"
+#include "BackgroundLoader.h"
+#include "Resource.h"
+#include "ResourceCache.h"
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+BackgroundLoader::BackgroundLoader(ResourceCache* owner) :
+    _owner(owner)
+{
+}
+
+BackgroundLoader::~BackgroundLoader()
+{
+    // Wake up the thread in case it is waiting for work
+    _shouldRun = false;
+    _queueCondition.Set();
+    Stop();
+
+    MutexLock lock(_queueMutex);
+    _queue.Clear();
+    _deferredRequests.Clear();
+}
+
+void BackgroundLoader::ThreadFunction()
+{
+    while (_shouldRun)
+    {
+        Resource* resource = nullptr;
+        BackgroundLoadItem* item = nullptr;
+
+        {
+            MutexLock lock(_queueMutex);
+            for (auto it = _queue.Begin(); it != _queue.End(); ++it)
+            {
+                if (!it->_second._loaded)
+                {
+                    item = &it->_second;
+                    resource = item->_resource.Get();
+                    break;
+                }
+            }
+        }
+
+        if (!item)
+        {
+            // Nothing to load, wait for more. A resource queued after the check above sets the condition, so it is not missed
+            _queueCondition.Wait();
+            continue;
+        }
+
+        // The main thread does not remove an item until it has been loaded, so it is safe to access without the lock.
+        // Do not copy the shared pointer here, as reference counting is not thread-safe
+        bool success = false;
+        AutoPtr<Stream> stream = _owner->OpenResource(resource->Name());
+        if (stream)
+            success = resource->BeginLoad(*stream);
+
+        {
+            MutexLock lock(_queueMutex);
+            item->_stream = stream;
+            item->_success = success;
+            item->_loaded = true;
+        }
+        _loadedCondition.Set();
+    }
+}
+
+bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool sendEvent, Resource* caller)
+{
+    if (Thread::IsMainThread())
+    {
+        if (!caller)
+            return QueueResource(type, name, sendEvent, (const BackgroundLoadKey*)nullptr);
+
+        BackgroundLoadKey callerKey = MakePair(caller->GetType(), caller->NameHash());
+        return QueueResource(type, name, sendEvent, &callerKey);
+    }
+
+    // Objects are only created on the main thread, so defer the request. Hold back the caller from finishing until the
+    // request has been queued and its dependency is known
+    MutexLock lock(_queueMutex);
+    BackgroundLoadRequest request;
+    request._type = type;
+    request._name = name;
+    request._sendEvent = sendEvent;
+    if (caller)
+    {
+        request._caller = MakePair(caller->GetType(), caller->NameHash());
+        auto it = _queue.Find(request._caller);
+        if (it != _queue.End())
+            ++it->_second._pendingRequests;
+    }
+    _deferredRequests.Push(request);
+    return true;
+}
+
+void BackgroundLoader::WaitForResource(StringHash type, StringHash nameHash)
+{
+    PROFILE(WaitForBackgroundLoad);
+
+    BackgroundLoadKey key = MakePair(type, nameHash);
+
+    for (;;)
+    {
+        QueueDeferredRequests();
+
+        Vector<BackgroundLoadKey> dependencies;
+        bool ready = false;
+        {
+            MutexLock lock(_queueMutex);
+            auto it = _queue.Find(key);
+            // Not queued, or already finished
+            if (it == _queue.End())
+                return;
+
+            const BackgroundLoadItem& item = it->_second;
+            ready = item._loaded && !item._pendingRequests;
+            for (auto dIt = item._dependencies.Begin(); dIt != item._dependencies.End(); ++dIt)
+                dependencies.Push(*dIt);
+        }
+
+        // The item may have been loaded after the check, in which case the condition is already set and the wait returns at once
+        if (!ready)
+            _loadedCondition.Wait();
+        else if (dependencies.Size())
+        {
+            for (auto it = dependencies.Begin(); it != dependencies.End(); ++it)
+                WaitForResource(it->_first, it->_second);
+        }
+        else
+        {
+            FinishResource(key);
+            return;
+        }
+    }
+}
+
+void BackgroundLoader::FinishResources(int maxMs)
+{
+    PROFILE(FinishBackgroundLoads);
+
+    QueueDeferredRequests();
+
+    _finished.Clear();
+    {
+        MutexLock lock(_queueMutex);
+        for (auto it = _queue.Begin(); it != _queue.End(); ++it)
+        {
+            const BackgroundLoadItem& item = it->_second;
+            if (item._loaded && !item._pendingRequests && item._dependencies.IsEmpty())
+                _finished.Push(it->_first);
+        }
+    }
+
+    // Resources whose dependencies finish now will be finished on the next call
+    HiresTimer timer;
+    for (auto it = _finished.Begin(); it != _finished.End(); ++it)
+    {
+        FinishResource(*it);
+        if (timer.ElapsedUSec(false) >= maxMs * 1000LL)
+            break;
+    }
+}
+
+size_t BackgroundLoader::NumQueuedResources() const
+{
+    MutexLock lock(_queueMutex);
+    return _queue.Size();
+}
+
+bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool sendEvent, const BackgroundLoadKey* callerKey)
+{
+    BackgroundLoadKey key = MakePair(type, StringHash(name));
+    if (_owner->_resources.Contains(key))
+        return false;
+
+    MutexLock lock(_queueMutex);
+
+    // Reuse an existing request for the same resource
+    auto it = _queue.Find(key);
+    if (it == _queue.End())
+    {
+        SharedPtr<Object> newObject(Object::Create(type));
+        Resource* newResource = dynamic_cast<Resource*>(newObject.Get());
+        if (!newResource)
+        {
+            ErrorString("Could not background load unknown resource type " + String(type));
+            return false;
+        }
+
+        LogString("Background loading resource " + name);
+        newResource->SetName(name);
+
+        it = _queue.Insert(MakePair(key, BackgroundLoadItem()));
+        BackgroundLoadItem& item = it->_second;
+        item._resource = newResource;
+        item._pendingRequests = 0;
+        item._sendEvent = sendEvent;
+        item._loaded = false;
+        item._success = false;
+        _queueCondition.Set();
+    }
+    else if (sendEvent)
+        it->_second._sendEvent = true;
+
+    if (callerKey)
+    {
+        auto callerIt = _queue.Find(*callerKey);
+        if (callerIt != _queue.End() && callerIt != it)
+        {
+            callerIt->_second._dependencies.Insert(key);
+            it->_second._dependents.Insert(*callerKey);
+        }
+    }
+
+    return true;
+}
+
+void BackgroundLoader::QueueDeferredRequests()
+{
+    Vector<BackgroundLoadRequest> requests;
+    {
+        MutexLock lock(_queueMutex);
+        if (_deferredRequests.IsEmpty())
+            return;
+        requests.Swap(_deferredRequests);
+    }
+
+    for (auto it = requests.Begin(); it != requests.End(); ++it)
+    {
+        bool hasCaller = it->_caller._first != StringHash();
+        QueueResource(it->_type, it->_name, it->_sendEvent, hasCaller ? &it->_caller : nullptr);
+
+        if (hasCaller)
+        {
+            MutexLock lock(_queueMutex);
+            auto callerIt = _queue.Find(it->_caller);
+            if (callerIt != _queue.End() && callerIt->_second._pendingRequests)
+                --callerIt->_second._pendingRequests;
+        }
+    }
+}
+
+void BackgroundLoader::FinishResource(const BackgroundLoadKey& key)
+{
+    SharedPtr<Resource> resource;
+    AutoPtr<Stream> stream;
+    Vector<SharedPtr<Resource> > finishedDependencies;
+    bool success;
+    bool sendEvent;
+
+    {
+        MutexLock lock(_queueMutex);
+        auto it = _queue.Find(key);
+        if (it == _queue.End())
+            return;
+
+        BackgroundLoadItem& item = it->_second;
+        resource = item._resource;
+        stream = item._stream;
+        finishedDependencies.Swap(item._finishedDependencies);
+        success = item._success;
+        sendEvent = item._sendEvent;
+
+        // Release the dependents, which keep this resource referenced until they finish
+        for (auto dIt = item._dependents.Begin(); dIt != item._dependents.End(); ++dIt)
+        {
+            auto dependentIt = _queue.Find(*dIt);
+            if (dependentIt != _queue.End())
+            {
+                dependentIt->_second._dependencies.Erase(key);
+                if (success)
+                    dependentIt->_second._finishedDependencies.Push(resource);
+            }
+        }
+
+        _queue.Erase(it);
+    }
+
+    if (success)
+    {
+        PROFILE(EndLoadResource);
+        success = resource->EndLoad();
+    }
+
+    if (success)
+        _owner->StoreResource(key, resource);
+    else
+        ErrorString("Failed to background load resource " + resource->Name());
+
+    if (sendEvent)
+    {
+        ResourceBackgroundLoadedEvent& event = _owner->resourceBackgroundLoadedEvent;
+        event._resource = success ? resource.Get() : nullptr;
+        event._type = key._first;
+        event._name = resource->Name();
+        event._success = success;
+        _owner->SendEvent(event);
+    }
+}
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../Base/AutoPtr.h"
+#include "../Base/HashMap.h"
+#include "../Base/HashSet.h"
+#include "../Base/Ptr.h"
+#include "../Base/String.h"
+#include "../Base/StringHash.h"
+#include "../Thread/Condition.h"
+#include "../Thread/Mutex.h"
+#include "../Thread/Thread.h"
+
+namespace Auto3D
+{
+
+class Resource;
+class ResourceCache;
+class Stream;
+
+/// Resource type and name hash pair used to identify background loaded resources.
+typedef Pair<StringHash, StringHash> BackgroundLoadKey;
+
+/// Queued background load of a resource.
+struct AUTO_API BackgroundLoadItem
+{
+    /// Resource being loaded.
+    SharedPtr<Resource> _resource;
+    /// Source stream, kept until EndLoad() for views read from it.
+    AutoPtr<Stream> _stream;
+    /// Resources that must finish before this one.
+    HashSet<BackgroundLoadKey> _dependencies;
+    /// Resources waiting for this one to finish.
+    HashSet<BackgroundLoadKey> _dependents;
+    /// Dependencies that have finished, referenced until this resource finishes so that the cache's memory budget can not unload them before EndLoad() takes them. Accessed only on the main thread.
+    Vector<SharedPtr<Resource> > _finishedDependencies;
+    /// Dependency requests made from the loader thread that the main thread has not queued yet.
+    unsigned _pendingRequests;
+    /// Whether to send the completion event.
+    bool _sendEvent;
+    /// BeginLoad() finished flag.
+    bool _loaded;
+    /// BeginLoad() success flag.
+    bool _success;
+};
+
+/// Resource load request made from the loader thread, queued later on the main thread.
+struct AUTO_API BackgroundLoadRequest
+{
+    /// Resource type.
+    StringHash _type;
+    /// Resource name.
+    String _name;
+    /// Resource that requested the load.
+    BackgroundLoadKey _caller;
+    /// Whether to send the completion event.
+    bool _sendEvent;
+};
+
+/// Background loader thread owned by the resource cache. Executes Resource::BeginLoad() outside the main thread, while Resource::EndLoad() is called from the main thread within a time budget.
+class AUTO_API BackgroundLoader : public Thread
+{
+public:
+    /// Construct.
+    BackgroundLoader(ResourceCache* owner);
+    /// Destruct. Stop the thread and discard unfinished loads.
+    ~BackgroundLoader();
+
+    /// Load queued resources until stopped.
+    void ThreadFunction() override;
+
+    /// Queue a resource load. If a caller resource that is itself being background loaded is given, it will not finish before this resource. Can also be called from the loader thread inside BeginLoad(). Return true if queued or already queued, false if already loaded or failed.
+    bool QueueResource(StringHash type, const String& name, bool sendEvent, Resource* caller);
+    /// Wait for a queued resource and its dependencies to load, then finish them. Called from the main thread.
+    void WaitForResource(StringHash type, StringHash nameHash);
+    /// Finish loaded resources until the time budget in milliseconds is used. Called from the main thread.
+    void FinishResources(int maxMs);
+
+    /// Return number of resources queued or being loaded.
+    size_t NumQueuedResources() const;
+
+private:
+    /// Queue a resource load on the main thread.
+    bool QueueResource(StringHash type, const String& name, bool sendEvent, const BackgroundLoadKey* callerKey);
+    /// Queue the load requests made from the loader thread. Called from the main thread.
+    void QueueDeferredRequests();
+    /// Finish a resource: call EndLoad(), store to the cache and send the completion event. Called from the main thread.
+    void FinishResource(const BackgroundLoadKey& key);
+
+    /// Resource cache.
+    ResourceCache* _owner;
+    /// Mutex for the queue and deferred requests.
+    mutable Mutex _queueMutex;
+    /// Queued resources. Items are added and removed only on the main thread.
+    HashMap<BackgroundLoadKey, BackgroundLoadItem> _queue;
+    /// Load requests made from the loader thread.
+    Vector<BackgroundLoadRequest> _deferredRequests;
+    /// Condition the loader thread waits on when it has nothing to load. Set when resources are queued or the thread is stopped.
+    Condition _queueCondition;
+    /// Condition the main thread waits on for a resource to load. Set when a resource has been loaded.
+    Condition _loadedCondition;
+    /// Resources ready to finish, collected by FinishResources().
+    Vector<BackgroundLoadKey> _finished;
+};
+
+}
@@ -1,7 +1,67 @@
+#include "../Math/Math.h"
+#include "../Math/SIMD.h"
 #include "Decompress.h"
+
+#include <cstring>
+
 namespace Auto3D
 {
 
+/// Copy a decompressed 4x4 block of RGBA pixels to the image, clipping it at the image edges.
+static void StoreBlock(unsigned char* rgba, const unsigned* block, int x, int y, int width, int height)
+{
+    unsigned char* dest = rgba + 4 * ((size_t)width * y + x);
+
+    // Copy whole rows with a constant size so that the copies compile to single moves
+    if (x + 4 <= width && y + 4 <= height)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            memcpy(dest, block + 4 * i, 16);
+            dest += 4 * width;
+        }
+    }
+    else
+    {
+        size_t rowBytes = Min(width - x, 4) * 4;
+        int numRows = Min(height - y, 4);
+        for (int i = 0; i < numRows; ++i)
+        {
+            memcpy(dest, block + 4 * i, rowBytes);
+            dest += 4 * width;
+        }
+    }
+}
+
+#ifdef AUTO_SSE
+/// Select from a where the mask is set, otherwise from b.
+static inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/// Expand 4 pixels from a 2-bit index per pixel, given the masks of the low and high index bits per lane.
+static inline __m128i ExpandIndices(__m128i low, __m128i high, const __m128i* colours)
+{
+    return Select(high, Select(low, colours[3], colours[2]), Select(low, colours[1], colours[0]));
+}
+#endif
+
+#ifdef AUTO_NEON
+/// Return the high 16 bits of multiplying each lane with a constant.
+static inline uint16x8_t MulHi(uint16x8_t value, uint16_t multiplier)
+{
+    return vcombine_u16(vshrn_n_u32(vmull_n_u16(vget_low_u16(value), multiplier), 16),
+        vshrn_n_u32(vmull_n_u16(vget_high_u16(value), multiplier), 16));
+}
+
+/// Expand 4 pixels from a 2-bit index per pixel, given the masks of the low and high index bits per lane.
+static inline uint32x4_t ExpandIndices(uint32x4_t low, uint32x4_t high, const uint32x4_t* colours)
+{
+    return vbslq_u32(high, vbslq_u32(low, colours[3], colours[2]), vbslq_u32(low, colours[1], colours[0]));
+}
+#endif
+
 /* -----------------------------------------------------------------------------
 
     Copyright (c) 2006 Simon Brown                          si@sjbrown.co.uk
@@ -27,212 +87,249 @@ namespace Auto3D
 
    -------------------------------------------------------------------------- */
 
-static int Unpack565( unsigned char const* packed, unsigned char* colour )
+// DXT decompression based on squish, modified for Auto3D to build and expand the palettes with SIMD
+
+/// Unpack a 565 colour to 8 bits per component and return the packed value.
+static int Unpack565(const unsigned char* packed, int* colour)
 {
-    // build the packed value
-    int value = ( int )packed[0] | ( ( int )packed[1] << 8 );
-
-    // get the components in the stored range
-    unsigned char red = ( unsigned char )( ( value >> 11 ) & 0x1f );
-    unsigned char green = ( unsigned char )( ( value >> 5 ) & 0x3f );
-    unsigned char blue = ( unsigned char )( value & 0x1f );
-
-    // scale up to 8 bits
-    colour[0] = ( red << 3 ) | ( red >> 2 );
-    colour[1] = ( green << 2 ) | ( green >> 4 );
-    colour[2] = ( blue << 3 ) | ( blue >> 2 );
+    int value = (int)packed[0] | ((int)packed[1] << 8);
+
+    int red = (value >> 11) & 0x1f;
+    int green = (value >> 5) & 0x3f;
+    int blue = value & 0x1f;
+
+    colour[0] = (red << 3) | (red >> 2);
+    colour[1] = (green << 2) | (green >> 4);
+    colour[2] = (blue << 3) | (blue >> 2);
     colour[3] = 255;
 
-    // return the value
     return value;
 }
 
-static void DecompressColourDXT( unsigned char* rgba, void const* block, bool isDxt1 )
+/// Build the 4-colour palette of a DXT colour block as RGBA8 values.
+static void DecodeColourPaletteDXT(unsigned* palette, const unsigned char* bytes, bool isDxt1)
 {
-    // get the block bytes
-    unsigned char const* bytes = reinterpret_cast< unsigned char const* >( block );
-
-    // unpack the endpoints
-    unsigned char codes[16];
-    int a = Unpack565( bytes, codes );
-    int b = Unpack565( bytes + 2, codes + 4 );
-
-    // generate the midpoints
-    for( int i = 0; i < 3; ++i )
+    int c[4], d[4];
+    int a = Unpack565(bytes, c);
+    int b = Unpack565(bytes + 2, d);
+    // DXT1 blocks with the endpoints in ascending order have 3 colours and transparent black
+    bool threeColour = isDxt1 && a <= b;
+
+#if defined(AUTO_SSE)
+    __m128i endpoints = _mm_setr_epi16((short)c[0], (short)c[1], (short)c[2], 255, (short)d[0], (short)d[1], (short)d[2], 255);
+    __m128i swapped = _mm_shuffle_epi32(endpoints, _MM_SHUFFLE(1, 0, 3, 2));
+    __m128i midpoints;
+    if (threeColour)
     {
-        int c = codes[i];
-        int d = codes[4 + i];
-
-        if( isDxt1 && a <= b )
+        midpoints = _mm_and_si128(_mm_srli_epi16(_mm_add_epi16(endpoints, swapped), 1), _mm_setr_epi16(-1, -1, -1, -1, 0, 0, 0, 0));
+    }
+    else
+    {
+        // (2c + d) / 3 and (c + 2d) / 3. Multiplying with 21846 and taking the high bits is an exact division by 3 for these values
+        __m128i sum = _mm_add_epi16(_mm_add_epi16(endpoints, endpoints), swapped);
+        midpoints = _mm_mulhi_epu16(sum, _mm_set1_epi16(21846));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(palette), _mm_packus_epi16(endpoints, midpoints));
+#elif defined(AUTO_NEON)
+    const uint16_t values[] = { (uint16_t)c[0], (uint16_t)c[1], (uint16_t)c[2], 255, (uint16_t)d[0], (uint16_t)d[1], (uint16_t)d[2], 255 };
+    uint16x8_t endpoints = vld1q_u16(values);
+    uint16x8_t swapped = vextq_u16(endpoints, endpoints, 4);
+    uint16x8_t midpoints;
+    if (threeColour)
+        midpoints = vcombine_u16(vget_low_u16(vshrq_n_u16(vaddq_u16(endpoints, swapped), 1)), vdup_n_u16(0));
+    else
+        midpoints = MulHi(vaddq_u16(vaddq_u16(endpoints, endpoints), swapped), 21846);
+    vst1q_u8(reinterpret_cast<uint8_t*>(palette), vcombine_u8(vmovn_u16(endpoints), vmovn_u16(midpoints)));
+#else
+    unsigned char* codes = reinterpret_cast<unsigned char*>(palette);
+    for (int i = 0; i < 4; ++i)
+    {
+        codes[i] = (unsigned char)c[i];
+        codes[4 + i] = (unsigned char)d[i];
+        if (threeColour)
         {
-            codes[8 + i] = ( unsigned char )( ( c + d )/2 );
+            codes[8 + i] = (unsigned char)((c[i] + d[i]) / 2);
             codes[12 + i] = 0;
         }
         else
         {
-            codes[8 + i] = ( unsigned char )( ( 2*c + d )/3 );
-            codes[12 + i] = ( unsigned char )( ( c + 2*d )/3 );
+            codes[8 + i] = (unsigned char)((2 * c[i] + d[i]) / 3);
+            codes[12 + i] = (unsigned char)((c[i] + 2 * d[i]) / 3);
         }
     }
+#endif
+}
 
-    // fill in alpha for the intermediate values
-    codes[8 + 3] = 255;
-    codes[12 + 3] = ( isDxt1 && a <= b ) ? 0 : 255;
-
-    // unpack the indices
-    unsigned char indices[16];
-    for( int i = 0; i < 4; ++i )
+/// Expand the 2-bit colour indices of a DXT block to RGBA8 pixels.
+static void ExpandColourIndicesDXT(unsigned* block, const unsigned* palette, const unsigned char* indices)
+{
+#if defined(AUTO_SSE)
+    __m128i codes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette));
+    const __m128i colours[] = {
+        _mm_shuffle_epi32(codes, 0x00),
+        _mm_shuffle_epi32(codes, 0x55),
+        _mm_shuffle_epi32(codes, 0xaa),
+        _mm_shuffle_epi32(codes, 0xff)
+    };
+    const __m128i lowBits = _mm_setr_epi32(0x01, 0x04, 0x10, 0x40);
+    const __m128i highBits = _mm_setr_epi32(0x02, 0x08, 0x20, 0x80);
+
+    for (int i = 0; i < 4; ++i)
     {
-        unsigned char* ind = indices + 4*i;
-        unsigned char packed = bytes[4 + i];
-
-        ind[0] = packed & 0x3;
-        ind[1] = ( packed >> 2 ) & 0x3;
-        ind[2] = ( packed >> 4 ) & 0x3;
-        ind[3] = ( packed >> 6 ) & 0x3;
+        __m128i packed = _mm_set1_epi32(indices[i]);
+        __m128i low = _mm_cmpeq_epi32(_mm_and_si128(packed, lowBits), lowBits);
+        __m128i high = _mm_cmpeq_epi32(_mm_and_si128(packed, highBits), highBits);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(block + 4 * i), ExpandIndices(low, high, colours));
     }
-
-    // store out the colours
-    for( int i = 0; i < 16; ++i )
+#elif defined(AUTO_NEON)
+    const uint32x4_t colours[] = { vdupq_n_u32(palette[0]), vdupq_n_u32(palette[1]), vdupq_n_u32(palette[2]), vdupq_n_u32(palette[3]) };
+    const uint32_t lowValues[] = { 0x01, 0x04, 0x10, 0x40 };
+    const uint32_t highValues[] = { 0x02, 0x08, 0x20, 0x80 };
+    uint32x4_t lowBits = vld1q_u32(lowValues);
+    uint32x4_t highBits = vld1q_u32(highValues);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        uint32x4_t packed = vdupq_n_u32(indices[i]);
+        vst1q_u32(block + 4 * i, ExpandIndices(vtstq_u32(packed, lowBits), vtstq_u32(packed, highBits), colours));
+    }
+#else
+    for (int i = 0; i < 4; ++i)
     {
-        unsigned char offset = 4*indices[i];
-        for( int j = 0; j < 4; ++j )
-            rgba[4*i + j] = codes[offset + j];
+        unsigned packed = indices[i];
+        for (int j = 0; j < 4; ++j)
+            block[4 * i + j] = palette[(packed >> 2 * j) & 3];
     }
+#endif
 }
 
-static void DecompressAlphaDXT3( unsigned char* rgba, void const* block )
+/// Decompress the colour of a DXT block.
+static void DecompressColourDXT(unsigned* block, const unsigned char* bytes, bool isDxt1)
 {
-    unsigned char const* bytes = reinterpret_cast< unsigned char const* >( block );
+    unsigned palette[4];
+    DecodeColourPaletteDXT(palette, bytes, isDxt1);
+    ExpandColourIndicesDXT(block, palette, bytes + 4);
+}
 
-    // unpack the alpha values pairwise
-    for( int i = 0; i < 8; ++i )
+/// Decompress the explicit 4-bit alpha of a DXT3 block.
+static void DecompressAlphaDXT3(unsigned char* rgba, const unsigned char* bytes)
+{
+    for (int i = 0; i < 8; ++i)
     {
-        // quantise down to 4 bits
         unsigned char quant = bytes[i];
-
-        // unpack the values
         unsigned char lo = quant & 0x0f;
         unsigned char hi = quant & 0xf0;
 
-        // convert back up to bytes
-        rgba[8*i + 3] = lo | ( lo << 4 );
-        rgba[8*i + 7] = hi | ( hi >> 4 );
+        rgba[8 * i + 3] = lo | (lo << 4);
+        rgba[8 * i + 7] = hi | (hi >> 4);
     }
 }
 
-static void DecompressAlphaDXT5( unsigned char* rgba, void const* block )
+/// Build the 8-value alpha palette of a DXT5 block.
+static void DecodeAlphaPaletteDXT5(unsigned char* codes, int alpha0, int alpha1)
 {
-    // get the two alpha values
-    unsigned char const* bytes = reinterpret_cast< unsigned char const* >( block );
-    int alpha0 = bytes[0];
-    int alpha1 = bytes[1];
-
-    // compare the values to build the codebook
-    unsigned char codes[8];
-    codes[0] = ( unsigned char )alpha0;
-    codes[1] = ( unsigned char )alpha1;
-    if( alpha0 <= alpha1 )
+    // Use the 5-alpha codebook with explicit 0 and 255 if the endpoints are in ascending order, else the 7-alpha codebook.
+    // Multiplying with 13108 or 9363 and taking the high bits is an exact division by 5 or 7 for these values
+#if defined(AUTO_SSE)
+    __m128i a0 = _mm_set1_epi16((short)alpha0);
+    __m128i a1 = _mm_set1_epi16((short)alpha1);
+    __m128i values;
+    if (alpha0 <= alpha1)
     {
-        // use 5-alpha codebook
-        for( int i = 1; i < 5; ++i )
-            codes[1 + i] = ( unsigned char )( ( ( 5 - i )*alpha0 + i*alpha1 )/5 );
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a0, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)), _mm_mullo_epi16(a1, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+        values = _mm_or_si128(_mm_mulhi_epu16(sum, _mm_set1_epi16(13108)), _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255));
+    }
+    else
+    {
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a0, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)), _mm_mullo_epi16(a1, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+        values = _mm_mulhi_epu16(sum, _mm_set1_epi16(9363));
+    }
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(codes), _mm_packus_epi16(values, values));
+#elif defined(AUTO_NEON)
+    static const uint16_t weights5[2][8] = { { 5, 0, 4, 3, 2, 1, 0, 0 }, { 0, 5, 1, 2, 3, 4, 0, 0 } };
+    static const uint16_t weights7[2][8] = { { 7, 0, 6, 5, 4, 3, 2, 1 }, { 0, 7, 1, 2, 3, 4, 5, 6 } };
+    uint16x8_t values;
+    if (alpha0 <= alpha1)
+    {
+        uint16x8_t sum = vmlaq_n_u16(vmulq_n_u16(vld1q_u16(weights5[0]), (uint16_t)alpha0), vld1q_u16(weights5[1]), (uint16_t)alpha1);
+        values = vsetq_lane_u16(255, MulHi(sum, 13108), 7);
+    }
+    else
+    {
+        uint16x8_t sum = vmlaq_n_u16(vmulq_n_u16(vld1q_u16(weights7[0]), (uint16_t)alpha0), vld1q_u16(weights7[1]), (uint16_t)alpha1);
+        values = MulHi(sum, 9363);
+    }
+    vst1_u8(codes, vmovn_u16(values));
+#else
+    codes[0] = (unsigned char)alpha0;
+    codes[1] = (unsigned char)alpha1;
+    if (alpha0 <= alpha1)
+    {
+        for (int i = 1; i < 5; ++i)
+            codes[1 + i] = (unsigned char)(((5 - i) * alpha0 + i * alpha1) / 5);
         codes[6] = 0;
         codes[7] = 255;
     }
     else
     {
-        // use 7-alpha codebook
-        for( int i = 1; i < 7; ++i )
-            codes[1 + i] = ( unsigned char )( ( ( 7 - i )*alpha0 + i*alpha1 )/7 );
+        for (int i = 1; i < 7; ++i)
+            codes[1 + i] = (unsigned char)(((7 - i) * alpha0 + i * alpha1) / 7);
     }
+#endif
+}
+
+/// Decompress the interpolated alpha of a DXT5 block.
+static void DecompressAlphaDXT5(unsigned char* rgba, const unsigned char* bytes)
+{
+    unsigned char codes[8];
+    DecodeAlphaPaletteDXT5(codes, bytes[0], bytes[1]);
 
-    // decode the indices
-    unsigned char indices[16];
-    unsigned char const* src = bytes + 2;
-    unsigned char* dest = indices;
-    for( int i = 0; i < 2; ++i )
+    // Each group of 3 bytes holds 8 3-bit indices
+    const unsigned char* src = bytes + 2;
+    for (int i = 0; i < 2; ++i)
     {
-        // grab 3 bytes
-        int value = 0;
-        for( int j = 0; j < 3; ++j )
-        {
-            int byte = *src++;
-            value |= ( byte << 8*j );
-        }
+        unsigned value = (unsigned)src[0] | ((unsigned)src[1] << 8) | ((unsigned)src[2] << 16);
+        src += 3;
 
-        // unpack 8 3-bit values from it
-        for( int j = 0; j < 8; ++j )
-        {
-            int index = ( value >> 3*j ) & 0x7;
-            *dest++ = ( unsigned char )index;
-        }
+        for (int j = 0; j < 8; ++j)
+            rgba[4 * (8 * i + j) + 3] = codes[(value >> 3 * j) & 7];
     }
+}
 
-    // write out the indexed codebook values
-    for( int i = 0; i < 16; ++i )
-        rgba[4*i + 3] = codes[indices[i]];
+/// Decompress a DXT1/3/5 block to RGBA8 pixels.
+static void DecompressDXT(unsigned* block, const unsigned char* bytes, ImageFormat::Type format)
+{
+    if (format == ImageFormat::DXT1)
+        DecompressColourDXT(block, bytes, true);
+    else
+    {
+        unsigned char* rgba = reinterpret_cast<unsigned char*>(block);
+        DecompressColourDXT(block, bytes + 8, false);
+        if (format == ImageFormat::DXT3)
+            DecompressAlphaDXT3(rgba, bytes);
+        else
+            DecompressAlphaDXT5(rgba, bytes);
+    }
 }
 
-static void DecompressDXT( unsigned char* rgba, const void* block, ImageFormat::Type _format)
+void DecompressImageDXT(unsigned char* rgba, const void* blocks, int width, int height, ImageFormat::Type format)
 {
-    // get the block locations
-    void const* colourBlock = block;
-    void const* alphaBock = block;
-    if( _format == ImageFormat::DXT3 || _format == ImageFormat::DXT5)
-        colourBlock = reinterpret_cast< unsigned char const* >( block ) + 8;
-
-    // decompress colour
-    DecompressColourDXT( rgba, colourBlock, _format == ImageFormat::DXT1 );
-
-    // decompress alpha separately if necessary
-    if( _format == ImageFormat::DXT3 )
-        DecompressAlphaDXT3( rgba, alphaBock );
-    else if ( _format == ImageFormat::DXT5 )
-        DecompressAlphaDXT5( rgba, alphaBock );
+    DecompressImageDXT(rgba, blocks, width, height, format, 0, (height + 3) / 4);
 }
 
-void DecompressImageDXT( unsigned char* rgba, const void* blocks, int width, int height, ImageFormat::Type _format )
+void DecompressImageDXT(unsigned char* rgba, const void* blocks, int width, int height, ImageFormat::Type format, int firstBlockRow, int lastBlockRow)
 {
-    // initialise the block input
-    unsigned char const* sourceBlock = reinterpret_cast< unsigned char const* >( blocks );
-    int bytesPerBlock = _format == ImageFormat::DXT1 ? 8 : 16;
+    size_t bytesPerBlock = format == ImageFormat::DXT1 ? 8 : 16;
+    size_t blocksPerRow = (width + 3) / 4;
+    const unsigned char* sourceBlock = reinterpret_cast<const unsigned char*>(blocks) + firstBlockRow * blocksPerRow * bytesPerBlock;
 
-    // loop over blocks
-    for( int y = 0; y < height; y += 4 )
+    for (int y = firstBlockRow * 4; y < lastBlockRow * 4; y += 4)
     {
-        for( int x = 0; x < width; x += 4 )
+        for (int x = 0; x < width; x += 4)
         {
-            // decompress the block
-            unsigned char targetRgba[4*16];
-            DecompressDXT( targetRgba, sourceBlock, _format );
-
-            // write the decompressed pixels to the correct image locations
-            unsigned char const* sourcePixel = targetRgba;
-            for( int py = 0; py < 4; ++py )
-            {
-                for( int px = 0; px < 4; ++px )
-                {
-                    // get the target location
-                    int sx = x + px;
-                    int sy = y + py;
-                    if( sx < width && sy < height )
-                    {
-                        unsigned char* targetPixel = rgba + 4*( width*sy + sx );
-
-                        // copy the rgba value
-                        for( int i = 0; i < 4; ++i )
-                            *targetPixel++ = *sourcePixel++;
-                    }
-                    else
-                    {
-                        // skip this pixel as its outside the image
-                        sourcePixel += 4;
-                    }
-                }
-            }
-
-            // advance
+            unsigned block[16];
+            DecompressDXT(block, sourceBlock, format);
+            StoreBlock(rgba, block, x, y, width, height);
             sourceBlock += bytesPerBlock;
         }
     }
@@ -261,9 +358,9 @@ misrepresented as being the original software.
 
 #define _CLAMP_(X,Xmin,Xmax) ( (X)<(Xmax) ? ( (X)<(Xmin)?(Xmin):(X) ) : (Xmax) )
 
-unsigned int ETC_FLIP =  0x01000000;
-unsigned int ETC_DIFF = 0x02000000;
-const int mod[8][4]={{2, 8,-2,-8},
+static const unsigned ETC_FLIP = 0x01000000;
+static const unsigned ETC_DIFF = 0x02000000;
+static const int mod[8][4]={{2, 8,-2,-8},
                     {5, 17, -5, -17},
                     {9, 29, -9, -29},
                     {13, 42, -13, -42},
@@ -272,39 +369,111 @@ const int mod[8][4]={{2, 8,-2,-8},
                     {33, 106, -33, -106},
                     {47, 183, -47, -183}};
 
-// lsb: hgfedcba ponmlkji msb: hgfedcba ponmlkji due to endianness
-static unsigned long ModifyPixel(int red, int green, int blue, int x, int y, unsigned long modBlock, int modTable)
+/// Build the 4-colour palette of an ETC1 subblock from its base colour and modifier table as RGBA8 values.
+static void DecodePaletteETC(unsigned* palette, int red, int green, int blue, int modTable)
 {
-    int index = x*4+y, pixelMod;
-    unsigned long mostSig = modBlock<<1;
-    if (index<8)    //hgfedcba
-        pixelMod = mod[modTable][((modBlock>>(index+24))&0x1)+((mostSig>>(index+8))&0x2)];
-    else    // ponmlkj
-        pixelMod = mod[modTable][((modBlock>>(index+8))&0x1)+((mostSig>>(index-8))&0x2)];
-
-    red = _CLAMP_(red+pixelMod,0,255);
-    green = _CLAMP_(green+pixelMod,0,255);
-    blue = _CLAMP_(blue+pixelMod,0,255);
-
-    return ((blue<<16) + (green<<8) + red)|0xff000000;
+    const int* modifiers = mod[modTable];
+
+#if defined(AUTO_SSE)
+    // The first two modifiers are positive and the last two negative: add and subtract them to all components with saturation
+    __m128i base = _mm_set1_epi32(red | (green << 8) | (blue << 16));
+    __m128i add = _mm_setr_epi32(modifiers[0] * 0x10101, modifiers[1] * 0x10101, 0, 0);
+    __m128i sub = _mm_setr_epi32(0, 0, -modifiers[2] * 0x10101, -modifiers[3] * 0x10101);
+    __m128i colours = _mm_subs_epu8(_mm_adds_epu8(base, add), sub);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(palette), _mm_or_si128(colours, _mm_set1_epi32((int)0xff000000)));
+#elif defined(AUTO_NEON)
+    const uint32_t addValues[] = { (uint32_t)modifiers[0] * 0x10101, (uint32_t)modifiers[1] * 0x10101, 0, 0 };
+    const uint32_t subValues[] = { 0, 0, (uint32_t)-modifiers[2] * 0x10101, (uint32_t)-modifiers[3] * 0x10101 };
+    uint8x16_t base = vreinterpretq_u8_u32(vdupq_n_u32(red | (green << 8) | (blue << 16)));
+    uint8x16_t colours = vqsubq_u8(vqaddq_u8(base, vreinterpretq_u8_u32(vld1q_u32(addValues))), vreinterpretq_u8_u32(vld1q_u32(subValues)));
+    vst1q_u32(palette, vorrq_u32(vreinterpretq_u32_u8(colours), vdupq_n_u32(0xff000000)));
+#else
+    for (int i = 0; i < 4; ++i)
+    {
+        int r = _CLAMP_(red + modifiers[i], 0, 255);
+        int g = _CLAMP_(green + modifiers[i], 0, 255);
+        int b = _CLAMP_(blue + modifiers[i], 0, 255);
+        palette[i] = (unsigned)(r | (g << 8) | (b << 16)) | 0xff000000;
+    }
+#endif
 }
 
-static void DecompressETC(unsigned char* pDestData, const void* pSrcData)
+/// Expand the pixel indices of an ETC1 block to RGBA8 pixels. The pixels are indexed in column-major order, with the low and high index bits in separate 16-bit fields.
+static void ExpandIndicesETC(unsigned* block, const unsigned* palette1, const unsigned* palette2, bool flip, unsigned lowBits, unsigned highBits)
 {
-    unsigned long blockTop, blockBot, *input = (unsigned long*)pSrcData, *output;
-    unsigned char red1, green1, blue1, red2, green2, blue2;
-    bool bFlip, bDiff;
-    int modtable1,modtable2;
+#if defined(AUTO_SSE)
+    // Without flip the subblocks are 2x4 side by side, with flip 4x2 on top of each other
+    __m128i codes1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette1));
+    __m128i codes2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette2));
+    __m128i top[] = {
+        _mm_shuffle_epi32(codes1, 0x00),
+        _mm_shuffle_epi32(codes1, 0x55),
+        _mm_shuffle_epi32(codes1, 0xaa),
+        _mm_shuffle_epi32(codes1, 0xff)
+    };
+    __m128i bottom[] = {
+        _mm_shuffle_epi32(codes2, 0x00),
+        _mm_shuffle_epi32(codes2, 0x55),
+        _mm_shuffle_epi32(codes2, 0xaa),
+        _mm_shuffle_epi32(codes2, 0xff)
+    };
+    if (!flip)
+    {
+        for (int i = 0; i < 4; ++i)
+            top[i] = bottom[i] = _mm_unpacklo_epi64(top[i], bottom[i]);
+    }
+
+    __m128i low = _mm_set1_epi32(lowBits);
+    __m128i high = _mm_set1_epi32(highBits);
+    for (int y = 0; y < 4; ++y)
+    {
+        __m128i rowBits = _mm_setr_epi32(0x1 << y, 0x10 << y, 0x100 << y, 0x1000 << y);
+        __m128i lowMask = _mm_cmpeq_epi32(_mm_and_si128(low, rowBits), rowBits);
+        __m128i highMask = _mm_cmpeq_epi32(_mm_and_si128(high, rowBits), rowBits);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(block + 4 * y), ExpandIndices(lowMask, highMask, y < 2 ? top : bottom));
+    }
+#elif defined(AUTO_NEON)
+    uint32x4_t top[4], bottom[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        top[i] = vdupq_n_u32(palette1[i]);
+        bottom[i] = vdupq_n_u32(palette2[i]);
+        if (!flip)
+            top[i] = bottom[i] = vcombine_u32(vget_low_u32(top[i]), vget_low_u32(bottom[i]));
+    }
 
-    blockTop = *(input++);
-    blockBot = *(input++);
+    uint32x4_t low = vdupq_n_u32(lowBits);
+    uint32x4_t high = vdupq_n_u32(highBits);
+    for (int y = 0; y < 4; ++y)
+    {
+        const uint32_t bitValues[] = { 0x1u << y, 0x10u << y, 0x100u << y, 0x1000u << y };
+        uint32x4_t rowBits = vld1q_u32(bitValues);
+        vst1q_u32(block + 4 * y, ExpandIndices(vtstq_u32(low, rowBits), vtstq_u32(high, rowBits), y < 2 ? top : bottom));
+    }
+#else
+    for (int y = 0; y < 4; ++y)
+    {
+        for (int x = 0; x < 4; ++x)
+        {
+            int bit = x * 4 + y;
+            unsigned index = ((lowBits >> bit) & 1) | (((highBits >> bit) & 1) << 1);
+            bool second = flip ? y >= 2 : x >= 2;
+            block[4 * y + x] = second ? palette2[index] : palette1[index];
+        }
+    }
+#endif
+}
 
-    output = (unsigned long*)pDestData;
-    // check flipbit
-    bFlip = (blockTop & ETC_FLIP) != 0;
-    bDiff = (blockTop & ETC_DIFF) != 0;
+/// Decompress an ETC1 block to RGBA8 pixels.
+static void DecompressETC(unsigned* block, const unsigned char* bytes)
+{
+    // The block is stored big-endian; read the colour word so that the red component is in the lowest byte
+    unsigned blockTop = (unsigned)bytes[0] | ((unsigned)bytes[1] << 8) | ((unsigned)bytes[2] << 16) | ((unsigned)bytes[3] << 24);
+    unsigned highBits = ((unsigned)bytes[4] << 8) | bytes[5];
+    unsigned lowBits = ((unsigned)bytes[6] << 8) | bytes[7];
+    unsigned char red1, green1, blue1, red2, green2, blue2;
 
-    if(bDiff)
+    if (blockTop & ETC_DIFF)
     {    // differential mode 5 colour bits + 3 difference bits
         // get base colour for subblock 1
         blue1 = (unsigned char)((blockTop&0xf80000)>>16);
@@ -346,75 +515,32 @@ static void DecompressETC(unsigned char* pDestData, const void* pSrcData)
         red2 = (unsigned char)((blockTop&0xf)<<4);
         red2 = red2 + (red2>>4);    // copy bits to lower sig
     }
+
     // get the modtables for each subblock
-    modtable1 = (blockTop>>29)&0x7;
-    modtable2 = (blockTop>>26)&0x7;
+    unsigned palette1[4], palette2[4];
+    DecodePaletteETC(palette1, red1, green1, blue1, (blockTop >> 29) & 0x7);
+    DecodePaletteETC(palette2, red2, green2, blue2, (blockTop >> 26) & 0x7);
+    ExpandIndicesETC(block, palette1, palette2, (blockTop & ETC_FLIP) != 0, lowBits, highBits);
+}
 
-    if(!bFlip)
-    {   // 2 2x4 blocks side by side
-        for(int j=0;j<4;j++)    // vertical
-        {
-            for(int k=0;k<2;k++)    // horizontal
-            {
-                *(output+j*4+k) = ModifyPixel(red1,green1,blue1,k,j,blockBot,modtable1);
-                *(output+j*4+k+2) = ModifyPixel(red2,green2,blue2,k+2,j,blockBot,modtable2);
-            }
-        }
-    }
-    else
-    {   // 2 4x2 blocks on top of each other
-        for(int j=0;j<2;j++)
-        {
-            for(int k=0;k<4;k++)
-            {
-                *(output+j*4+k) = ModifyPixel(red1,green1,blue1,k,j,blockBot,modtable1);
-                *(output+(j+2)*4+k) = ModifyPixel(red2,green2,blue2,k,j+2,blockBot,modtable2);
-            }
-        }
-    }
+void DecompressImageETC(unsigned char* rgba, const void* blocks, int width, int height)
+{
+    DecompressImageETC(rgba, blocks, width, height, 0, (height + 3) / 4);
 }
 
-void DecompressImageETC( unsigned char* rgba, const void* blocks, int width, int height )
+void DecompressImageETC(unsigned char* rgba, const void* blocks, int width, int height, int firstBlockRow, int lastBlockRow)
 {
-    // initialise the block input
-    unsigned char const* sourceBlock = reinterpret_cast< unsigned char const* >( blocks );
-    int bytesPerBlock = 8;
+    const size_t bytesPerBlock = 8;
+    size_t blocksPerRow = (width + 3) / 4;
+    const unsigned char* sourceBlock = reinterpret_cast<const unsigned char*>(blocks) + firstBlockRow * blocksPerRow * bytesPerBlock;
 
-    // loop over blocks
-    for( int y = 0; y < height; y += 4 )
+    for (int y = firstBlockRow * 4; y < lastBlockRow * 4; y += 4)
     {
-        for( int x = 0; x < width; x += 4 )
+        for (int x = 0; x < width; x += 4)
         {
-            // decompress the block
-            unsigned char targetRgba[4*16];
-            DecompressETC( targetRgba, sourceBlock );
-
-            // write the decompressed pixels to the correct image locations
-            unsigned char const* sourcePixel = targetRgba;
-            for( int py = 0; py < 4; ++py )
-            {
-                for( int px = 0; px < 4; ++px )
-                {
-                    // get the target location
-                    int sx = x + px;
-                    int sy = y + py;
-                    if( sx < width && sy < height )
-                    {
-                        unsigned char* targetPixel = rgba + 4*( width*sy + sx );
-
-                        // copy the rgba value
-                        for( int i = 0; i < 4; ++i )
-                            *targetPixel++ = *sourcePixel++;
-                    }
-                    else
-                    {
-                        // skip this pixel as its outside the image
-                        sourcePixel += 4;
-                    }
-                }
-            }
-
-            // advance
+            unsigned block[16];
+            DecompressETC(block, sourceBlock);
+            StoreBlock(rgba, block, x, y, width, height);
             sourceBlock += bytesPerBlock;
         }
     }
@@ -770,7 +896,12 @@ static unsigned TwiddleUV(unsigned YSize, unsigned XSize, unsigned YPos, unsigne
     return Twiddled;
 }
 
-void DecompressImagePVRTC(unsigned char* dest, const void *blocks, int width, int height, ImageFormat::Type _format)
+void DecompressImagePVRTC(unsigned char* dest, const void* blocks, int width, int height, ImageFormat::Type format)
+{
+    DecompressImagePVRTC(dest, blocks, width, height, format, 0, height);
+}
+
+void DecompressImagePVRTC(unsigned char* dest, const void *blocks, int width, int height, ImageFormat::Type _format, int firstRow, int lastRow)
 {
     AMTC_BLOCK_STRUCT* pCompressedData = (AMTC_BLOCK_STRUCT*)blocks;
     int AssumeImageTiles = 1;
@@ -824,7 +955,7 @@ void DecompressImagePVRTC(unsigned char* dest, const void *blocks, int width, in
     // Step through the pixels of the image decompressing each one in turn
     //
     // Note that this is a hideously inefficient way to do this!
-    for(y = 0; y < height; y++)
+    for(y = firstRow; y < lastRow; y++)
     {
         for(x = 0; x < width; x++)
         {
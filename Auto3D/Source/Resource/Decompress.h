@@ -7,9 +7,15 @@ namespace Auto3D
 
 /// Decompress DXT1/3/5 image data.
 AUTO_API void DecompressImageDXT(unsigned char* dest, const void* blocks, int width, int height, ImageFormat::Type _format);
+/// Decompress rows of 4x4 blocks [firstBlockRow, lastBlockRow) of DXT1/3/5 image data. Block rows can be decompressed on several threads at once.
+AUTO_API void DecompressImageDXT(unsigned char* dest, const void* blocks, int width, int height, ImageFormat::Type _format, int firstBlockRow, int lastBlockRow);
 /// Decompress ETC image data.
 AUTO_API void DecompressImageETC(unsigned char* dest, const void* blocks, int width, int height);
+/// Decompress rows of 4x4 blocks [firstBlockRow, lastBlockRow) of ETC image data. Block rows can be decompressed on several threads at once.
+AUTO_API void DecompressImageETC(unsigned char* dest, const void* blocks, int width, int height, int firstBlockRow, int lastBlockRow);
 /// Decompress PVRTC image data.
 AUTO_API void DecompressImagePVRTC(unsigned char* dest, const void* blocks, int width, int height, ImageFormat::Type _format);
+/// Decompress pixel rows [firstRow, lastRow) of PVRTC image data. Rows can be decompressed on several threads at once.
+AUTO_API void DecompressImagePVRTC(unsigned char* dest, const void* blocks, int width, int height, ImageFormat::Type _format, int firstRow, int lastRow);
 
 }
@@ -2,7 +2,10 @@
 #include "../Debug/Profiler.h"
 #include "../IO/Stream.h"
 #include "../Math/Math.h"
+#include "../Thread/Thread.h"
+#include "../Thread/WorkQueue.h"
 #include "Decompress.h"
+#include "MipFilter.h"
 
 #include <cstdlib>
 #include <cstring>
@@ -29,6 +32,32 @@
 namespace Auto3D
 {
 
+/// Minimum image level size in bytes to split mip generation or decompression across worker threads.
+static const size_t MIN_PARALLEL_IMAGE_BYTES = 64 * 1024;
+/// Minimum number of pixel rows per parallel work item.
+static const size_t MIN_PARALLEL_GRAIN_ROWS = 16;
+
+/// Decompress a range of rows of a compressed image level to RGBA. DXT and ETC rows are rows of 4x4 blocks, PVRTC rows are pixel rows.
+static void DecompressRows(unsigned char* dest, const ImageLevel& level, ImageFormat::Type format, int firstRow, int lastRow)
+{
+    switch (format)
+    {
+    case ImageFormat::DXT1:
+    case ImageFormat::DXT3:
+    case ImageFormat::DXT5:
+        DecompressImageDXT(dest, level._data, level._size._x, level._size._y, format, firstRow, lastRow);
+        break;
+
+    case ImageFormat::ETC1:
+        DecompressImageETC(dest, level._data, level._size._x, level._size._y, firstRow, lastRow);
+        break;
+
+    default:
+        DecompressImagePVRTC(dest, level._data, level._size._x, level._size._y, format, firstRow, lastRow);
+        break;
+    }
+}
+
 const int Image::components[] =
 {
     0,      // ImageFormat::NONE
@@ -271,6 +300,7 @@ bool Image::BeginLoad(Stream& source)
         _data = new unsigned char[dataSize];
         _size = Vector2I(ddsd.dwWidth, ddsd.dwHeight);
         _numLevels = ddsd.dwMipMapCount ? ddsd.dwMipMapCount : 1;
+        SetMemoryUse((unsigned)dataSize);
         source.Read(_data.Get(), dataSize);
     }
     else if (fileID == "\253KTX")
@@ -363,6 +393,7 @@ bool Image::BeginLoad(Stream& source)
         _data = new unsigned char[dataSize];
         _size = Vector2I(imageWidth, imageHeight);
         _numLevels = mipmaps;
+        SetMemoryUse((unsigned)dataSize);
 
         size_t dataOffset = 0;
         for (size_t i = 0; i < mipmaps; ++i)
@@ -455,6 +486,7 @@ bool Image::BeginLoad(Stream& source)
         _data = new unsigned char[dataSize];
         _size = Vector2I(imageWidth, imageHeight);
         _numLevels = mipmapCount;
+        SetMemoryUse((unsigned)dataSize);
 
         source.Read(_data.Get(), dataSize);
     }
@@ -544,10 +576,12 @@ void Image::SetSize(const Vector2I& newSize, ImageFormat::Type newFormat)
         return;
     }
 
-    _data = new unsigned char[newSize._x * newSize._y * pixelByteSizes[newFormat]];
+    size_t dataSize = newSize._x * newSize._y * pixelByteSizes[newFormat];
+    _data = new unsigned char[dataSize];
     _size = newSize;
     _format = newFormat;
     _numLevels = 1;
+    SetMemoryUse((unsigned)dataSize);
 }
 
 void Image::SetData(const unsigned char* pixelData)
@@ -560,11 +594,19 @@ void Image::SetData(const unsigned char* pixelData)
 
 unsigned char* Image::DecodePixelData(Stream& source, int& width, int& height, unsigned& components)
 {
-    size_t dataSize = source.Size();
+    size_t dataSize = source.Size() - source.Position();
 
-    AutoArrayPtr<unsigned char> buffer(new unsigned char[dataSize]);
-    source.Read(buffer.Get(), dataSize);
-    return stbi_load_from_memory(buffer.Get(), (int)dataSize, &width, &height, (int *)&components, 0);
+    // Decode directly from the stream's memory if possible
+    const unsigned char* data = (const unsigned char*)source.ReadView(dataSize);
+    AutoArrayPtr<unsigned char> buffer;
+    if (!data)
+    {
+        buffer = new unsigned char[dataSize];
+        source.Read(buffer.Get(), dataSize);
+        data = buffer.Get();
+    }
+
+    return stbi_load_from_memory(data, (int)dataSize, &width, &height, (int *)&components, 0);
 }
 
 void Image::FreePixelData(unsigned char* pixelData)
@@ -575,12 +617,11 @@ void Image::FreePixelData(unsigned char* pixelData)
     stbi_image_free(pixelData);
 }
 
-bool Image::GenerateMipImage(Image& dest) const
+bool Image::GenerateMipImage(Image& dest, bool sRGB) const
 {
     PROFILE(GenerateMipImage);
 
-    int components = GetComponents();
-    if (components < 1 || components > 4)
+    if (!CanGenerateMips(_format))
     {
         ErrorString("Unsupported format for calculating the next mip level");
         return false;
@@ -588,60 +629,65 @@ bool Image::GenerateMipImage(Image& dest) const
 
     Vector2I sizeOut(Max(_size._x / 2, 1), Max(_size._y / 2, 1));
     dest.SetSize(sizeOut, _format);
+    GenerateMipLevel(GetLevel(0), dest.GetLevel(0), _format, sRGB);
 
-    const unsigned char* pixelDataIn = _data.Get();
-    unsigned char* pixelDataOut = dest._data.Get();
-
-    switch (components)
-    {
-    case 1:
-        for (int y = 0; y < sizeOut._y; ++y)
-        {
-            const unsigned char* inUpper = &pixelDataIn[(y * 2) * _size._x];
-            const unsigned char* inLower = &pixelDataIn[(y * 2 + 1) * _size._x];
-            unsigned char* out = &pixelDataOut[y * sizeOut._x];
+    return true;
+}
 
-            for (int x = 0; x < sizeOut._x; ++x)
-                out[x] = ((unsigned)inUpper[x * 2] + inUpper[x * 2 + 1] + inLower[x * 2] + inLower[x * 2 + 1]) >> 2;
-        }
-        break;
+bool Image::GenerateMipLevels(bool sRGB)
+{
+    PROFILE(GenerateMipLevels);
 
-    case 2:
-        for (int y = 0; y < sizeOut._y; ++y)
-        {
-            const unsigned char* inUpper = &pixelDataIn[(y * 2) * _size._x * 2];
-            const unsigned char* inLower = &pixelDataIn[(y * 2 + 1) * _size._x * 2];
-            unsigned char* out = &pixelDataOut[y * sizeOut._x * 2];
+    if (!CanGenerateMips(_format))
+    {
+        ErrorString("Unsupported format for generating mip levels");
+        return false;
+    }
 
-            for (int x = 0; x < sizeOut._x * 2; x += 2)
-            {
-                out[x] = ((unsigned)inUpper[x * 2] + inUpper[x * 2 + 2] + inLower[x * 2] + inLower[x * 2 + 2]) >> 2;
-                out[x + 1] = ((unsigned)inUpper[x * 2 + 1] + inUpper[x * 2 + 3] + inLower[x * 2 + 1] + inLower[x * 2 + 3]) >> 2;
-            }
-        }
-        break;
+    size_t numLevels = 1;
+    size_t totalSize = CalculateDataSize(_size, _format);
+    size_t baseSize = totalSize;
+    for (Vector2I levelSize = _size; levelSize._x > 1 || levelSize._y > 1; ++numLevels)
+    {
+        levelSize = Vector2I(Max(levelSize._x / 2, 1), Max(levelSize._y / 2, 1));
+        totalSize += CalculateDataSize(levelSize, _format);
+    }
 
-    case 4:
-        for (int y = 0; y < sizeOut._y; ++y)
-        {
-            const unsigned char* inUpper = &pixelDataIn[(y * 2) * _size._x * 4];
-            const unsigned char* inLower = &pixelDataIn[(y * 2 + 1) * _size._x * 4];
-            unsigned char* out = &pixelDataOut[y * sizeOut._x * 4];
+    SharedArrayPtr<unsigned char> newData(new unsigned char[totalSize]);
+    memcpy(newData.Get(), _data.Get(), baseSize);
+    _data = newData;
+    _numLevels = numLevels;
 
-            for (int x = 0; x < sizeOut._x * 4; x += 4)
-            {
-                out[x] = ((unsigned)inUpper[x * 2] + inUpper[x * 2 + 4] + inLower[x * 2] + inLower[x * 2 + 4]) >> 2;
-                out[x + 1] = ((unsigned)inUpper[x * 2 + 1] + inUpper[x * 2 + 5] + inLower[x * 2 + 1] + inLower[x * 2 + 5]) >> 2;
-                out[x + 2] = ((unsigned)inUpper[x * 2 + 2] + inUpper[x * 2 + 6] + inLower[x * 2 + 2] + inLower[x * 2 + 6]) >> 2;
-                out[x + 3] = ((unsigned)inUpper[x * 2 + 3] + inUpper[x * 2 + 7] + inLower[x * 2 + 3] + inLower[x * 2 + 7]) >> 2;
-            }
-        }
-        break;
+    ImageLevel src = GetLevel(0);
+    for (size_t i = 1; i < _numLevels; ++i)
+    {
+        ImageLevel dest = GetLevel(i);
+        GenerateMipLevel(src, dest, _format, sRGB);
+        src = dest;
     }
 
+    SetMemoryUse((unsigned)totalSize);
     return true;
 }
 
+void Image::GenerateMipLevel(const ImageLevel& src, const ImageLevel& dest, ImageFormat::Type format, bool sRGB)
+{
+    // Levels depend on each other, so only the rows within one level are filtered in parallel. The background loader thread
+    // shares the main thread's job queue, so filter serially there to not stall the frame with jobs stolen from it
+    WorkQueue* workQueue = Subsystem<WorkQueue>();
+    size_t numRows = dest._rows;
+    if (workQueue && workQueue->NumThreads() && Thread::IsMainThread() && numRows * dest._rowSize >= MIN_PARALLEL_IMAGE_BYTES)
+    {
+        size_t grainSize = workQueue->GrainSize(numRows, MIN_PARALLEL_GRAIN_ROWS);
+        workQueue->ParallelFor(numRows, grainSize, [&src, &dest, format, sRGB](size_t begin, size_t end, unsigned)
+        {
+            GenerateMipRows(src, dest, format, sRGB, begin, end);
+        });
+    }
+    else
+        GenerateMipRows(src, dest, format, sRGB, 0, numRows);
+}
+
 ImageLevel Image::GetLevel(size_t index) const
 {
     ImageLevel level;
@@ -743,25 +789,21 @@ bool Image::DecompressLevel(unsigned char* dest, size_t index) const
         return false;
     }
 
-    ImageLevel level = GetLevel(index);
-
+    size_t rowHeight;
     switch (_format)
     {
     case ImageFormat::DXT1:
     case ImageFormat::DXT3:
     case ImageFormat::DXT5:
-        DecompressImageDXT(dest, level._data, level._size._x, level._size._y, _format);
-        break;
-
     case ImageFormat::ETC1:
-        DecompressImageETC(dest, level._data, level._size._x, level._size._y);
+        rowHeight = 4;
         break;
 
     case ImageFormat::PVRTC_RGB_2BPP:
     case ImageFormat::PVRTC_RGBA_2BPP:
     case ImageFormat::PVRTC_RGB_4BPP:
     case ImageFormat::PVRTC_RGBA_4BPP:
-        DecompressImagePVRTC(dest, level._data, level._size._x, level._size._y, _format);
+        rowHeight = 1;
         break;
 
     default:
@@ -769,6 +811,24 @@ bool Image::DecompressLevel(unsigned char* dest, size_t index) const
         return false;
     }
 
+    ImageLevel level = GetLevel(index);
+    ImageFormat::Type format = _format;
+    size_t numRows = (level._size._y + rowHeight - 1) / rowHeight;
+
+    // The rows decompress independently, so split large levels across the work queue's threads. Decompress serially in the
+    // background loader thread, as it shares the main thread's job queue
+    WorkQueue* workQueue = Subsystem<WorkQueue>();
+    if (workQueue && workQueue->NumThreads() && Thread::IsMainThread() && (size_t)level._size._x * level._size._y * 4 >= MIN_PARALLEL_IMAGE_BYTES)
+    {
+        size_t grainSize = workQueue->GrainSize(numRows, MIN_PARALLEL_GRAIN_ROWS / rowHeight);
+        workQueue->ParallelFor(numRows, grainSize, [dest, &level, format](size_t begin, size_t end, unsigned)
+        {
+            DecompressRows(dest, level, format, (int)begin, (int)end);
+        });
+    }
+    else
+        DecompressRows(dest, level, format, 0, (int)numRows);
+
     return true;
 }
 
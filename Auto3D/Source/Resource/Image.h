@@ -108,13 +108,15 @@ public:
     bool IsCompressed() const { return _format >= ImageFormat::DXT1; }
     /// Return number of mip levels contained in the image data.
     size_t GetNumLevels() const { return _numLevels; }
-    /// Calculate the next mip image with halved width and height. Supports uncompressed 8 bits per pixel images only. Return true on success.
-    bool GenerateMipImage(Image& dest) const;
+    /// Calculate the next mip image with halved width and height. Supports uncompressed color formats. If sRGB is true, 8-bit color components are averaged in linear space. Return true on success.
+    bool GenerateMipImage(Image& dest, bool sRGB = false) const;
+    /// Generate the full mip chain into the image data as one allocation, replacing any existing mip levels. Supports uncompressed color formats. Rows are filtered on the work queue's threads for large levels. Return true on success.
+    bool GenerateMipLevels(bool sRGB = false);
     /// Return the data for a mip level. Images loaded from eg. PNG or JPG formats will only have one (index 0) level.
     ImageLevel GetLevel(size_t index) const;
 	/// Return an SDL surface from the image, or null if failed. Only RGB images are supported. Specify rect to only return partial image. You must free the surface yourself.
 	SDL_Surface* GetSDLSurface(const RectI& rect = RectI::ZERO) const;
-	/// Decompress a mip level as 8-bit RGBA. Supports compressed images only. Return true on success.
+	/// Decompress a mip level as 8-bit RGBA. Supports compressed images only. Large levels are decompressed on the work queue's threads. Return true on success.
     bool DecompressLevel(unsigned char* dest, size_t levelIndex) const;
 
     /// Calculate the data _size of an image level.
@@ -130,12 +132,14 @@ private:
     static unsigned char* DecodePixelData(Stream& source, int& width, int& height, unsigned& components);
     /// Free the decoded pixel data.
     static void FreePixelData(unsigned char* pixelData);
+    /// Filter one mip level from the next larger level, splitting the rows across the work queue's threads when the level is large enough.
+    static void GenerateMipLevel(const ImageLevel& src, const ImageLevel& dest, ImageFormat::Type format, bool sRGB);
 
     /// Image dimensions.
     Vector2I _size;
     /// Image format.
     ImageFormat::Type _format;
-    /// Number of mip levels. 1 for uncompressed images.
+    /// Number of mip levels. 1 for uncompressed images unless generated with GenerateMipLevels().
     size_t _numLevels;
     /// Image pixel data.
     SharedArrayPtr<unsigned char> _data;
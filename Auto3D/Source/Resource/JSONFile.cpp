@@ -1,7 +1,7 @@
-#include "../Base/AutoPtr.h"
 #include "../Debug/Log.h"
 #include "../Debug/Profiler.h"
 #include "../IO/File.h"
+#include "../IO/JSONWriter.h"
 #include "JSONFile.h"
 
 #include "../Debug/DebugNew.h"
@@ -18,22 +18,13 @@ bool JSONFile::BeginLoad(Stream& source)
 {
     PROFILE(LoadJSONFile);
     
-    size_t dataSize = source.Size() - source.Position();
-    AutoArrayPtr<char> buffer(new char[dataSize]);
-    if (source.Read(buffer.Get(), dataSize) != dataSize)
-        return false;
-    
-    const char* pos = buffer.Get();
-    const char* end = pos + dataSize;
-    
-    // Remove any previous content
-    _root.SetNull();
-    /// \todo If fails, log the line number on which the error occurred
-    bool success = _root.Parse(pos, end);
+    // The reader parses directly from the stream's memory if possible, otherwise from a temporary buffer.
+    // The builder removes any previous content
+    JSONReader reader;
+    JSONValueBuilder builder(_root);
+    bool success = reader.Parse(source, builder);
     if (!success)
-    {
-        ErrorString("Parsing JSON from " + source.Name() + " failed; data may be partial");
-    }
+        ErrorString("Parsing JSON from " + source.Name() + " failed on line " + String(reader.ErrorLine()) + "; data may be partial");
 
     return success;
 }
@@ -42,9 +33,9 @@ bool JSONFile::Save(Stream& dest)
 {
     PROFILE(SaveJSONFile);
     
-    String buffer;
-    _root.ToString(buffer);
-    return dest.Write(buffer.Begin()._ptr, buffer.Length()) == buffer.Length();
+    JSONWriter writer(dest);
+    writer.WriteValue(_root);
+    return writer.Flush();
 }
 
 }
@@ -0,0 +1,387 @@
+#include "../Math/Math.h"
+#include "../Math/SIMD.h"
+#include "MipFilter.h"
+
+#include <cstring>
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+/// Number of entries in the linear to sRGB conversion table.
+static const int LINEAR_TO_SRGB_ENTRIES = 4096;
+
+/// Conversion tables between 8-bit sRGB and linear values.
+struct SRGBTables
+{
+    /// Construct and fill the tables.
+    SRGBTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            float value = i / 255.0f;
+            _toLinear[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+        }
+
+        for (int i = 0; i < LINEAR_TO_SRGB_ENTRIES; ++i)
+        {
+            float value = (float)i / (LINEAR_TO_SRGB_ENTRIES - 1);
+            float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+            _toSRGB[i] = (unsigned char)Clamp((int)(srgb * 255.0f + 0.5f), 0, 255);
+        }
+    }
+
+    /// Linear value of each 8-bit sRGB value.
+    float _toLinear[256];
+    /// 8-bit sRGB value of each quantized linear value.
+    unsigned char _toSRGB[LINEAR_TO_SRGB_ENTRIES];
+};
+
+/// Return the sRGB conversion tables. They are created on first use, which is thread-safe.
+static const SRGBTables& GetSRGBTables()
+{
+    static const SRGBTables tables;
+    return tables;
+}
+
+/// Box filter one row of interleaved components, with the source column clamped for 1 pixel wide sources. Start from destination pixel startX.
+template <typename _Ty, typename _Fun> void FilterRow(const _Ty* upper, const _Ty* lower, _Ty* out, int srcWidth, int destWidth,
+    int components, int startX, _Fun filter)
+{
+    for (int x = startX; x < destWidth; ++x)
+    {
+        const int x0 = x * 2 * components;
+        const int x1 = Min(x * 2 + 1, srcWidth - 1) * components;
+        for (int c = 0; c < components; ++c)
+            out[x * components + c] = filter(upper[x0 + c], upper[x1 + c], lower[x0 + c], lower[x1 + c], c);
+    }
+}
+
+#ifdef AUTO_SSE
+/// Sum adjacent pixels of 16-bit components, leaving the 4 results in the low 64 bits.
+static inline __m128i SumPixelPairs(__m128i value, int components)
+{
+    switch (components)
+    {
+    case 1:
+        value = _mm_add_epi16(value, _mm_srli_epi32(value, 16));
+        value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(3, 1, 2, 0));
+        value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(3, 1, 2, 0));
+        return _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 1, 2, 0));
+
+    case 2:
+        value = _mm_add_epi16(value, _mm_srli_epi64(value, 32));
+        return _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 1, 2, 0));
+
+    default:
+        return _mm_add_epi16(value, _mm_srli_si128(value, 8));
+    }
+}
+#endif
+
+/// Box filter a row of 8-bit pixels with 1, 2 or 4 components using SIMD where available. Return the number of destination pixels processed; the caller filters the rest.
+static int FilterRowUnorm8SIMD(const unsigned char* upper, const unsigned char* lower, unsigned char* out, int destWidth, int components)
+{
+#if defined(AUTO_SSE)
+    // Each iteration reads 32 bytes from both rows and writes 16 bytes
+    const __m128i zero = _mm_setzero_si128();
+    int numBlocks = destWidth * components / 16;
+
+    for (int i = 0; i < numBlocks; ++i)
+    {
+        __m128i upper0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(upper + i * 32));
+        __m128i upper1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(upper + i * 32 + 16));
+        __m128i lower0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lower + i * 32));
+        __m128i lower1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lower + i * 32 + 16));
+
+        __m128i sum0 = _mm_add_epi16(_mm_unpacklo_epi8(upper0, zero), _mm_unpacklo_epi8(lower0, zero));
+        __m128i sum1 = _mm_add_epi16(_mm_unpackhi_epi8(upper0, zero), _mm_unpackhi_epi8(lower0, zero));
+        __m128i sum2 = _mm_add_epi16(_mm_unpacklo_epi8(upper1, zero), _mm_unpacklo_epi8(lower1, zero));
+        __m128i sum3 = _mm_add_epi16(_mm_unpackhi_epi8(upper1, zero), _mm_unpackhi_epi8(lower1, zero));
+
+        __m128i result0 = _mm_srli_epi16(_mm_unpacklo_epi64(SumPixelPairs(sum0, components), SumPixelPairs(sum1, components)), 2);
+        __m128i result1 = _mm_srli_epi16(_mm_unpacklo_epi64(SumPixelPairs(sum2, components), SumPixelPairs(sum3, components)), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 16), _mm_packus_epi16(result0, result1));
+    }
+
+    return numBlocks * 16 / components;
+#elif defined(AUTO_NEON)
+    // Each iteration writes 8 pixels, deinterleaving the components on load
+    int numBlocks = destWidth / 8;
+
+    for (int i = 0; i < numBlocks; ++i)
+    {
+        switch (components)
+        {
+        case 1:
+            {
+                uint16x8_t sum = vpadalq_u8(vpaddlq_u8(vld1q_u8(upper + i * 16)), vld1q_u8(lower + i * 16));
+                vst1_u8(out + i * 8, vshrn_n_u16(sum, 2));
+            }
+            break;
+
+        case 2:
+            {
+                uint8x16x2_t upperPixels = vld2q_u8(upper + i * 32);
+                uint8x16x2_t lowerPixels = vld2q_u8(lower + i * 32);
+                uint8x8x2_t result;
+                for (int c = 0; c < 2; ++c)
+                    result.val[c] = vshrn_n_u16(vpadalq_u8(vpaddlq_u8(upperPixels.val[c]), lowerPixels.val[c]), 2);
+                vst2_u8(out + i * 16, result);
+            }
+            break;
+
+        default:
+            {
+                uint8x16x4_t upperPixels = vld4q_u8(upper + i * 64);
+                uint8x16x4_t lowerPixels = vld4q_u8(lower + i * 64);
+                uint8x8x4_t result;
+                for (int c = 0; c < 4; ++c)
+                    result.val[c] = vshrn_n_u16(vpadalq_u8(vpaddlq_u8(upperPixels.val[c]), lowerPixels.val[c]), 2);
+                vst4_u8(out + i * 32, result);
+            }
+            break;
+        }
+    }
+
+    return numBlocks * 8;
+#else
+    (void)upper;
+    (void)lower;
+    (void)out;
+    (void)destWidth;
+    (void)components;
+    return 0;
+#endif
+}
+
+/// Box filter a row of 32-bit float pixels with 1, 2 or 4 components using SIMD where available. Return the number of destination pixels processed; the caller filters the rest.
+static int FilterRowFloatSIMD(const float* upper, const float* lower, float* out, int destWidth, int components)
+{
+#ifdef AUTO_SSE
+    // Each iteration reads 8 floats from both rows and writes 4 floats
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    int numBlocks = destWidth * components / 4;
+
+    for (int i = 0; i < numBlocks; ++i)
+    {
+        __m128 sum0 = _mm_add_ps(_mm_loadu_ps(upper + i * 8), _mm_loadu_ps(lower + i * 8));
+        __m128 sum1 = _mm_add_ps(_mm_loadu_ps(upper + i * 8 + 4), _mm_loadu_ps(lower + i * 8 + 4));
+        __m128 result;
+
+        switch (components)
+        {
+        case 1:
+            result = _mm_add_ps(_mm_shuffle_ps(sum0, sum1, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(sum0, sum1, _MM_SHUFFLE(3, 1, 3, 1)));
+            break;
+
+        case 2:
+            result = _mm_add_ps(_mm_shuffle_ps(sum0, sum1, _MM_SHUFFLE(1, 0, 1, 0)), _mm_shuffle_ps(sum0, sum1, _MM_SHUFFLE(3, 2, 3, 2)));
+            break;
+
+        default:
+            result = _mm_add_ps(sum0, sum1);
+            break;
+        }
+
+        _mm_storeu_ps(out + i * 4, _mm_mul_ps(result, quarter));
+    }
+
+    return numBlocks * 4 / components;
+#else
+    (void)upper;
+    (void)lower;
+    (void)out;
+    (void)destWidth;
+    (void)components;
+    return 0;
+#endif
+}
+
+bool CanGenerateMips(ImageFormat::Type format)
+{
+    switch (format)
+    {
+    case ImageFormat::R8:
+    case ImageFormat::RG8:
+    case ImageFormat::RGBA8:
+    case ImageFormat::A8:
+    case ImageFormat::R16:
+    case ImageFormat::RG16:
+    case ImageFormat::RGBA16:
+    case ImageFormat::R16F:
+    case ImageFormat::RG16F:
+    case ImageFormat::RGBA16F:
+    case ImageFormat::R32F:
+    case ImageFormat::RG32F:
+    case ImageFormat::RGB32F:
+    case ImageFormat::RGBA32F:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+void GenerateMipRows(const ImageLevel& src, const ImageLevel& dest, ImageFormat::Type format, bool sRGB, size_t firstRow, size_t lastRow)
+{
+    const int srcWidth = src._size._x;
+    const int srcHeight = src._size._y;
+    const int destWidth = dest._size._x;
+
+    for (size_t y = firstRow; y < lastRow; ++y)
+    {
+        // Clamp the lower row for 1 pixel high sources
+        const unsigned char* upper = src._data + (y * 2) * src._rowSize;
+        const unsigned char* lower = src._data + Min((int)y * 2 + 1, srcHeight - 1) * src._rowSize;
+        unsigned char* out = dest._data + y * dest._rowSize;
+
+        switch (format)
+        {
+        case ImageFormat::R8:
+        case ImageFormat::RG8:
+        case ImageFormat::RGBA8:
+        case ImageFormat::A8:
+            {
+                int components = Image::components[format];
+                if (sRGB && format != ImageFormat::A8)
+                {
+                    // Alpha of RGBA8 stays linear
+                    const SRGBTables& tables = GetSRGBTables();
+                    int alphaComponent = format == ImageFormat::RGBA8 ? 3 : -1;
+                    FilterRow(upper, lower, out, srcWidth, destWidth, components, 0,
+                        [&tables, alphaComponent](unsigned char a, unsigned char b, unsigned char c, unsigned char d, int component)
+                    {
+                        if (component == alphaComponent)
+                            return (unsigned char)(((unsigned)a + b + c + d) >> 2);
+                        float linear = (tables._toLinear[a] + tables._toLinear[b] + tables._toLinear[c] + tables._toLinear[d]) * 0.25f;
+                        return tables._toSRGB[(int)(linear * (LINEAR_TO_SRGB_ENTRIES - 1) + 0.5f)];
+                    });
+                }
+                else
+                {
+                    int startX = srcWidth > 1 ? FilterRowUnorm8SIMD(upper, lower, out, destWidth, components) : 0;
+                    FilterRow(upper, lower, out, srcWidth, destWidth, components, startX,
+                        [](unsigned char a, unsigned char b, unsigned char c, unsigned char d, int)
+                    {
+                        return (unsigned char)(((unsigned)a + b + c + d) >> 2);
+                    });
+                }
+            }
+            break;
+
+        case ImageFormat::R16:
+        case ImageFormat::RG16:
+        case ImageFormat::RGBA16:
+            FilterRow((const unsigned short*)upper, (const unsigned short*)lower, (unsigned short*)out, srcWidth, destWidth,
+                (int)(Image::pixelByteSizes[format] / sizeof(unsigned short)), 0,
+                [](unsigned short a, unsigned short b, unsigned short c, unsigned short d, int)
+            {
+                return (unsigned short)(((unsigned)a + b + c + d) >> 2);
+            });
+            break;
+
+        case ImageFormat::R16F:
+        case ImageFormat::RG16F:
+        case ImageFormat::RGBA16F:
+            FilterRow((const unsigned short*)upper, (const unsigned short*)lower, (unsigned short*)out, srcWidth, destWidth,
+                (int)(Image::pixelByteSizes[format] / sizeof(unsigned short)), 0,
+                [](unsigned short a, unsigned short b, unsigned short c, unsigned short d, int)
+            {
+                return FloatToHalf((HalfToFloat(a) + HalfToFloat(b) + HalfToFloat(c) + HalfToFloat(d)) * 0.25f);
+            });
+            break;
+
+        case ImageFormat::R32F:
+        case ImageFormat::RG32F:
+        case ImageFormat::RGB32F:
+        case ImageFormat::RGBA32F:
+            {
+                int components = (int)(Image::pixelByteSizes[format] / sizeof(float));
+                int startX = srcWidth > 1 && components != 3 ? FilterRowFloatSIMD((const float*)upper, (const float*)lower,
+                    (float*)out, destWidth, components) : 0;
+                FilterRow((const float*)upper, (const float*)lower, (float*)out, srcWidth, destWidth, components, startX,
+                    [](float a, float b, float c, float d, int)
+                {
+                    return (a + b + c + d) * 0.25f;
+                });
+            }
+            break;
+
+        default:
+            return;
+        }
+    }
+}
+
+float HalfToFloat(unsigned short value)
+{
+    unsigned sign = (unsigned)(value & 0x8000) << 16;
+    int exponent = (value >> 10) & 0x1f;
+    unsigned mantissa = value & 0x3ff;
+    unsigned bits;
+
+    if (exponent == 0)
+    {
+        if (!mantissa)
+            bits = sign;
+        else
+        {
+            // Normalize the denormal
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | ((unsigned)exponent << 23) | ((mantissa & 0x3ff) << 13);
+        }
+    }
+    else if (exponent == 31)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else
+        bits = sign | ((unsigned)(exponent + 127 - 15) << 23) | (mantissa << 13);
+
+    float ret;
+    memcpy(&ret, &bits, sizeof ret);
+    return ret;
+}
+
+unsigned short FloatToHalf(float value)
+{
+    unsigned bits;
+    memcpy(&bits, &value, sizeof bits);
+
+    unsigned short sign = (unsigned short)((bits >> 16) & 0x8000);
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    unsigned mantissa = bits & 0x7fffff;
+
+    // Infinity and NaN
+    if ((bits & 0x7fffffff) >= 0x7f800000)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    // Overflow to infinity
+    if (exponent >= 31)
+        return sign | 0x7c00;
+
+    if (exponent <= 0)
+    {
+        // Denormal or underflow to zero
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        unsigned half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+            ++half;
+        return sign | (unsigned short)half;
+    }
+
+    // Rounding may carry into the exponent, which gives the correct result
+    unsigned short half = sign | (unsigned short)(exponent << 10) | (unsigned short)(mantissa >> 13);
+    if (mantissa & 0x1000)
+        ++half;
+    return half;
+}
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Image.h"
+
+namespace Auto3D
+{
+
+/// Return whether mip levels can be generated for an image format. All uncompressed color formats are supported.
+AUTO_API bool CanGenerateMips(ImageFormat::Type format);
+/// Generate rows [firstRow, lastRow) of a mip level from the next larger level with a 2x2 box filter. If sRGB is true, the color components of 8-bit formats are averaged in linear space; alpha is always linear. Rows can be generated on several threads at once.
+AUTO_API void GenerateMipRows(const ImageLevel& src, const ImageLevel& dest, ImageFormat::Type format, bool sRGB, size_t firstRow, size_t lastRow);
+/// Convert a half float to float.
+AUTO_API float HalfToFloat(unsigned short value);
+/// Convert a float to half float, rounding to nearest.
+AUTO_API unsigned short FloatToHalf(float value);
+
+}
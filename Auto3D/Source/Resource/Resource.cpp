@@ -6,6 +6,12 @@
 namespace Auto3D
 {
 
+Resource::Resource() :
+    _memoryUse(0),
+    _lastUseTime(0)
+{
+}
+
 bool Resource::BeginLoad(Stream&)
 {
     return false;
@@ -37,9 +43,10 @@ void Resource::SetName(const String& newName)
     _name = newName;
     _nameHash = StringHash(newName);
 }
-void Resource::SetMemoryUse(unsigned _size)
+
+void Resource::SetMemoryUse(unsigned size)
 {
-	_memoryUse = _size;
+    _memoryUse = size;
 }
 
 }
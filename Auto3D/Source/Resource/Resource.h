@@ -14,7 +14,10 @@ class AUTO_API Resource : public Object
     REGISTER_OBJECT_CLASS(Resource,Object)
 
 public:
-    /// Load the resource data from a stream. May be executed outside the main thread, should not access GPU resources. Return true on success.
+    /// Construct.
+    Resource();
+
+    /// Load the resource data from a stream. May be executed outside the main thread, should not access GPU resources. The stream stays alive until EndLoad(), so views read from it can be used there. Return true on success.
     virtual bool BeginLoad(Stream& source);
     /// Finish resource loading if necessary. Always called from the main thread, so GPU resources can be accessed here. Return true on success.
     virtual bool EndLoad();
@@ -26,22 +29,29 @@ public:
     /// Set name of the resource, usually the same as the file being loaded from.
     void SetName(const String& newName);
 
-	void SetMemoryUse(unsigned _size);
+    /// Set memory use in bytes, possibly approximate. Used for the resource cache's memory budgets.
+    void SetMemoryUse(unsigned size);
+    /// Set the time of last use in milliseconds. Called by the resource cache when the resource is requested.
+    void SetLastUseTime(unsigned time) { _lastUseTime = time; }
 
     /// Return name of the resource.
     const String& Name() const { return _name; }
     /// Return name hash of the resource.
     const StringHash& NameHash() const { return _nameHash; }
-	/// Return memory use in bytes, possibly approximate.
-	unsigned GetMemoryUse() const { return _memoryUse; }
+    /// Return memory use in bytes, possibly approximate.
+    unsigned GetMemoryUse() const { return _memoryUse; }
+    /// Return the time of last use in milliseconds.
+    unsigned LastUseTime() const { return _lastUseTime; }
+
 private:
     /// Resource name.
     String _name;
     /// Resource name hash.
     StringHash _nameHash;
-
-	/// Memory use in bytes.
-	unsigned _memoryUse;
+    /// Memory use in bytes.
+    unsigned _memoryUse;
+    /// Time of last use in milliseconds.
+    unsigned _lastUseTime;
 };
 
 /// Return name from a resource pointer.
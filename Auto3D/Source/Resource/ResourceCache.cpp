@@ -2,22 +2,73 @@
 #include "../Debug/Profiler.h"
 #include "../IO/File.h"
 #include "../IO/FileSystem.h"
+#include "../IO/FileWatcher.h"
+#include "../IO/MappedFile.h"
+#include "../IO/PackageFile.h"
+#include "../IO/VectorBuffer.h"
+#include "BackgroundLoader.h"
 #include "Image.h"
 #include "JSONFile.h"
 #include "ResourceCache.h"
 
+#include "../Base/Sort.h"
 #include "../Debug/DebugNew.h"
 
 namespace Auto3D
 {
 
-ResourceCache::ResourceCache()
+/// Minimum size of a resource file to memory-map it. Smaller files are cheaper to read into memory than to map.
+static const size_t MIN_MAPPED_RESOURCE_SIZE = 64 * 1024;
+
+/// Open a resource file so that loaders can read views into it without a further copy. Large files are memory-mapped, small files
+/// read into a buffer. The mapping is held until the resource's EndLoad(). If another process truncates the file meanwhile,
+/// reading the lost part of the mapping faults, and on Windows the mapping prevents the file from being saved; the short mapping
+/// time and the size threshold keep both rare for resources being edited.
+static Stream* OpenResourceFile(const String& fileName)
+{
+    AutoPtr<File> file(new File(fileName));
+    if (!file->IsOpen() || !file->Size())
+        return file.Detach();
+
+    if (file->Size() >= MIN_MAPPED_RESOURCE_SIZE)
+    {
+        MappedFile* mappedFile = new MappedFile(fileName);
+        if (mappedFile->IsOpen())
+            return mappedFile;
+        delete mappedFile;
+    }
+
+    VectorBuffer* buffer = new VectorBuffer();
+    buffer->SetData(*file, file->Size());
+    buffer->SetName(fileName);
+    return buffer;
+}
+
+/// Return the resource index key of a resource file name. On Windows the file system is case-insensitive, so the name is
+/// lowercased to find the file however the name is cased.
+static StringHash ResourceIndexKey(const String& name)
+{
+#ifdef _WIN32
+    return StringHash(name.ToLower());
+#else
+    return StringHash(name);
+#endif
+}
+
+ResourceCache::ResourceCache() :
+    _executableDir(ExecutableDir()),
+    _backgroundLoadBudget(DEFAULT_BACKGROUND_LOAD_BUDGET),
+    _autoReloadResources(false),
+    _autoReloadDelay(DEFAULT_FILE_WATCHER_DELAY)
 {
     RegisterSubsystem(this);
 }
 
 ResourceCache::~ResourceCache()
 {
+    // Stop the loader thread before the resources it may be loading are destroyed
+    _backgroundLoader.Reset();
+    _fileWatchers.Clear();
     UnloadAllResources(true);
     RemoveSubsystem(this);
 }
@@ -33,6 +84,7 @@ bool ResourceCache::AddResourceDir(const String& pathName, bool addFirst)
     }
 
     String fixedPath = SanitateResourceDirName(pathName);
+    MutexLock lock(_resourceMutex);
 
     // Check that the same path does not already exist
     for (size_t i = 0; i < _resourceDirs.Size(); ++i)
@@ -41,15 +93,65 @@ bool ResourceCache::AddResourceDir(const String& pathName, bool addFirst)
             return true;
     }
 
+    // Precalculate the path relative to the executable for sanitating resource names
+    String relativePath = fixedPath.StartsWith(_executableDir) ? fixedPath.Substring(_executableDir.Length()) : fixedPath;
+
     if (addFirst)
+    {
         _resourceDirs.Insert(0, fixedPath);
+        _relativeResourceDirs.Insert(0, relativePath);
+        if (_autoReloadResources)
+            _fileWatchers.Insert(0, AutoPtr<FileWatcher>(CreateFileWatcher(fixedPath)));
+        // Existing directory indices change, so the whole index must be rebuilt
+        RefreshResourceIndex();
+    }
     else
+    {
         _resourceDirs.Push(fixedPath);
+        _relativeResourceDirs.Push(relativePath);
+        if (_autoReloadResources)
+            _fileWatchers.Push(AutoPtr<FileWatcher>(CreateFileWatcher(fixedPath)));
+        IndexResourceDir(_resourceDirs.Size() - 1);
+    }
 
     InfoString("Added resource path " + fixedPath);
     return true;
 }
 
+bool ResourceCache::AddPackageFile(const String& fileName, bool addFirst)
+{
+    PROFILE(AddPackageFile);
+
+    SharedPtr<PackageFile> package(new PackageFile());
+    return package->Open(fileName) && AddPackageFile(package, addFirst);
+}
+
+bool ResourceCache::AddPackageFile(PackageFile* package, bool addFirst)
+{
+    if (!package || !package->IsOpen())
+    {
+        ErrorString("Null or unopened package file, can not add");
+        return false;
+    }
+
+    MutexLock lock(_resourceMutex);
+
+    // Check that the same package does not already exist
+    for (size_t i = 0; i < _packageFiles.Size(); ++i)
+    {
+        if (_packageFiles[i] == package)
+            return true;
+    }
+
+    if (addFirst)
+        _packageFiles.Insert(0, SharedPtr<PackageFile>(package));
+    else
+        _packageFiles.Push(SharedPtr<PackageFile>(package));
+
+    InfoString("Added resource package " + package->Name());
+    return true;
+}
+
 bool ResourceCache::AddManualResource(Resource* resource)
 {
     if (!resource)
@@ -64,7 +166,7 @@ bool ResourceCache::AddManualResource(Resource* resource)
         return false;
     }
 
-    _resources[MakePair(resource->GetType(), StringHash(resource->Name()))] = resource;
+    StoreResource(MakePair(resource->GetType(), StringHash(resource->Name())), resource);
     return true;
 }
 
@@ -72,18 +174,38 @@ void ResourceCache::RemoveResourceDir(const String& pathName)
 {
     // Convert path to absolute
     String fixedPath = SanitateResourceDirName(pathName);
+    MutexLock lock(_resourceMutex);
 
     for (size_t i = 0; i < _resourceDirs.Size(); ++i)
     {
         if (!_resourceDirs[i].Compare(fixedPath, false))
         {
             _resourceDirs.Erase(i);
+            _relativeResourceDirs.Erase(i);
+            if (_autoReloadResources)
+                _fileWatchers.Erase(i);
+            RefreshResourceIndex();
             InfoString("Removed resource path " + fixedPath);
             return;
         }
     }
 }
 
+void ResourceCache::RemovePackageFile(const String& fileName)
+{
+    MutexLock lock(_resourceMutex);
+
+    for (size_t i = 0; i < _packageFiles.Size(); ++i)
+    {
+        if (!_packageFiles[i]->Name().Compare(fileName, false))
+        {
+            _packageFiles.Erase(i);
+            InfoString("Removed resource package " + fileName);
+            return;
+        }
+    }
+}
+
 void ResourceCache::UnloadResource(StringHash type, const String& name, bool force)
 {
     auto key = MakePair(type, StringHash(name));
@@ -203,25 +325,89 @@ bool ResourceCache::ReloadResource(Resource* resource)
     return stream ? resource->Load(*stream) : false;
 }
 
+void ResourceCache::SetAutoReloadResources(bool enable)
+{
+    if (enable == _autoReloadResources)
+        return;
+
+    _autoReloadResources = enable;
+    _fileWatchers.Clear();
+    if (enable)
+    {
+        for (size_t i = 0; i < _resourceDirs.Size(); ++i)
+            _fileWatchers.Push(AutoPtr<FileWatcher>(CreateFileWatcher(_resourceDirs[i])));
+    }
+}
+
+void ResourceCache::SetAutoReloadDelay(int delayMs)
+{
+    _autoReloadDelay = Max(delayMs, 0);
+    for (size_t i = 0; i < _fileWatchers.Size(); ++i)
+        _fileWatchers[i]->SetDelay(_autoReloadDelay);
+}
+
+void ResourceCache::ReloadChangedResources()
+{
+    PROFILE(ReloadChangedResources);
+
+    for (size_t i = 0; i < _fileWatchers.Size(); ++i)
+    {
+        String fileName;
+        while (_fileWatchers[i]->NextChange(fileName))
+        {
+            // The file may be new, or shadow a file in a later resource directory
+            {
+                StringHash nameHash = ResourceIndexKey(fileName);
+                MutexLock lock(_resourceMutex);
+                auto it = _resourceIndex.Find(nameHash);
+                if (it == _resourceIndex.End() || it->_second > i)
+                    _resourceIndex[nameHash] = (unsigned)i;
+            }
+
+            ReloadChangedResource(fileName);
+        }
+    }
+}
+
+void ResourceCache::StoreResourceDependency(Resource* resource, const String& dependency)
+{
+    if (!resource || resource->Name().IsEmpty())
+        return;
+
+    StringHash nameHash(SanitateResourceName(dependency));
+    MutexLock lock(_dependencyMutex);
+    _dependentResources[nameHash].Insert(resource->NameHash());
+}
+
 AutoPtr<Stream> ResourceCache::OpenResource(const String& nameIn)
 {
     String name = SanitateResourceName(nameIn);
     AutoPtr<Stream> ret;
+    String fileName;
 
-    for (size_t i = 0; i < _resourceDirs.Size(); ++i)
+    // Called also from the background loader thread, so resolve the name while the resource directories and packages can
+    // not change, but open loose files outside the lock
     {
-        if (FileExists(_resourceDirs[i] + name))
+        MutexLock lock(_resourceMutex);
+
+        // Packages need no filesystem access, so check them first
+        for (size_t i = 0; i < _packageFiles.Size(); ++i)
         {
-            // Construct the file first with full path, then rename it to not contain the resource path,
-            // so that the file's name can be used in further OpenResource() calls (for example over the network)
-            ret = new File(_resourceDirs[i] + name);
-            break;
+            if (_packageFiles[i]->Exists(name))
+                return _packageFiles[i]->OpenEntry(name);
         }
+
+        const String* resourceDir = FindResourceDir(name);
+        if (resourceDir)
+            fileName = *resourceDir + name;
     }
 
+    if (!fileName.IsEmpty())
+        ret = OpenResourceFile(fileName);
+
     // Fallback using absolute path
     if (!ret)
-        ret = new File(name);
+        ret = OpenResourceFile(name);
 
     if (!ret->IsReadable())
     {
@@ -244,7 +430,22 @@ Resource* ResourceCache::LoadResource(StringHash type, const String& nameIn)
     auto key = MakePair(type, StringHash(name));
     auto it = _resources.Find(key);
     if (it != _resources.End())
+    {
+        it->_second->SetLastUseTime(UseTime());
         return it->_second;
+    }
+
+    // If queued for background loading, wait for it instead of loading twice
+    if (_backgroundLoader && _backgroundLoader->NumQueuedResources())
+    {
+        _backgroundLoader->WaitForResource(type, key._second);
+        it = _resources.Find(key);
+        if (it != _resources.End())
+        {
+            it->_second->SetLastUseTime(UseTime());
+            return it->_second;
+        }
+    }
 
     SharedPtr<Object> newObject = Create(type);
     if (!newObject)
@@ -270,10 +471,170 @@ Resource* ResourceCache::LoadResource(StringHash type, const String& nameIn)
         return nullptr;
 
     // Store to cache
-    _resources[key] = newResource;
+    StoreResource(key, newResource);
     return newResource;
 }
 
+bool ResourceCache::BackgroundLoadResource(StringHash type, const String& nameIn, bool sendEventOnCompletion, Resource* caller)
+{
+    String name = SanitateResourceName(nameIn);
+    if (name.IsEmpty())
+        return false;
+
+    if (!_backgroundLoader)
+    {
+        _backgroundLoader = new BackgroundLoader(this);
+        if (!_backgroundLoader->Run())
+        {
+            ErrorString("Failed to start background loader thread");
+            _backgroundLoader.Reset();
+            return false;
+        }
+    }
+
+    return _backgroundLoader->QueueResource(type, name, sendEventOnCompletion, caller);
+}
+
+void ResourceCache::UpdateBackgroundLoading()
+{
+    if (_backgroundLoader)
+        _backgroundLoader->FinishResources(_backgroundLoadBudget);
+}
+
+void ResourceCache::SetBackgroundLoadBudget(int maxMs)
+{
+    _backgroundLoadBudget = Max(maxMs, 0);
+}
+
+Resource* ResourceCache::GetExistingResource(StringHash type, const String& nameIn) const
+{
+    String name = SanitateResourceName(nameIn);
+    auto it = _resources.Find(MakePair(type, StringHash(name)));
+    if (it == _resources.End())
+        return nullptr;
+
+    it->_second->SetLastUseTime(UseTime());
+    return it->_second;
+}
+
+size_t ResourceCache::NumBackgroundLoadResources() const
+{
+    return _backgroundLoader ? _backgroundLoader->NumQueuedResources() : 0;
+}
+
+void ResourceCache::SetMemoryBudget(StringHash type, unsigned long long budget)
+{
+    if (budget)
+    {
+        _memoryBudgets[type] = budget;
+        CheckMemoryBudget(type);
+    }
+    else
+        _memoryBudgets.Erase(type);
+}
+
+size_t ResourceCache::CheckMemoryBudget(StringHash type, Resource* keep)
+{
+    unsigned long long budget = MemoryBudget(type);
+    if (!budget)
+        return 0;
+
+    unsigned long long memoryUse = MemoryUse(type);
+    if (memoryUse <= budget)
+        return 0;
+
+    PROFILE(CheckMemoryBudget);
+
+    // Resources referenced only by the cache can be unloaded, least recently used first. Background loaded resources hold
+    // references to their finished dependencies until they finish themselves, so those are not unloaded
+    _unloadCandidates.Clear();
+    for (auto it = _resources.Begin(); it != _resources.End(); ++it)
+    {
+        Resource* resource = it->_second;
+        if (it->_first._first == type && resource != keep && resource->Refs() == 1)
+            _unloadCandidates.Push(resource);
+    }
+
+    Sort(_unloadCandidates.Begin(), _unloadCandidates.End(), [](Resource* lhs, Resource* rhs) { return lhs->LastUseTime() < rhs->LastUseTime(); });
+
+    size_t unloaded = 0;
+    for (auto it = _unloadCandidates.Begin(); it != _unloadCandidates.End() && memoryUse > budget; ++it)
+    {
+        Resource* resource = *it;
+        memoryUse -= resource->GetMemoryUse();
+        LogString("Unloading resource " + resource->Name() + " to stay within memory budget");
+        _resources.Erase(MakePair(type, resource->NameHash()));
+        ++unloaded;
+    }
+
+    if (memoryUse > budget)
+        WarningStringF("Memory budget of resource type %s exceeded by %llu bytes of resources in use", type.ToString().CString(),
+            memoryUse - budget);
+
+    return unloaded;
+}
+
+unsigned long long ResourceCache::MemoryBudget(StringHash type) const
+{
+    auto it = _memoryBudgets.Find(type);
+    return it != _memoryBudgets.End() ? it->_second : 0;
+}
+
+unsigned long long ResourceCache::MemoryUse(StringHash type) const
+{
+    unsigned long long ret = 0;
+    for (auto it = _resources.Begin(); it != _resources.End(); ++it)
+    {
+        if (it->_first._first == type)
+            ret += it->_second->GetMemoryUse();
+    }
+
+    return ret;
+}
+
+unsigned long long ResourceCache::TotalMemoryUse() const
+{
+    unsigned long long ret = 0;
+    for (auto it = _resources.Begin(); it != _resources.End(); ++it)
+        ret += it->_second->GetMemoryUse();
+
+    return ret;
+}
+
+void ResourceCache::MemoryReport(Vector<ResourceMemoryInfo>& result) const
+{
+    result.Clear();
+
+    HashMap<StringHash, size_t> typeIndices;
+    for (auto it = _resources.Begin(); it != _resources.End(); ++it)
+    {
+        StringHash type = it->_first._first;
+        auto indexIt = typeIndices.Find(type);
+        if (indexIt == typeIndices.End())
+        {
+            ResourceMemoryInfo info;
+            info._type = type;
+            info._typeName = it->_second->GetTypeName();
+            info._numResources = 0;
+            info._memoryUse = 0;
+            info._memoryBudget = MemoryBudget(type);
+            indexIt = typeIndices.Insert(MakePair(type, result.Size()));
+            result.Push(info);
+        }
+
+        ResourceMemoryInfo& info = result[indexIt->_second];
+        ++info._numResources;
+        info._memoryUse += it->_second->GetMemoryUse();
+    }
+}
+
+void ResourceCache::StoreResource(const Pair<StringHash, StringHash>& key, Resource* resource)
+{
+    resource->SetLastUseTime(UseTime());
+    _resources[key] = resource;
+    CheckMemoryBudget(key._first, resource);
+}
+
 void ResourceCache::ResourcesByType(Vector<Resource*>& result, StringHash type) const
 {
     result.Clear();
@@ -289,9 +650,16 @@ bool ResourceCache::Exists(const String& nameIn) const
 {
     String name = SanitateResourceName(nameIn);
 
-    for (size_t i = 0; i < _resourceDirs.Size(); ++i)
     {
-        if (FileExists(_resourceDirs[i] + name))
+        MutexLock lock(_resourceMutex);
+
+        for (size_t i = 0; i < _packageFiles.Size(); ++i)
+        {
+            if (_packageFiles[i]->Exists(name))
+                return true;
+        }
+
+        if (FindResourceDir(name))
             return true;
     }
 
@@ -301,13 +669,9 @@ bool ResourceCache::Exists(const String& nameIn) const
 
 String ResourceCache::ResourceFileName(const String& name) const
 {
-    for (unsigned i = 0; i < _resourceDirs.Size(); ++i)
-    {
-        if (FileExists(_resourceDirs[i] + name))
-            return _resourceDirs[i] + name;
-    }
-
-    return String();
+    MutexLock lock(_resourceMutex);
+    const String* resourceDir = FindResourceDir(name);
+    return resourceDir ? *resourceDir + name : String();
 }
 
 String ResourceCache::SanitateResourceName(const String& nameIn) const
@@ -317,29 +681,92 @@ String ResourceCache::SanitateResourceName(const String& nameIn) const
     name.Replace("../", "");
     name.Replace("./", "");
 
-    // If the path refers to one of the resource directories, normalize the resource name
-    if (_resourceDirs.Size())
-    {
-        String namePath = Path(name);
-        String exePath = ExecutableDir();
-        for (unsigned i = 0; i < _resourceDirs.Size(); ++i)
-        {
-            String relativeResourcePath = _resourceDirs[i];
-            if (relativeResourcePath.StartsWith(exePath))
-                relativeResourcePath = relativeResourcePath.Substring(exePath.Length());
-
-            if (namePath.StartsWith(_resourceDirs[i], false))
-                namePath = namePath.Substring(_resourceDirs[i].Length());
-            else if (namePath.StartsWith(relativeResourcePath, false))
-                namePath = namePath.Substring(relativeResourcePath.Length());
-        }
+    MutexLock lock(_resourceMutex);
 
-        name = namePath + FileNameAndExtension(name);
+    // If the path refers to one of the resource directories, normalize the resource name. The directory names end in a
+    // slash, so they can only match the path part of the name
+    for (size_t i = 0; i < _resourceDirs.Size(); ++i)
+    {
+        if (name.StartsWith(_resourceDirs[i], false))
+            name = name.Substring(_resourceDirs[i].Length());
+        else if (name.StartsWith(_relativeResourceDirs[i], false))
+            name = name.Substring(_relativeResourceDirs[i].Length());
     }
 
     return name.Trimmed();
 }
 
+void ResourceCache::RefreshResourceIndex()
+{
+    PROFILE(RefreshResourceIndex);
+
+    MutexLock lock(_resourceMutex);
+    _resourceIndex.Clear();
+    for (size_t i = 0; i < _resourceDirs.Size(); ++i)
+        IndexResourceDir(i);
+}
+
+void ResourceCache::IndexResourceDir(size_t index)
+{
+    PROFILE(IndexResourceDir);
+
+    Vector<String> fileNames;
+    ScanDir(fileNames, _resourceDirs[index], "*", SCAN_FILES, true);
+
+    // Earlier directories take priority, so do not replace existing entries
+    for (auto it = fileNames.Begin(); it != fileNames.End(); ++it)
+    {
+        StringHash nameHash = ResourceIndexKey(*it);
+        if (!_resourceIndex.Contains(nameHash))
+            _resourceIndex[nameHash] = (unsigned)index;
+    }
+}
+
+const String* ResourceCache::FindResourceDir(const String& name) const
+{
+    auto it = _resourceIndex.Find(ResourceIndexKey(name));
+    return it != _resourceIndex.End() ? &_resourceDirs[it->_second] : nullptr;
+}
+
+FileWatcher* ResourceCache::CreateFileWatcher(const String& pathName)
+{
+    FileWatcher* watcher = new FileWatcher();
+    watcher->SetDelay(_autoReloadDelay);
+    watcher->StartWatching(pathName, true);
+    return watcher;
+}
+
+void ResourceCache::ReloadChangedResource(const String& name)
+{
+    StringHash nameHash(name);
+    HashSet<StringHash> reloadNames;
+    reloadNames.Insert(nameHash);
+
+    {
+        MutexLock lock(_dependencyMutex);
+        auto it = _dependentResources.Find(nameHash);
+        if (it != _dependentResources.End())
+            reloadNames.Insert(it->_second);
+    }
+
+    // Resources of different types may share a file, so check all of them. Reloading may load further resources, so collect
+    // the resources first
+    Vector<SharedPtr<Resource> > reloadResources;
+    for (auto it = _resources.Begin(); it != _resources.End(); ++it)
+    {
+        if (reloadNames.Contains(it->_second->NameHash()))
+            reloadResources.Push(it->_second);
+    }
+
+    for (auto it = reloadResources.Begin(); it != reloadResources.End(); ++it)
+    {
+        Resource* resource = *it;
+        LogString("Reloading changed resource " + resource->Name());
+        if (!ReloadResource(resource))
+            ErrorString("Failed to reload resource " + resource->Name());
+    }
+}
+
 String ResourceCache::SanitateResourceDirName(const String& nameIn) const
 {
     // Convert path to absolute
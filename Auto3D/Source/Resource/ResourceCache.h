@@ -1,19 +1,58 @@
 #pragma once
 
+#include "../Base/HashSet.h"
 #include "../Object/GameManager.h"
+#include "../Thread/Mutex.h"
+#include "../Time/Time.h"
 
 namespace Auto3D
 {
 
+class BackgroundLoader;
+class FileWatcher;
+class PackageFile;
 class Resource;
 class Stream;
 
 typedef HashMap<Pair<StringHash, StringHash>, SharedPtr<Resource> > ResourceMap;
+
+/// Memory use of one resource type.
+struct AUTO_API ResourceMemoryInfo
+{
+    /// Resource type.
+    StringHash _type;
+    /// Resource type name.
+    String _typeName;
+    /// Number of loaded resources.
+    size_t _numResources;
+    /// Memory use in bytes.
+    unsigned long long _memoryUse;
+    /// Memory budget in bytes, or zero if unlimited.
+    unsigned long long _memoryBudget;
+};
+
+/// Default time budget in milliseconds per frame for finishing background loaded resources.
+static const int DEFAULT_BACKGROUND_LOAD_BUDGET = 5;
+
+/// Background resource load finished event.
+class AUTO_API ResourceBackgroundLoadedEvent : public Event
+{
+public:
+    /// Resource name.
+    String _name;
+    /// Resource type.
+    StringHash _type;
+    /// The loaded resource, or null if failed.
+    Resource* _resource;
+    /// Success flag.
+    bool _success;
+};
  
 /// %Resource cache subsystem. Loads resources on demand and stores them for later access.
 class AUTO_API ResourceCache : public BaseSubsystem
 {
     REGISTER_OBJECT_CLASS(ResourceCache, BaseSubsystem)
+    friend class BackgroundLoader;
 
 public:
     /// Construct and register subsystem.
@@ -23,14 +62,40 @@ public:
 
     /// Add a resource directory. Return true on success.
     bool AddResourceDir(const String& pathName, bool addFirst = false);
+    /// Open and add a package file. Packages are searched before the resource directories. Return true on success.
+    bool AddPackageFile(const String& fileName, bool addFirst = false);
+    /// Add an opened package file. Return true on success.
+    bool AddPackageFile(PackageFile* package, bool addFirst = false);
     /// Add a manually created resource. If returns success, the resource cache takes ownership of it.
     bool AddManualResource(Resource* resource);
     /// Remove a resource directory.
     void RemoveResourceDir(const String& pathName);
-    /// Open a resource file stream from the resource directories. Return a pointer to the stream, or null if not found.
+    /// Remove a package file. Resources already loaded from it stay loaded.
+    void RemovePackageFile(const String& fileName);
+    /// Rescan the resource directories. Files added to or removed from the directories after they were added are not seen until this is called.
+    void RefreshResourceIndex();
+    /// Open a resource file stream from the package files or resource directories. Return a pointer to the stream, or null if not found.
     AutoPtr<Stream> OpenResource(const String& name);
-    /// Load and return a resource.
+    /// Load and return a resource. If the resource is being background loaded, wait for it to finish.
     Resource* LoadResource(StringHash type, const String& name);
+    /// Queue a resource to be loaded in the background. Resource::BeginLoad() runs in the loader thread and Resource::EndLoad() in UpdateBackgroundLoading(). If a caller resource being background loaded is given, for example from its BeginLoad(), the caller will not finish before this resource. Return true if queued or already queued, false if already loaded or failed.
+    bool BackgroundLoadResource(StringHash type, const String& name, bool sendEventOnCompletion = true, Resource* caller = nullptr);
+    /// Finish background loaded resources within the time budget. Called once per frame by the engine.
+    void UpdateBackgroundLoading();
+    /// Set the time budget in milliseconds per frame for finishing background loaded resources.
+    void SetBackgroundLoadBudget(int maxMs);
+    /// Set the memory budget in bytes for a resource type, or zero for unlimited. When a loaded resource exceeds the budget, the least recently used resources of the type that are not referenced outside the cache are unloaded.
+    void SetMemoryBudget(StringHash type, unsigned long long budget);
+    /// Unload least recently used resources of a type that are not referenced outside the cache until the type is within its memory budget. Optionally keep one resource. Return number of resources unloaded.
+    size_t CheckMemoryBudget(StringHash type, Resource* keep = nullptr);
+    /// Enable or disable automatic reloading of resources when their files in the resource directories change. Watches each resource directory in a background thread.
+    void SetAutoReloadResources(bool enable);
+    /// Set the delay in milliseconds after the last change to a file before its resources are reloaded.
+    void SetAutoReloadDelay(int delayMs);
+    /// Reload the resources whose files have changed, and the resources depending on them. Called once per frame by the engine when automatic reloading is enabled.
+    void ReloadChangedResources();
+    /// Store a dependency of a resource on another resource file, for example a shader include file, so that the resource is reloaded when the file changes. Can be called from the background loader thread.
+    void StoreResourceDependency(Resource* resource, const String& dependency);
     /// Unload resource. Optionally force removal even if referenced.
     void UnloadResource(StringHash type, const String& name, bool force = false);
     /// Unload all resources of type.
@@ -45,14 +110,42 @@ public:
     bool ReloadResource(Resource* resource);
     /// Load and return a resource, template version.
     template <typename _Ty> _Ty* LoadResource(const String& name) { return static_cast<_Ty*>(LoadResource(_Ty::GetTypeStatic(), name)); }
+    /// Set the memory budget for a resource type, template version.
+    template <typename _Ty> void SetMemoryBudget(unsigned long long budget) { SetMemoryBudget(_Ty::GetTypeStatic(), budget); }
     /// Load and return a resource, template version.
     template <typename _Ty> _Ty* LoadResource(const char* name) { return static_cast<_Ty*>(LoadResource(_Ty::GetTypeStatic(), name)); }
+    /// Queue a resource to be loaded in the background, template version.
+    template <typename _Ty> bool BackgroundLoadResource(const String& name, bool sendEventOnCompletion = true, Resource* caller = nullptr) { return BackgroundLoadResource(_Ty::GetTypeStatic(), name, sendEventOnCompletion, caller); }
+    /// Queue a resource to be loaded in the background, template version.
+    template <typename _Ty> bool BackgroundLoadResource(const char* name, bool sendEventOnCompletion = true, Resource* caller = nullptr) { return BackgroundLoadResource(_Ty::GetTypeStatic(), name, sendEventOnCompletion, caller); }
 
     /// Return resources by type.
     void ResourcesByType(Vector<Resource*>& result, StringHash type) const;
-    /// Return resource directories.
+    /// Return the memory budget in bytes for a resource type, or zero if unlimited.
+    unsigned long long MemoryBudget(StringHash type) const;
+    /// Return memory use in bytes of a resource type.
+    unsigned long long MemoryUse(StringHash type) const;
+    /// Return total memory use in bytes of all resources.
+    unsigned long long TotalMemoryUse() const;
+    /// Return memory use of each loaded resource type.
+    void MemoryReport(Vector<ResourceMemoryInfo>& result) const;
+    /// Return an already loaded resource, or null if not loaded. Does not wait for background loading.
+    Resource* GetExistingResource(StringHash type, const String& name) const;
+    /// Return number of resources queued or being loaded in the background.
+    size_t NumBackgroundLoadResources() const;
+    /// Return the time budget in milliseconds per frame for finishing background loaded resources.
+    int BackgroundLoadBudget() const { return _backgroundLoadBudget; }
+    /// Return whether resources are reloaded automatically when their files change.
+    bool AutoReloadResources() const { return _autoReloadResources; }
+    /// Return the delay in milliseconds before changed resources are reloaded.
+    int AutoReloadDelay() const { return _autoReloadDelay; }
+    /// Return resource directories. Only safe to iterate in the main thread.
     const Vector<String>& ResourceDirs() const { return _resourceDirs; }
-    /// Return whether a file exists in the resource directories.
+    /// Return package files. Only safe to iterate in the main thread.
+    const Vector<SharedPtr<PackageFile> >& PackageFiles() const { return _packageFiles; }
+    /// Return number of indexed files in the resource directories.
+    size_t NumIndexedResources() const { return _resourceIndex.Size(); }
+    /// Return whether a file exists in the package files or resource directories.
     bool Exists(const String& name) const;
     /// Return an absolute filename from a resource name.
     String ResourceFileName(const String& name) const;
@@ -77,9 +170,55 @@ public:
     /// Normalize and remove unsupported constructs from a resource directory name.
     String SanitateResourceDirName(const String& name) const;
 
+    /// Background load finished event.
+    ResourceBackgroundLoadedEvent resourceBackgroundLoadedEvent;
+
 private:
+    /// Store a loaded resource, mark it used and enforce the memory budget of its type.
+    void StoreResource(const Pair<StringHash, StringHash>& key, Resource* resource);
+    /// Return the current time in milliseconds for marking resources used.
+    unsigned UseTime() const { return (unsigned)(_useTimer.ElapsedUSec(false) / 1000); }
+    /// Add a resource directory's files to the resource index.
+    void IndexResourceDir(size_t index);
+    /// Return the resource directory containing a sanitated resource name from the index, or null if not found. The resource mutex must be held while the result is used.
+    const String* FindResourceDir(const String& name) const;
+    /// Create and start a file watcher for a resource directory.
+    FileWatcher* CreateFileWatcher(const String& pathName);
+    /// Reload the resources loaded from a file and the resources depending on it.
+    void ReloadChangedResource(const String& name);
+
     ResourceMap _resources;
     Vector<String> _resourceDirs;
+    /// Resource directories relative to the executable directory, or absolute if outside it.
+    Vector<String> _relativeResourceDirs;
+    /// Resource directory index by resource name hash. The names are lowercased on Windows.
+    HashMap<StringHash, unsigned> _resourceIndex;
+    /// Executable directory.
+    String _executableDir;
+    /// Package files.
+    Vector<SharedPtr<PackageFile> > _packageFiles;
+    /// Memory budgets by resource type.
+    HashMap<StringHash, unsigned long long> _memoryBudgets;
+    /// Resources that may be unloaded to stay within a memory budget, kept to avoid allocating on each check.
+    Vector<Resource*> _unloadCandidates;
+    /// Timer for resource last use times.
+    mutable HiresTimer _useTimer;
+    /// Background loader thread, created on first use.
+    AutoPtr<BackgroundLoader> _backgroundLoader;
+    /// Time budget in milliseconds per frame for finishing background loaded resources.
+    int _backgroundLoadBudget;
+    /// File watchers corresponding to the resource directories when reloading automatically.
+    Vector<AutoPtr<FileWatcher> > _fileWatchers;
+    /// Names of the dependent resources by resource file name hash.
+    HashMap<StringHash, HashSet<StringHash> > _dependentResources;
+    /// Mutex for the dependent resources.
+    Mutex _dependencyMutex;
+    /// Mutex for the resource directories, resource index and package files, which the background loader thread reads when opening resources. Modified only in the main thread.
+    mutable Mutex _resourceMutex;
+    /// Automatic reload flag.
+    bool _autoReloadResources;
+    /// Delay in milliseconds before reloading changed resources.
+    int _autoReloadDelay;
 };
 
 /// Register Resource related object factories and attributes.
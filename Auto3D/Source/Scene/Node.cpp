@@ -1,7 +1,9 @@
 #include "../Debug/Log.h"
-#include "../IO/Stream.h"
+#include "../IO/JSONDocument.h"
+#include "../IO/JSONReader.h"
+#include "../IO/JSONWriter.h"
+#include "../IO/VectorBuffer.h"
 #include "../Object/ObjectResolver.h"
-#include "../Resource/JSONFile.h"
 #include "../Renderer/Camera.h"
 #include "Scene.h"
 
@@ -12,13 +14,34 @@ namespace Auto3D
 
 static Vector<SharedPtr<Node> > noChildren;
 
+/// Create and load the child nodes from either a JSON value or a JSON document node.
+template <typename _Ty> static void LoadChildrenJSON(Node* node, const _Ty& source, ObjectResolver& resolver)
+{
+    const _Ty& children = source["children"];
+    if (!children.IsArray())
+        return;
+
+    for (size_t i = 0; i < children.Size(); ++i)
+    {
+        const _Ty& childJSON = children[i];
+        StringHash childType(childJSON["type"].GetString());
+        unsigned childId = (unsigned)childJSON["id"].GetNumber();
+        Node* child = node->CreateChild(childType);
+        if (child)
+        {
+            resolver.StoreObject(childId, child);
+            child->LoadJSON(childJSON, resolver);
+        }
+    }
+}
+
 Node::Node() :
-    _flags(NF_ENABLED),
-    _layer(LAYER_DEFAULT),
-    _tag(TAG_NONE),
     _parent(nullptr),
     _scenes(nullptr),
-    _id(0)
+    _id(0),
+    _flags(NF_ENABLED),
+    _layer(LAYER_DEFAULT),
+    _tag(TAG_NONE)
 {
 }
 
@@ -84,52 +107,60 @@ void Node::LoadJSON(const JSONValue& source, ObjectResolver& resolver)
 {
     // Type and _id has been read by the parent
     Serializable::LoadJSON(source, resolver);
-    
-    const JSONArray& children = source["children"].GetArray();
-    if (children.Size())
-    {
-        for (auto it = children.Begin(); it != children.End(); ++it)
-        {
-            const JSONValue& childJSON = *it;
-            StringHash childType(childJSON["type"].GetString());
-            unsigned childId = (unsigned)childJSON["id"].GetNumber();
-            Node* child = CreateChild(childType);
-            if (child)
-            {
-                resolver.StoreObject(childId, child);
-                child->LoadJSON(childJSON, resolver);
-            }
-        }
-    }
+    LoadChildrenJSON(this, source, resolver);
+}
+
+void Node::LoadJSON(const JSONNode& source, ObjectResolver& resolver)
+{
+    // Type and _id has been read by the parent
+    Serializable::LoadJSON(source, resolver);
+    LoadChildrenJSON(this, source, resolver);
 }
 
 void Node::SaveJSON(JSONValue& dest)
 {
-    dest["type"] = GetTypeName();
-    dest["id"] = Id();
-    Serializable::SaveJSON(dest);
+    // Write through the streaming writer so that the hierarchy is traversed in one place, then read the text back as a value.
+    // The numbers are written in a form that reads back exactly, and vectors in the vector dialect, so the value is the same
+    VectorBuffer buffer;
+    JSONWriter writer(buffer);
+    SaveJSON(writer);
+    writer.Flush();
+
+    JSONReader reader;
+    JSONValueBuilder builder(dest);
+    reader.Parse((const char*)buffer.Data(), buffer.Size(), builder);
+}
+
+void Node::SaveJSON(JSONWriter& dest)
+{
+    dest.StartObject();
+    dest.WriteKey("type");
+    dest.WriteString(GetTypeName());
+    dest.WriteKey("id");
+    dest.WriteNumber(Id());
+    SaveAttributesJSON(dest);
     
     if (NumPersistentChildren())
     {
-        dest["children"].SetEmptyArray();
+        dest.WriteKey("children");
+        dest.StartArray();
         for (auto it = _children.Begin(); it != _children.End(); ++it)
         {
             Node* child = *it;
             if (!child->IsTemporary())
-            {
-                JSONValue childJSON;
-                child->SaveJSON(childJSON);
-                dest["children"].Push(childJSON);
-            }
+                child->SaveJSON(dest);
         }
+        dest.EndArray();
     }
+
+    dest.EndObject();
 }
 
 bool Node::SaveJSON(Stream& dest)
 {
-    JSONFile json;
-    SaveJSON(json.Root());
-    return json.Save(dest);
+    JSONWriter writer(dest);
+    SaveJSON(writer);
+    return writer.Flush();
 }
 
 void Node::SetName(const String& newName)
@@ -144,8 +175,11 @@ void Node::SetName(const char* newName)
 
 void Node::SetLayer(unsigned char newLayer)
 {
-    if (_layer < 32)
+    if (newLayer < 32)
+    {
         _layer = newLayer;
+        OnSetLayer(_layer);
+    }
     else
         ErrorString("Can not set layer 32 or higher");
 }
@@ -158,7 +192,10 @@ void Node::SetLayerName(const String& newLayerName)
     const HashMap<String, unsigned char>& layers = _scenes->Layers();
     auto it = layers.Find(newLayerName);
     if (it != layers.End())
+    {
         _layer = it->_second;
+        OnSetLayer(_layer);
+    }
     else
         ErrorString("Layer " + newLayerName + " not defined in the scene");
 }
@@ -210,28 +247,6 @@ void Node::SetParent(Node* newParent)
         ErrorString("Could not set null parent");
 }
 
-void Node::DefineLayer(unsigned char index, const String& name)
-{
-	if (index >= 32)
-	{
-		ErrorString("Can not define more than 32 layers");
-		return;
-	}
-
-	if (_layerNames.Size() <= index)
-		_layerNames.Resize(index + 1);
-	_layerNames[index] = name;
-	_layers[name] = index;
-}
-
-void Node::DefineTag(unsigned char index, const String& name)
-{
-	if (_tagNames.Size() <= index)
-		_tagNames.Resize(index + 1);
-	_tagNames[index] = name;
-	_tags[name] = index;
-}
-
 Node* Node::CreateChild(StringHash childType)
 {
     SharedPtr<Object> newObject = Create(childType);
@@ -357,6 +372,56 @@ void Node::RemoveSelf()
         delete this;
 }
 
+SharedPtr<Node> Node::Clone()
+{
+    SharedPtr<Node> clone(static_cast<Node*>(Create(GetType())));
+    if (!clone)
+    {
+        ErrorString("Could not clone node of type " + GetTypeName() + " without an object factory");
+        return clone;
+    }
+
+    clone->CopyAttributes(this);
+    for (auto it = _children.Begin(); it != _children.End(); ++it)
+    {
+        Node* child = *it;
+        if (!child->IsTemporary())
+        {
+            SharedPtr<Node> childClone = child->Clone();
+            if (childClone)
+                clone->AddChild(childClone.Get());
+        }
+    }
+
+    return clone;
+}
+
+bool Node::CopyHierarchy(Node* source)
+{
+    if (!source || source->GetType() != GetType())
+        return false;
+
+    CopyAttributes(source);
+
+    size_t index = 0;
+    for (auto it = source->_children.Begin(); it != source->_children.End(); ++it)
+    {
+        Node* sourceChild = *it;
+        if (sourceChild->IsTemporary())
+            continue;
+
+        while (index < _children.Size() && _children[index]->IsTemporary())
+            ++index;
+        if (index >= _children.Size() || !_children[index]->CopyHierarchy(sourceChild))
+            return false;
+        ++index;
+    }
+
+    while (index < _children.Size() && _children[index]->IsTemporary())
+        ++index;
+    return index == _children.Size();
+}
+
 const String& Node::GetLayerName() const
 {
     if (!_scenes)
@@ -372,7 +437,7 @@ const String& Node::GetTagName() const
         return String::EMPTY;
 
     const Vector<String>& tagNames = _scenes->TagNames();
-    return _tag < tagNames.Size() ? tagNames[_layer] : String::EMPTY;
+    return _tag < tagNames.Size() ? tagNames[_tag] : String::EMPTY;
 }
 
 size_t Node::NumPersistentChildren() const
@@ -399,6 +464,17 @@ void Node::AllChildren(Vector<Node*>& result) const
     }
 }
 
+void Node::CollectPersistentNodes(Vector<Node*>& result)
+{
+    result.Push(this);
+    for (auto it = _children.Begin(); it != _children.End(); ++it)
+    {
+        Node* child = *it;
+        if (!child->IsTemporary())
+            child->CollectPersistentNodes(result);
+    }
+}
+
 Node* Node::FindChild(const String& childName, bool recursive) const
 {
     return FindChild(childName.CString(), recursive);
@@ -612,4 +688,8 @@ void Node::OnSetEnabled(bool)
 {
 }
 
+void Node::OnSetLayer(unsigned char)
+{
+}
+
 }
@@ -18,6 +18,7 @@ static const unsigned short NF_OCTREE_UPDATE_QUEUED = 0x40;
 static const unsigned short NF_GEOMETRY = 0x80;
 static const unsigned short NF_LIGHT = 0x100;
 static const unsigned short NF_CASTSHADOWS = 0x200;
+static const unsigned short NF_PREFAB_INSTANCE = 0x400;
 static const unsigned char LAYER_DEFAULT = 0x0;
 static const unsigned char TAG_NONE = 0x0;
 static const unsigned LAYERMASK_ALL = 0xffffffff;
@@ -42,8 +43,12 @@ public:
     void Save(Stream& dest) override;
     /// Load from JSON data. Store node references to be resolved later.
     void LoadJSON(const JSONValue& source, ObjectResolver& resolver) override;
+    /// Load from a JSON document node. Store node references to be resolved later.
+    void LoadJSON(const JSONNode& source, ObjectResolver& resolver) override;
     /// Save as JSON data.
     void SaveJSON(JSONValue& dest) override;
+    /// Save as a JSON object to a writer.
+    void SaveJSON(JSONWriter& dest) override;
     /// Return unique _id within the scene, or 0 if not in a scene.
     unsigned Id() const override { return _id; }
     /// Save as JSON text data to a binary stream. Return true on success.
@@ -68,10 +73,6 @@ public:
     void SetTemporary(bool enable);
     /// Reparent the node.
     void SetParent(Node* newParent);
-	/// Define a layer name. There can be 32 different layers (indices 0-31.)
-	void DefineLayer(unsigned char index, const String& name);
-	/// Define a tag name.
-	void DefineTag(unsigned char index, const String& name);
     /// Create child node of specified type. A registered object factory for the type is required.
     Node* CreateChild(StringHash childType);
     /// Create named child node of specified type.
@@ -88,6 +89,10 @@ public:
     void RemoveAllChildren();
     /// Remove self immediately. As this will delete the node (if no other strong references exist) no operations on the node are permitted after calling this.
     void RemoveSelf();
+    /// Create a copy of the node and its non-temporary child nodes by copying attribute values directly. The copy has no parent; its values are set before it is added anywhere, so the setters cause no scene updates. Object refs are copied as is. Return null if the type has no object factory.
+    SharedPtr<Node> Clone();
+    /// Copy attribute values from a node hierarchy of the same structure, ignoring temporary child nodes. Return false if the types or the numbers of children differ, in which case the values may be partially copied.
+    bool CopyHierarchy(Node* source);
     /// Create child node of the specified type, template version.
     template <typename _Ty> _Ty* CreateChild() { return static_cast<_Ty*>(CreateChild(_Ty::GetTypeStatic())); }
     /// Create named child node of the specified type, template version.
@@ -125,6 +130,8 @@ public:
     const Vector<SharedPtr<Node> >& Children() const { return _children; }
     /// Return child nodes recursively.
     void AllChildren(Vector<Node*>& result) const;
+    /// Return the node itself and its non-temporary child nodes recursively in depth-first order.
+    void CollectPersistentNodes(Vector<Node*>& result);
     /// Return first child node that matches name.
     Node* FindChild(const String& childName, bool recursive = false) const;
     /// Return first child node that matches name.
@@ -172,14 +179,6 @@ public:
     void SetScene(Scene* newScene);
     /// Assign new _id. Called internally.
     void SetId(unsigned newId);
-	/// Return the layer names.
-	const Vector<String>& LayerNames() const { return _layerNames; }
-	/// Return the layer name-to-index map.
-	const HashMap<String, unsigned char>& Layers() const { return _layers; }
-	/// Return the tag names.
-	const Vector<String>& TagNames() const { return _tagNames; }
-	/// Return the tag name-to-index map.
-	const HashMap<String, unsigned char>& Tags() const { return _tags; }
 
     /// Skip the binary data of a node hierarchy, in case the node could not be created.
     static void SkipHierarchy(Stream& source);
@@ -191,15 +190,9 @@ protected:
     virtual void OnSceneSet(Scene* newScene, Scene* oldScene);
     /// Handle the enabled status changing.
     virtual void OnSetEnabled(bool newEnabled);
+    /// Handle the layer changing.
+    virtual void OnSetLayer(unsigned char newLayer);
 
-	/// List of layer names by index.
-	Vector<String> _layerNames;
-	/// Map from layer names to indices.
-	HashMap<String, unsigned char> _layers;
-	/// List of tag names by index.
-	Vector<String> _tagNames;
-	/// Map from tag names to indices.
-	HashMap<String, unsigned char> _tags;
 private:
     /// Parent node.
     Node* _parent;
@@ -207,10 +200,10 @@ private:
     Scene* _scenes;
     /// Child nodes.
     Vector<SharedPtr<Node> > _children;
-    /// Id within the scene.
-    unsigned _id;
     /// %Node name.
     String _name;
+    /// Id within the scene.
+    unsigned _id;
     /// %Node flags. Used to hold several boolean values (some subclass-specific) to reduce memory use.
     mutable unsigned short _flags;
     /// Layer number.
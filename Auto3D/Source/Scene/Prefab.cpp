@@ -0,0 +1,329 @@
+#include "../Debug/Log.h"
+#include "../Debug/Profiler.h"
+#include "../IO/JSONDocument.h"
+#include "../IO/MemoryBuffer.h"
+#include "../IO/ObjectRef.h"
+#include "../Object/ObjectResolver.h"
+#include "Prefab.h"
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+/// Create the root node of a prefab.
+static SharedPtr<Node> CreatePrefabRoot(StringHash type)
+{
+    SharedPtr<Object> newObject(Object::Create(type));
+    SharedPtr<Node> node(dynamic_cast<Node*>(newObject.Get()));
+    if (node)
+        return node;
+
+    if (newObject)
+        ErrorString(newObject->GetTypeName() + " is not a Node subclass, could not use as a prefab root");
+    else
+        ErrorString("Could not create prefab root node of unknown type " + type.ToString());
+    return node;
+}
+
+Prefab::Prefab() :
+    _poolSize(0)
+{
+}
+
+Prefab::~Prefab()
+{
+}
+
+void Prefab::RegisterObject()
+{
+    RegisterFactory<Prefab>();
+}
+
+bool Prefab::BeginLoad(Stream& source)
+{
+    PROFILE(BeginLoadPrefab);
+
+    _loadJSON.Reset();
+    _loadData.Clear();
+
+    size_t startPosition = source.Position();
+    if (source.Size() - startPosition >= 4 && source.ReadFileID() == "PRFB")
+    {
+        _loadData.Resize(source.Size() - source.Position());
+        if (_loadData.Size() && source.Read(&_loadData[0], _loadData.Size()) != _loadData.Size())
+        {
+            ErrorString("Failed to read prefab data from " + source.Name());
+            return false;
+        }
+        return true;
+    }
+
+    // Not binary, so parse as JSON
+    source.Seek(startPosition);
+    _loadJSON = new JSONDocument();
+    return _loadJSON->Load(source);
+}
+
+bool Prefab::EndLoad()
+{
+    PROFILE(EndLoadPrefab);
+
+    // Nodes are created here rather than in BeginLoad(), as their attribute setters may request resources
+    ClearPool();
+    _objectRefs.Clear();
+    _root.Reset();
+
+    ObjectResolver resolver;
+    if (_loadJSON)
+    {
+        const JSONNode& root = _loadJSON->Root();
+        _root = CreatePrefabRoot(StringHash(root["type"].GetString()));
+        if (_root)
+        {
+            resolver.StoreObject((unsigned)root["id"].GetNumber(), _root);
+            _root->LoadJSON(root, resolver);
+        }
+    }
+    else
+    {
+        MemoryBuffer buffer(_loadData);
+        StringHash type = buffer.Read<StringHash>();
+        unsigned id = buffer.Read<unsigned>();
+        _root = CreatePrefabRoot(type);
+        if (_root)
+        {
+            resolver.StoreObject(id, _root);
+            _root->Load(buffer, resolver);
+        }
+    }
+
+    _loadJSON.Reset();
+    _loadData.Clear();
+    if (!_root)
+        return false;
+
+    // Number the nodes before resolving, so that the resolved object refs refer to the template's own nodes
+    Vector<Node*> nodes;
+    _root->CollectPersistentNodes(nodes);
+    for (size_t i = 0; i < nodes.Size(); ++i)
+        nodes[i]->SetId((unsigned)i + 1);
+    resolver.Resolve();
+    SetupTemplate();
+
+    return true;
+}
+
+bool Prefab::Save(Stream& dest)
+{
+    PROFILE(SavePrefab);
+
+    if (!_root)
+    {
+        ErrorString("Prefab " + Name() + " has no nodes to save");
+        return false;
+    }
+
+    dest.WriteFileID("PRFB");
+    _root->Save(dest);
+    return true;
+}
+
+void Prefab::Define(Node* source)
+{
+    PROFILE(DefinePrefab);
+
+    ClearPool();
+    _objectRefs.Clear();
+    _root.Reset();
+    if (!source)
+        return;
+
+    _root = source->Clone();
+    if (!_root)
+        return;
+
+    Vector<Node*> sourceNodes;
+    Vector<Node*> nodes;
+    source->CollectPersistentNodes(sourceNodes);
+    _root->CollectPersistentNodes(nodes);
+
+    // Convert object refs from scene ids to the depth-first numbering of the template. If some nodes could not be copied the hierarchies do not match, so clear all refs
+    HashMap<unsigned, size_t> indices;
+    if (sourceNodes.Size() == nodes.Size())
+    {
+        for (size_t i = 0; i < sourceNodes.Size(); ++i)
+        {
+            if (sourceNodes[i]->Id())
+                indices[sourceNodes[i]->Id()] = i;
+        }
+    }
+
+    for (size_t i = 0; i < nodes.Size(); ++i)
+    {
+        Node* node = nodes[i];
+        node->SetId((unsigned)i + 1);
+
+        const Vector<SharedPtr<Attribute> >* attributes = node->Attributes();
+        if (!attributes)
+            continue;
+
+        for (auto it = attributes->Begin(); it != attributes->End(); ++it)
+        {
+            if ((*it)->Type() != AttributeType::OBJECTREF)
+                continue;
+
+            AttributeImpl<ObjectRef>* typedAttr = static_cast<AttributeImpl<ObjectRef>*>(it->Get());
+            auto indexIt = indices.Find(typedAttr->Value(node)._id);
+            typedAttr->SetValue(node, indexIt != indices.End() ? ObjectRef((unsigned)indexIt->_second + 1) : ObjectRef());
+        }
+    }
+
+    SetupTemplate();
+}
+
+Node* Prefab::Instantiate(Node* parent)
+{
+    PROFILE(InstantiatePrefab);
+
+    if (!_root)
+    {
+        ErrorString("Prefab " + Name() + " has no nodes to instantiate");
+        return nullptr;
+    }
+    if (!parent)
+    {
+        ErrorString("Null parent for instance of prefab " + Name());
+        return nullptr;
+    }
+    // Nodes outside a scene have no ids, so the object refs could not be resolved
+    if (_objectRefs.Size() && !parent->ParentScene())
+    {
+        ErrorString("Parent for instance of prefab " + Name() + " is not in a scene, can not resolve object refs");
+        return nullptr;
+    }
+
+    SharedPtr<Node> instance;
+    while (!instance && _pool.Size())
+    {
+        instance = _pool.Back();
+        _pool.Pop();
+        // Restore the template's values, as the instance may have been changed while in use. Discard it if its structure was changed
+        if (!instance->CopyHierarchy(_root))
+            instance.Reset();
+    }
+
+    if (!instance)
+    {
+        instance = _root->Clone();
+        if (!instance)
+            return nullptr;
+    }
+
+    // Add to the parent only after the values are set, so that the nodes enter the scene and octree once
+    parent->AddChild(instance);
+    ResolveInstanceRefs(instance);
+    instance->SetFlag(NF_PREFAB_INSTANCE, true);
+
+    return instance;
+}
+
+void Prefab::Release(Node* instance)
+{
+    if (!instance)
+        return;
+
+    // The mark does not tell which prefab the instance came from. An instance of another prefab with the same root type would fail to copy this template when reused from the pool, and is then discarded
+    if (!instance->TestFlag(NF_PREFAB_INSTANCE) || !_root || instance->GetType() != _root->GetType())
+    {
+        ErrorString("Node is not an instance of prefab " + Name() + ", can not release");
+        return;
+    }
+    instance->SetFlag(NF_PREFAB_INSTANCE, false);
+
+    // Hold a reference while detaching, so that the instance is not destroyed yet
+    SharedPtr<Node> keep(instance);
+    if (instance->Parent())
+        instance->Parent()->RemoveChild(instance);
+
+    if (_pool.Size() < _poolSize)
+        _pool.Push(keep);
+}
+
+void Prefab::SetPoolSize(size_t size)
+{
+    _poolSize = size;
+    if (_pool.Size() > _poolSize)
+        _pool.Resize(_poolSize);
+}
+
+void Prefab::FillPool()
+{
+    if (!_root)
+        return;
+
+    _pool.Reserve(_poolSize);
+    while (_pool.Size() < _poolSize)
+    {
+        SharedPtr<Node> instance = _root->Clone();
+        if (!instance)
+            break;
+        _pool.Push(instance);
+    }
+}
+
+void Prefab::ClearPool()
+{
+    _pool.Clear();
+}
+
+void Prefab::SetupTemplate()
+{
+    Vector<Node*> nodes;
+    _root->CollectPersistentNodes(nodes);
+
+    for (size_t i = 0; i < nodes.Size(); ++i)
+    {
+        Node* node = nodes[i];
+        const Vector<SharedPtr<Attribute> >* attributes = node->Attributes();
+        if (!attributes)
+            continue;
+
+        for (auto it = attributes->Begin(); it != attributes->End(); ++it)
+        {
+            Attribute* attr = *it;
+            if (attr->Type() != AttributeType::OBJECTREF)
+                continue;
+
+            unsigned id = static_cast<AttributeImpl<ObjectRef>*>(attr)->Value(node)._id;
+            if (id && id <= nodes.Size())
+            {
+                PrefabObjectRef ref;
+                ref._nodeIndex = i;
+                ref._attr = attr;
+                ref._targetIndex = id - 1;
+                _objectRefs.Push(ref);
+            }
+        }
+    }
+}
+
+void Prefab::ResolveInstanceRefs(Node* instance)
+{
+    if (_objectRefs.IsEmpty())
+        return;
+
+    _instanceNodes.Clear();
+    instance->CollectPersistentNodes(_instanceNodes);
+
+    for (auto it = _objectRefs.Begin(); it != _objectRefs.End(); ++it)
+    {
+        if (it->_nodeIndex < _instanceNodes.Size() && it->_targetIndex < _instanceNodes.Size())
+        {
+            AttributeImpl<ObjectRef>* typedAttr = static_cast<AttributeImpl<ObjectRef>*>(it->_attr);
+            typedAttr->SetValue(_instanceNodes[it->_nodeIndex], ObjectRef(_instanceNodes[it->_targetIndex]->Id()));
+        }
+    }
+}
+
+}
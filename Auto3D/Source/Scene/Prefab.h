@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../Base/AutoPtr.h"
+#include "../Resource/Resource.h"
+#include "Node.h"
+
+namespace Auto3D
+{
+
+class JSONDocument;
+
+/// Object ref attribute inside a prefab's node hierarchy, stored as indices to the hierarchy in depth-first order.
+struct AUTO_API PrefabObjectRef
+{
+    /// Index of the node that has the attribute.
+    size_t _nodeIndex;
+    /// Description of the object ref attribute.
+    Attribute* _attr;
+    /// Index of the node being referred to.
+    size_t _targetIndex;
+};
+
+/// Node hierarchy template for instantiating copies quickly. The data is parsed and its object refs resolved once on load. Instances are created by copying attribute values directly from the template, and can be released to a pool for reuse without allocation. Loads JSON or binary data; binary data starts with the file ID "PRFB" followed by the data written by Node::Save().
+class AUTO_API Prefab : public Resource
+{
+    REGISTER_OBJECT_CLASS(Prefab, Resource)
+
+public:
+    /// Construct.
+    Prefab();
+    /// Destruct.
+    ~Prefab();
+
+    /// Register object factory.
+    static void RegisterObject();
+
+    /// Load the prefab data from a stream. Return true on success.
+    bool BeginLoad(Stream& source) override;
+    /// Create the template nodes. Return true on success.
+    bool EndLoad() override;
+    /// Save the template in the binary format. Return true on success.
+    bool Save(Stream& dest) override;
+
+    /// Define the template by copying an existing node hierarchy. Object refs between the copied nodes are kept, others are cleared.
+    void Define(Node* source);
+    /// Instantiate as a child of a parent node. Reuse a pooled instance if available, otherwise copy the template. If the template has object refs between its nodes, the parent must be in a scene, as the refs are resolved to the instance's scene node ids. Return the instance's root node, or null on failure.
+    Node* Instantiate(Node* parent);
+    /// Release an instance of this prefab that is no longer needed. It is removed from its parent and scene, and kept in the pool for reuse if there is room, otherwise destroyed. No operations on the instance are permitted after calling this. Nodes that are not marked as live prefab instances, or whose type differs from the template root, are not released.
+    void Release(Node* instance);
+    /// Set the maximum number of released instances to keep for reuse. Zero (default) disables pooling.
+    void SetPoolSize(size_t size);
+    /// Create instances to the pool until it is full, so that instantiating later does not need to allocate.
+    void FillPool();
+    /// Destroy the pooled instances.
+    void ClearPool();
+
+    /// Return the template's root node, or null if not loaded.
+    Node* Root() const { return _root; }
+    /// Return the maximum number of pooled instances.
+    size_t PoolSize() const { return _poolSize; }
+    /// Return the number of instances currently in the pool.
+    size_t NumPooled() const { return _pool.Size(); }
+
+private:
+    /// Collect the object refs between the template nodes. The nodes must be numbered in depth-first order starting from 1, and the refs must use those numbers.
+    void SetupTemplate();
+    /// Set the object refs of a new instance to refer to the instance's own nodes.
+    void ResolveInstanceRefs(Node* instance);
+
+    /// Template root node.
+    SharedPtr<Node> _root;
+    /// Object refs between the template nodes.
+    Vector<PrefabObjectRef> _objectRefs;
+    /// Released instances available for reuse.
+    Vector<SharedPtr<Node> > _pool;
+    /// Maximum number of pooled instances.
+    size_t _poolSize;
+    /// Instance nodes in depth-first order, kept to avoid allocating when resolving object refs.
+    Vector<Node*> _instanceNodes;
+    /// JSON data used during loading.
+    AutoPtr<JSONDocument> _loadJSON;
+    /// Binary data used during loading.
+    Vector<unsigned char> _loadData;
+};
+
+}
@@ -1,10 +1,13 @@
 #include "../Debug/Log.h"
 #include "../Debug/Profiler.h"
+#include "../IO/JSONDocument.h"
+#include "../IO/JSONWriter.h"
+#include "../IO/ObjectRef.h"
 #include "../IO/Stream.h"
 #include "../Object/ObjectResolver.h"
-#include "../Resource/JSONFile.h"
 #include "../Renderer/Renderer.h"
 #include "../RegisteredBox/RegisteredBox.h"
+#include "Prefab.h"
 #include "Scene.h"
 #include "SpatialNode.h"
 
@@ -13,6 +16,96 @@
 namespace Auto3D
 {
 
+/// Version of the binary scene format written by Scene::Save().
+static const unsigned SCENE_FORMAT_VERSION = 1;
+/// Smallest size in bytes of a node type in a binary scene file: the type hash and the attribute count.
+static const size_t MIN_SCENE_NODE_TYPE_SIZE = 5;
+/// Smallest size in bytes of an attribute schema entry in a binary scene file: an empty name and the type.
+static const size_t MIN_SCENE_ATTRIBUTE_SIZE = 2;
+/// Smallest size in bytes of a node entry in a binary scene file: the type index, id and child count.
+static const size_t MIN_SCENE_NODE_ENTRY_SIZE = 6;
+
+/// Attribute schema entry of a node type in a binary scene file.
+struct SceneAttributeSchema
+{
+    /// Attribute name.
+    String _name;
+    /// Attribute type.
+    AttributeType::Type _type;
+};
+
+/// Node type in a binary scene file, with its attribute schema and the nodes of that type in file order.
+struct SceneNodeType
+{
+    /// Node type.
+    StringHash _type;
+    /// Attributes stored for the type.
+    Vector<SceneAttributeSchema> _attributes;
+    /// Nodes of the type. Null for nodes that could not be created on load.
+    Vector<Serializable*> _nodes;
+};
+
+/// Node entry of the hierarchy in a binary scene file.
+struct SceneNodeEntry
+{
+    /// Index to the node types.
+    size_t _typeIndex;
+    /// Id in the file.
+    unsigned _id;
+    /// Index of the parent node.
+    size_t _parentIndex;
+};
+
+/// Return the number of bytes left to read in a stream.
+static size_t RemainingSize(Stream& source)
+{
+    return source.Position() < source.Size() ? source.Size() - source.Position() : 0;
+}
+
+/// Load a scene from either a JSON value or a JSON document node. Return true on success.
+template <typename _Ty> static bool LoadSceneJSON(Scene* scene, const _Ty& source)
+{
+    PROFILE(LoadSceneJSON);
+    
+    StringHash ownType(source["type"].GetString());
+    unsigned ownId = (unsigned)source["id"].GetNumber();
+
+    if (ownType != Scene::GetTypeStatic())
+    {
+        ErrorString("Mismatching type of scene root node in scene file");
+        return false;
+    }
+
+    scene->Clear();
+
+    ObjectResolver resolver;
+    resolver.StoreObject(ownId, scene);
+    scene->Node::LoadJSON(source, resolver);
+    resolver.Resolve();
+
+    return true;
+}
+
+/// Instantiate a node from either a JSON value or a JSON document node. Return the node, or null on failure.
+template <typename _Ty> static Node* InstantiateSceneJSON(Scene* scene, const _Ty& source)
+{
+    PROFILE(InstantiateJSON);
+    
+    ObjectResolver resolver;
+    StringHash childType(source["type"].GetString());
+    unsigned childId = (unsigned)source["id"].GetNumber();
+
+    Node* child = scene->CreateChild(childType);
+    if (child)
+    {
+        resolver.StoreObject(childId, child);
+        child->LoadJSON(source, resolver);
+        resolver.Resolve();
+    }
+
+    return child;
+}
+
 Scene::Scene() :
     _nextNodeId(1)
 {
@@ -51,8 +144,68 @@ void Scene::Save(Stream& dest)
     
     InfoString("Saving scene to " + dest.Name());
     
-    dest.WriteFileID("SCNE");
-    Node::Save(dest);
+    // Collect the persistent nodes in depth-first order and group them by type
+    Vector<Node*> nodes;
+    Vector<size_t> nodeTypeIndices;
+    Vector<SceneNodeType> types;
+    HashMap<StringHash, size_t> typeIndices;
+    CollectPersistentNodes(nodes);
+
+    nodeTypeIndices.Resize(nodes.Size());
+    for (size_t i = 0; i < nodes.Size(); ++i)
+    {
+        Node* node = nodes[i];
+        auto it = typeIndices.Find(node->GetType());
+        if (it == typeIndices.End())
+        {
+            it = typeIndices.Insert(MakePair(node->GetType(), types.Size()));
+            types.Resize(types.Size() + 1);
+            types.Back()._type = node->GetType();
+        }
+        nodeTypeIndices[i] = it->_second;
+        types[it->_second]._nodes.Push(node);
+    }
+
+    dest.WriteFileID("SCNT");
+    dest.WriteVLE(SCENE_FORMAT_VERSION);
+
+    // Write the attribute schema of each type, so that the data can be matched to the attributes when loading
+    dest.WriteVLE(types.Size());
+    for (auto it = types.Begin(); it != types.End(); ++it)
+    {
+        const Vector<SharedPtr<Attribute> >* attributes = it->_nodes[0]->Attributes();
+        dest.Write(it->_type);
+        dest.WriteVLE(attributes ? attributes->Size() : 0);
+        if (attributes)
+        {
+            for (auto attrIt = attributes->Begin(); attrIt != attributes->End(); ++attrIt)
+            {
+                Attribute* attr = *attrIt;
+                dest.Write(attr->Name());
+                dest.Write<unsigned char>((unsigned char)attr->Type());
+            }
+        }
+    }
+
+    // Write the hierarchy as type index, id and number of children for each node
+    dest.WriteVLE(nodes.Size());
+    for (size_t i = 0; i < nodes.Size(); ++i)
+    {
+        dest.WriteVLE(nodeTypeIndices[i]);
+        dest.Write(nodes[i]->Id());
+        dest.WriteVLE(nodes[i]->NumPersistentChildren());
+    }
+
+    // Write the attribute values of each type one attribute at a time
+    for (auto it = types.Begin(); it != types.End(); ++it)
+    {
+        const Vector<SharedPtr<Attribute> >* attributes = it->_nodes[0]->Attributes();
+        if (!attributes)
+            continue;
+
+        for (auto attrIt = attributes->Begin(); attrIt != attributes->End(); ++attrIt)
+            (*attrIt)->ToBinaryColumn(&it->_nodes[0], it->_nodes.Size(), dest);
+    }
 }
 
 bool Scene::Load(Stream& source)
@@ -62,12 +215,15 @@ bool Scene::Load(Stream& source)
     InfoString("Loading scene from " + source.Name());
     
     String fileId = source.ReadFileID();
-    if (fileId != "SCNE")
+    if (fileId == "SCNT")
+        return LoadTables(source);
+    else if (fileId != "SCNE")
     {
         ErrorString("File is not a binary scene file");
         return false;
     }
 
+    // Load the older format, which stores each node's attributes along with the node
     StringHash ownType = source.Read<StringHash>();
     unsigned ownId = source.Read<unsigned>();
     if (ownType != GetTypeStatic())
@@ -86,14 +242,81 @@ bool Scene::Load(Stream& source)
     return true;
 }
 
-bool Scene::LoadJSON(const JSONValue& source)
+bool Scene::LoadTables(Stream& source)
 {
-    PROFILE(LoadSceneJSON);
-    
-    StringHash ownType(source["type"].GetString());
-    unsigned ownId = (unsigned)source["id"].GetNumber();
+    unsigned version = source.ReadVLE();
+    if (version > SCENE_FORMAT_VERSION)
+    {
+        ErrorString("Unsupported binary scene format version " + String(version));
+        return false;
+    }
 
-    if (ownType != GetTypeStatic())
+    // Check the counts against the remaining data before allocating, so that a corrupt file can not cause huge allocations
+    size_t numTypes = source.ReadVLE();
+    if (numTypes > RemainingSize(source) / MIN_SCENE_NODE_TYPE_SIZE)
+    {
+        ErrorString("Corrupt node types in scene file");
+        return false;
+    }
+
+    Vector<SceneNodeType> types(numTypes);
+    for (auto it = types.Begin(); it != types.End(); ++it)
+    {
+        it->_type = source.Read<StringHash>();
+        size_t numAttributes = source.ReadVLE();
+        if (numAttributes > RemainingSize(source) / MIN_SCENE_ATTRIBUTE_SIZE)
+        {
+            ErrorString("Corrupt attribute schema in scene file");
+            return false;
+        }
+        it->_attributes.Resize(numAttributes);
+        for (auto attrIt = it->_attributes.Begin(); attrIt != it->_attributes.End(); ++attrIt)
+        {
+            attrIt->_name = source.Read<String>();
+            attrIt->_type = (AttributeType::Type)source.Read<unsigned char>();
+            if (attrIt->_type >= AttributeType::Count)
+            {
+                ErrorString("Corrupt attribute schema in scene file");
+                return false;
+            }
+        }
+    }
+
+    // Read the hierarchy, finding the parent of each node from the child counts
+    size_t numEntries = source.ReadVLE();
+    if (numEntries > RemainingSize(source) / MIN_SCENE_NODE_ENTRY_SIZE)
+    {
+        ErrorString("Corrupt node hierarchy in scene file");
+        return false;
+    }
+
+    Vector<SceneNodeEntry> entries(numEntries);
+    Vector<Pair<size_t, size_t> > openNodes;
+    for (size_t i = 0; i < entries.Size(); ++i)
+    {
+        SceneNodeEntry& entry = entries[i];
+        entry._typeIndex = source.ReadVLE();
+        entry._id = source.Read<unsigned>();
+        size_t numChildren = source.ReadVLE();
+
+        while (openNodes.Size() && !openNodes.Back()._second)
+            openNodes.Pop();
+        if (entry._typeIndex >= types.Size() || (i && openNodes.IsEmpty()) || source.IsEof())
+        {
+            ErrorString("Corrupt node hierarchy in scene file");
+            return false;
+        }
+
+        entry._parentIndex = 0;
+        if (i)
+        {
+            entry._parentIndex = openNodes.Back()._first;
+            --openNodes.Back()._second;
+        }
+        openNodes.Push(MakePair(i, numChildren));
+    }
+
+    if (entries.IsEmpty() || types[entries[0]._typeIndex]._type != GetTypeStatic())
     {
         ErrorString("Mismatching type of scene root node in scene file");
         return false;
@@ -101,19 +324,114 @@ bool Scene::LoadJSON(const JSONValue& source)
 
     Clear();
 
+    // Create the nodes without attaching them yet. Nodes of unknown type are skipped along with their children
     ObjectResolver resolver;
-    resolver.StoreObject(ownId, this);
-    Node::LoadJSON(source, resolver);
+    Vector<Node*> nodes(entries.Size());
+    Vector<SharedPtr<Node> > detachedNodes;
+    detachedNodes.Reserve(entries.Size());
+
+    nodes[0] = this;
+    resolver.StoreObject(entries[0]._id, this);
+    types[entries[0]._typeIndex]._nodes.Push(this);
+
+    for (size_t i = 1; i < entries.Size(); ++i)
+    {
+        const SceneNodeEntry& entry = entries[i];
+        SceneNodeType& type = types[entry._typeIndex];
+        Node* node = nullptr;
+
+        if (nodes[entry._parentIndex])
+        {
+            SharedPtr<Object> newObject(Create(type._type));
+            node = dynamic_cast<Node*>(newObject.Get());
+            if (node)
+            {
+                detachedNodes.Push(SharedPtr<Node>(node));
+                resolver.StoreObject(entry._id, node);
+            }
+            else if (newObject)
+                ErrorString(newObject->GetTypeName() + " is not a Node subclass, could not add as a child");
+            else
+                ErrorString("Could not create child node of unknown type " + type._type.ToString());
+        }
+
+        nodes[i] = node;
+        type._nodes.Push(node);
+    }
+
+    // Set the attributes one column at a time. Attributes in the file are matched to the current ones by name and type; the rest of the data is skipped
+    for (auto it = types.Begin(); it != types.End(); ++it)
+    {
+        SceneNodeType& type = *it;
+        const Vector<SharedPtr<Attribute> >* attributes = nullptr;
+        for (auto nodeIt = type._nodes.Begin(); nodeIt != type._nodes.End() && !attributes; ++nodeIt)
+        {
+            if (*nodeIt)
+                attributes = (*nodeIt)->Attributes();
+        }
+
+        for (auto schemaIt = type._attributes.Begin(); schemaIt != type._attributes.End(); ++schemaIt)
+        {
+            Attribute* attr = nullptr;
+            if (attributes)
+            {
+                for (auto attrIt = attributes->Begin(); attrIt != attributes->End(); ++attrIt)
+                {
+                    if ((*attrIt)->Type() == schemaIt->_type && (*attrIt)->Name() == schemaIt->_name)
+                    {
+                        attr = *attrIt;
+                        break;
+                    }
+                }
+            }
+
+            if (!Attribute::CheckColumnSize(schemaIt->_type, type._nodes.Size(), source))
+                return false;
+
+            if (!attr)
+                Attribute::SkipColumn(schemaIt->_type, type._nodes.Size(), source);
+            else if (attr->Type() == AttributeType::OBJECTREF)
+            {
+                // Store object refs to the resolver instead of immediately setting
+                for (auto nodeIt = type._nodes.Begin(); nodeIt != type._nodes.End(); ++nodeIt)
+                {
+                    ObjectRef ref = source.Read<ObjectRef>();
+                    if (*nodeIt)
+                        resolver.StoreObjectRef(*nodeIt, attr, ref);
+                }
+            }
+            else
+                attr->FromBinaryColumn(&type._nodes[0], type._nodes.Size(), source);
+        }
+    }
+
+    // Attach the nodes last and parents first, so that the setters above did not dirty transforms or queue octree updates, and each node enters the scene only once
+    for (size_t i = 1; i < entries.Size(); ++i)
+    {
+        if (nodes[i])
+            nodes[entries[i]._parentIndex]->AddChild(nodes[i]);
+    }
+
     resolver.Resolve();
 
     return true;
 }
 
+bool Scene::LoadJSON(const JSONValue& source)
+{
+    return LoadSceneJSON(this, source);
+}
+
+bool Scene::LoadJSON(const JSONNode& source)
+{
+    return LoadSceneJSON(this, source);
+}
+
 bool Scene::LoadJSON(Stream& source)
 {
     InfoString("Loading scene from " + source.Name());
     
-    JSONFile json;
+    JSONDocument json;
     bool success = json.Load(source);
     LoadJSON(json.Root());
     return success;
@@ -125,9 +443,9 @@ bool Scene::SaveJSON(Stream& dest)
     
     InfoString("Saving scene to " + dest.Name());
     
-    JSONFile json;
-    Node::SaveJSON(json.Root());
-    return json.Save(dest);
+    JSONWriter writer(dest);
+    Node::SaveJSON(writer);
+    return writer.Flush();
 }
 
 Node* Scene::Instantiate(Stream& source)
@@ -149,28 +467,30 @@ Node* Scene::Instantiate(Stream& source)
     return child;
 }
 
-Node* Scene::InstantiateJSON(const JSONValue& source)
+Node* Scene::Instantiate(Prefab* prefab)
 {
-    PROFILE(InstantiateJSON);
-    
-    ObjectResolver resolver;
-    StringHash childType(source["type"].GetString());
-    unsigned childId = (unsigned)source["id"].GetNumber();
-
-    Node* child = CreateChild(childType);
-    if (child)
+    if (!prefab)
     {
-        resolver.StoreObject(childId, child);
-        child->LoadJSON(source, resolver);
-        resolver.Resolve();
+        ErrorString("Null prefab to instantiate");
+        return nullptr;
     }
 
-    return child;
+    return prefab->Instantiate(this);
+}
+
+Node* Scene::InstantiateJSON(const JSONValue& source)
+{
+    return InstantiateSceneJSON(this, source);
+}
+
+Node* Scene::InstantiateJSON(const JSONNode& source)
+{
+    return InstantiateSceneJSON(this, source);
 }
 
 Node* Scene::InstantiateJSON(Stream& source)
 {
-    JSONFile json;
+    JSONDocument json;
     json.Load(source);
     return InstantiateJSON(json.Root());
 }
@@ -181,6 +501,28 @@ void Scene::Clear()
     _nextNodeId = 1;
 }
 
+void Scene::DefineLayer(unsigned char index, const String& name)
+{
+    if (index >= 32)
+    {
+        ErrorString("Can not define more than 32 layers");
+        return;
+    }
+
+    if (_layerNames.Size() <= index)
+        _layerNames.Resize(index + 1);
+    _layerNames[index] = name;
+    _layers[name] = index;
+}
+
+void Scene::DefineTag(unsigned char index, const String& name)
+{
+    if (_tagNames.Size() <= index)
+        _tagNames.Resize(index + 1);
+    _tagNames[index] = name;
+    _tags[name] = index;
+}
+
 Node* Scene::FindNode(unsigned id) const
 {
     auto it = _nodes.Find(id);
@@ -303,6 +645,7 @@ void RegisterSceneLibrary()
     Node::RegisterObject();
     Scene::RegisterObject();
     SpatialNode::RegisterObject();
+    Prefab::RegisterObject();
 }
 
 }
@@ -6,6 +6,7 @@ namespace Auto3D
 {
 
 class Camera;
+class Prefab;
 
 /// %Scene root node, which also represents the whole scene.
 class AUTO_API Scene : public Node
@@ -21,26 +22,44 @@ public:
     /// Register factory and attributes.
     static void RegisterObject();
 
-    /// Save scene to binary stream.
+    /// Save scene to binary stream. Nodes are grouped by type and the attributes of each type are stored as columns, preceded by an attribute schema.
     void Save(Stream& dest) override;
-    /// Load scene from a binary stream. Existing nodes will be destroyed. Return true on success.
+    /// Load scene from a binary stream. Also reads the older format that stores attributes node by node. Existing nodes will be destroyed. Return true on success.
     bool Load(Stream& source);
     /// Load scene from JSON data. Existing nodes will be destroyed. Return true on success.
     bool LoadJSON(const JSONValue& source);
+    /// Load scene from a JSON document node. Existing nodes will be destroyed. Return true on success.
+    bool LoadJSON(const JSONNode& source);
     /// Load scene from JSON text data read from a binary stream. Existing nodes will be destroyed. Return true if the JSON was correctly parsed; otherwise the data may be partial.
     bool LoadJSON(Stream& source);
     /// Save scene as JSON text data to a binary stream. Return true on success.
     bool SaveJSON(Stream& dest);
     /// Instantiate node(s) from binary stream and return the root node.
     Node* Instantiate(Stream& source);
+    /// Instantiate a prefab as a child of the scene root, reusing one of its pooled instances if available, and return the root node. Faster than instantiating from data, as the prefab is parsed only once.
+    Node* Instantiate(Prefab* prefab);
     /// Instantiate node(s) from JSON data and return the root node.
     Node* InstantiateJSON(const JSONValue& source);
+    /// Instantiate node(s) from a JSON document node and return the root node.
+    Node* InstantiateJSON(const JSONNode& source);
     /// Load JSON data as text from a binary stream, then instantiate node(s) from it and return the root node.
     Node* InstantiateJSON(Stream& source);
     /// Destroy child nodes recursively, leaving the scene empty.
     void Clear();
+    /// Define a layer name. There can be 32 different layers (indices 0-31.) The names are shared by all nodes in the scene.
+    void DefineLayer(unsigned char index, const String& name);
+    /// Define a tag name. The names are shared by all nodes in the scene.
+    void DefineTag(unsigned char index, const String& name);
     /// Find node by _id.
     Node* FindNode(unsigned id) const;
+    /// Return the layer names.
+    const Vector<String>& LayerNames() const { return _layerNames; }
+    /// Return the layer name-to-index map.
+    const HashMap<String, unsigned char>& Layers() const { return _layers; }
+    /// Return the tag names.
+    const Vector<String>& TagNames() const { return _tagNames; }
+    /// Return the tag name-to-index map.
+    const HashMap<String, unsigned char>& Tags() const { return _tags; }
 	/// Return all camera vector
 	Vector<Camera*>& GetAllCamera();
     /// Add node to the scene. This assigns a scene-unique id to it. Called internally.
@@ -57,6 +76,8 @@ public:
     using Node::SaveJSON;
 
 private:
+    /// Load the node hierarchy and attribute columns of the binary scene format after the file ID. Return true on success.
+    bool LoadTables(Stream& source);
     /// Set layer names. Used in serialization.
     void SetLayerNamesAttr(JSONValue names);
     /// Return layer names. Used in serialization.
@@ -72,6 +93,14 @@ private:
 	Vector<Camera*> _cameras;
     /// Next free node id.
     unsigned _nextNodeId;
+    /// List of layer names by index.
+    Vector<String> _layerNames;
+    /// Map from layer names to indices.
+    HashMap<String, unsigned char> _layers;
+    /// List of tag names by index.
+    Vector<String> _tagNames;
+    /// Map from tag names to indices.
+    HashMap<String, unsigned char> _tags;
 
 };
 
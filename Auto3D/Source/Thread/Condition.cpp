@@ -36,6 +36,7 @@ void Condition::Wait()
 #else
 Condition::Condition() :
 	_mutex(new pthread_mutex_t),
+    _signaled(false),
     _event(new pthread_cond_t)
 {
     pthread_mutex_init((pthread_mutex_t*)_mutex, 0);
@@ -57,7 +58,14 @@ Condition::~Condition()
 
 void Condition::Set()
 {
-    pthread_cond_signal((pthread_cond_t*)_event);
+    pthread_cond_t* c = (pthread_cond_t*)_event;
+    pthread_mutex_t* m = (pthread_mutex_t*)_mutex;
+
+    // Behave like an auto-reset event: stay signaled until a waiting thread wakes up
+    pthread_mutex_lock(m);
+    _signaled = true;
+    pthread_cond_signal(c);
+    pthread_mutex_unlock(m);
 }
 
 void Condition::Wait()
@@ -66,7 +74,9 @@ void Condition::Wait()
     pthread_mutex_t* m = (pthread_mutex_t*)_mutex;
 
     pthread_mutex_lock(m);
-    pthread_cond_wait(c, m);
+    while (!_signaled)
+        pthread_cond_wait(c, m);
+    _signaled = false;
     pthread_mutex_unlock(m);
 }
 #endif
@@ -25,6 +25,8 @@ private:
     #ifndef WIN32
     /// Mutex for the _event, necessary for pthreads-based implementation.
     void* _mutex;
+    /// Signaled flag, so that a Set() which happens before Wait() is not lost.
+    bool _signaled;
     #endif
     /// Operating system specific _event.
     void* _event;
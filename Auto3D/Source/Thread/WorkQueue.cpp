@@ -0,0 +1,399 @@
+#include "../Debug/Log.h"
+#include "../Math/Math.h"
+#include "Condition.h"
+#include "Thread.h"
+#include "WorkQueue.h"
+
+#include "../Debug/DebugNew.h"
+
+namespace Auto3D
+{
+
+static const size_t INITIAL_DEQUE_CAPACITY = 64;
+static const size_t JOBS_PER_THREAD = 4;
+
+/// Worker thread owned by the work queue.
+class WorkerThread : public Thread
+{
+public:
+    /// Construct.
+    WorkerThread(WorkQueue* owner, unsigned index) :
+        _owner(owner),
+        _index(index),
+        _sleeping(false)
+    {
+    }
+
+    /// Process jobs until stopped. Sleep when there is no work.
+    void ThreadFunction() override
+    {
+        _owner->_threadIndex.SetValue((void*)(size_t)_index);
+
+        while (_shouldRun)
+        {
+            Job* job = _owner->FindJob(_index);
+            if (job)
+            {
+                _owner->RunJob(job, _index);
+                continue;
+            }
+
+            // Announce sleeping before the final check, so that a job queued in between is guaranteed to wake this thread
+            _sleeping.store(true);
+            if (!_owner->_pendingJobs.load() && _shouldRun)
+                _wakeCondition.Wait();
+            _sleeping.store(false);
+        }
+    }
+
+    /// Wake the thread if it is sleeping. Return true if was sleeping.
+    bool Wake()
+    {
+        if (!_sleeping.load())
+            return false;
+        _wakeCondition.Set();
+        return true;
+    }
+
+    /// Stop the thread and wait for it to exit.
+    void Shutdown()
+    {
+        _shouldRun = false;
+        _wakeCondition.Set();
+        Stop();
+    }
+
+private:
+    /// Owning work queue.
+    WorkQueue* _owner;
+    /// Thread index.
+    unsigned _index;
+    /// Sleeping flag.
+    std::atomic<bool> _sleeping;
+    /// Condition for waking up.
+    Condition _wakeCondition;
+};
+
+JobCounter::JobCounter() :
+    _pending(0)
+{
+}
+
+JobCounter::~JobCounter()
+{
+    assert(IsDone());
+}
+
+JobDeque::JobDeque() :
+    _head(0),
+    _size(0)
+{
+    _buffer.Resize(INITIAL_DEQUE_CAPACITY);
+}
+
+JobDeque::~JobDeque()
+{
+    while (Job* job = Pop())
+        delete job;
+}
+
+void JobDeque::Push(Job* job)
+{
+    MutexLock lock(_mutex);
+
+    size_t size = _size.load();
+    size_t capacity = _buffer.Size();
+    if (size == capacity)
+    {
+        // Unwrap the ring into a buffer of double capacity
+        Vector<Job*> newBuffer(capacity * 2);
+        for (size_t i = 0; i < size; ++i)
+            newBuffer[i] = _buffer[(_head + i) & (capacity - 1)];
+        _buffer.Swap(newBuffer);
+        _head = 0;
+        capacity *= 2;
+    }
+
+    _buffer[(_head + size) & (capacity - 1)] = job;
+    _size.store(size + 1);
+}
+
+Job* JobDeque::Pop()
+{
+    if (IsEmpty())
+        return nullptr;
+
+    MutexLock lock(_mutex);
+
+    size_t size = _size.load();
+    if (!size)
+        return nullptr;
+
+    --size;
+    Job* job = _buffer[(_head + size) & (_buffer.Size() - 1)];
+    _size.store(size);
+    return job;
+}
+
+Job* JobDeque::Steal()
+{
+    if (IsEmpty())
+        return nullptr;
+
+    MutexLock lock(_mutex);
+
+    size_t size = _size.load();
+    if (!size)
+        return nullptr;
+
+    Job* job = _buffer[_head];
+    _head = (_head + 1) & (_buffer.Size() - 1);
+    _size.store(size - 1);
+    return job;
+}
+
+WorkQueue::WorkQueue() :
+    _pendingJobs(0),
+    _numWaiters(0)
+{
+    // The main thread's deque always exists, so jobs can be added and completed also without worker threads
+    _queues.Push(new JobDeque());
+    RegisterSubsystem(this);
+}
+
+WorkQueue::~WorkQueue()
+{
+    for (auto it = _threads.Begin(); it != _threads.End(); ++it)
+        (*it)->Shutdown();
+    _threads.Clear();
+
+    // Jobs left in the queues may have counters that are still being waited on, so execute them instead of deleting them.
+    // This also queues the jobs that depend on them
+    Complete();
+    _queues.Clear();
+
+    RemoveSubsystem(this);
+}
+
+void WorkQueue::CreateThreads(unsigned numThreads)
+{
+    if (!_threads.IsEmpty())
+    {
+        ErrorString("Worker threads already exist, can not create more");
+        return;
+    }
+
+    for (unsigned i = 0; i < numThreads; ++i)
+        _queues.Push(new JobDeque());
+
+    for (unsigned i = 0; i < numThreads; ++i)
+    {
+        WorkerThread* thread = new WorkerThread(this, i + 1);
+        _threads.Push(thread);
+        thread->Run();
+    }
+
+    InfoString("Created " + String(numThreads) + " worker threads");
+}
+
+void WorkQueue::AddJob(const JobFunction& function, JobCounter* counter, JobCounter* dependency)
+{
+    Job* job = new Job();
+    job->_function = function;
+    job->_counter = counter;
+    if (counter)
+        ++counter->_pending;
+
+    QueueJob(job, dependency);
+    WakeThreads();
+}
+
+void WorkQueue::AddRangeJobs(size_t count, size_t grainSize, const RangeJobFunction& function, JobCounter* counter, JobCounter* dependency)
+{
+    if (!grainSize)
+        grainSize = GrainSize(count);
+
+    for (size_t begin = 0; begin < count; begin += grainSize)
+    {
+        size_t end = Min(begin + grainSize, count);
+
+        Job* job = new Job();
+        job->_function = [function, begin, end](unsigned threadIndex) { function(begin, end, threadIndex); };
+        job->_counter = counter;
+        if (counter)
+            ++counter->_pending;
+
+        QueueJob(job, dependency);
+    }
+
+    WakeThreads();
+}
+
+void WorkQueue::ParallelFor(size_t count, size_t grainSize, const RangeJobFunction& function)
+{
+    if (!count)
+        return;
+    if (!grainSize)
+        grainSize = GrainSize(count);
+
+    // Run directly if there is nothing to distribute
+    if (_threads.IsEmpty() || count <= grainSize)
+    {
+        function(0, count, ThreadIndex());
+        return;
+    }
+
+    // The function outlives the jobs as this call waits for them, so refer to it instead of copying per job
+    const RangeJobFunction* functionPtr = &function;
+    JobCounter counter;
+    AddRangeJobs(count, grainSize, [functionPtr](size_t begin, size_t end, unsigned threadIndex) { (*functionPtr)(begin, end, threadIndex); },
+        &counter);
+    Wait(counter);
+}
+
+void WorkQueue::Wait(JobCounter& counter)
+{
+    unsigned threadIndex = ThreadIndex();
+    AutoPtr<Condition> wakeCondition;
+
+    while (!counter.IsDone())
+    {
+        Job* job = FindJob(threadIndex);
+        if (job)
+        {
+            RunJob(job, threadIndex);
+            continue;
+        }
+
+        // The remaining jobs are running on other threads. Sleep until a job finishes its counter or more jobs are queued.
+        // Register before the final check, so that a change in between is guaranteed to set the condition
+        if (!wakeCondition)
+            wakeCondition = new Condition();
+        {
+            MutexLock lock(_waiterMutex);
+            _waiters.Push(wakeCondition.Get());
+            ++_numWaiters;
+        }
+        if (!counter.IsDone() && !_pendingJobs.load())
+            wakeCondition->Wait();
+        {
+            MutexLock lock(_waiterMutex);
+            _waiters.Remove(wakeCondition.Get());
+            --_numWaiters;
+        }
+    }
+
+    // Make sure the thread that finished the last job has released the counter, so that it can be destroyed safely
+    MutexLock lock(counter._mutex);
+}
+
+void WorkQueue::Complete()
+{
+    while (ExecuteJob())
+    {
+    }
+}
+
+bool WorkQueue::ExecuteJob()
+{
+    unsigned threadIndex = ThreadIndex();
+    Job* job = FindJob(threadIndex);
+    if (!job)
+        return false;
+
+    RunJob(job, threadIndex);
+    return true;
+}
+
+size_t WorkQueue::GrainSize(size_t count, size_t minGrainSize) const
+{
+    size_t numJobs = (_threads.Size() + 1) * JOBS_PER_THREAD;
+    return Max((count + numJobs - 1) / numJobs, Max(minGrainSize, (size_t)1));
+}
+
+void WorkQueue::QueueJob(Job* job)
+{
+    // Threads not owned by the work queue share the main thread's deque
+    unsigned threadIndex = ThreadIndex();
+    ++_pendingJobs;
+    _queues[threadIndex]->Push(job);
+    WakeWaiters();
+}
+
+void WorkQueue::QueueJob(Job* job, JobCounter* dependency)
+{
+    if (dependency)
+    {
+        MutexLock lock(dependency->_mutex);
+        if (!dependency->IsDone())
+        {
+            dependency->_dependents.Push(job);
+            return;
+        }
+    }
+
+    QueueJob(job);
+}
+
+void WorkQueue::WakeThreads()
+{
+    unsigned toWake = _pendingJobs.load();
+    for (auto it = _threads.Begin(); it != _threads.End() && toWake; ++it)
+    {
+        if ((*it)->Wake())
+            --toWake;
+    }
+}
+
+void WorkQueue::WakeWaiters()
+{
+    if (!_numWaiters.load())
+        return;
+
+    MutexLock lock(_waiterMutex);
+    for (auto it = _waiters.Begin(); it != _waiters.End(); ++it)
+        (*it)->Set();
+}
+
+Job* WorkQueue::FindJob(unsigned threadIndex)
+{
+    if (!_pendingJobs.load())
+        return nullptr;
+
+    size_t numQueues = _queues.Size();
+    Job* job = _queues[threadIndex]->Pop();
+
+    // Steal the oldest job from the other threads, which is likely to be the largest and to not share data with their current work
+    for (size_t i = 1; !job && i < numQueues; ++i)
+        job = _queues[(threadIndex + i) % numQueues]->Steal();
+
+    if (job)
+        --_pendingJobs;
+    return job;
+}
+
+void WorkQueue::RunJob(Job* job, unsigned threadIndex)
+{
+    job->_function(threadIndex);
+
+    JobCounter* counter = job->_counter;
+    delete job;
+
+    if (counter)
+    {
+        MutexLock lock(counter->_mutex);
+        if (--counter->_pending == 0)
+        {
+            if (counter->_dependents.Size())
+            {
+                for (auto it = counter->_dependents.Begin(); it != counter->_dependents.End(); ++it)
+                    QueueJob(*it);
+                counter->_dependents.Clear();
+                WakeThreads();
+            }
+            WakeWaiters();
+        }
+    }
+}
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "../Base/AutoPtr.h"
+#include "../Base/Vector.h"
+#include "../Object/GameManager.h"
+#include "Mutex.h"
+#include "ThreadLocalValue.h"
+
+#include <atomic>
+#include <functional>
+
+namespace Auto3D
+{
+
+class Condition;
+class WorkerThread;
+struct Job;
+
+/// Job function. Receives the index of the executing thread, 0 being the main thread.
+typedef std::function<void(unsigned)> JobFunction;
+/// Parallel-for function. Receives a half-open index range and the index of the executing thread.
+typedef std::function<void(size_t, size_t, unsigned)> RangeJobFunction;
+
+/// Counter of unfinished jobs. Can be waited on, and used as a dependency for other jobs. Must outlive the jobs that refer to it.
+class AUTO_API JobCounter
+{
+    friend class WorkQueue;
+
+public:
+    /// Construct.
+    JobCounter();
+    /// Destruct.
+    ~JobCounter();
+
+    /// Prevent copy construction.
+    JobCounter(const JobCounter& rhs) = delete;
+    /// Prevent assignment.
+    JobCounter& operator = (const JobCounter& rhs) = delete;
+
+    /// Return number of jobs not yet finished.
+    unsigned Pending() const { return _pending.load(); }
+    /// Return whether all jobs have finished.
+    bool IsDone() const { return _pending.load() == 0; }
+
+private:
+    /// Number of jobs not yet finished.
+    std::atomic<unsigned> _pending;
+    /// Mutex for finishing jobs and for the dependent jobs.
+    Mutex _mutex;
+    /// Jobs waiting for this counter to reach zero.
+    Vector<Job*> _dependents;
+};
+
+/// Unit of work executed by the work queue.
+struct AUTO_API Job
+{
+    /// Function to execute.
+    JobFunction _function;
+    /// Counter to decrement once finished, or null.
+    JobCounter* _counter;
+};
+
+/// Double-ended job queue of one thread. The owning thread pushes and pops at the back (newest first), other threads steal from the front.
+class AUTO_API JobDeque
+{
+public:
+    /// Construct.
+    JobDeque();
+    /// Destruct. Delete any jobs left.
+    ~JobDeque();
+
+    /// Add a job to the back.
+    void Push(Job* job);
+    /// Remove and return the newest job, or null if empty.
+    Job* Pop();
+    /// Remove and return the oldest job, or null if empty.
+    Job* Steal();
+    /// Return whether is empty. Does not lock, so the result is only a hint.
+    bool IsEmpty() const { return _size.load() == 0; }
+
+private:
+    /// Mutex for the ring buffer.
+    Mutex _mutex;
+    /// Ring buffer of jobs. Capacity is always a power of two.
+    Vector<Job*> _buffer;
+    /// Index of the oldest job.
+    size_t _head;
+    /// Number of jobs.
+    std::atomic<size_t> _size;
+};
+
+/// Work-stealing job system subsystem. Each worker thread, and the main thread, owns a job deque; idle threads steal work from the others.
+class AUTO_API WorkQueue : public BaseSubsystem
+{
+    REGISTER_OBJECT_CLASS(WorkQueue, BaseSubsystem)
+
+    friend class WorkerThread;
+
+public:
+    /// Construct and register subsystem. No worker threads are created yet.
+    WorkQueue();
+    /// Destruct. Stop the worker threads and execute the jobs not yet started on the calling thread, so that their counters finish.
+    ~WorkQueue();
+
+    /// Create worker threads. Can only be called once. With zero threads all jobs run on the thread which waits for them.
+    void CreateThreads(unsigned numThreads);
+    /// Add a job. The counter, if any, is incremented now and decremented when the job finishes. If a dependency is given, the job is queued only once the dependency reaches zero.
+    void AddJob(const JobFunction& function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+    /// Split an index range into jobs of at most grainSize indices and add them. Zero grain size chooses one based on the thread count.
+    void AddRangeJobs(size_t count, size_t grainSize, const RangeJobFunction& function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+    /// Execute a function over an index range on all threads and return once finished. The calling thread participates.
+    void ParallelFor(size_t count, size_t grainSize, const RangeJobFunction& function);
+    /// Wait for a counter to reach zero, executing queued jobs on the calling thread meanwhile. Sleeps while there are no jobs to execute.
+    void Wait(JobCounter& counter);
+    /// Execute queued jobs on the calling thread until no jobs are left in the queues.
+    void Complete();
+    /// Try to execute one queued job on the calling thread. Return true if a job was executed.
+    bool ExecuteJob();
+
+    /// Return number of worker threads.
+    unsigned NumThreads() const { return (unsigned)_threads.Size(); }
+    /// Return index of the calling thread. The main thread and threads not owned by the work queue return 0.
+    unsigned ThreadIndex() const { return (unsigned)(size_t)_threadIndex.Value(); }
+    /// Return number of jobs queued but not yet started.
+    unsigned NumPendingJobs() const { return _pendingJobs.load(); }
+    /// Return a grain size that splits the range into a few jobs per thread, but not smaller than the minimum.
+    size_t GrainSize(size_t count, size_t minGrainSize = 1) const;
+
+private:
+    /// Queue a job that is ready to run to the calling thread's deque.
+    void QueueJob(Job* job);
+    /// Queue a job, or defer it if the dependency is not done yet.
+    void QueueJob(Job* job, JobCounter* dependency);
+    /// Wake sleeping worker threads, at most as many as there are pending jobs.
+    void WakeThreads();
+    /// Wake the threads sleeping in Wait(), so that they recheck their counter and look for jobs.
+    void WakeWaiters();
+    /// Find a job for a thread: first from its own deque, then by stealing from the others.
+    Job* FindJob(unsigned threadIndex);
+    /// Execute a job, then finish its counter and queue jobs that were waiting for it.
+    void RunJob(Job* job, unsigned threadIndex);
+
+    /// Worker threads.
+    Vector<AutoPtr<WorkerThread> > _threads;
+    /// Job deques, index 0 belongs to the main thread.
+    Vector<AutoPtr<JobDeque> > _queues;
+    /// Index of the calling thread.
+    ThreadLocalValue _threadIndex;
+    /// Number of jobs queued but not yet started.
+    std::atomic<unsigned> _pendingJobs;
+    /// Wake conditions of the threads sleeping in Wait().
+    Vector<Condition*> _waiters;
+    /// Mutex for the waiting threads.
+    Mutex _waiterMutex;
+    /// Number of threads sleeping in Wait(), checked before locking the mutex.
+    std::atomic<unsigned> _numWaiters;
+};
+
+}
@@ -1,4 +1,5 @@
 #include "../Debug/Log.h"
+#include "../IO/JSONDocument.h"
 #include "../IO/Stream.h"
 #include "../Object/ObjectResolver.h"
 #include "../Resource/JSONFile.h"
@@ -11,6 +12,27 @@
 namespace Auto3D
 {
 
+/// Create and load the child nodes from either a JSON value or a JSON document node.
+template <typename _Ty> static void LoadChildrenJSON(UINode* node, const _Ty& source, ObjectResolver& resolver)
+{
+	const _Ty& children = source["children"];
+	if (!children.IsArray())
+		return;
+
+	for (size_t i = 0; i < children.Size(); ++i)
+	{
+		const _Ty& childJSON = children[i];
+		StringHash childType(childJSON["type"].GetString());
+		unsigned childId = (unsigned)childJSON["id"].GetNumber();
+		UINode* child = node->CreateChild(childType);
+		if (child)
+		{
+			resolver.StoreObject(childId, child);
+			child->LoadJSON(childJSON, resolver);
+		}
+	}
+}
+
 UINode::UINode() :
 	_sameLineEnable(false),
 	_offsetFromStartX(0.0f),
@@ -83,23 +105,14 @@ void UINode::LoadJSON(const JSONValue& source, ObjectResolver& resolver)
 {
 	// Type and _id has been read by the parent
 	Serializable::LoadJSON(source, resolver);
+	LoadChildrenJSON(this, source, resolver);
+}
 
-	const JSONArray& children = source["children"].GetArray();
-	if (children.Size())
-	{
-		for (auto it = children.Begin(); it != children.End(); ++it)
-		{
-			const JSONValue& childJSON = *it;
-			StringHash childType(childJSON["type"].GetString());
-			unsigned childId = (unsigned)childJSON["id"].GetNumber();
-			UINode* child = CreateChild(childType);
-			if (child)
-			{
-				resolver.StoreObject(childId, child);
-				child->LoadJSON(childJSON, resolver);
-			}
-		}
-	}
+void UINode::LoadJSON(const JSONNode& source, ObjectResolver& resolver)
+{
+	// Type and _id has been read by the parent
+	Serializable::LoadJSON(source, resolver);
+	LoadChildrenJSON(this, source, resolver);
 }
 
 void UINode::SaveJSON(JSONValue& dest)
@@ -40,6 +40,8 @@ public:
 	void Save(Stream& dest) override;
 	/// Load from JSON data. Store node references to be resolved later.
 	void LoadJSON(const JSONValue& source, ObjectResolver& resolver) override;
+	/// Load from a JSON document node. Store node references to be resolved later.
+	void LoadJSON(const JSONNode& source, ObjectResolver& resolver) override;
 	/// Save as JSON data.
 	void SaveJSON(JSONValue& dest) override;
 	/// Return unique _id within the scene, or 0 if not in a scene.
@@ -1,6 +1,8 @@
 layout(std140) uniform PerFramePS0
 {
     vec3 ambientColor;
+    vec4 clusterParameters;
+    vec4 clusterDepthParameters;
 };
 
 layout(std140) uniform LightsPS3
@@ -134,6 +136,73 @@ vec3 CalculateShadowPointLight(int index, vec4 worldPos, vec3 normal)
     return atten * lightColors[index].rgb;
 }
 
+#ifdef CLUSTERED
+// Must match the light cluster constants in LightClusters.h
+#define NUM_CLUSTERS_X 16
+#define NUM_CLUSTERS_Y 8
+#define NUM_CLUSTERS_Z 16
+#define MAX_CLUSTER_LIGHTS 255
+
+layout(std140) uniform ClusterLightsPS4
+{
+    vec4 clusterLightPositions[MAX_CLUSTER_LIGHTS];
+    vec4 clusterLightDirections[MAX_CLUSTER_LIGHTS];
+    vec4 clusterLightAttenuations[MAX_CLUSTER_LIGHTS];
+    vec4 clusterLightColors[MAX_CLUSTER_LIGHTS];
+};
+
+// Offset to the light index list in the high 24 bits and light count in the low 8 bits, four clusters per element
+layout(std140) uniform ClusterGridPS5
+{
+    uvec4 clusterGrid[NUM_CLUSTERS_X * NUM_CLUSTERS_Y * NUM_CLUSTERS_Z / 4];
+};
+
+// Light indices as bytes, sixteen per element
+layout(std140) uniform ClusterLightIndicesPS6
+{
+    uvec4 clusterLightIndices[1024];
+};
+
+vec3 CalculateClusterLight(int index, vec4 worldPos, vec3 normal)
+{
+    // Point lights have a spot cutoff that never attenuates
+    vec3 lightVec = (clusterLightPositions[index].xyz - worldPos.xyz) * clusterLightAttenuations[index].x;
+    float lightDist = length(lightVec);
+    vec3 localDir = lightVec / lightDist;
+    float NdotL = clamp(dot(normal, localDir), 0.0, 1.0);
+    float spotEffect = dot(localDir, clusterLightDirections[index].xyz);
+    float spotAtten = clamp((spotEffect - clusterLightAttenuations[index].y) * clusterLightAttenuations[index].z, 0.0, 1.0);
+    return NdotL * spotAtten * clamp(1.0 - lightDist * lightDist, 0.0, 1.0) * clusterLightColors[index].rgb;
+}
+
+vec3 CalculateClusteredLights(vec4 worldPos, vec3 normal)
+{
+    vec3 totalLight = vec3(0, 0, 0);
+
+    // Directional lights come first and affect all clusters
+    int numDirLights = int(clusterDepthParameters.z);
+    for (int i = 0; i < numDirLights; ++i)
+        totalLight += clamp(dot(normal, clusterLightDirections[i].xyz), 0.0, 1.0) * clusterLightColors[i].rgb;
+
+    vec2 tile = clamp(gl_FragCoord.xy * clusterParameters.xy + clusterParameters.zw, vec2(0, 0),
+        vec2(NUM_CLUSTERS_X - 1, NUM_CLUSTERS_Y - 1));
+    float slice = clamp(log(max(worldPos.w, 0.00001)) * clusterDepthParameters.x + clusterDepthParameters.y, 0.0,
+        float(NUM_CLUSTERS_Z - 1));
+    int cluster = (int(slice) * NUM_CLUSTERS_Y + int(tile.y)) * NUM_CLUSTERS_X + int(tile.x);
+
+    uint clusterData = clusterGrid[cluster >> 2][cluster & 3];
+    int offset = int(clusterData >> 8u);
+    int count = int(clusterData & 255u);
+    for (int i = offset; i < offset + count; ++i)
+    {
+        int lightIndex = int((clusterLightIndices[i >> 4][(i >> 2) & 3] >> uint((i & 3) * 8)) & 255u);
+        totalLight += CalculateClusterLight(lightIndex, worldPos, normal);
+    }
+
+    return totalLight;
+}
+#endif
+
 #ifdef NUMSHADOWCOORDS
 vec4 CalculateLighting(vec4 worldPos, vec3 normal, vec4 shadowPos[NUMSHADOWCOORDS])
 #else
@@ -150,6 +219,10 @@ vec4 CalculateLighting(vec4 worldPos, vec3 normal)
     totalLight.rgb += ambientColor;
     #endif
 
+    #ifdef CLUSTERED
+    totalLight.rgb += CalculateClusteredLights(worldPos, normal);
+    #endif
+
     #ifdef DIRLIGHT0
     #ifdef SHADOW0
     totalLight.rgb += CalculateShadowDirLight(0, worldPos, normal, shadowPos);
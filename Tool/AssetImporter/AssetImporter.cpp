@@ -0,0 +1,347 @@
+#include "Source/Base/ProcessUtils.h"
+#include "Source/Graphics/IndexBuffer.h"
+#include "Source/Graphics/VertexBuffer.h"
+#include "Source/IO/File.h"
+#include "Source/Math/Vector2.h"
+#include "Source/Math/Vector4.h"
+#include "Source/Renderer/Model.h"
+#include "MeshOptimizer.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <cstring>
+
+using namespace Auto3D;
+
+/// Maximum number of LOD levels including the original geometry.
+static const int MAX_LOD_LEVELS = 8;
+/// Default triangle ratio between consecutive LOD levels.
+static const float DEFAULT_LOD_RATIO = 0.5f;
+/// LOD distance step as a multiple of the model's bounding box diagonal, if not specified.
+static const float DEFAULT_LOD_DISTANCE_SCALE = 5.0f;
+/// LOD levels that do not reduce the triangle count at least this much are not generated.
+static const float MIN_LOD_REDUCTION = 0.9f;
+
+/// Import settings.
+struct ImportSettings
+{
+    /// Number of LOD levels including the original geometry.
+    int _numLodLevels = 1;
+    /// Triangle ratio between consecutive LOD levels.
+    float _lodRatio = DEFAULT_LOD_RATIO;
+    /// LOD distance step, or zero to derive from the bounding box.
+    float _lodDistance = 0.0f;
+};
+
+/// Processed geometry ready for the model.
+struct ImportedGeometry
+{
+    /// Vertex declaration.
+    Vector<VertexElement> _elements;
+    /// Interleaved vertex data.
+    Vector<unsigned char> _vertexData;
+    /// Number of vertices.
+    size_t _numVertices;
+    /// Triangle list indices of each LOD level.
+    Vector<Vector<unsigned> > _lodIndices;
+};
+
+void Usage()
+{
+    PrintLine("Usage: AssetImporter <input> <output> [options]\n"
+        "\n"
+        "Import a model file supported by Assimp (for example glTF, FBX or OBJ) and save it in\n"
+        "the binary model format. All meshes are transformed to model space. Vertices are\n"
+        "deduplicated and ordered for the vertex cache, and 16-bit indices are used when possible.\n"
+        "\n"
+        "Options:\n"
+        "-l <count>     Number of LOD levels including the original, default 1, max 8\n"
+        "-r <ratio>     Triangle ratio between consecutive LOD levels, default 0.5\n"
+        "-d <distance>  LOD distance step, default 5 times the bounding box diagonal");
+    ErrorExit(String::EMPTY, 1);
+}
+
+/// Write a value into interleaved vertex data.
+template <typename _Ty> void WriteVertexValue(unsigned char*& dest, const _Ty& value)
+{
+    memcpy(dest, &value, sizeof value);
+    dest += sizeof value;
+}
+
+/// Return the vertex declaration for a mesh. The element order matches the legacy model format.
+Vector<VertexElement> MeshElements(const aiMesh* mesh)
+{
+    Vector<VertexElement> elements;
+    elements.Push(VertexElement(ElementType::VECTOR3, ElementSemantic::POSITION));
+    if (mesh->HasNormals())
+        elements.Push(VertexElement(ElementType::VECTOR3, ElementSemantic::NORMAL));
+    if (mesh->HasVertexColors(0))
+        elements.Push(VertexElement(ElementType::UBYTE4, ElementSemantic::COLOR));
+    if (mesh->HasTextureCoords(0))
+        elements.Push(VertexElement(ElementType::VECTOR2, ElementSemantic::TEXCOORD));
+    if (mesh->HasTextureCoords(1))
+        elements.Push(VertexElement(ElementType::VECTOR2, ElementSemantic::TEXCOORD, 1));
+    if (mesh->HasNormals() && mesh->HasTangentsAndBitangents())
+        elements.Push(VertexElement(ElementType::VECTOR4, ElementSemantic::TANGENT));
+    return elements;
+}
+
+/// Interleave the vertex data of a mesh according to its vertex declaration.
+void BuildVertexData(const aiMesh* mesh, const Vector<VertexElement>& elements, Vector<unsigned char>& vertexData)
+{
+    size_t vertexSize = 0;
+    for (auto it = elements.Begin(); it != elements.End(); ++it)
+        vertexSize += elementSizes[it->_type];
+
+    vertexData.Resize(mesh->mNumVertices * vertexSize);
+    unsigned char* dest = vertexData.Size() ? &vertexData[0] : nullptr;
+
+    for (unsigned i = 0; i < mesh->mNumVertices; ++i)
+    {
+        for (auto it = elements.Begin(); it != elements.End(); ++it)
+        {
+            switch (it->_semantic)
+            {
+            case ElementSemantic::POSITION:
+                WriteVertexValue(dest, Vector3F(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z));
+                break;
+
+            case ElementSemantic::NORMAL:
+                WriteVertexValue(dest, Vector3F(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z).Normalized());
+                break;
+
+            case ElementSemantic::COLOR:
+                {
+                    const aiColor4D& color = mesh->mColors[0][i];
+                    unsigned char bytes[4] = {
+                        (unsigned char)Clamp((int)(color.r * 255.0f + 0.5f), 0, 255),
+                        (unsigned char)Clamp((int)(color.g * 255.0f + 0.5f), 0, 255),
+                        (unsigned char)Clamp((int)(color.b * 255.0f + 0.5f), 0, 255),
+                        (unsigned char)Clamp((int)(color.a * 255.0f + 0.5f), 0, 255)
+                    };
+                    WriteVertexValue(dest, bytes);
+                }
+                break;
+
+            case ElementSemantic::TEXCOORD:
+                {
+                    const aiVector3D& texCoord = mesh->mTextureCoords[it->_index][i];
+                    WriteVertexValue(dest, Vector2F(texCoord.x, texCoord.y));
+                }
+                break;
+
+            case ElementSemantic::TANGENT:
+                {
+                    Vector3F normal(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+                    Vector3F tangent(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+                    Vector3F bitangent(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+                    // Store the bitangent direction in W so that the shader can reconstruct it
+                    float handedness = normal.CrossProduct(tangent).DotProduct(bitangent) < 0.0f ? -1.0f : 1.0f;
+                    tangent.Normalize();
+                    WriteVertexValue(dest, Vector4F(tangent._x, tangent._y, tangent._z, handedness));
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+}
+
+/// Deduplicate, simplify and cache-optimize a mesh.
+ImportedGeometry ProcessMesh(const aiMesh* mesh, const ImportSettings& settings)
+{
+    ImportedGeometry geometry;
+    geometry._elements = MeshElements(mesh);
+    BuildVertexData(mesh, geometry._elements, geometry._vertexData);
+
+    Vector<unsigned> indices;
+    for (unsigned i = 0; i < mesh->mNumFaces; ++i)
+    {
+        const aiFace& face = mesh->mFaces[i];
+        if (face.mNumIndices != 3)
+            continue;
+        indices.Push(face.mIndices[0]);
+        indices.Push(face.mIndices[1]);
+        indices.Push(face.mIndices[2]);
+    }
+
+    size_t vertexSize = geometry._vertexData.Size() / Max(mesh->mNumVertices, 1u);
+    size_t numVertices = DeduplicateVertices(geometry._vertexData, vertexSize, indices);
+
+    // Position is always the first element
+    Vector<Vector3F> positions(numVertices);
+    for (size_t i = 0; i < numVertices; ++i)
+        memcpy(&positions[i], &geometry._vertexData[i * vertexSize], sizeof(Vector3F));
+
+    geometry._lodIndices.Push(indices);
+    for (int i = 1; i < settings._numLodLevels; ++i)
+    {
+        const Vector<unsigned>& previous = geometry._lodIndices.Back();
+        size_t previousTriangles = previous.Size() / 3;
+        Vector<unsigned> lodIndices = SimplifyMesh(positions, previous, (size_t)(previousTriangles * settings._lodRatio));
+        if (lodIndices.IsEmpty() || lodIndices.Size() / 3 > previousTriangles * MIN_LOD_REDUCTION)
+            break;
+        geometry._lodIndices.Push(lodIndices);
+    }
+
+    for (size_t i = 0; i < geometry._lodIndices.Size(); ++i)
+        OptimizeVertexCache(geometry._lodIndices[i], numVertices);
+
+    // Order the vertices by first use, the most detailed LOD level first. This also drops unreferenced vertices
+    Vector<unsigned> allIndices;
+    for (size_t i = 0; i < geometry._lodIndices.Size(); ++i)
+        allIndices.Push(geometry._lodIndices[i]);
+    Vector<unsigned> remap = OptimizeVertexFetch(allIndices, numVertices, geometry._numVertices);
+
+    Vector<unsigned char> vertexData(geometry._numVertices * vertexSize);
+    for (size_t i = 0; i < numVertices; ++i)
+    {
+        if (remap[i] != M_MAX_UNSIGNED)
+            memcpy(&vertexData[remap[i] * vertexSize], &geometry._vertexData[i * vertexSize], vertexSize);
+    }
+    geometry._vertexData = vertexData;
+
+    size_t start = 0;
+    for (size_t i = 0; i < geometry._lodIndices.Size(); ++i)
+    {
+        Vector<unsigned>& lodIndices = geometry._lodIndices[i];
+        for (size_t j = 0; j < lodIndices.Size(); ++j)
+            lodIndices[j] = allIndices[start + j];
+        start += lodIndices.Size();
+    }
+
+    return geometry;
+}
+
+void Import(const String& inputName, const String& outputName, const ImportSettings& settings)
+{
+    Assimp::Importer importer;
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+
+    // The engine is left-handed. Pre-transforming bakes the node hierarchy into model space and merges meshes by material
+    const aiScene* scene = importer.ReadFile(inputName.CString(), aiProcess_ConvertToLeftHanded | aiProcess_Triangulate |
+        aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_SortByPType |
+        aiProcess_PreTransformVertices | aiProcess_RemoveRedundantMaterials | aiProcess_OptimizeMeshes |
+        aiProcess_FindInvalidData | aiProcess_ValidateDataStructure);
+    if (!scene)
+        ErrorExit("Could not import " + inputName + ": " + importer.GetErrorString());
+
+    Vector<ImportedGeometry> geometries;
+    BoundingBoxF boundingBox;
+    size_t numTriangles = 0;
+    size_t numLodTriangles = 0;
+
+    for (unsigned i = 0; i < scene->mNumMeshes; ++i)
+    {
+        const aiMesh* mesh = scene->mMeshes[i];
+        if (!mesh->mNumVertices || !(mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE))
+            continue;
+        if (mesh->HasBones())
+            PrintLine("Warning: skinning of mesh " + String(mesh->mName.C_Str()) + " is not imported");
+
+        geometries.Push(ProcessMesh(mesh, settings));
+
+        const ImportedGeometry& geometry = geometries.Back();
+        size_t vertexSize = geometry._vertexData.Size() / Max(geometry._numVertices, (size_t)1);
+        for (size_t j = 0; j < geometry._numVertices; ++j)
+        {
+            Vector3F position;
+            memcpy(&position, &geometry._vertexData[j * vertexSize], sizeof position);
+            boundingBox.Merge(position);
+        }
+
+        numTriangles += geometry._lodIndices[0].Size() / 3;
+        for (size_t j = 1; j < geometry._lodIndices.Size(); ++j)
+            numLodTriangles += geometry._lodIndices[j].Size() / 3;
+    }
+
+    if (geometries.IsEmpty())
+        ErrorExit("No triangle meshes found in " + inputName);
+
+    float lodDistance = settings._lodDistance > 0.0f ? settings._lodDistance : boundingBox.Size().Length() *
+        DEFAULT_LOD_DISTANCE_SCALE;
+
+    // Without a Graphics subsystem the buffers only keep their shadow data, which Model::Save() writes
+    SharedPtr<Model> model(new Model());
+    model->SetNumGeometries(geometries.Size());
+    model->SetLocalBoundingBox(boundingBox);
+
+    for (size_t i = 0; i < geometries.Size(); ++i)
+    {
+        const ImportedGeometry& geometry = geometries[i];
+
+        // All LOD levels share the vertex buffer and use consecutive ranges of one index buffer
+        Vector<unsigned> indices;
+        for (size_t j = 0; j < geometry._lodIndices.Size(); ++j)
+            indices.Push(geometry._lodIndices[j]);
+
+        SharedPtr<VertexBuffer> vb(new VertexBuffer());
+        vb->Define(ResourceUsage::IMMUTABLE, geometry._numVertices, geometry._elements, true, &geometry._vertexData[0]);
+
+        SharedPtr<IndexBuffer> ib(new IndexBuffer());
+        if (geometry._numVertices <= 0x10000)
+        {
+            Vector<unsigned short> shortIndices(indices.Size());
+            for (size_t j = 0; j < indices.Size(); ++j)
+                shortIndices[j] = (unsigned short)indices[j];
+            ib->Define(ResourceUsage::IMMUTABLE, shortIndices.Size(), sizeof(unsigned short), true, &shortIndices[0]);
+        }
+        else
+            ib->Define(ResourceUsage::IMMUTABLE, indices.Size(), sizeof(unsigned), true, &indices[0]);
+
+        model->SetNumLodLevels(i, geometry._lodIndices.Size());
+        size_t drawStart = 0;
+        for (size_t j = 0; j < geometry._lodIndices.Size(); ++j)
+        {
+            Geometry* geom = model->GetGeometry(i, j);
+            geom->_vertexBuffer = vb;
+            geom->_indexBuffer = ib;
+            geom->_primitiveType = PrimitiveType::TRIANGLE_LIST;
+            geom->_drawStart = drawStart;
+            geom->_drawCount = geometry._lodIndices[j].Size();
+            geom->_lodDistance = j * lodDistance;
+            drawStart += geom->_drawCount;
+        }
+    }
+
+    File dest(outputName, FileMode::WRITE);
+    if (!dest.IsOpen())
+        ErrorExit("Could not open " + outputName + " for writing");
+    if (!model->Save(dest))
+        ErrorExit("Could not save " + outputName);
+
+    PrintLine(String::Format("Imported %d geometries, %d triangles, %d triangles in LOD levels", (int)geometries.Size(),
+        (int)numTriangles, (int)numLodTriangles));
+}
+
+int main(int argc, char** argv)
+{
+    const Vector<String>& arguments = ParseArguments(argc, argv);
+    if (arguments.Size() < 2 || arguments[0].StartsWith("-") || arguments[1].StartsWith("-"))
+        Usage();
+
+    ImportSettings settings;
+    for (size_t i = 2; i < arguments.Size(); ++i)
+    {
+        if (i + 1 >= arguments.Size())
+            Usage();
+
+        const String& option = arguments[i];
+        const String& value = arguments[++i];
+        if (option == "-l")
+            settings._numLodLevels = Clamp(value.ToInt(), 1, MAX_LOD_LEVELS);
+        else if (option == "-r")
+            settings._lodRatio = Clamp(value.ToFloat(), 0.01f, 0.99f);
+        else if (option == "-d")
+            settings._lodDistance = Max(value.ToFloat(), 0.0f);
+        else
+            Usage();
+    }
+
+    Import(arguments[0], arguments[1], settings);
+    return 0;
+}
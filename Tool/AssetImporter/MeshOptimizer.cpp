@@ -0,0 +1,425 @@
+#include "Source/Base/HashMap.h"
+#include "Source/Math/BoundingBox.h"
+#include "Source/Math/Math.h"
+#include "MeshOptimizer.h"
+
+#include <cstring>
+
+namespace Auto3D
+{
+
+/// Simulated post-transform vertex cache size.
+static const size_t VERTEX_CACHE_SIZE = 32;
+/// Falloff of the score of vertices further back in the cache.
+static const float CACHE_DECAY_POWER = 1.5f;
+/// Score of the vertices of the last added triangle. Slightly less than the next cache positions, so that strips are not favored.
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+/// Score bonus for vertices with few remaining triangles, so that lone triangles are not left behind.
+static const float VALENCE_BOOST_SCALE = 2.0f;
+/// Falloff of the valence bonus.
+static const float VALENCE_BOOST_POWER = 0.5f;
+/// Finest grid resolution tried when simplifying.
+static const unsigned MAX_CLUSTER_RESOLUTION = 1024;
+
+/// Error quadric of a set of planes.
+struct Quadric
+{
+    /// Construct as zero.
+    Quadric() :
+        _a2(0.0), _ab(0.0), _ac(0.0), _ad(0.0),
+        _b2(0.0), _bc(0.0), _bd(0.0),
+        _c2(0.0), _cd(0.0),
+        _d2(0.0)
+    {
+    }
+
+    /// Add a weighted plane.
+    void AddPlane(double a, double b, double c, double d, double weight)
+    {
+        _a2 += weight * a * a; _ab += weight * a * b; _ac += weight * a * c; _ad += weight * a * d;
+        _b2 += weight * b * b; _bc += weight * b * c; _bd += weight * b * d;
+        _c2 += weight * c * c; _cd += weight * c * d;
+        _d2 += weight * d * d;
+    }
+
+    /// Add another quadric.
+    void Add(const Quadric& rhs)
+    {
+        _a2 += rhs._a2; _ab += rhs._ab; _ac += rhs._ac; _ad += rhs._ad;
+        _b2 += rhs._b2; _bc += rhs._bc; _bd += rhs._bd;
+        _c2 += rhs._c2; _cd += rhs._cd;
+        _d2 += rhs._d2;
+    }
+
+    /// Return the sum of squared distances of a point from the planes.
+    double Error(const Vector3F& point) const
+    {
+        double x = point._x;
+        double y = point._y;
+        double z = point._z;
+        return _a2 * x * x + 2.0 * _ab * x * y + 2.0 * _ac * x * z + 2.0 * _ad * x +
+            _b2 * y * y + 2.0 * _bc * y * z + 2.0 * _bd * y +
+            _c2 * z * z + 2.0 * _cd * z +
+            _d2;
+    }
+
+    double _a2, _ab, _ac, _ad;
+    double _b2, _bc, _bd;
+    double _c2, _cd;
+    double _d2;
+};
+
+/// Return a hash of vertex bytes.
+static unsigned HashVertex(const unsigned char* data, size_t size)
+{
+    unsigned hash = 0;
+    for (size_t i = 0; i < size; ++i)
+        hash = data[i] + (hash << 6) + (hash << 16) - hash;
+    return hash;
+}
+
+/// Return the Forsyth score of a vertex.
+static float VertexScore(int cachePosition, unsigned remainingTriangles)
+{
+    if (!remainingTriangles)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else
+        {
+            float scale = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            score = powf(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+        }
+    }
+
+    return score + VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -VALENCE_BOOST_POWER);
+}
+
+/// Map each vertex to the vertex with the least quadric error in its grid cell at the given resolution.
+static void ClusterVertices(const Vector<Vector3F>& positions, const Vector<Quadric>& vertexQuadrics, const BoundingBoxF& box,
+    unsigned resolution, Vector<unsigned>& representatives)
+{
+    Vector3F size = box.Size();
+    Vector3F cellScale(resolution / Max(size._x, M_EPSILON), resolution / Max(size._y, M_EPSILON), resolution / Max(size._z, M_EPSILON));
+
+    HashMap<unsigned long long, unsigned> cells;
+    Vector<unsigned> vertexClusters(positions.Size());
+    Vector<Quadric> clusterQuadrics;
+
+    for (size_t i = 0; i < positions.Size(); ++i)
+    {
+        Vector3F cell = (positions[i] - box._min) * cellScale;
+        unsigned long long x = Min((unsigned)Max(cell._x, 0.0f), resolution - 1);
+        unsigned long long y = Min((unsigned)Max(cell._y, 0.0f), resolution - 1);
+        unsigned long long z = Min((unsigned)Max(cell._z, 0.0f), resolution - 1);
+        unsigned long long key = (x << 42) | (y << 21) | z;
+
+        auto it = cells.Find(key);
+        unsigned cluster;
+        if (it != cells.End())
+            cluster = it->_second;
+        else
+        {
+            cluster = (unsigned)clusterQuadrics.Size();
+            cells[key] = cluster;
+            clusterQuadrics.Push(Quadric());
+        }
+
+        vertexClusters[i] = cluster;
+        clusterQuadrics[cluster].Add(vertexQuadrics[i]);
+    }
+
+    // Keeping an original vertex instead of solving for the optimal position preserves its other attributes
+    Vector<unsigned> best(clusterQuadrics.Size());
+    Vector<double> bestError(clusterQuadrics.Size());
+    for (size_t i = 0; i < best.Size(); ++i)
+        best[i] = M_MAX_UNSIGNED;
+
+    for (size_t i = 0; i < positions.Size(); ++i)
+    {
+        unsigned cluster = vertexClusters[i];
+        double error = clusterQuadrics[cluster].Error(positions[i]);
+        if (best[cluster] == M_MAX_UNSIGNED || error < bestError[cluster])
+        {
+            best[cluster] = (unsigned)i;
+            bestError[cluster] = error;
+        }
+    }
+
+    representatives.Resize(positions.Size());
+    for (size_t i = 0; i < positions.Size(); ++i)
+        representatives[i] = best[vertexClusters[i]];
+}
+
+size_t DeduplicateVertices(Vector<unsigned char>& vertexData, size_t vertexSize, Vector<unsigned>& indices)
+{
+    size_t numVertices = vertexData.Size() / vertexSize;
+    HashMap<unsigned, unsigned> firstWithHash;
+    Vector<unsigned> nextWithHash(numVertices);
+    Vector<unsigned> remap(numVertices);
+    size_t numUnique = 0;
+
+    // Unique vertices are compacted in place, so a match is always searched among already compacted vertices
+    for (size_t i = 0; i < numVertices; ++i)
+    {
+        const unsigned char* vertex = &vertexData[i * vertexSize];
+        unsigned hash = HashVertex(vertex, vertexSize);
+        auto it = firstWithHash.Find(hash);
+        unsigned first = it != firstWithHash.End() ? it->_second : M_MAX_UNSIGNED;
+
+        unsigned match = M_MAX_UNSIGNED;
+        for (unsigned j = first; j != M_MAX_UNSIGNED; j = nextWithHash[j])
+        {
+            if (!memcmp(&vertexData[j * vertexSize], vertex, vertexSize))
+            {
+                match = j;
+                break;
+            }
+        }
+
+        if (match == M_MAX_UNSIGNED)
+        {
+            match = (unsigned)numUnique++;
+            if (match != i)
+                memcpy(&vertexData[match * vertexSize], vertex, vertexSize);
+            nextWithHash[match] = first;
+            firstWithHash[hash] = match;
+        }
+
+        remap[i] = match;
+    }
+
+    for (size_t i = 0; i < indices.Size(); ++i)
+        indices[i] = remap[indices[i]];
+
+    vertexData.Resize(numUnique * vertexSize);
+    return numUnique;
+}
+
+void OptimizeVertexCache(Vector<unsigned>& indices, size_t numVertices)
+{
+    size_t numTriangles = indices.Size() / 3;
+    if (numTriangles < 2)
+        return;
+
+    // Build the list of triangles using each vertex. The remaining triangles of a vertex are kept first in its list
+    Vector<unsigned> remainingTriangles(numVertices);
+    Vector<unsigned> triangleOffsets(numVertices);
+    for (size_t i = 0; i < numVertices; ++i)
+        remainingTriangles[i] = 0;
+    for (size_t i = 0; i < numTriangles * 3; ++i)
+        ++remainingTriangles[indices[i]];
+
+    unsigned offset = 0;
+    for (size_t i = 0; i < numVertices; ++i)
+    {
+        triangleOffsets[i] = offset;
+        offset += remainingTriangles[i];
+    }
+
+    Vector<unsigned> vertexTriangles(numTriangles * 3);
+    Vector<unsigned> fillPositions(triangleOffsets);
+    for (size_t i = 0; i < numTriangles * 3; ++i)
+        vertexTriangles[fillPositions[indices[i]]++] = (unsigned)(i / 3);
+
+    Vector<int> cachePositions(numVertices);
+    Vector<float> vertexScores(numVertices);
+    for (size_t i = 0; i < numVertices; ++i)
+    {
+        cachePositions[i] = -1;
+        vertexScores[i] = VertexScore(-1, remainingTriangles[i]);
+    }
+
+    Vector<unsigned char> triangleAdded(numTriangles);
+    unsigned bestTriangle = M_MAX_UNSIGNED;
+    float bestScore = -1.0f;
+    for (size_t i = 0; i < numTriangles; ++i)
+    {
+        triangleAdded[i] = 0;
+        const unsigned* triangle = &indices[i * 3];
+        float score = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+        if (score > bestScore)
+        {
+            bestTriangle = (unsigned)i;
+            bestScore = score;
+        }
+    }
+
+    Vector<unsigned> result;
+    result.Reserve(numTriangles * 3);
+    unsigned cache[VERTEX_CACHE_SIZE + 3];
+    unsigned newCache[VERTEX_CACHE_SIZE + 3];
+    size_t cacheSize = 0;
+    size_t scanPosition = 0;
+
+    while (bestTriangle != M_MAX_UNSIGNED)
+    {
+        triangleAdded[bestTriangle] = 1;
+        const unsigned* triangle = &indices[bestTriangle * 3];
+        size_t newCacheSize = 0;
+
+        for (size_t i = 0; i < 3; ++i)
+        {
+            unsigned vertex = triangle[i];
+            result.Push(vertex);
+
+            // Remove the triangle from the vertex's remaining triangles
+            unsigned* triangles = &vertexTriangles[triangleOffsets[vertex]];
+            unsigned remaining = remainingTriangles[vertex];
+            for (unsigned j = 0; j < remaining; ++j)
+            {
+                if (triangles[j] == bestTriangle)
+                {
+                    triangles[j] = triangles[remaining - 1];
+                    triangles[remaining - 1] = bestTriangle;
+                    --remainingTriangles[vertex];
+                    break;
+                }
+            }
+
+            bool cached = false;
+            for (size_t j = 0; j < newCacheSize; ++j)
+                cached |= newCache[j] == vertex;
+            if (!cached)
+                newCache[newCacheSize++] = vertex;
+        }
+
+        // The added triangle's vertices go first, followed by the rest of the previous cache
+        for (size_t i = 0; i < cacheSize; ++i)
+        {
+            unsigned vertex = cache[i];
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                newCache[newCacheSize++] = vertex;
+        }
+
+        for (size_t i = 0; i < newCacheSize; ++i)
+        {
+            unsigned vertex = newCache[i];
+            cachePositions[vertex] = i < VERTEX_CACHE_SIZE ? (int)i : -1;
+            vertexScores[vertex] = VertexScore(cachePositions[vertex], remainingTriangles[vertex]);
+        }
+
+        // Rescore the triangles whose vertex scores changed and pick the best one
+        bestTriangle = M_MAX_UNSIGNED;
+        bestScore = -1.0f;
+        for (size_t i = 0; i < newCacheSize; ++i)
+        {
+            unsigned vertex = newCache[i];
+            const unsigned* triangles = &vertexTriangles[triangleOffsets[vertex]];
+            for (unsigned j = 0; j < remainingTriangles[vertex]; ++j)
+            {
+                const unsigned* candidate = &indices[triangles[j] * 3];
+                float score = vertexScores[candidate[0]] + vertexScores[candidate[1]] + vertexScores[candidate[2]];
+                if (score > bestScore)
+                {
+                    bestTriangle = triangles[j];
+                    bestScore = score;
+                }
+            }
+        }
+
+        cacheSize = Min(newCacheSize, VERTEX_CACHE_SIZE);
+        memcpy(cache, newCache, cacheSize * sizeof(unsigned));
+
+        // If no cached vertex has triangles left, continue from the first triangle not yet added
+        if (bestTriangle == M_MAX_UNSIGNED)
+        {
+            while (scanPosition < numTriangles && triangleAdded[scanPosition])
+                ++scanPosition;
+            if (scanPosition < numTriangles)
+                bestTriangle = (unsigned)scanPosition;
+        }
+    }
+
+    indices = result;
+}
+
+Vector<unsigned> OptimizeVertexFetch(Vector<unsigned>& indices, size_t numVertices, size_t& numUsedVertices)
+{
+    Vector<unsigned> remap(numVertices);
+    for (size_t i = 0; i < numVertices; ++i)
+        remap[i] = M_MAX_UNSIGNED;
+
+    unsigned nextVertex = 0;
+    for (size_t i = 0; i < indices.Size(); ++i)
+    {
+        unsigned& index = indices[i];
+        if (remap[index] == M_MAX_UNSIGNED)
+            remap[index] = nextVertex++;
+        index = remap[index];
+    }
+
+    numUsedVertices = nextVertex;
+    return remap;
+}
+
+Vector<unsigned> SimplifyMesh(const Vector<Vector3F>& positions, const Vector<unsigned>& indices, size_t targetTriangles)
+{
+    size_t numTriangles = indices.Size() / 3;
+    if (numTriangles <= targetTriangles || positions.IsEmpty())
+        return indices;
+
+    BoundingBoxF box;
+    box.Define(&positions[0], positions.Size());
+
+    // Accumulate the area-weighted planes of the triangles around each vertex
+    Vector<Quadric> vertexQuadrics(positions.Size());
+    for (size_t i = 0; i < numTriangles; ++i)
+    {
+        const Vector3F& p0 = positions[indices[i * 3]];
+        const Vector3F& p1 = positions[indices[i * 3 + 1]];
+        const Vector3F& p2 = positions[indices[i * 3 + 2]];
+        Vector3F normal = (p1 - p0).CrossProduct(p2 - p0);
+        float doubleArea = normal.Length();
+        if (doubleArea < M_EPSILON)
+            continue;
+
+        normal /= doubleArea;
+        double d = -normal.DotProduct(p0);
+        for (size_t j = 0; j < 3; ++j)
+            vertexQuadrics[indices[i * 3 + j]].AddPlane(normal._x, normal._y, normal._z, d, 0.5 * doubleArea);
+    }
+
+    // Search for the finest grid that meets the target. A grid of one cell collapses everything, so a result always exists
+    Vector<unsigned> representatives;
+    Vector<unsigned> candidate;
+    Vector<unsigned> best;
+    unsigned low = 1;
+    unsigned high = MAX_CLUSTER_RESOLUTION;
+
+    while (low <= high)
+    {
+        unsigned resolution = (low + high) / 2;
+        ClusterVertices(positions, vertexQuadrics, box, resolution, representatives);
+
+        candidate.Clear();
+        for (size_t i = 0; i < numTriangles; ++i)
+        {
+            unsigned v0 = representatives[indices[i * 3]];
+            unsigned v1 = representatives[indices[i * 3 + 1]];
+            unsigned v2 = representatives[indices[i * 3 + 2]];
+            if (v0 != v1 && v1 != v2 && v0 != v2)
+            {
+                candidate.Push(v0);
+                candidate.Push(v1);
+                candidate.Push(v2);
+            }
+        }
+
+        if (candidate.Size() / 3 <= targetTriangles)
+        {
+            best = candidate;
+            low = resolution + 1;
+        }
+        else
+            high = resolution - 1;
+    }
+
+    return best;
+}
+
+}
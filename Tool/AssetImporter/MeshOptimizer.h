@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Source/Base/Vector.h"
+#include "Source/Math/Vector3.h"
+
+namespace Auto3D
+{
+
+/// Remove vertices whose bytes are identical to an earlier vertex and remap the indices. Return the new number of vertices.
+size_t DeduplicateVertices(Vector<unsigned char>& vertexData, size_t vertexSize, Vector<unsigned>& indices);
+/// Reorder triangles for the post-transform vertex cache, using Tom Forsyth's linear-speed vertex cache optimization.
+void OptimizeVertexCache(Vector<unsigned>& indices, size_t numVertices);
+/// Return a vertex remap table that orders vertices by their first use in the indices, and remap the indices with it. Unused vertices map to M_MAX_UNSIGNED. Return the number of used vertices in numUsedVertices.
+Vector<unsigned> OptimizeVertexFetch(Vector<unsigned>& indices, size_t numVertices, size_t& numUsedVertices);
+/// Simplify a triangle list to at most targetTriangles triangles with quadric-weighted vertex clustering. The returned indices reference the original vertices, so no new vertex data is needed.
+Vector<unsigned> SimplifyMesh(const Vector<Vector3F>& positions, const Vector<unsigned>& indices, size_t targetTriangles);
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Source/Base/ProcessUtils.h"
+#include "Source/Base/Vector.h"
+#include "Source/Math/Math.h"
+
+namespace Auto3D
+{
+
+/// Default number of benchmark passes.
+static const int DEFAULT_BENCHMARK_PASSES = 10;
+
+/// Print a tool's usage text and exit with an error code.
+inline void ExitWithUsage(const char* usage)
+{
+    PrintLine(usage);
+    ErrorExit(String::EMPTY, 1);
+}
+
+/// Return a positive count, such as the number of benchmark passes, from an optional command line argument. Return the default if the argument is not given, and at least one.
+inline int CountArgument(const Vector<String>& arguments, size_t index, int defaultCount = DEFAULT_BENCHMARK_PASSES)
+{
+    return Max(arguments.Size() > index ? arguments[index].ToInt() : defaultCount, 1);
+}
+
+}
@@ -0,0 +1,98 @@
+#include "../Common/ToolUtils.h"
+#include "Source/Math/Random.h"
+#include "Source/Renderer/Camera.h"
+#include "Source/Renderer/GeometryNode.h"
+#include "Source/Renderer/Octree.h"
+#include "Source/Renderer/Renderer.h"
+#include "Source/Scene/Scene.h"
+#include "Source/Thread/WorkQueue.h"
+#include "Source/Time/Time.h"
+
+using namespace Auto3D;
+
+/// Default number of geometry nodes.
+static const int DEFAULT_NODE_COUNT = 100000;
+/// Default number of benchmark passes.
+static const int DEFAULT_CULL_BENCHMARK_PASSES = 100;
+/// Half size of the cube the nodes are scattered in. Roughly a third of the nodes are in the camera's view.
+static const float SCENE_EXTENT = 900.0f;
+
+/// Usage text.
+static const char* usageText =
+    "Usage: CullBenchmark [nodes] [passes]\n"
+    "\n"
+    "Create a scene with randomly placed geometry nodes and benchmark collecting the\n"
+    "visible nodes from a camera, first on the main thread only, then with increasing\n"
+    "numbers of worker threads. Reports the time per frame and the speedup compared\n"
+    "to the main thread only. No graphics device is needed.";
+
+void CreateScene(Scene* scene, int count)
+{
+    scene->CreateChild<Octree>();
+
+    SetRandomSeed(1);
+    BoundingBoxF nodeBox(-1.0f, 1.0f);
+    for (int i = 0; i < count; ++i)
+    {
+        GeometryNode* node = scene->CreateChild<GeometryNode>();
+        node->SetLocalBoundingBox(nodeBox);
+        node->SetPosition(Vector3F(Random(2.0f * SCENE_EXTENT), Random(2.0f * SCENE_EXTENT), Random(2.0f * SCENE_EXTENT)) -
+            Vector3F(SCENE_EXTENT, SCENE_EXTENT, SCENE_EXTENT));
+    }
+}
+
+/// Return the average time in microseconds to collect the visible objects.
+long long CollectObjects(Renderer* renderer, Scene* scene, Camera* camera, int passes)
+{
+    // Warm up, so that the octree update and the first allocations are not measured
+    renderer->CollectObjects(scene, camera);
+
+    HiresTimer timer;
+    for (int i = 0; i < passes; ++i)
+        renderer->CollectObjects(scene, camera);
+    return timer.ElapsedUSec(false) / passes;
+}
+
+void Benchmark(int count, int passes)
+{
+    RegisterRendererLibrary();
+
+    AutoPtr<Renderer> renderer(new Renderer());
+    SharedPtr<Scene> scene(new Scene());
+    CreateScene(scene, count);
+    Camera* camera = scene->CreateChild<Camera>();
+
+    long long singleUSec = CollectObjects(renderer, scene, camera, passes);
+    Vector<OctreeNode*> visible;
+    scene->FindChild<Octree>()->FindNodes(visible, camera->GetWorldFrustum(), NF_ENABLED | NF_GEOMETRY);
+    PrintLine(String::Format("%d nodes, %d visible, %d passes", count, (int)visible.Size(), passes));
+    PrintLine(String::Format("%-17s %8.3f ms per frame", "Main thread", singleUSec / 1000.0));
+
+    unsigned maxThreads = Max((int)GetNumLogicalCPUs() - 1, 1);
+    for (unsigned numThreads = 1; ; numThreads = Min(numThreads * 2, maxThreads))
+    {
+        AutoPtr<WorkQueue> workQueue(new WorkQueue());
+        workQueue->CreateThreads(numThreads);
+
+        long long multiUSec = CollectObjects(renderer, scene, camera, passes);
+        PrintLine(String::Format("%2d worker threads %8.3f ms per frame, %5.2fx", (int)numThreads, multiUSec / 1000.0,
+            (double)singleUSec / Max(multiUSec, 1LL)));
+
+        if (numThreads == maxThreads)
+            break;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const Vector<String>& arguments = ParseArguments(argc, argv);
+
+    if (arguments.Size() >= 1 && arguments[0].StartsWith("-"))
+        ExitWithUsage(usageText);
+
+    int count = CountArgument(arguments, 0, DEFAULT_NODE_COUNT);
+    int passes = CountArgument(arguments, 1, DEFAULT_CULL_BENCHMARK_PASSES);
+    Benchmark(count, passes);
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "../Common/ToolUtils.h"
+#include "Source/IO/File.h"
+#include "Source/IO/FileSystem.h"
+#include "Source/Resource/Image.h"
+#include "Source/Thread/WorkQueue.h"
+#include "Source/Time/Time.h"
+
+using namespace Auto3D;
+
+/// Number of image formats.
+static const size_t NUM_FORMATS = ImageFormat::PVRTC_RGBA_4BPP + 1;
+
+/// Names of the compressed formats.
+static const char* compressedFormatNames[] =
+{
+    "DXT1",
+    "DXT3",
+    "DXT5",
+    "ETC1",
+    "PVRTC RGB 2BPP",
+    "PVRTC RGBA 2BPP",
+    "PVRTC RGB 4BPP",
+    "PVRTC RGBA 4BPP"
+};
+
+/// Usage text.
+static const char* usageText =
+    "Usage: DecompressBenchmark <directory> [passes]\n"
+    "\n"
+    "Load every DDS, KTX and PVR image in the directory and benchmark decompressing\n"
+    "the compressed ones to RGBA, first on the main thread only, then with the block\n"
+    "rows split across worker threads. Reports the throughput per format in megabytes\n"
+    "of decompressed data per second.";
+
+void LoadImages(Vector<SharedPtr<Image> >& images, const String& dirName)
+{
+    const char* filters[] = { "*.dds", "*.ktx", "*.pvr" };
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        Vector<String> fileNames;
+        ScanDir(fileNames, dirName, filters[i], SCAN_FILES, true);
+
+        for (auto it = fileNames.Begin(); it != fileNames.End(); ++it)
+        {
+            String fileName = AddTrailingSlash(dirName) + *it;
+            File source(fileName);
+            SharedPtr<Image> image(new Image());
+            if (!source.IsOpen() || !image->Load(source))
+                ErrorExit("Could not load " + fileName);
+            if (image->IsCompressed())
+                images.Push(image);
+        }
+    }
+}
+
+void DecompressImages(const Vector<SharedPtr<Image> >& images, int passes, long long* formatUSec, size_t* formatBytes)
+{
+    HiresTimer timer;
+    Vector<unsigned char> rgbaData;
+
+    for (int i = 0; i < passes; ++i)
+    {
+        for (auto it = images.Begin(); it != images.End(); ++it)
+        {
+            Image* image = it->Get();
+            ImageFormat::Type format = image->GetFormat();
+
+            for (size_t j = 0; j < image->GetNumLevels(); ++j)
+            {
+                ImageLevel level = image->GetLevel(j);
+                size_t levelBytes = level._size._x * level._size._y * 4;
+                if (rgbaData.Size() < levelBytes)
+                    rgbaData.Resize(levelBytes);
+
+                timer.Reset();
+                image->DecompressLevel(&rgbaData[0], j);
+                formatUSec[format] += timer.ElapsedUSec(false);
+                formatBytes[format] += levelBytes;
+            }
+        }
+    }
+}
+
+void Benchmark(const String& dirName, int passes)
+{
+    Vector<SharedPtr<Image> > images;
+    LoadImages(images, dirName);
+    if (images.IsEmpty())
+        ErrorExit("No compressed images found in " + dirName);
+
+    long long singleUSec[NUM_FORMATS] = {};
+    long long multiUSec[NUM_FORMATS] = {};
+    size_t singleBytes[NUM_FORMATS] = {};
+    size_t multiBytes[NUM_FORMATS] = {};
+
+    // Without a work queue subsystem the images decompress on the calling thread
+    DecompressImages(images, passes, singleUSec, singleBytes);
+
+    unsigned numThreads = Max((int)GetNumLogicalCPUs() - 1, 1);
+    AutoPtr<WorkQueue> workQueue(new WorkQueue());
+    workQueue->CreateThreads(numThreads);
+    DecompressImages(images, passes, multiUSec, multiBytes);
+
+    PrintLine(String::Format("%d images, %d passes, %d worker threads", (int)images.Size(), passes, (int)numThreads));
+    for (size_t i = ImageFormat::DXT1; i < NUM_FORMATS; ++i)
+    {
+        if (!singleBytes[i])
+            continue;
+
+        double singleMBps = (double)singleBytes[i] / Max(singleUSec[i], 1LL);
+        double multiMBps = (double)multiBytes[i] / Max(multiUSec[i], 1LL);
+        PrintLine(String::Format("%-16s %8.1f MB/s single-threaded, %8.1f MB/s multithreaded", compressedFormatNames[i - ImageFormat::DXT1],
+            singleMBps, multiMBps));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const Vector<String>& arguments = ParseArguments(argc, argv);
+
+    if (arguments.Size() >= 1 && !arguments[0].StartsWith("-"))
+        Benchmark(arguments[0], CountArgument(arguments, 1));
+    else
+        ExitWithUsage(usageText);
+
+    return 0;
+}
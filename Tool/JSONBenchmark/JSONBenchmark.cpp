@@ -0,0 +1,383 @@
+#include "../Common/ToolUtils.h"
+#include "Source/IO/File.h"
+#include "Source/IO/JSONDocument.h"
+#include "Source/IO/JSONReader.h"
+#include "Source/IO/JSONValue.h"
+#include "Source/Time/Time.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Auto3D;
+
+/// JSON handler that only counts the parse events, to measure the reader alone.
+class CountingHandler : public JSONHandler
+{
+public:
+    /// Construct.
+    CountingHandler() :
+        _numValues(0)
+    {
+    }
+
+    /// Handle a null value.
+    bool OnNull() override { ++_numValues; return true; }
+    /// Handle a boolean value.
+    bool OnBool(bool) override { ++_numValues; return true; }
+    /// Handle a number value.
+    bool OnNumber(double) override { ++_numValues; return true; }
+    /// Handle a vector2 value.
+    bool OnVector2(const Vector2F&) override { ++_numValues; return true; }
+    /// Handle a vector3 value.
+    bool OnVector3(const Vector3F&) override { ++_numValues; return true; }
+    /// Handle a vector4 value.
+    bool OnVector4(const Vector4F&) override { ++_numValues; return true; }
+    /// Handle a string value.
+    bool OnString(const char*, size_t) override { ++_numValues; return true; }
+    /// Handle the start of an array.
+    bool OnStartArray() override { return true; }
+    /// Handle the end of an array.
+    bool OnEndArray(size_t) override { ++_numValues; return true; }
+    /// Handle the start of an object.
+    bool OnStartObject() override { return true; }
+    /// Handle the key of an object member.
+    bool OnKey(const char*, size_t) override { return true; }
+    /// Handle the end of an object.
+    bool OnEndObject(size_t) override { ++_numValues; return true; }
+
+    /// Number of values parsed.
+    size_t _numValues;
+};
+
+/// The recursive JSONValue parser that JSONReader replaced, kept as the baseline. Each array element and object member is parsed into a temporary value and deep-copied into its parent.
+class OldJSONParser
+{
+public:
+    /// Parse a value. Return true on success.
+    static bool Parse(JSONValue& dest, const char*& pos, const char* end)
+    {
+        char c;
+
+        // Handle comments
+        for (;;)
+        {
+            if (!NextChar(c, pos, end, true))
+                return false;
+
+            if (c == '/')
+            {
+                if (!NextChar(c, pos, end, false))
+                    return false;
+                if (c == '/')
+                {
+                    if (!MatchChar('\n', pos, end))
+                        return false;
+                }
+                else if (c == '*')
+                {
+                    if (!MatchChar('*', pos, end) || !MatchChar('/', pos, end))
+                        return false;
+                }
+                else
+                    return false;
+            }
+            else
+                break;
+        }
+
+        if (c == 'v')
+        {
+            float values[4];
+            if (MatchString("ec2", pos, end))
+            {
+                if (!ReadVector(values, 2, pos, end))
+                    return false;
+                dest = Vector2F(values[0], values[1]);
+                return true;
+            }
+            else if (MatchString("ec3", pos, end))
+            {
+                if (!ReadVector(values, 3, pos, end))
+                    return false;
+                dest = Vector3F(values[0], values[1], values[2]);
+                return true;
+            }
+            else if (MatchString("ec4", pos, end))
+            {
+                if (!ReadVector(values, 4, pos, end))
+                    return false;
+                dest = Vector4F(values[0], values[1], values[2], values[3]);
+                return true;
+            }
+            return false;
+        }
+        else if (c == 'n')
+        {
+            dest.SetNull();
+            return MatchString("ull", pos, end);
+        }
+        else if (c == 'f')
+        {
+            dest = false;
+            return MatchString("alse", pos, end);
+        }
+        else if (c == 't')
+        {
+            dest = true;
+            return MatchString("rue", pos, end);
+        }
+        else if (IsDigit(c) || c == '-')
+        {
+            --pos;
+            dest = strtod(pos, const_cast<char**>(&pos));
+            return true;
+        }
+        else if (c == '\"')
+        {
+            String value;
+            if (!ReadString(value, pos, end, true))
+                return false;
+            dest = value;
+            return true;
+        }
+        else if (c == '[')
+        {
+            dest.SetEmptyArray();
+            if (!NextChar(c, pos, end, true))
+                return false;
+            if (c == ']')
+                return true;
+            --pos;
+
+            for (;;)
+            {
+                JSONValue arrayValue;
+                if (!Parse(arrayValue, pos, end))
+                    return false;
+                dest.Push(arrayValue);
+                if (!NextChar(c, pos, end, true))
+                    return false;
+                if (c == ']')
+                    return true;
+                else if (c != ',')
+                    return false;
+            }
+        }
+        else if (c == '{')
+        {
+            dest.SetEmptyObject();
+            if (!NextChar(c, pos, end, true))
+                return false;
+            if (c == '}')
+                return true;
+            --pos;
+
+            for (;;)
+            {
+                String key;
+                if (!ReadString(key, pos, end, false) || !NextChar(c, pos, end, true) || c != ':')
+                    return false;
+                JSONValue objectValue;
+                if (!Parse(objectValue, pos, end))
+                    return false;
+                dest[key] = objectValue;
+                if (!NextChar(c, pos, end, true))
+                    return false;
+                if (c == '}')
+                    return true;
+                else if (c != ',')
+                    return false;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    /// Get the next char. Return false if the text ended.
+    static bool NextChar(char& dest, const char*& pos, const char* end, bool skipWhiteSpace)
+    {
+        while (pos < end)
+        {
+            dest = *pos++;
+            if (!skipWhiteSpace || dest > 0x20)
+                return true;
+        }
+        return false;
+    }
+
+    /// Skip past the next occurrence of a char. Return false if not found.
+    static bool MatchChar(char c, const char*& pos, const char* end)
+    {
+        char next;
+        while (NextChar(next, pos, end, false))
+        {
+            if (next == c)
+                return true;
+        }
+        return false;
+    }
+
+    /// Match a string at the current position. Return false if it does not match.
+    static bool MatchString(const char* str, const char*& pos, const char* end)
+    {
+        const char* start = pos;
+        for (; *str; ++str, ++pos)
+        {
+            if (pos >= end || *pos != *str)
+            {
+                pos = start;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Read the parenthesized components of a vector value.
+    static bool ReadVector(float* dest, int numComponents, const char*& pos, const char* end)
+    {
+        char c;
+        if (!NextChar(c, pos, end, true) || c != '(')
+            return false;
+
+        for (int i = 0; i < numComponents; ++i)
+        {
+            if (!NextChar(c, pos, end, true) || !(IsDigit(c) || c == '-'))
+                return false;
+            --pos;
+            dest[i] = (float)strtod(pos, const_cast<char**>(&pos));
+            if (!NextChar(c, pos, end, true) || c != (i < numComponents - 1 ? ',' : ')'))
+                return false;
+        }
+        return true;
+    }
+
+    /// Read a string one char at a time, decoding the escapes.
+    static bool ReadString(String& dest, const char*& pos, const char* end, bool inQuote)
+    {
+        char c;
+        if (!inQuote && (!NextChar(c, pos, end, true) || c != '\"'))
+            return false;
+
+        dest.Clear();
+        for (;;)
+        {
+            if (!NextChar(c, pos, end, false))
+                return false;
+            if (c == '\"')
+                return true;
+            else if (c != '\\')
+                dest += c;
+            else
+            {
+                if (!NextChar(c, pos, end, false))
+                    return false;
+                switch (c)
+                {
+                case 'b': dest += '\b'; break;
+                case 'f': dest += '\f'; break;
+                case 'n': dest += '\n'; break;
+                case 'r': dest += '\r'; break;
+                case 't': dest += '\t'; break;
+                case 'u':
+                    {
+                        unsigned code = 0;
+                        sscanf(pos, "%x", &code);
+                        pos += 4;
+                        dest.AppendUTF8(code);
+                    }
+                    break;
+                default: dest += c; break;
+                }
+            }
+        }
+    }
+};
+
+/// Usage text.
+static const char* usageText =
+    "Usage: JSONBenchmark <file> [passes]\n"
+    "\n"
+    "Parse a JSON file repeatedly from memory and report the throughput in megabytes\n"
+    "of text per second for the event-based reader alone, for building a JSONValue\n"
+    "tree with the old recursive parser as the baseline and with the reader, and for\n"
+    "building an arena-backed JSONDocument.";
+
+/// Report the throughput of one benchmark.
+void Report(const char* name, size_t dataSize, int passes, long long usec)
+{
+    double mbps = (double)dataSize * passes / Max(usec, 1LL);
+    PrintLine(String::Format("%-14s %8.1f MB/s", name, mbps));
+}
+
+void Benchmark(const String& fileName, int passes)
+{
+    File source(fileName);
+    if (!source.IsOpen())
+        ErrorExit("Could not open " + fileName);
+
+    size_t dataSize = source.Size();
+    AutoArrayPtr<char> data(new char[dataSize]);
+    if (source.Read(data.Get(), dataSize) != dataSize)
+        ErrorExit("Could not read " + fileName);
+
+    HiresTimer timer;
+    JSONReader reader;
+
+    CountingHandler counter;
+    timer.Reset();
+    for (int i = 0; i < passes; ++i)
+    {
+        if (!reader.Parse(data.Get(), dataSize, counter))
+            ErrorExit("Parsing " + fileName + " failed on line " + String(reader.ErrorLine()));
+    }
+    long long readerUSec = timer.ElapsedUSec(false);
+
+    timer.Reset();
+    for (int i = 0; i < passes; ++i)
+    {
+        JSONValue value;
+        const char* pos = data.Get();
+        if (!OldJSONParser::Parse(value, pos, data.Get() + dataSize))
+            ErrorExit("Parsing " + fileName + " with the old parser failed");
+    }
+    long long oldValueUSec = timer.ElapsedUSec(false);
+
+    timer.Reset();
+    for (int i = 0; i < passes; ++i)
+    {
+        JSONValue value;
+        JSONValueBuilder builder(value);
+        reader.Parse(data.Get(), dataSize, builder);
+    }
+    long long valueUSec = timer.ElapsedUSec(false);
+
+    size_t memoryUse = 0;
+    timer.Reset();
+    for (int i = 0; i < passes; ++i)
+    {
+        JSONDocument document;
+        document.Parse(data.Get(), dataSize);
+        memoryUse = document.MemoryUse();
+    }
+    long long documentUSec = timer.ElapsedUSec(false);
+
+    PrintLine(String::Format("%s: %d bytes, %d values, %d passes", fileName.CString(), (int)dataSize, (int)(counter._numValues / passes), passes));
+    Report("JSONReader", dataSize, passes, readerUSec);
+    Report("JSONValue old", dataSize, passes, oldValueUSec);
+    Report("JSONValue", dataSize, passes, valueUSec);
+    Report("JSONDocument", dataSize, passes, documentUSec);
+    PrintLine(String::Format("JSONDocument arena size %d bytes", (int)memoryUse));
+}
+
+int main(int argc, char** argv)
+{
+    const Vector<String>& arguments = ParseArguments(argc, argv);
+
+    if (arguments.Size() >= 1 && !arguments[0].StartsWith("-"))
+        Benchmark(arguments[0], CountArgument(arguments, 1));
+    else
+        ExitWithUsage(usageText);
+
+    return 0;
+}
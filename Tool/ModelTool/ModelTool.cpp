@@ -0,0 +1,117 @@
+#include "../Common/ToolUtils.h"
+#include "Source/IO/File.h"
+#include "Source/IO/FileSystem.h"
+#include "Source/IO/MappedFile.h"
+#include "Source/Renderer/Model.h"
+#include "Source/Renderer/ModelFormat.h"
+#include "Source/Time/Time.h"
+
+using namespace Auto3D;
+
+/// Default number of benchmark passes.
+static const int DEFAULT_MODEL_BENCHMARK_PASSES = 20;
+
+/// Usage text.
+static const char* usageText =
+    "Usage: ModelTool <input> <output>\n"
+    "       ModelTool -b <directory> <output directory> [passes]\n"
+    "\n"
+    "Convert a UMDL model to the binary model format.\n"
+    "\n"
+    "Options:\n"
+    "-b  Convert every UMDL model in the directory to the output directory, then benchmark\n"
+    "    loading the converted models against the originals";
+
+bool IsLegacyModel(const String& fileName)
+{
+    File source(fileName);
+    return source.IsOpen() && source.Size() >= 4 && source.ReadFileID() == "UMDL";
+}
+
+void Convert(const String& inputName, const String& outputName)
+{
+    File source(inputName);
+    if (!source.IsOpen())
+        ErrorExit("Could not open " + inputName);
+
+    // Without a Graphics subsystem the buffers only define their shadow data, which is what Save() writes
+    SharedPtr<Model> model(new Model());
+    model->SetName(inputName);
+    if (!model->Load(source))
+        ErrorExit("Could not load " + inputName);
+
+    File dest(outputName, FileMode::WRITE);
+    if (!dest.IsOpen())
+        ErrorExit("Could not open " + outputName + " for writing");
+    if (!model->Save(dest))
+        ErrorExit("Could not save " + outputName);
+}
+
+/// Load a model through a mapped file like the resource cache does and return the time taken in microseconds.
+long long TimeLoad(const String& fileName, HiresTimer& timer)
+{
+    timer.Reset();
+    MappedFile source(fileName);
+    SharedPtr<Model> model(new Model());
+    if (!source.IsOpen() || !model->Load(source))
+        ErrorExit("Could not load " + fileName);
+    return timer.ElapsedUSec(false);
+}
+
+void Benchmark(const String& dirName, const String& outputDirName, int passes)
+{
+    if (!DirExists(outputDirName))
+        ErrorExit("Output directory " + outputDirName + " does not exist");
+
+    Vector<String> fileNames;
+    ScanDir(fileNames, dirName, "*.mdl", SCAN_FILES, true);
+
+    Vector<String> legacyNames;
+    Vector<String> convertedNames;
+    for (auto it = fileNames.Begin(); it != fileNames.End(); ++it)
+    {
+        String legacyName = AddTrailingSlash(dirName) + *it;
+        if (!IsLegacyModel(legacyName))
+            continue;
+
+        String convertedName = AddTrailingSlash(outputDirName) + FileNameAndExtension(*it);
+        Convert(legacyName, convertedName);
+        legacyNames.Push(legacyName);
+        convertedNames.Push(convertedName);
+    }
+
+    if (legacyNames.IsEmpty())
+        ErrorExit("No UMDL models found in " + dirName);
+
+    HiresTimer timer;
+    long long legacyUSec = 0;
+    long long convertedUSec = 0;
+
+    // Alternate the two so that neither gets an unfair advantage from the OS file cache warming up
+    for (int i = 0; i < passes; ++i)
+    {
+        for (size_t j = 0; j < legacyNames.Size(); ++j)
+        {
+            legacyUSec += TimeLoad(legacyNames[j], timer);
+            convertedUSec += TimeLoad(convertedNames[j], timer);
+        }
+    }
+
+    PrintLine(String::Format("%d models, %d passes", (int)legacyNames.Size(), passes));
+    PrintLine(String::Format("UMDL:   %.3f ms per pass", legacyUSec / 1000.0 / passes));
+    PrintLine(String::Format("Binary: %.3f ms per pass", convertedUSec / 1000.0 / passes));
+}
+
+int main(int argc, char** argv)
+{
+    const Vector<String>& arguments = ParseArguments(argc, argv);
+
+    if (arguments.Size() >= 3 && arguments[0] == "-b")
+        Benchmark(arguments[1], arguments[2], CountArgument(arguments, 3, DEFAULT_MODEL_BENCHMARK_PASSES));
+    else if (arguments.Size() >= 2 && !arguments[0].StartsWith("-"))
+        Convert(arguments[0], arguments[1]);
+    else
+        ExitWithUsage(usageText);
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "../Common/ToolUtils.h"
+#include "Source/Scene/Scene.h"
+#include "Source/Scene/SpatialNode.h"
+
+using namespace Auto3D;
+
+/// Default number of nodes to create.
+static const int DEFAULT_NODE_COUNT = 100000;
+
+/// Node's data members in their order before the layer and tag name registries moved to Scene. The id before the name also left padding on 64-bit.
+struct OldNodeLayout : public Serializable
+{
+    Vector<String> _layerNames;
+    HashMap<String, unsigned char> _layers;
+    Vector<String> _tagNames;
+    HashMap<String, unsigned char> _tags;
+    Node* _parent;
+    Scene* _scenes;
+    Vector<SharedPtr<Node> > _children;
+    unsigned _id;
+    String _name;
+    unsigned short _flags;
+    unsigned char _layer;
+    unsigned char _tag;
+};
+
+/// Node's data members in their current order.
+struct NewNodeLayout : public Serializable
+{
+    Node* _parent;
+    Scene* _scenes;
+    Vector<SharedPtr<Node> > _children;
+    String _name;
+    unsigned _id;
+    unsigned short _flags;
+    unsigned char _layer;
+    unsigned char _tag;
+};
+
+/// SpatialNode's data members on top of either Node layout.
+template <typename _Ty> struct SpatialNodeLayout : public _Ty
+{
+    Matrix3x4F _worldTransform;
+    Vector3F _position;
+    Quaternion _rotation;
+    Vector3F _scale;
+};
+
+// The current layouts must match the real classes, so that the old layouts are reconstructed the same way. Subclass sizes can not
+// be derived from the size of Node alone, as subclass members may be placed in the tail padding of the base class
+static_assert(sizeof(NewNodeLayout) == sizeof(Node), "NewNodeLayout does not match the members of Node");
+static_assert(sizeof(SpatialNodeLayout<NewNodeLayout>) == sizeof(SpatialNode), "SpatialNodeLayout does not match the members of SpatialNode");
+
+/// Usage text.
+static const char* usageText =
+    "Usage: NodeMemoryReport [count]\n"
+    "\n"
+    "Report the size of Node and SpatialNode before and after the layer and tag\n"
+    "name registries moved from every node to the scene, and the bytes per node in a\n"
+    "hierarchy of spatial nodes under one parent. The old sizes are reconstructed\n"
+    "from the old member layout of Node. The same reconstruction of the current layout\n"
+    "is checked against the real classes at compile time. Other heap memory and\n"
+    "allocator overhead are not included.";
+
+/// Report the size of a class in the old and current layout.
+void ReportSize(const char* name, size_t size, size_t oldSize)
+{
+    PrintLine(String::Format("%-14s %6d bytes, %6d before, %3d saved", name, (int)size, (int)oldSize, (int)(oldSize - size)));
+}
+
+void Report(int count)
+{
+    ReportSize("Node", sizeof(Node), sizeof(OldNodeLayout));
+    ReportSize("SpatialNode", sizeof(SpatialNode), sizeof(SpatialNodeLayout<OldNodeLayout>));
+
+    // The nodes are not in a scene, so no subsystems are needed. Count the nodes themselves and their references in the parent's child vector
+    SharedPtr<Node> root(new Node());
+    for (int i = 0; i < count; ++i)
+        root->AddChild(new SpatialNode());
+
+    // The vector buffer starts with the size and capacity
+    size_t childBytes = root->Children().Capacity() * sizeof(SharedPtr<Node>) + 2 * sizeof(size_t);
+    size_t totalBytes = count * sizeof(SpatialNode) + childBytes;
+    size_t oldTotalBytes = totalBytes + count * (sizeof(SpatialNodeLayout<OldNodeLayout>) - sizeof(SpatialNode));
+    PrintLine(String::Format("%d spatial nodes: %d bytes, %.1f bytes per node; before %d bytes, %.1f bytes per node", count,
+        (int)totalBytes, (double)totalBytes / count, (int)oldTotalBytes, (double)oldTotalBytes / count));
+}
+
+int main(int argc, char** argv)
+{
+    const Vector<String>& arguments = ParseArguments(argc, argv);
+
+    if (arguments.Size() >= 1 && arguments[0].StartsWith("-"))
+        ExitWithUsage(usageText);
+
+    int count = CountArgument(arguments, 0, DEFAULT_NODE_COUNT);
+    Report(count);
+
+    return 0;
+}
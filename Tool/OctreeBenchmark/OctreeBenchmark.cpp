@@ -0,0 +1,133 @@
+#include "../Common/ToolUtils.h"
+#include "Source/Math/Random.h"
+#include "Source/Math/Sphere.h"
+#include "Source/Renderer/Camera.h"
+#include "Source/Renderer/GeometryNode.h"
+#include "Source/Renderer/Octree.h"
+#include "Source/Renderer/Renderer.h"
+#include "Source/Scene/Scene.h"
+#include "Source/Time/Time.h"
+
+using namespace Auto3D;
+
+/// Default number of geometry nodes.
+static const int DEFAULT_NODE_COUNT = 100000;
+/// Default number of queries of each kind.
+static const int DEFAULT_QUERY_COUNT = 1000;
+/// Half size of the cube the nodes are scattered in.
+static const float SCENE_EXTENT = 900.0f;
+/// Radius of the sphere queries.
+static const float SPHERE_RADIUS = 50.0f;
+/// Node flags required by the queries.
+static const unsigned short QUERY_FLAGS = NF_ENABLED | NF_GEOMETRY;
+
+/// Result of the octant hierarchy traversal.
+static Vector<OctreeNode*> hierarchyResult;
+/// Query volume of the octant hierarchy traversal.
+static const void* hierarchyVolume = nullptr;
+
+/// Usage text.
+static const char* usageText =
+    "Usage: OctreeBenchmark [nodes] [queries]\n"
+    "\n"
+    "Create a scene with randomly placed geometry nodes and benchmark frustum and\n"
+    "sphere queries. Each query is run both by walking the octant hierarchy and\n"
+    "testing the nodes through their own bounds, as the octree did before it was\n"
+    "linearized, and through Octree::FindNodes(), which walks the linearized octants\n"
+    "and tests the bounds cached in the octants.";
+
+/// Octant callback that tests the nodes like the recursive query did before the octree was linearized.
+template <typename _Ty> void CollectHierarchyNodes(Vector<OctreeNode*>::ConstIterator begin, Vector<OctreeNode*>::ConstIterator end, bool inside)
+{
+    const _Ty& volume = *static_cast<const _Ty*>(hierarchyVolume);
+    for (auto it = begin; it != end; ++it)
+    {
+        OctreeNode* node = *it;
+        if ((node->Flags() & QUERY_FLAGS) == QUERY_FLAGS && (node->GetLayerMask() & LAYERMASK_ALL) && (inside ||
+            volume.IsInsideFast(node->WorldBoundingBox()) != OUTSIDE))
+            hierarchyResult.Push(node);
+    }
+}
+
+/// Run the queries both ways, print the time per query and check that the results match.
+template <typename _Ty> void BenchmarkQueries(Octree* octree, const Vector<_Ty>& volumes, const char* name)
+{
+    Vector<OctreeNode*> linearResult;
+    HiresTimer timer;
+    long long hierarchyUSec = 0;
+    long long linearUSec = 0;
+    size_t numFound = 0;
+    size_t numMismatches = 0;
+
+    for (auto it = volumes.Begin(); it != volumes.End(); ++it)
+    {
+        hierarchyResult.Clear();
+        hierarchyVolume = &(*it);
+        timer.Reset();
+        octree->FindNodes(*it, &CollectHierarchyNodes<_Ty>);
+        hierarchyUSec += timer.ElapsedUSec(false);
+
+        linearResult.Clear();
+        timer.Reset();
+        octree->FindNodes(linearResult, *it, QUERY_FLAGS);
+        linearUSec += timer.ElapsedUSec(false);
+
+        numFound += linearResult.Size();
+        if (linearResult.Size() != hierarchyResult.Size())
+            ++numMismatches;
+    }
+
+    double numQueries = (double)volumes.Size();
+    PrintLine(String::Format("%-8s %8.0f nodes per query, %8.2f us hierarchy, %8.2f us linearized, %5.2fx", name, numFound / numQueries,
+        hierarchyUSec / numQueries, linearUSec / numQueries, (double)hierarchyUSec / Max(linearUSec, 1LL)));
+    if (numMismatches)
+        PrintLine(String::Format("%d %s queries returned a different number of nodes", (int)numMismatches, name));
+}
+
+void Benchmark(int count, int queries)
+{
+    RegisterRendererLibrary();
+
+    SharedPtr<Scene> scene(new Scene());
+    Octree* octree = scene->CreateChild<Octree>();
+    Camera* camera = scene->CreateChild<Camera>();
+
+    SetRandomSeed(1);
+    BoundingBoxF nodeBox(-1.0f, 1.0f);
+    Vector3F offset(SCENE_EXTENT, SCENE_EXTENT, SCENE_EXTENT);
+    for (int i = 0; i < count; ++i)
+    {
+        GeometryNode* node = scene->CreateChild<GeometryNode>();
+        node->SetLocalBoundingBox(nodeBox);
+        node->SetPosition(Vector3F(Random(2.0f * SCENE_EXTENT), Random(2.0f * SCENE_EXTENT), Random(2.0f * SCENE_EXTENT)) - offset);
+    }
+    octree->Update();
+
+    Vector<Frustum> frustums;
+    Vector<Sphere> spheres;
+    for (int i = 0; i < queries; ++i)
+    {
+        camera->SetRotation(Quaternion(Random(180.0f) - 90.0f, Random(360.0f), 0.0f));
+        frustums.Push(camera->GetWorldFrustum());
+        spheres.Push(Sphere(Vector3F(Random(2.0f * SCENE_EXTENT), Random(2.0f * SCENE_EXTENT), Random(2.0f * SCENE_EXTENT)) - offset,
+            SPHERE_RADIUS));
+    }
+
+    PrintLine(String::Format("%d nodes, %d octants, %d queries of each kind", count, (int)octree->LinearOctants().Size(), queries));
+    BenchmarkQueries(octree, frustums, "Frustum");
+    BenchmarkQueries(octree, spheres, "Sphere");
+}
+
+int main(int argc, char** argv)
+{
+    const Vector<String>& arguments = ParseArguments(argc, argv);
+
+    if (arguments.Size() >= 1 && arguments[0].StartsWith("-"))
+        ExitWithUsage(usageText);
+
+    int count = CountArgument(arguments, 0, DEFAULT_NODE_COUNT);
+    int queries = CountArgument(arguments, 1, DEFAULT_QUERY_COUNT);
+    Benchmark(count, queries);
+
+    return 0;
+}
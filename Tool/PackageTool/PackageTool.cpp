@@ -0,0 +1,163 @@
+#include "../Common/ToolUtils.h"
+#include "Source/IO/File.h"
+#include "Source/IO/FileSystem.h"
+#include "Source/IO/PackageFile.h"
+#include "Source/Time/Time.h"
+
+#include <lz4.h>
+#include <lz4hc.h>
+
+using namespace Auto3D;
+
+/// Entries must shrink at least this much to be stored compressed.
+static const float MIN_COMPRESSION_RATIO = 0.9f;
+/// Default number of benchmark passes.
+static const int DEFAULT_PACKAGE_BENCHMARK_PASSES = 5;
+
+/// Usage text.
+static const char* usageText =
+    "Usage: PackageTool <directory> <package> [-c]\n"
+    "       PackageTool -b <directory> <package> [passes]\n"
+    "\n"
+    "Pack all files in the directory and its subdirectories. Resource names are the\n"
+    "file paths relative to the directory.\n"
+    "\n"
+    "Options:\n"
+    "-c  Compress entries with LZ4 when it saves space\n"
+    "-b  Benchmark reading every packed file from the package against the loose files";
+
+void Pack(const String& dirName, const String& packageName, bool compress)
+{
+    Vector<String> fileNames;
+    ScanDir(fileNames, dirName, "*", SCAN_FILES, true);
+    if (fileNames.IsEmpty())
+        ErrorExit("No files found in " + dirName);
+
+    File dest(packageName, FileMode::WRITE);
+    if (!dest.IsOpen())
+        ErrorExit("Could not open " + packageName + " for writing");
+
+    // The directory offset is patched after writing the entries
+    dest.WriteFileID(PACKAGE_FILE_ID);
+    dest.Write<unsigned>(PACKAGE_FILE_VERSION);
+    dest.Write<unsigned>((unsigned)fileNames.Size());
+    size_t directoryOffsetPosition = dest.Position();
+    dest.Write<unsigned long long>(0);
+
+    Vector<PackageEntry> entries;
+    Vector<unsigned char> data;
+    Vector<unsigned char> packedData;
+    unsigned char padding[PACKAGE_ENTRY_ALIGNMENT] = { 0 };
+    unsigned long long totalSize = 0;
+    unsigned long long totalStoredSize = 0;
+
+    for (auto it = fileNames.Begin(); it != fileNames.End(); ++it)
+    {
+        String fileName = AddTrailingSlash(dirName) + *it;
+        File source(fileName);
+        if (!source.IsOpen())
+            ErrorExit("Could not open " + fileName);
+
+        data.Resize(source.Size());
+        if (data.Size() && source.Read(&data[0], data.Size()) != data.Size())
+            ErrorExit("Could not read " + fileName);
+
+        size_t misalignment = dest.Position() % PACKAGE_ENTRY_ALIGNMENT;
+        if (misalignment)
+            dest.Write(padding, PACKAGE_ENTRY_ALIGNMENT - misalignment);
+
+        PackageEntry entry;
+        entry._name = *it;
+        entry._offset = dest.Position();
+        entry._size = (unsigned)data.Size();
+        entry._packedSize = 0;
+
+        if (compress && data.Size())
+        {
+            packedData.Resize(LZ4_compressBound((int)data.Size()));
+            int packedSize = LZ4_compress_HC((const char*)&data[0], (char*)&packedData[0], (int)data.Size(),
+                (int)packedData.Size(), LZ4HC_CLEVEL_DEFAULT);
+            if (packedSize > 0 && packedSize < data.Size() * MIN_COMPRESSION_RATIO)
+                entry._packedSize = (unsigned)packedSize;
+        }
+
+        if (entry._packedSize)
+            dest.Write(&packedData[0], entry._packedSize);
+        else if (data.Size())
+            dest.Write(&data[0], data.Size());
+
+        totalSize += entry._size;
+        totalStoredSize += entry._packedSize ? entry._packedSize : entry._size;
+        entries.Push(entry);
+    }
+
+    unsigned long long directoryOffset = dest.Position();
+    for (auto it = entries.Begin(); it != entries.End(); ++it)
+    {
+        dest.Write(it->_name);
+        dest.Write(it->_offset);
+        dest.Write(it->_size);
+        dest.Write(it->_packedSize);
+    }
+
+    dest.Seek(directoryOffsetPosition);
+    dest.Write(directoryOffset);
+    dest.Close();
+
+    PrintLine(String::Format("Packed %d files, %llu bytes stored as %llu bytes", (int)entries.Size(), totalSize,
+        totalStoredSize));
+}
+
+void Benchmark(const String& dirName, const String& packageName, int passes)
+{
+    PackageFile package;
+    if (!package.Open(packageName))
+        ErrorExit("Could not open package " + packageName);
+
+    const HashMap<StringHash, PackageEntry>& entries = package.Entries();
+    Vector<unsigned char> data;
+    HiresTimer timer;
+    long long looseUSec = 0;
+    long long packageUSec = 0;
+
+    // Alternate the two so that neither gets an unfair advantage from the OS file cache warming up
+    for (int i = 0; i < passes; ++i)
+    {
+        timer.Reset();
+        for (auto it = entries.Begin(); it != entries.End(); ++it)
+        {
+            File source(AddTrailingSlash(dirName) + it->_second._name);
+            data.Resize(source.Size());
+            if (data.Size())
+                source.Read(&data[0], data.Size());
+        }
+        looseUSec += timer.ElapsedUSec(true);
+
+        for (auto it = entries.Begin(); it != entries.End(); ++it)
+        {
+            AutoPtr<Stream> source = package.OpenEntry(it->_second._name);
+            data.Resize(source ? source->Size() : 0);
+            if (data.Size())
+                source->Read(&data[0], data.Size());
+        }
+        packageUSec += timer.ElapsedUSec(true);
+    }
+
+    PrintLine(String::Format("%d files, %d passes", (int)entries.Size(), passes));
+    PrintLine(String::Format("Loose files: %.3f ms per pass", looseUSec / 1000.0 / passes));
+    PrintLine(String::Format("Package:     %.3f ms per pass", packageUSec / 1000.0 / passes));
+}
+
+int main(int argc, char** argv)
+{
+    const Vector<String>& arguments = ParseArguments(argc, argv);
+
+    if (arguments.Size() >= 3 && arguments[0] == "-b")
+        Benchmark(arguments[1], arguments[2], CountArgument(arguments, 3, DEFAULT_PACKAGE_BENCHMARK_PASSES));
+    else if (arguments.Size() >= 2 && !arguments[0].StartsWith("-"))
+        Pack(arguments[0], arguments[1], arguments.Size() >= 3 && arguments[2] == "-c");
+    else
+        ExitWithUsage(usageText);
+
+    return 0;
+}